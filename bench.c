@@ -0,0 +1,96 @@
+#include "bench.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+void bench_stats_compute(double *samples, int count, struct bench_stats *stats)
+{
+    double sum = 0.0;
+
+    if (count <= 0) {
+        stats->min = stats->median = stats->p95 = stats->p99 = stats->max = stats->mean = 0.0;
+        return;
+    }
+
+    qsort(samples, count, sizeof(*samples), compare_doubles);
+
+    for (int i = 0; i < count; i++) {
+        sum += samples[i];
+    }
+
+    int p95_rank = (count * 95 + 99) / 100; // ceil(0.95 * count)
+    int p99_rank = (count * 99 + 99) / 100; // ceil(0.99 * count)
+
+    stats->min = samples[0];
+    stats->max = samples[count - 1];
+    stats->mean = sum / count;
+    stats->median = count % 2 ? samples[count / 2]
+                              : 0.5 * (samples[count / 2 - 1] + samples[count / 2]);
+    stats->p95 = samples[p95_rank - 1];
+    stats->p99 = samples[p99_rank - 1];
+}
+
+glc_context *bench_context_create(void)
+{
+    glc_attrib attribs[] = {
+        GLC_ATTRIB_CORE_PROFILE,
+        GLC_ATTRIB_END
+    };
+    glc_pixel_format *pixel_format;
+    GLint number_pixel_formats = 0;
+    glc_context *context = NULL;
+
+    if (glc_choose_pixel_format(attribs, &pixel_format, &number_pixel_formats) != GLC_NO_ERROR) {
+        return NULL;
+    }
+    glc_error err = glc_create_context(pixel_format, NULL, &context);
+    glc_destroy_pixel_format(pixel_format);
+
+    if (err != GLC_NO_ERROR) {
+        return NULL;
+    }
+    if (glc_set_current_context(context) != GLC_NO_ERROR) {
+        glc_destroy_context(context);
+        return NULL;
+    }
+    return context;
+}
+
+void bench_context_destroy(glc_context *context)
+{
+    glc_destroy_context(context);
+}
+
+int bench_has_gl(int major, int minor, const char *extension)
+{
+    GLint context_major = 0, context_minor = 0, extensions = 0;
+
+    glGetIntegerv(GL_MAJOR_VERSION, &context_major);
+    glGetIntegerv(GL_MINOR_VERSION, &context_minor);
+    if (context_major > major || (context_major == major && context_minor >= minor)) {
+        return 1;
+    }
+
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+    for (GLint i = 0; i < extensions; i++) {
+        if (strcmp((const char *) glGetStringi(GL_EXTENSIONS, i), extension) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
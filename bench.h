@@ -0,0 +1,68 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+#include "glc.h"
+
+/*
+ * Shared plumbing for open_gl_bench. Each benchmark lives in its own
+ * bench_*.c, is declared at the bottom of this header and listed in the
+ * table in bench_main.c.
+ */
+
+struct bench_options {
+    int repeat;     /* timed runs per configuration */
+    int warmup;     /* untimed runs before the timed ones */
+    int quick;      /* only the smallest points of every sweep */
+};
+
+struct bench_stats {
+    double min;
+    double median;
+    double p95;
+    double p99;
+    double max;
+    double mean;
+};
+
+/* Monotonic clock. */
+uint64_t bench_now_ns(void);
+
+/* Sorts samples in place. p95 and p99 are nearest-rank percentiles. */
+void bench_stats_compute(double *samples, int count, struct bench_stats *stats);
+
+/* Creates a core profile context and makes it current. NULL on failure. */
+glc_context *bench_context_create(void);
+void bench_context_destroy(glc_context *context);
+
+/* Whether the current context is at least major.minor or lists extension. */
+int bench_has_gl(int major, int minor, const char *extension);
+
+/* ARB_pipeline_statistics_query, core in 4.6; macOS headers stop at 4.1. */
+#ifndef GL_VERTEX_SHADER_INVOCATIONS
+#define GL_VERTEX_SHADER_INVOCATIONS 0x82F0
+#endif
+
+/* Benchmarks. Each returns 0 on success. */
+int bench_bind(const struct bench_options *options);
+int bench_buffer_readback(const struct bench_options *options);
+int bench_compare(const struct bench_options *options);
+int bench_context(const struct bench_options *options);
+int bench_draw(const struct bench_options *options);
+int bench_errors(const struct bench_options *options);
+int bench_feedback(const struct bench_options *options);
+int bench_frame_loop(const struct bench_options *options);
+int bench_geometry(const struct bench_options *options);
+int bench_loader(const struct bench_options *options);
+int bench_program_cache(const struct bench_options *options);
+int bench_readback(const struct bench_options *options);
+int bench_reference(const struct bench_options *options);
+int bench_render_targets(const struct bench_options *options);
+int bench_shader_corpus(const struct bench_options *options);
+int bench_stream(const struct bench_options *options);
+int bench_texture_upload(const struct bench_options *options);
+int bench_trace(const struct bench_options *options);
+int bench_vertex_layout(const struct bench_options *options);
+
+#endif
@@ -0,0 +1,276 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "bind_cache.h"
+#include "draw_pipeline.h"
+
+/*
+ * Bind churn: a random sequence of framebuffer, renderbuffer, texture,
+ * buffer, vertex array and program binds, with a draw every DRAW_EVERY
+ * binds, replayed straight to GL and through bind_cache. The redundancy
+ * sweep is the chance that a bind names what is already bound, which is
+ * what the cache can skip. Every object is real and every combination
+ * draws, so drivers that defer bind work to the draw get charged for it.
+ */
+
+#define PIPELINES 4
+#define TEXTURES 8
+#define TEXTURE_UNITS 4
+#define EXTRA_BUFFERS 4
+#define OPS 60000
+#define DRAW_EVERY 8
+
+enum op_kind { OP_FRAMEBUFFER, OP_RENDERBUFFER, OP_ACTIVE_TEXTURE, OP_TEXTURE, OP_BUFFER,
+               OP_VERTEX_ARRAY, OP_PROGRAM, OP_KIND_COUNT, OP_DRAW = OP_KIND_COUNT };
+
+struct op {
+    enum op_kind kind;
+    GLenum target;
+    GLuint name;
+};
+
+struct objects {
+    struct draw_pipeline pipelines[PIPELINES];
+    GLuint textures[TEXTURES];
+    GLuint buffers[PIPELINES + EXTRA_BUFFERS];
+};
+
+static const GLenum buffer_targets[] = { GL_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_COPY_READ_BUFFER };
+
+static uint32_t next_random(uint32_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+/* Name currently bound in the slot an op addresses, as the generator models it. */
+static GLuint *model_slot(GLuint model[OP_KIND_COUNT][TEXTURE_UNITS], GLuint active_unit, enum op_kind kind, int target)
+{
+    switch (kind) {
+    case OP_TEXTURE: return &model[kind][active_unit];
+    case OP_BUFFER:  return &model[kind][target];
+    default:         return &model[kind][0];
+    }
+}
+
+static void generate(struct op *ops, const struct objects *objects, double redundancy, uint32_t seed)
+{
+    GLuint model[OP_KIND_COUNT][TEXTURE_UNITS] = { { 0 } };
+    GLuint active_unit = 0;
+
+    // what reset_bindings() leaves bound
+    model[OP_FRAMEBUFFER][0] = objects->pipelines[0].framebuffer;
+    model[OP_VERTEX_ARRAY][0] = objects->pipelines[0].vao;
+    model[OP_PROGRAM][0] = objects->pipelines[0].program;
+
+    for (int i = 0; i < OPS; i++) {
+        struct op *op = &ops[i];
+
+        if (i % (DRAW_EVERY + 1) == DRAW_EVERY) {
+            op->kind = OP_DRAW;
+            continue;
+        }
+
+        op->kind = (enum op_kind) (next_random(&seed) % OP_KIND_COUNT);
+        int target = (int) (next_random(&seed) % 3);
+        const struct draw_pipeline *pipeline = &objects->pipelines[next_random(&seed) % PIPELINES];
+        GLuint *slot = model_slot(model, active_unit, op->kind, target);
+        int repeat = next_random(&seed) % 1000 < redundancy * 1000;
+
+        switch (op->kind) {
+        case OP_FRAMEBUFFER:
+            op->target = GL_FRAMEBUFFER;
+            op->name = repeat ? *slot : pipeline->framebuffer;
+            break;
+        case OP_RENDERBUFFER:
+            op->target = GL_RENDERBUFFER;
+            op->name = repeat ? *slot : pipeline->color_renderbuffer;
+            break;
+        case OP_ACTIVE_TEXTURE:
+            op->target = GL_TEXTURE0 + (repeat ? active_unit : next_random(&seed) % TEXTURE_UNITS);
+            active_unit = op->target - GL_TEXTURE0;
+            continue;
+        case OP_TEXTURE:
+            op->target = GL_TEXTURE_2D;
+            op->name = repeat ? *slot : objects->textures[next_random(&seed) % TEXTURES];
+            break;
+        case OP_BUFFER:
+            op->target = buffer_targets[target];
+            op->name = repeat ? *slot : objects->buffers[next_random(&seed) % (PIPELINES + EXTRA_BUFFERS)];
+            break;
+        case OP_VERTEX_ARRAY:
+            op->name = repeat ? *slot : pipeline->vao;
+            break;
+        case OP_PROGRAM:
+            op->name = repeat ? *slot : pipeline->program;
+            break;
+        default:
+            break;
+        }
+        *slot = op->name;
+    }
+}
+
+static void replay(const struct op *ops, struct bind_cache *cache)
+{
+    for (int i = 0; i < OPS; i++) {
+        const struct op *op = &ops[i];
+
+        if (cache == NULL) {
+            switch (op->kind) {
+            case OP_FRAMEBUFFER:    glBindFramebuffer(op->target, op->name); break;
+            case OP_RENDERBUFFER:   glBindRenderbuffer(op->target, op->name); break;
+            case OP_ACTIVE_TEXTURE: glActiveTexture(op->target); break;
+            case OP_TEXTURE:        glBindTexture(op->target, op->name); break;
+            case OP_BUFFER:         glBindBuffer(op->target, op->name); break;
+            case OP_VERTEX_ARRAY:   glBindVertexArray(op->name); break;
+            case OP_PROGRAM:        glUseProgram(op->name); break;
+            case OP_DRAW:           glDrawArrays(GL_TRIANGLES, 0, 3); break;
+            }
+        } else {
+            switch (op->kind) {
+            case OP_FRAMEBUFFER:    bind_cache_bind_framebuffer(cache, op->target, op->name); break;
+            case OP_RENDERBUFFER:   bind_cache_bind_renderbuffer(cache, op->target, op->name); break;
+            case OP_ACTIVE_TEXTURE: bind_cache_active_texture(cache, op->target); break;
+            case OP_TEXTURE:        bind_cache_bind_texture(cache, op->target, op->name); break;
+            case OP_BUFFER:         bind_cache_bind_buffer(cache, op->target, op->name); break;
+            case OP_VERTEX_ARRAY:   bind_cache_bind_vertex_array(cache, op->name); break;
+            case OP_PROGRAM:        bind_cache_use_program(cache, op->name); break;
+            case OP_DRAW:           glDrawArrays(GL_TRIANGLES, 0, 3); break;
+            }
+        }
+    }
+}
+
+/* Starts every replay from the same bindings: the first pipeline, everything else 0. */
+static void reset_bindings(const struct objects *objects)
+{
+    for (int unit = TEXTURE_UNITS - 1; unit >= 0; unit--) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    for (size_t t = 0; t < sizeof(buffer_targets) / sizeof(buffer_targets[0]); t++) {
+        glBindBuffer(buffer_targets[t], 0);
+    }
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    draw_pipeline_bind(&objects->pipelines[0]);
+}
+
+static int create_objects(struct objects *objects)
+{
+    const unsigned char texel[4] = { 255, 255, 255, 255 };
+
+    for (int i = 0; i < PIPELINES; i++) {
+        if (draw_pipeline_create(&objects->pipelines[i], 16, 16, triangle, 3) != GL_FRAMEBUFFER_COMPLETE) {
+            return -1;
+        }
+        objects->buffers[i] = objects->pipelines[i].vbo;
+    }
+
+    glGenTextures(TEXTURES, objects->textures);
+    for (int i = 0; i < TEXTURES; i++) {
+        glBindTexture(GL_TEXTURE_2D, objects->textures[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenBuffers(EXTRA_BUFFERS, objects->buffers + PIPELINES);
+    for (int i = PIPELINES; i < PIPELINES + EXTRA_BUFFERS; i++) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, objects->buffers[i]);
+        glBufferData(GL_COPY_WRITE_BUFFER, 256, NULL, GL_STATIC_DRAW);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return 0;
+}
+
+static void destroy_objects(struct objects *objects)
+{
+    draw_pipeline_unbind();
+    glDeleteBuffers(EXTRA_BUFFERS, objects->buffers + PIPELINES);
+    glDeleteTextures(TEXTURES, objects->textures);
+    for (int i = 0; i < PIPELINES; i++) {
+        draw_pipeline_destroy(&objects->pipelines[i]);
+    }
+}
+
+int bench_bind(const struct bench_options *options)
+{
+    static const double redundancies[] = { 0.0, 0.25, 0.5, 0.75, 0.9 };
+    const int redundancy_count = options->quick ? 2 : (int) (sizeof(redundancies) / sizeof(redundancies[0]));
+    struct objects objects;
+    struct op *ops = malloc(OPS * sizeof(*ops));
+    double *samples[2];
+    int result = 0;
+
+    glc_context *context = bench_context_create();
+    if (context == NULL) {
+        fprintf(stderr, "could not create a context\n");
+        free(ops);
+        return 1;
+    }
+
+    samples[0] = calloc(options->repeat, sizeof(double));
+    samples[1] = calloc(options->repeat, sizeof(double));
+    if (ops == NULL || samples[0] == NULL || samples[1] == NULL || create_objects(&objects) != 0) {
+        fprintf(stderr, "could not set up\n");
+        result = 1;
+        goto done;
+    }
+
+    printf("%d binds and %d draws per replay, %s\n", OPS - OPS / (DRAW_EVERY + 1), OPS / (DRAW_EVERY + 1),
+           glGetString(GL_RENDERER));
+    printf("%-10s %10s %14s %14s %10s %14s\n", "redundant", "elided", "direct ms p50", "cached ms p50",
+           "saved", "cached ms p99");
+
+    for (int k = 0; k < redundancy_count; k++) {
+        struct bench_stats stats[2];
+        struct bind_cache cache;
+
+        generate(ops, &objects, redundancies[k], 0x9e3779b9u + (uint32_t) k);
+        bind_cache_init(&cache);
+
+        for (int r = -options->warmup; r < options->repeat; r++) {
+            if (r == 0) {
+                cache.stats.calls = cache.stats.elided = 0;
+            }
+            // alternate so drift hits both equally
+            for (int cached = 0; cached < 2; cached++) {
+                reset_bindings(&objects);
+                bind_cache_invalidate(&cache);
+                glFinish();
+
+                uint64_t start = bench_now_ns();
+                replay(ops, cached ? &cache : NULL);
+                double ms = (bench_now_ns() - start) / 1e6;
+                glFinish();
+
+                if (r >= 0) {
+                    samples[cached][r] = ms;
+                }
+            }
+        }
+
+        bench_stats_compute(samples[0], options->repeat, &stats[0]);
+        bench_stats_compute(samples[1], options->repeat, &stats[1]);
+        printf("%9.0f%% %9.1f%% %14.3f %14.3f %9.1f%% %14.3f\n", redundancies[k] * 100,
+               cache.stats.calls ? 100.0 * cache.stats.elided / cache.stats.calls : 0.0,
+               stats[0].median, stats[1].median, 100.0 * (1.0 - stats[1].median / stats[0].median), stats[1].p99);
+    }
+
+    destroy_objects(&objects);
+
+    if (glGetError() != GL_NO_ERROR) {
+        fprintf(stderr, "GL error during the run\n");
+        result = 1;
+    }
+
+done:
+    free(samples[0]);
+    free(samples[1]);
+    free(ops);
+    bench_context_destroy(context);
+    return result;
+}
@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "readback.h"
+
+/*
+ * Buffer-to-client readback bandwidth per path (see readback_buffer()).
+ * Before every read the first word of the buffer is rewritten, as a
+ * simulation step would, so no read can be served from a stale copy and
+ * each one has to wait for the write ahead of it. The word is checked on
+ * the way back.
+ */
+
+int bench_buffer_readback(const struct bench_options *options)
+{
+    static const GLsizeiptr full_sizes[] = { 16, 256, 4 << 10, 64 << 10, 1 << 20, 16 << 20, 256 << 20 };
+    static const GLsizeiptr quick_sizes[] = { 16, 256, 4 << 10, 64 << 10, 1 << 20 };
+
+    const GLsizeiptr *sizes = options->quick ? quick_sizes : full_sizes;
+    int size_count = options->quick ? 5 : 7;
+    int result = 0;
+
+    glc_context *context = bench_context_create();
+    if (context == NULL) {
+        fprintf(stderr, "could not create a context\n");
+        return 1;
+    }
+
+    printf("%s\n", glGetString(GL_RENDERER));
+    printf("%-11s %9s %6s %14s %14s %10s\n", "path", "size", "calls", "call us p50", "call us p99", "GB/s");
+
+    for (int s = 0; s < size_count && result == 0; s++) {
+        GLsizeiptr bytes = sizes[s];
+        int calls = (int) ((64 << 20) / bytes);
+        calls = calls < 4 ? 4 : calls > 1024 ? 1024 : calls;
+
+        uint32_t *dst = malloc(bytes);
+        double *call_us = calloc((size_t) calls * options->repeat, sizeof(*call_us));
+        double *run_s = calloc(options->repeat, sizeof(*run_s));
+        GLuint buffer, staging;
+
+        if (dst == NULL || call_us == NULL || run_s == NULL) {
+            free(dst);
+            free(call_us);
+            free(run_s);
+            result = 1;
+            break;
+        }
+
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_DYNAMIC_READ);
+        glGenBuffers(1, &staging);
+        glBindBuffer(GL_ARRAY_BUFFER, staging);
+        glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_STREAM_READ);
+
+        for (int p = 0; p < READBACK_BUFFER_PATH_COUNT && result == 0; p++) {
+            uint32_t step = 0;
+
+            for (int r = -options->warmup; r < options->repeat && result == 0; r++) {
+                double *slot = call_us + (size_t) (r < 0 ? 0 : r) * calls;
+                double total = 0.0;
+
+                for (int c = 0; c < calls; c++) {
+                    step++;
+                    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+                    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(step), &step);
+
+                    uint64_t start = bench_now_ns();
+                    int failed = readback_buffer(p, buffer, 0, bytes, staging, dst);
+                    slot[c] = (bench_now_ns() - start) / 1e3;
+                    total += slot[c];
+
+                    if (failed || dst[0] != step) {
+                        fprintf(stderr, "%s returned stale or no data\n", readback_buffer_path_name(p));
+                        result = 1;
+                        break;
+                    }
+                }
+                if (r >= 0) {
+                    run_s[r] = total / 1e6;
+                }
+            }
+            if (result != 0) {
+                break;
+            }
+
+            struct bench_stats call, run;
+            bench_stats_compute(call_us, calls * options->repeat, &call);
+            bench_stats_compute(run_s, options->repeat, &run);
+
+            char size[32];
+            if (bytes < 1024) {
+                snprintf(size, sizeof(size), "%ldB", (long) bytes);
+            } else {
+                snprintf(size, sizeof(size), "%ldK", (long) (bytes >> 10));
+            }
+            printf("%-11s %9s %6d %14.2f %14.2f %10.2f\n", readback_buffer_path_name(p), size, calls,
+                   call.median, call.p99, (double) bytes * calls / run.median / 1e9);
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glDeleteBuffers(1, &buffer);
+        glDeleteBuffers(1, &staging);
+        free(dst);
+        free(call_us);
+        free(run_s);
+    }
+
+    if (glGetError() != GL_NO_ERROR) {
+        fprintf(stderr, "GL error during the run\n");
+        result = 1;
+    }
+
+    bench_context_destroy(context);
+    return result;
+}
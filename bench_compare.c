@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "image_compare.h"
+
+/*
+ * Full-frame golden compare on the CPU, per kernel. The two frames are
+ * identical apart from a small patch, which is the usual case for a
+ * passing test: the whole frame has to be scanned either way.
+ */
+
+static void fill_frames(uint8_t *actual, uint8_t *expected, int width, int height)
+{
+    for (size_t i = 0; i < (size_t) width * height * 4; i++) {
+        expected[i] = actual[i] = (uint8_t) (i * 2654435761u >> 24);
+    }
+    for (int y = height / 2; y < height / 2 + 8; y++) {
+        for (int x = width / 2; x < width / 2 + 8; x++) {
+            actual[((size_t) y * width + x) * 4] ^= 0x80;
+        }
+    }
+}
+
+int bench_compare(const struct bench_options *options)
+{
+    static const struct { int width, height; } full_sizes[] = { { 512, 512 }, { 1920, 1080 }, { 3840, 2160 } };
+    static const enum image_compare_kernel kernels[] = { IMAGE_COMPARE_SCALAR, IMAGE_COMPARE_SSE2, IMAGE_COMPARE_AVX2 };
+    const uint8_t tolerance[4] = { 1, 1, 1, 0 };
+
+    int size_count = options->quick ? 2 : 3;
+    double *samples = calloc(options->repeat, sizeof(*samples));
+    int result = 0;
+
+    printf("RGBA8, tolerance 1, 64 differing pixels\n");
+    printf("%-8s %10s %10s %10s %10s\n", "kernel", "size", "ms p50", "ms p99", "GB/s");
+
+    for (int s = 0; s < size_count && result == 0; s++) {
+        int width = full_sizes[s].width;
+        int height = full_sizes[s].height;
+        size_t bytes = (size_t) width * height * 4;
+        uint8_t *actual = malloc(bytes);
+        uint8_t *expected = malloc(bytes);
+
+        if (samples == NULL || actual == NULL || expected == NULL) {
+            free(actual);
+            free(expected);
+            result = 1;
+            break;
+        }
+        fill_frames(actual, expected, width, height);
+
+        for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+            struct image_compare_result compare;
+            struct bench_stats stats;
+
+            if (!image_compare_kernel_supported(kernels[k])) {
+                printf("%-8s %4dx%-5d %10s\n", image_compare_kernel_name(kernels[k]), width, height, "n/a");
+                continue;
+            }
+
+            for (int r = -options->warmup; r < options->repeat; r++) {
+                uint64_t start = bench_now_ns();
+                image_compare_rgba8_with(kernels[k], actual, expected, width, height, tolerance, &compare);
+                if (r >= 0) {
+                    samples[r] = (bench_now_ns() - start) / 1e6;
+                }
+            }
+            if (compare.mismatches != 64) {
+                fprintf(stderr, "%s kernel found %llu mismatches instead of 64\n",
+                        image_compare_kernel_name(kernels[k]), (unsigned long long) compare.mismatches);
+                result = 1;
+            }
+
+            bench_stats_compute(samples, options->repeat, &stats);
+            // both frames are read once
+            printf("%-8s %4dx%-5d %10.3f %10.3f %10.2f\n", image_compare_kernel_name(kernels[k]),
+                   width, height, stats.median, stats.p99, 2.0 * bytes / (stats.median / 1e3) / 1e9);
+        }
+
+        free(actual);
+        free(expected);
+    }
+
+    free(samples);
+    return result;
+}
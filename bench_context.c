@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "pixel_format_cache.h"
+
+/*
+ * Context bring-up latency: choose a pixel format, create a core profile
+ * context, make it current, and destroy it again, thousands of times, to
+ * get at the tail that a single create in a test never shows. Each phase
+ * is timed on its own and "bring-up" is choose + create + make current,
+ * what a service waits for before its first GL call. Runs once choosing
+ * with glc_choose_pixel_format() every time and once through a
+ * pixel_format_cache, which chooses on the first iteration only.
+ */
+
+#define ITERATIONS 2000
+#define QUICK_ITERATIONS 100
+
+enum phase {
+    PHASE_CHOOSE,
+    PHASE_CREATE,
+    PHASE_MAKE_CURRENT,
+    PHASE_DESTROY,
+    PHASE_BRING_UP,
+    PHASE_COUNT
+};
+
+static const char *phase_names[PHASE_COUNT] = { "choose", "create", "make current", "destroy", "bring-up" };
+
+/* One bring-up and tear-down; stores each phase's time in us. Returns 0 on success. */
+static int cycle(struct pixel_format_cache *cache, double *us)
+{
+    glc_attrib attribs[] = {
+        GLC_ATTRIB_CORE_PROFILE,
+        GLC_ATTRIB_END
+    };
+    glc_pixel_format *pixel_format;
+    glc_context *context = NULL;
+    glc_error err;
+
+    uint64_t start = bench_now_ns();
+    if (cache != NULL) {
+        err = pixel_format_cache_choose(cache, attribs, &pixel_format, NULL);
+    } else {
+        err = glc_choose_pixel_format(attribs, &pixel_format, NULL);
+    }
+    uint64_t chosen = bench_now_ns();
+    if (err != GLC_NO_ERROR) {
+        return -1;
+    }
+
+    err = glc_create_context(pixel_format, NULL, &context);
+    uint64_t created = bench_now_ns();
+    if (cache == NULL) {
+        glc_destroy_pixel_format(pixel_format);
+    }
+    if (err != GLC_NO_ERROR) {
+        return -1;
+    }
+
+    uint64_t before_current = bench_now_ns();
+    err = glc_set_current_context(context);
+    uint64_t current = bench_now_ns();
+
+    err = glc_destroy_context(context) != GLC_NO_ERROR ? GLC_BAD_CONTEXT : err;
+    uint64_t destroyed = bench_now_ns();
+
+    us[PHASE_CHOOSE] = (chosen - start) / 1e3;
+    us[PHASE_CREATE] = (created - chosen) / 1e3;
+    us[PHASE_MAKE_CURRENT] = (current - before_current) / 1e3;
+    us[PHASE_DESTROY] = (destroyed - current) / 1e3;
+    us[PHASE_BRING_UP] = us[PHASE_CHOOSE] + us[PHASE_CREATE] + us[PHASE_MAKE_CURRENT];
+    return err == GLC_NO_ERROR ? 0 : -1;
+}
+
+int bench_context(const struct bench_options *options)
+{
+    const int iterations = options->quick ? QUICK_ITERATIONS : ITERATIONS;
+    double *samples[PHASE_COUNT];
+    int result = 0;
+
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        samples[p] = calloc(iterations, sizeof(double));
+        if (samples[p] == NULL) {
+            result = 1;
+        }
+    }
+    if (result != 0) {
+        fprintf(stderr, "out of memory\n");
+    }
+
+    printf("%d iterations, %s backend\n", iterations, glc_backend_name());
+    printf("%-9s %-13s %10s %10s %10s %10s\n", "formats", "phase", "p50 us", "p99 us", "max us", "mean us");
+
+    for (int cached = 0; cached < 2 && result == 0; cached++) {
+        struct pixel_format_cache cache;
+        double us[PHASE_COUNT];
+
+        pixel_format_cache_init(&cache);
+        for (int i = -options->warmup; i < iterations; i++) {
+            if (cycle(cached ? &cache : NULL, us) != 0) {
+                fprintf(stderr, "could not bring a context up\n");
+                result = 1;
+                break;
+            }
+            for (int p = 0; p < PHASE_COUNT && i >= 0; p++) {
+                samples[p][i] = us[p];
+            }
+        }
+
+        for (int p = 0; p < PHASE_COUNT && result == 0; p++) {
+            struct bench_stats stats;
+
+            bench_stats_compute(samples[p], iterations, &stats);
+            printf("%-9s %-13s %10.1f %10.1f %10.1f %10.1f\n", cached ? "cached" : "chosen", phase_names[p],
+                   stats.median, stats.p99, stats.max, stats.mean);
+        }
+        if (cached && result == 0) {
+            printf("cache: %llu hit(s), %llu miss(es)\n", (unsigned long long) cache.hits,
+                   (unsigned long long) cache.misses);
+        }
+        pixel_format_cache_destroy(&cache);
+    }
+
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        free(samples[p]);
+    }
+    return result;
+}
@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "draw_pipeline.h"
+#include "gl_trace.h" // last: it redefines the gl* calls it traces
+
+/*
+ * Draw-call throughput on the pipeline of the draw test. Every
+ * configuration clears, submits `draws` draws of `tris` triangles and
+ * waits for glFinish(). The time until the submitting calls return is the
+ * CPU submission cost; the time until glFinish() returns adds rasterising.
+ *
+ * Triangles sit in the cells of a fixed GRID x GRID grid, so every
+ * triangle covers the same few pixels no matter how many there are and
+ * raster cost grows linearly with the triangle count.
+ */
+
+#define WIDTH 512
+#define HEIGHT 512
+#define GRID 64
+#define MAX_TRIANGLES (GRID * GRID)
+
+enum draw_mode {
+    DRAW_LOOP,          /* one glDrawArrays per draw */
+    DRAW_MULTI,         /* one glMultiDrawArrays for all draws */
+    DRAW_INSTANCED      /* one glDrawArraysInstanced, one instance per draw */
+};
+
+static const char *mode_names[] = { "loop", "multi", "instanced" };
+
+static float *make_grid_triangles(int count)
+{
+    float *vertices = malloc(count * 6 * sizeof(float));
+    float cell = 2.0f / GRID;
+
+    if (vertices == NULL) {
+        return NULL;
+    }
+
+    for (int i = 0; i < count; i++) {
+        float x = -1.0f + (i % GRID) * cell;
+        float y = -1.0f + (i / GRID) * cell;
+        float *v = vertices + i * 6;
+
+        v[0] = x;        v[1] = y;
+        v[2] = x + cell; v[3] = y;
+        v[4] = x;        v[5] = y + cell;
+    }
+    return vertices;
+}
+
+static void submit(enum draw_mode mode, int draws, int tris, GLint *firsts, GLsizei *counts)
+{
+    switch (mode) {
+    case DRAW_LOOP:
+        for (int i = 0; i < draws; i++) {
+            glDrawArrays(GL_TRIANGLES, 0, tris * 3);
+        }
+        break;
+    case DRAW_MULTI:
+        glMultiDrawArrays(GL_TRIANGLES, firsts, counts, draws);
+        break;
+    case DRAW_INSTANCED:
+        glDrawArraysInstanced(GL_TRIANGLES, 0, tris * 3, draws);
+        break;
+    }
+}
+
+int bench_draw(const struct bench_options *options)
+{
+    static const int full_draw_counts[] = { 1, 10, 100, 1000, 10000 };
+    static const int full_tri_counts[] = { 1, 64, 4096 };
+    static const int quick_draw_counts[] = { 1, 100 };
+    static const int quick_tri_counts[] = { 1, 64 };
+
+    const int *draw_counts = options->quick ? quick_draw_counts : full_draw_counts;
+    const int *tri_counts = options->quick ? quick_tri_counts : full_tri_counts;
+    int draw_count_n = options->quick ? 2 : 5;
+    int tri_count_n = options->quick ? 2 : 3;
+    int max_draws = draw_counts[draw_count_n - 1];
+    int result = 0;
+
+    glc_context *context = bench_context_create();
+    if (context == NULL) {
+        fprintf(stderr, "could not create a context\n");
+        return 1;
+    }
+
+    float *vertices = make_grid_triangles(MAX_TRIANGLES);
+    GLint *firsts = calloc(max_draws, sizeof(*firsts));
+    GLsizei *counts = calloc(max_draws, sizeof(*counts));
+    double *total_ms = calloc(options->repeat, sizeof(*total_ms));
+    double *submit_ms = calloc(options->repeat, sizeof(*submit_ms));
+    struct draw_pipeline pipeline;
+
+    if (vertices == NULL || firsts == NULL || counts == NULL || total_ms == NULL || submit_ms == NULL ||
+        draw_pipeline_create(&pipeline, WIDTH, HEIGHT, vertices, MAX_TRIANGLES * 3) != GL_FRAMEBUFFER_COMPLETE ||
+        pipeline.program == 0) {
+        fprintf(stderr, "could not build the draw pipeline\n");
+        result = 1;
+        goto done;
+    }
+
+    printf("%dx%d RGBA8 + DEPTH16, %s\n", WIDTH, HEIGHT, glGetString(GL_RENDERER));
+    printf("%-10s %7s %9s %14s %12s %12s %13s %13s %13s\n",
+           "mode", "draws", "tris/draw", "submit us/draw", "total ms p50", "total ms p99",
+           "draws/s p50", "draws/s p99", "Mtris/s p50");
+
+    draw_pipeline_bind(&pipeline);
+
+    for (int m = DRAW_LOOP; m <= DRAW_INSTANCED; m++) {
+        for (int d = 0; d < draw_count_n; d++) {
+            for (int t = 0; t < tri_count_n; t++) {
+                int draws = draw_counts[d];
+                int tris = tri_counts[t];
+                struct bench_stats total, submitted;
+
+                for (int i = 0; i < draws; i++) {
+                    firsts[i] = 0;
+                    counts[i] = tris * 3;
+                }
+
+                for (int r = -options->warmup; r < options->repeat; r++) {
+                    glFinish();
+
+                    uint64_t start = bench_now_ns();
+                    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                    submit(m, draws, tris, firsts, counts);
+                    uint64_t submitted_at = bench_now_ns();
+                    glFinish();
+                    uint64_t finished_at = bench_now_ns();
+
+                    if (r >= 0) {
+                        submit_ms[r] = (submitted_at - start) / 1e6;
+                        total_ms[r] = (finished_at - start) / 1e6;
+                    }
+                }
+
+                GLenum err = glGetError();
+                if (err != GL_NO_ERROR) {
+                    fprintf(stderr, "%s: GL error 0x%04x\n", mode_names[m], err);
+                    result = 1;
+                    goto unbind;
+                }
+
+                bench_stats_compute(total_ms, options->repeat, &total);
+                bench_stats_compute(submit_ms, options->repeat, &submitted);
+
+                printf("%-10s %7d %9d %14.3f %12.3f %12.3f %13.0f %13.0f %13.2f\n",
+                       mode_names[m], draws, tris,
+                       submitted.median * 1e3 / draws,
+                       total.median, total.p99,
+                       draws / (total.median / 1e3),
+                       draws / (total.p99 / 1e3),
+                       (double) draws * tris / (total.median / 1e3) / 1e6);
+            }
+        }
+    }
+
+unbind:
+    draw_pipeline_unbind();
+    draw_pipeline_destroy(&pipeline);
+
+done:
+    free(vertices);
+    free(firsts);
+    free(counts);
+    free(total_ms);
+    free(submit_ms);
+    bench_context_destroy(context);
+    return result;
+}
@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "gl_errors.h"
+
+/*
+ * What checking for errors costs: the vertex array test's calls (bind,
+ * enable, pointer, unbind) repeated ITERATIONS times per run, with no
+ * checking, with glGetError() after every call, and with the debug output
+ * callback installed and the queue collected once per run.
+ */
+
+#define ITERATIONS 10000
+
+enum mode { MODE_NONE, MODE_POLL, MODE_CALLBACK, MODE_COUNT };
+
+static const char *const mode_names[MODE_COUNT] = { "none", "glGetError", "callback" };
+
+static int run(enum mode mode, GLuint vao, GLuint buffer, struct gl_errors *errors)
+{
+    int failures = 0;
+
+    for (int i = 0; i < ITERATIONS; i++) {
+        glBindVertexArray(vao);
+        failures += mode == MODE_POLL && glGetError() != GL_NO_ERROR;
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        failures += mode == MODE_POLL && glGetError() != GL_NO_ERROR;
+        glEnableVertexAttribArray(0);
+        failures += mode == MODE_POLL && glGetError() != GL_NO_ERROR;
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+        failures += mode == MODE_POLL && glGetError() != GL_NO_ERROR;
+        glBindVertexArray(0);
+        failures += mode == MODE_POLL && glGetError() != GL_NO_ERROR;
+    }
+    if (mode == MODE_CALLBACK) {
+        failures += gl_errors_collect(errors);
+    }
+    return failures;
+}
+
+int bench_errors(const struct bench_options *options)
+{
+    double *samples[MODE_COUNT];
+    struct bench_stats stats[MODE_COUNT];
+    struct gl_errors errors;
+    GLuint vao, buffer;
+    int measured = MODE_COUNT;
+    int failures = 0;
+    int result = 0;
+
+    glc_context *context = bench_context_create();
+    if (context == NULL) {
+        fprintf(stderr, "could not create a context\n");
+        return 1;
+    }
+
+    for (int m = 0; m < MODE_COUNT; m++) {
+        samples[m] = calloc(options->repeat, sizeof(double));
+        result |= samples[m] == NULL;
+    }
+    if (result != 0) {
+        fprintf(stderr, "out of memory\n");
+        goto done;
+    }
+
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, 4096, NULL, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    for (int m = 0; m < MODE_COUNT; m++) {
+        gl_errors_init(&errors, m != MODE_CALLBACK);
+        if (m == MODE_CALLBACK && !errors.debug_output) {
+            printf("no KHR_debug on this context, skipping the callback\n");
+            gl_errors_destroy(&errors);
+            measured = m;
+            break;
+        }
+        for (int r = -options->warmup; r < options->repeat; r++) {
+            uint64_t start = bench_now_ns();
+            failures += run((enum mode) m, vao, buffer, &errors);
+            if (r >= 0) {
+                samples[m][r] = (bench_now_ns() - start) / 1e6;
+            }
+        }
+        gl_errors_destroy(&errors);
+        bench_stats_compute(samples[m], options->repeat, &stats[m]);
+    }
+
+    glDeleteBuffers(1, &buffer);
+    glDeleteVertexArrays(1, &vao);
+
+    printf("%d x 5 state calls per run, %s\n", ITERATIONS, glGetString(GL_RENDERER));
+    printf("%-12s %14s %14s %14s\n", "checking", "ns/call p50", "ns/call p99", "overhead");
+    for (int m = 0; m < measured; m++) {
+        printf("%-12s %14.1f %14.1f %13.1f%%\n", mode_names[m],
+               stats[m].median * 1e6 / (ITERATIONS * 5), stats[m].p99 * 1e6 / (ITERATIONS * 5),
+               100.0 * (stats[m].median / stats[MODE_NONE].median - 1.0));
+    }
+
+    if (failures != 0 || glGetError() != GL_NO_ERROR) {
+        fprintf(stderr, "GL error during the run\n");
+        result = 1;
+    }
+
+done:
+    for (int m = 0; m < MODE_COUNT; m++) {
+        free(samples[m]);
+    }
+    bench_context_destroy(context);
+    return result;
+}
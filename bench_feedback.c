@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "feedback_compute.h"
+
+/*
+ * Transform-feedback compute against the CPU: every kernel of
+ * feedback_compute.h over growing element counts, on the CPU in plain C,
+ * SSE2 and AVX2, and on the GPU. The GPU is timed twice: "gpu" is the
+ * kernel alone on data already in buffers, and "gpu+copy" also uploads
+ * the inputs with glBufferSubData and reads the output back with
+ * glGetBufferSubData, which is what offloading a CPU loop costs.
+ * "offload" is the fastest CPU time over gpu+copy, so offloading pays
+ * where it is over 1. Every GPU result is checked against the plain C one.
+ */
+
+static uint32_t next_random(uint32_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static float random_float(uint32_t *state, float low, float high)
+{
+    return low + (high - low) * (next_random(state) >> 8) / (float) (1 << 24);
+}
+
+static void fill_inputs(enum feedback_kernel kernel, void *const *inputs, uint32_t count)
+{
+    uint32_t state = 0x9e3779b9u;
+
+    if (kernel == FEEDBACK_SAXPY) {
+        for (uint32_t i = 0; i < count; i++) {
+            ((float *) inputs[0])[i] = random_float(&state, -1.0f, 1.0f);
+            ((float *) inputs[1])[i] = random_float(&state, -1.0f, 1.0f);
+        }
+        return;
+    }
+
+    struct particle *particles = inputs[0];
+    for (uint32_t i = 0; i < count; i++) {
+        for (int c = 0; c < 3; c++) {
+            particles[i].position[c] = random_float(&state, c == 1 ? 0.0f : -10.0f, 10.0f);
+            particles[i].velocity[c] = random_float(&state, -5.0f, 5.0f);
+        }
+        particles[i].position[3] = 1.0f;
+        particles[i].velocity[3] = 0.0f;
+    }
+}
+
+static double median_ms(double *samples, int count)
+{
+    struct bench_stats stats;
+
+    bench_stats_compute(samples, count, &stats);
+    return stats.median;
+}
+
+/* Returns 0 on success, -1 on a GL failure or a GPU result that does not match. */
+static int run_point(struct feedback_compute *compute, enum feedback_kernel kernel, uint32_t count,
+                     const struct bench_options *options, double *samples)
+{
+    static const enum feedback_cpu_isa isas[] = { FEEDBACK_CPU_SCALAR, FEEDBACK_CPU_SSE2, FEEDBACK_CPU_AVX2 };
+    const struct feedback_params params = { 2.5f, 1.0f / 60.0f, 9.81f, 0.995f, 0.8f };
+    const int input_count = kernel == FEEDBACK_SAXPY ? 2 : 1;
+    const GLsizeiptr bytes = (GLsizeiptr) count * feedback_element_bytes(kernel);
+    void *inputs[2] = { NULL, NULL };
+    void *expected = malloc(bytes);
+    void *actual = malloc(bytes);
+    double cpu_ms[3] = { 0.0, 0.0, 0.0 };
+    double best_cpu_ms = 0.0;
+    GLuint input_buffers[2] = { 0, 0 }, output_buffer;
+    int result = 0;
+
+    for (int i = 0; i < input_count; i++) {
+        inputs[i] = malloc(bytes);
+    }
+    if (expected == NULL || actual == NULL || inputs[0] == NULL || (input_count == 2 && inputs[1] == NULL)) {
+        fprintf(stderr, "out of memory\n");
+        result = -1;
+        goto done;
+    }
+    fill_inputs(kernel, inputs, count);
+
+    for (int k = 0; k < 3; k++) {
+        if (!feedback_cpu_isa_supported(isas[k])) {
+            continue;
+        }
+        for (int r = -options->warmup; r < options->repeat; r++) {
+            uint64_t start = bench_now_ns();
+            feedback_cpu_run_with(isas[k], kernel, (const void *const *) inputs, expected, count, &params);
+            if (r >= 0) {
+                samples[r] = (bench_now_ns() - start) / 1e6;
+            }
+        }
+        cpu_ms[k] = median_ms(samples, options->repeat);
+        best_cpu_ms = best_cpu_ms == 0.0 || cpu_ms[k] < best_cpu_ms ? cpu_ms[k] : best_cpu_ms;
+    }
+    // the plain C result is the reference; the SIMD ones match it bit for bit
+    feedback_cpu_run_with(FEEDBACK_CPU_SCALAR, kernel, (const void *const *) inputs, expected, count, &params);
+
+    glGenBuffers(input_count, input_buffers);
+    for (int i = 0; i < input_count; i++) {
+        glBindBuffer(GL_ARRAY_BUFFER, input_buffers[i]);
+        glBufferData(GL_ARRAY_BUFFER, bytes, inputs[i], GL_DYNAMIC_DRAW);
+    }
+    glGenBuffers(1, &output_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, output_buffer);
+    glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    for (int r = -options->warmup; r < options->repeat; r++) {
+        glFinish();
+        uint64_t start = bench_now_ns();
+        feedback_compute_run(compute, input_buffers, output_buffer, count, &params);
+        glFinish();
+        if (r >= 0) {
+            samples[r] = (bench_now_ns() - start) / 1e6;
+        }
+    }
+    double gpu_ms = median_ms(samples, options->repeat);
+
+    for (int r = -options->warmup; r < options->repeat; r++) {
+        glFinish();
+        uint64_t start = bench_now_ns();
+        for (int i = 0; i < input_count; i++) {
+            glBindBuffer(GL_ARRAY_BUFFER, input_buffers[i]);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, inputs[i]);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        feedback_compute_run(compute, input_buffers, output_buffer, count, &params);
+        glBindBuffer(GL_COPY_READ_BUFFER, output_buffer);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, bytes, actual);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        if (r >= 0) {
+            samples[r] = (bench_now_ns() - start) / 1e6;
+        }
+    }
+    double round_trip_ms = median_ms(samples, options->repeat);
+    float error = feedback_max_error(kernel, actual, expected, count);
+
+    printf("%-10s %9u %8.1f", feedback_kernel_name(kernel), count, (input_count + 1) * bytes / (1024.0 * 1024.0));
+    for (int k = 0; k < 3; k++) {
+        if (cpu_ms[k] > 0.0) {
+            printf(" %10.3f", cpu_ms[k]);
+        } else {
+            printf(" %10s", "-");
+        }
+    }
+    printf(" %10.3f %10.3f %8.2fx %9.1e\n", gpu_ms, round_trip_ms, best_cpu_ms / round_trip_ms, error);
+
+    if (error > FEEDBACK_COMPUTE_TOLERANCE) {
+        fprintf(stderr, "%s: the GPU is off the CPU by %g\n", feedback_kernel_name(kernel), error);
+        result = -1;
+    }
+
+    glDeleteBuffers(input_count, input_buffers);
+    glDeleteBuffers(1, &output_buffer);
+    if (glGetError() != GL_NO_ERROR) {
+        fprintf(stderr, "GL error during the run\n");
+        result = -1;
+    }
+
+done:
+    free(inputs[0]);
+    free(inputs[1]);
+    free(expected);
+    free(actual);
+    return result;
+}
+
+int bench_feedback(const struct bench_options *options)
+{
+    static const uint32_t counts[] = { 1 << 10, 1 << 14, 1 << 18, 1 << 22 };
+    const int count_n = options->quick ? 2 : (int) (sizeof(counts) / sizeof(counts[0]));
+    double *samples;
+    int result = 0;
+
+    glc_context *context = bench_context_create();
+    if (context == NULL) {
+        fprintf(stderr, "could not create a context\n");
+        return 1;
+    }
+
+    samples = calloc(options->repeat, sizeof(double));
+    if (samples == NULL) {
+        fprintf(stderr, "out of memory\n");
+        bench_context_destroy(context);
+        return 1;
+    }
+
+    printf("%s\n", glGetString(GL_RENDERER));
+    printf("%-10s %9s %8s %10s %10s %10s %10s %10s %9s %9s\n", "kernel", "elements", "MB", "scalar ms", "sse2 ms",
+           "avx2 ms", "gpu ms", "gpu+copy", "offload", "max err");
+
+    for (int k = 0; k < FEEDBACK_KERNEL_COUNT && result == 0; k++) {
+        struct feedback_compute compute;
+
+        if (feedback_compute_init(&compute, k) != 0) {
+            fprintf(stderr, "could not build the %s kernel\n", feedback_kernel_name(k));
+            result = 1;
+            break;
+        }
+        for (int c = 0; c < count_n; c++) {
+            if (run_point(&compute, k, counts[c], options, samples) != 0) {
+                result = 1;
+                break;
+            }
+        }
+        feedback_compute_destroy(&compute);
+    }
+
+    free(samples);
+    bench_context_destroy(context);
+    return result;
+}
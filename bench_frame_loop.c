@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "frame_loop.h"
+
+/*
+ * Thousands of frames back to back through frame_loop.h, with 1, 2 and 3
+ * buffers and a light and a heavy frame, to see what a single frame does
+ * not: how much rendering and readback overlap, how the tail behaves, and
+ * whether frames get slower as the run goes on. "drift" is the mean frame
+ * time of the last tenth of the run over that of the first.
+ *
+ * FRAME_LOOP_FRAMES, FRAME_LOOP_DRAWS (triangles drawn per frame) and
+ * FRAME_LOOP_BUFFERS replace the defaults and the sweeps; with
+ * FRAME_LOOP_HISTOGRAM=1 every configuration also prints its frame time
+ * and latency histograms, one power-of-two bucket per line.
+ */
+
+#define WIDTH 512
+#define HEIGHT 512
+#define FRAMES 2000
+#define QUICK_FRAMES 120
+#define HISTOGRAM_BUCKETS 12
+#define HISTOGRAM_FIRST_MS 0.0625
+
+static int env_int(const char *name, int fallback)
+{
+    const char *value = getenv(name);
+    return value != NULL && value[0] != '\0' ? atoi(value) : fallback;
+}
+
+static double window_mean(const double *samples, int begin, int end)
+{
+    double sum = 0.0;
+
+    for (int i = begin; i < end; i++) {
+        sum += samples[i];
+    }
+    return end > begin ? sum / (end - begin) : 0.0;
+}
+
+/* Counts of samples under 0.0625 ms, under 0.125 ms, ... doubling, the last bucket open-ended. */
+static void print_histogram(const char *label, const double *samples, int count)
+{
+    int buckets[HISTOGRAM_BUCKETS] = { 0 };
+
+    for (int i = 0; i < count; i++) {
+        int b = 0;
+        double edge = HISTOGRAM_FIRST_MS;
+
+        while (b < HISTOGRAM_BUCKETS - 1 && samples[i] >= edge) {
+            edge *= 2.0;
+            b++;
+        }
+        buckets[b]++;
+    }
+
+    printf("  %s\n", label);
+    double edge = HISTOGRAM_FIRST_MS;
+    for (int b = 0; b < HISTOGRAM_BUCKETS; b++, edge *= 2.0) {
+        if (buckets[b] == 0) {
+            continue;
+        }
+        if (b < HISTOGRAM_BUCKETS - 1) {
+            printf("    < %8.4f ms %7d\n", edge, buckets[b]);
+        } else {
+            printf("   >= %8.4f ms %7d\n", edge / 2.0, buckets[b]);
+        }
+    }
+}
+
+/* Returns 0 on success, -1 on a failed run or a frame that came back wrong. */
+static int run_config(int buffers, int draws, int frames, int warmup, int histogram)
+{
+    struct frame_loop_config config = { buffers, frames, draws, WIDTH, HEIGHT };
+    struct frame_loop_config warm_config = { buffers, frames < 10 ? frames : 10, draws, WIDTH, HEIGHT };
+    struct frame_loop loop, warm_loop;
+    struct frame_loop_result result;
+    struct bench_stats frame, latency;
+    double *frame_ms = calloc(frames, sizeof(double));
+    double *latency_ms = calloc(frames, sizeof(double));
+    int status = 0;
+
+    if (frame_ms == NULL || latency_ms == NULL || frame_loop_init(&loop, &config) != 0) {
+        fprintf(stderr, "could not set up %d buffer(s)\n", buffers);
+        free(frame_ms);
+        free(latency_ms);
+        return -1;
+    }
+
+    if (warmup > 0 && frame_loop_init(&warm_loop, &warm_config) == 0) {
+        for (int w = 0; w < warmup; w++) {
+            frame_loop_run(&warm_loop, frame_ms, latency_ms, &result);
+        }
+        frame_loop_destroy(&warm_loop);
+    }
+
+    if (frame_loop_run(&loop, frame_ms, latency_ms, &result) != 0 || result.wrong_frames > 0) {
+        fprintf(stderr, "%d buffer(s): a readback failed or %d frame(s) came back wrong\n", buffers,
+                result.wrong_frames);
+        status = -1;
+    } else {
+        int tenth = frames / 10 > 0 ? frames / 10 : 1;
+        double first = window_mean(frame_ms, 0, tenth);
+        double last = window_mean(frame_ms, frames - tenth, frames);
+
+        // drift is taken above, in frame order: computing the stats sorts the samples
+        bench_stats_compute(frame_ms, frames, &frame);
+        bench_stats_compute(latency_ms, frames, &latency);
+
+        printf("%7d %6d %9.1f %8.3f %8.3f %8.3f %8.3f %8.3f %8.3f %8.3f %8.3f %6.2f\n", buffers, draws,
+               frames / (result.elapsed_ms / 1e3), frame.median, frame.p95, frame.p99, frame.max, latency.median,
+               latency.p95, latency.p99, latency.max, last / first);
+        if (histogram) {
+            print_histogram("frame time", frame_ms, frames);
+            print_histogram("latency", latency_ms, frames);
+        }
+    }
+
+    frame_loop_destroy(&loop);
+    free(frame_ms);
+    free(latency_ms);
+    return status;
+}
+
+int bench_frame_loop(const struct bench_options *options)
+{
+    static const int buffer_counts[] = { 1, 2, 3 };
+    static const int draw_counts[] = { 1, 256 };
+    int frames = env_int("FRAME_LOOP_FRAMES", options->quick ? QUICK_FRAMES : FRAMES);
+    int draws = env_int("FRAME_LOOP_DRAWS", 0);
+    int buffers = env_int("FRAME_LOOP_BUFFERS", 0);
+    int histogram = env_int("FRAME_LOOP_HISTOGRAM", 0);
+    int result = 0;
+
+    if (frames < 1) {
+        frames = 1;
+    }
+
+    glc_context *context = bench_context_create();
+    if (context == NULL) {
+        fprintf(stderr, "could not create a context\n");
+        return 1;
+    }
+
+    printf("%dx%d RGBA8, %d frames, whole-frame readback, times in ms, %s\n", WIDTH, HEIGHT, frames, glGetString(GL_RENDERER));
+    printf("%7s %6s %9s %8s %8s %8s %8s %8s %8s %8s %8s %6s\n", "buffers", "draws", "frames/s", "frame", "p95",
+           "p99", "max", "latency", "p95", "p99", "max", "drift");
+
+    for (int d = 0; d < 2 && result == 0; d++) {
+        for (int b = 0; b < 3 && result == 0; b++) {
+            // an environment override replaces the sweep with its one value
+            if ((draws > 0 && d > 0) || (buffers > 0 && b > 0)) {
+                continue;
+            }
+            if (run_config(buffers > 0 ? buffers : buffer_counts[b], draws > 0 ? draws : draw_counts[d], frames,
+                           options->warmup, histogram) != 0) {
+                result = 1;
+            }
+        }
+    }
+
+    if (glGetError() != GL_NO_ERROR) {
+        fprintf(stderr, "GL error during the run\n");
+        result = 1;
+    }
+    bench_context_destroy(context);
+    return result;
+}
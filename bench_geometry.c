@@ -0,0 +1,444 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "draw_pipeline.h"
+#include "mesh.h"
+#include "render_target.h"
+
+/*
+ * Geometry throughput: grid meshes from about 1K to 50M small triangles
+ * drawn into a 1024 x 1024 RGBA8 target, one whole mesh per frame, with
+ * every way of submitting it:
+ *
+ *   arrays      unindexed, one glDrawArrays
+ *   instanced   one unindexed patch, glDrawArraysInstanced, an instance per patch
+ *   elements32  32-bit indices, one glDrawElements, in the generated row
+ *               order, shuffled, and optimised for the vertex cache
+ *   elements16  16-bit indices per patch, one glMultiDrawElementsBaseVertex
+ *   loop32      optimised 32-bit indices, one glDrawElements per patch
+ *   multi32     the same ranges in one glMultiDrawElements
+ *
+ * Vertices per second counts the vertices a frame references: three per
+ * triangle unindexed, the mesh's distinct vertices indexed. Where the
+ * context has pipeline statistics queries, "VS/tri" is how many times the
+ * vertex shader really ran per triangle, which is what the index order
+ * changes. Each point runs until options->repeat frames or POINT_BUDGET_MS,
+ * whichever comes first, but at least MIN_RUNS; the biggest meshes take
+ * seconds a frame in software. Points whose buffers would go over
+ * MEMORY_BUDGET_MB are skipped.
+ */
+
+#define WIDTH 1024
+#define HEIGHT 1024
+#define POINT_BUDGET_MS 3000.0
+#define MIN_RUNS 3
+#define MEMORY_BUDGET_MB 1024
+
+static const char *placed_vertex_shader =
+    "#version 410\n"
+    "layout(location = 0) in vec2 position;\n"
+    "uniform mat4 transform;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_Position = transform * vec4(position, 0.0, 1.0);\n"
+    "}\n";
+
+static const char *instanced_vertex_shader =
+    "#version 410\n"
+    "layout(location = 0) in vec2 position;\n"
+    "uniform mat4 transform;\n"
+    "uniform int patches_per_row;\n"
+    "void main()\n"
+    "{\n"
+    "    vec2 cell = vec2(gl_InstanceID % patches_per_row, gl_InstanceID / patches_per_row);\n"
+    "    vec2 placed = (cell + position) * (2.0 / float(patches_per_row)) - 1.0;\n"
+    "    gl_Position = transform * vec4(placed, 0.0, 1.0);\n"
+    "}\n";
+
+enum geometry_mode {
+    MODE_ARRAYS,
+    MODE_INSTANCED,
+    MODE_ELEMENTS32_ROWS,
+    MODE_ELEMENTS32_SHUFFLED,
+    MODE_ELEMENTS32,
+    MODE_ELEMENTS16,
+    MODE_LOOP32,
+    MODE_MULTI32,
+    MODE_COUNT
+};
+
+enum index_order { ORDER_ROWS, ORDER_SHUFFLED, ORDER_OPTIMIZED, ORDER_COUNT };
+
+static const char *mode_names[MODE_COUNT] = { "arrays", "instanced", "elements32", "elements32", "elements32",
+                                              "elements16", "loop32", "multi32" };
+static const enum index_order mode_orders[MODE_COUNT] = { ORDER_ROWS, ORDER_ROWS, ORDER_ROWS, ORDER_SHUFFLED,
+                                                          ORDER_OPTIMIZED, ORDER_OPTIMIZED, ORDER_OPTIMIZED,
+                                                          ORDER_OPTIMIZED };
+static const char *order_names[ORDER_COUNT] = { "rows", "shuffled", "optimized" };
+
+struct geometry {
+    const struct mesh *mesh;
+    uint32_t *orders[ORDER_COUNT];  /* one patch's indices in each order */
+    GLsizei *counts;                /* per patch, for the per-patch modes */
+    const void **offsets32;
+    const void **offsets16;
+    GLint *base_vertices;
+    GLuint placed_program;
+    GLuint instanced_program;
+};
+
+static int mode_is_indexed(enum geometry_mode mode)
+{
+    return mode != MODE_ARRAYS && mode != MODE_INSTANCED;
+}
+
+static uint64_t mode_bytes(const struct mesh *mesh, enum geometry_mode mode)
+{
+    uint64_t vertices = (uint64_t) mesh->patch_count * mesh->patch_vertex_count * 2 * sizeof(float);
+    uint64_t indices = (uint64_t) mesh->patch_count * mesh->patch_index_count;
+
+    switch (mode) {
+    case MODE_ARRAYS:     return indices * 2 * sizeof(float);
+    case MODE_INSTANCED:  return (uint64_t) mesh->patch_index_count * 2 * sizeof(float);
+    case MODE_ELEMENTS16: return vertices + indices * sizeof(uint16_t);
+    default:              return vertices + indices * sizeof(uint32_t);
+    }
+}
+
+/* Vertices a frame references. */
+static uint64_t mode_vertices(const struct mesh *mesh, enum geometry_mode mode)
+{
+    if (mode_is_indexed(mode)) {
+        return (uint64_t) mesh->patch_count * mesh->patch_vertex_count;
+    }
+    return (uint64_t) mesh->patch_count * mesh->patch_index_count;
+}
+
+static GLuint upload_placed_vertices(const struct mesh *mesh, float *scratch)
+{
+    GLsizeiptr patch_bytes = mesh->patch_vertex_count * 2 * sizeof(float);
+    GLuint buffer;
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, patch_bytes * mesh->patch_count, NULL, GL_STATIC_DRAW);
+    for (int p = 0; p < mesh->patch_count; p++) {
+        mesh_place_patch(mesh, p, scratch);
+        glBufferSubData(GL_ARRAY_BUFFER, patch_bytes * p, patch_bytes, scratch);
+    }
+    return buffer;
+}
+
+/* Every patch's triangles spelled out; patch space only when instanced. */
+static GLuint upload_unindexed_vertices(const struct mesh *mesh, int patches, const uint32_t *indices,
+                                        float *placed, float *scratch)
+{
+    GLsizeiptr patch_bytes = mesh->patch_index_count * 2 * sizeof(float);
+    GLuint buffer;
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, patch_bytes * patches, NULL, GL_STATIC_DRAW);
+    for (int p = 0; p < patches; p++) {
+        const float *source = mesh->patch_vertices;
+
+        if (patches > 1) {
+            mesh_place_patch(mesh, p, placed);
+            source = placed;
+        }
+        for (uint32_t i = 0; i < mesh->patch_index_count; i++) {
+            scratch[2 * i] = source[2 * indices[i]];
+            scratch[2 * i + 1] = source[2 * indices[i] + 1];
+        }
+        glBufferSubData(GL_ARRAY_BUFFER, patch_bytes * p, patch_bytes, scratch);
+    }
+    return buffer;
+}
+
+static GLuint upload_indices(const struct mesh *mesh, const uint32_t *indices, int wide, void *scratch)
+{
+    GLsizeiptr patch_bytes = mesh->patch_index_count * (wide ? sizeof(uint32_t) : sizeof(uint16_t));
+    GLuint buffer;
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, patch_bytes * mesh->patch_count, NULL, GL_STATIC_DRAW);
+    for (int p = 0; p < mesh->patch_count; p++) {
+        uint32_t base = p * mesh->patch_vertex_count;
+
+        // 16-bit indices stay patch-relative and get their base vertex from the draw
+        for (uint32_t i = 0; i < mesh->patch_index_count; i++) {
+            if (wide) {
+                ((uint32_t *) scratch)[i] = base + indices[i];
+            } else {
+                ((uint16_t *) scratch)[i] = (uint16_t) indices[i];
+            }
+        }
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, patch_bytes * p, patch_bytes, scratch);
+    }
+    return buffer;
+}
+
+static void draw(const struct geometry *geometry, enum geometry_mode mode)
+{
+    const struct mesh *mesh = geometry->mesh;
+    GLsizei total = (GLsizei) (mesh->patch_count * mesh->patch_index_count);
+
+    switch (mode) {
+    case MODE_ARRAYS:
+        glDrawArrays(GL_TRIANGLES, 0, total);
+        break;
+    case MODE_INSTANCED:
+        glDrawArraysInstanced(GL_TRIANGLES, 0, mesh->patch_index_count, mesh->patch_count);
+        break;
+    case MODE_ELEMENTS32_ROWS:
+    case MODE_ELEMENTS32_SHUFFLED:
+    case MODE_ELEMENTS32:
+        glDrawElements(GL_TRIANGLES, total, GL_UNSIGNED_INT, NULL);
+        break;
+    case MODE_ELEMENTS16:
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, geometry->counts, GL_UNSIGNED_SHORT, geometry->offsets16,
+                                      mesh->patch_count, geometry->base_vertices);
+        break;
+    case MODE_LOOP32:
+        for (int p = 0; p < mesh->patch_count; p++) {
+            glDrawElements(GL_TRIANGLES, geometry->counts[p], GL_UNSIGNED_INT, geometry->offsets32[p]);
+        }
+        break;
+    case MODE_MULTI32:
+        glMultiDrawElements(GL_TRIANGLES, geometry->counts, GL_UNSIGNED_INT, geometry->offsets32, mesh->patch_count);
+        break;
+    default:
+        break;
+    }
+}
+
+static int draw_calls(const struct mesh *mesh, enum geometry_mode mode)
+{
+    return mode == MODE_LOOP32 ? mesh->patch_count : 1;
+}
+
+/* Returns 0 if the point ran or was skipped, -1 on a GL failure. */
+static int run_point(const struct geometry *geometry, enum geometry_mode mode, const struct bench_options *options,
+                     int statistics, double *samples)
+{
+    const struct mesh *mesh = geometry->mesh;
+    double mb = mode_bytes(mesh, mode) / (1024.0 * 1024.0);
+    uint64_t triangles = mesh_triangle_count(mesh);
+    float *placed = malloc(mesh->patch_vertex_count * 2 * sizeof(float));
+    float *scratch = malloc(mesh->patch_index_count * 2 * sizeof(float));
+    GLuint vertex_buffer = 0, index_buffer = 0, vao;
+    struct bench_stats stats;
+    int runs = 0;
+
+    printf("%-11s %-10s %9.3f %7d %9.1f", mode_names[mode], mode_is_indexed(mode) ? order_names[mode_orders[mode]] : "-",
+           triangles / 1e6, draw_calls(mesh, mode), mb);
+    if (placed == NULL || scratch == NULL) {
+        printf("\n");
+        free(placed);
+        free(scratch);
+        return -1;
+    }
+    if (mb > MEMORY_BUDGET_MB) {
+        printf("   skipped: over the %d MB budget\n", MEMORY_BUDGET_MB);
+        free(placed);
+        free(scratch);
+        return 0;
+    }
+
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    if (mode == MODE_ARRAYS || mode == MODE_INSTANCED) {
+        int patches = mode == MODE_ARRAYS ? mesh->patch_count : 1;
+        vertex_buffer = upload_unindexed_vertices(mesh, patches, geometry->orders[ORDER_ROWS], placed, scratch);
+    } else {
+        vertex_buffer = upload_placed_vertices(mesh, placed);
+        index_buffer = upload_indices(mesh, geometry->orders[mode_orders[mode]], mode != MODE_ELEMENTS16, scratch);
+    }
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, NULL);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glUseProgram(mode == MODE_INSTANCED ? geometry->instanced_program : geometry->placed_program);
+
+    double spent_ms = 0.0;
+    for (int r = -options->warmup; r < options->repeat; r++) {
+        glFinish();
+        uint64_t start = bench_now_ns();
+        glClear(GL_COLOR_BUFFER_BIT);
+        draw(geometry, mode);
+        glFinish();
+        double ms = (bench_now_ns() - start) / 1e6;
+
+        if (r < 0) {
+            if (ms > POINT_BUDGET_MS / (MIN_RUNS + 1)) {
+                r = -1; // one warm-up is plenty for frames this slow
+            }
+            continue;
+        }
+        samples[runs++] = ms;
+        spent_ms += ms;
+        if (runs >= MIN_RUNS && spent_ms > POINT_BUDGET_MS) {
+            break;
+        }
+    }
+
+    GLuint64 invocations = 0;
+    if (statistics) {
+        GLuint query;
+
+        glGenQueries(1, &query);
+        glBeginQuery(GL_VERTEX_SHADER_INVOCATIONS, query);
+        draw(geometry, mode);
+        glEndQuery(GL_VERTEX_SHADER_INVOCATIONS);
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &invocations);
+        glDeleteQueries(1, &query);
+    }
+
+    bench_stats_compute(samples, runs, &stats);
+    printf(" %5d %11.3f %10.1f %10.1f", runs, stats.median, mode_vertices(mesh, mode) / (stats.median * 1e3),
+           triangles / (stats.median * 1e3));
+    if (statistics) {
+        printf(" %7.2f\n", (double) invocations / triangles);
+    } else {
+        printf(" %7s\n", "-");
+    }
+
+    glUseProgram(0);
+    glBindVertexArray(0);
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &vertex_buffer);
+    glDeleteBuffers(1, &index_buffer);
+    free(placed);
+    free(scratch);
+    return glGetError() == GL_NO_ERROR ? 0 : -1;
+}
+
+static int prepare(struct geometry *geometry, const struct mesh *mesh)
+{
+    geometry->mesh = mesh;
+    for (int o = 0; o < ORDER_COUNT; o++) {
+        geometry->orders[o] = malloc(mesh->patch_index_count * sizeof(uint32_t));
+        if (geometry->orders[o] == NULL) {
+            return -1;
+        }
+        memcpy(geometry->orders[o], mesh->patch_indices, mesh->patch_index_count * sizeof(uint32_t));
+    }
+    mesh_shuffle_triangles(geometry->orders[ORDER_SHUFFLED], mesh->patch_index_count, 0x2545f491u);
+    if (mesh_optimize_vertex_cache(geometry->orders[ORDER_OPTIMIZED], mesh->patch_index_count,
+                                   mesh->patch_vertex_count) != 0) {
+        return -1;
+    }
+
+    geometry->counts = malloc(mesh->patch_count * sizeof(GLsizei));
+    geometry->offsets32 = malloc(mesh->patch_count * sizeof(void *));
+    geometry->offsets16 = malloc(mesh->patch_count * sizeof(void *));
+    geometry->base_vertices = malloc(mesh->patch_count * sizeof(GLint));
+    if (geometry->counts == NULL || geometry->offsets32 == NULL || geometry->offsets16 == NULL ||
+        geometry->base_vertices == NULL) {
+        return -1;
+    }
+    for (int p = 0; p < mesh->patch_count; p++) {
+        geometry->counts[p] = mesh->patch_index_count;
+        geometry->offsets32[p] = (const void *) ((uintptr_t) p * mesh->patch_index_count * sizeof(uint32_t));
+        geometry->offsets16[p] = (const void *) ((uintptr_t) p * mesh->patch_index_count * sizeof(uint16_t));
+        geometry->base_vertices[p] = (GLint) (p * mesh->patch_vertex_count);
+    }
+    return 0;
+}
+
+static void release(struct geometry *geometry)
+{
+    for (int o = 0; o < ORDER_COUNT; o++) {
+        free(geometry->orders[o]);
+        geometry->orders[o] = NULL;
+    }
+    free(geometry->counts);
+    free(geometry->offsets32);
+    free(geometry->offsets16);
+    free(geometry->base_vertices);
+    geometry->counts = NULL;
+    geometry->offsets32 = geometry->offsets16 = NULL;
+    geometry->base_vertices = NULL;
+}
+
+int bench_geometry(const struct bench_options *options)
+{
+    static const uint64_t sizes[] = { 1000, 32768, 1 << 20, 8 << 20, 50000000 };
+    static const float transform[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+    const int size_count = options->quick ? 2 : (int) (sizeof(sizes) / sizeof(sizes[0]));
+    const struct render_target_desc target_desc = { WIDTH, HEIGHT, GL_RGBA8, 0, 1, 1 };
+    struct geometry geometry = { 0 };
+    struct render_target target = { 0 };
+    double *samples;
+    int result = 0;
+
+    glc_context *context = bench_context_create();
+    if (context == NULL) {
+        fprintf(stderr, "could not create a context\n");
+        return 1;
+    }
+
+    samples = calloc(options->repeat > 0 ? options->repeat : 1, sizeof(double));
+    geometry.placed_program = draw_pipeline_compile_program(placed_vertex_shader, fragment_shader);
+    geometry.instanced_program = draw_pipeline_compile_program(instanced_vertex_shader, fragment_shader);
+    if (samples == NULL || geometry.placed_program == 0 || geometry.instanced_program == 0 ||
+        render_target_create(&target, &target_desc) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "could not set up\n");
+        result = 1;
+        goto done;
+    }
+
+    glUseProgram(geometry.placed_program);
+    glUniformMatrix4fv(glGetUniformLocation(geometry.placed_program, "transform"), 1, GL_FALSE, transform);
+    glUseProgram(geometry.instanced_program);
+    glUniformMatrix4fv(glGetUniformLocation(geometry.instanced_program, "transform"), 1, GL_FALSE, transform);
+    glUseProgram(0);
+
+    int statistics = bench_has_gl(4, 6, "GL_ARB_pipeline_statistics_query");
+    printf("%dx%d RGBA8, vertex shader invocations %s, %s\n", WIDTH, HEIGHT,
+           statistics ? "counted" : "not countable here", glGetString(GL_RENDERER));
+    render_target_bind(&target);
+
+    for (int s = 0; s < size_count && result == 0; s++) {
+        struct mesh mesh;
+
+        if (mesh_create_grid(&mesh, sizes[s]) != 0 || prepare(&geometry, &mesh) != 0) {
+            fprintf(stderr, "out of memory\n");
+            result = 1;
+        } else {
+            glUseProgram(geometry.instanced_program);
+            glUniform1i(glGetUniformLocation(geometry.instanced_program, "patches_per_row"), mesh.patches_per_row);
+            glUseProgram(0);
+
+            printf("-- %llu triangles: %d patch(es) of %dx%d quads, ACMR at %d entries: rows %.3f, "
+                   "shuffled %.3f, optimized %.3f\n",
+                   (unsigned long long) mesh_triangle_count(&mesh), mesh.patch_count, mesh.columns, mesh.rows, MESH_CACHE_SIZE,
+                   mesh_acmr(geometry.orders[ORDER_ROWS], mesh.patch_index_count, MESH_CACHE_SIZE),
+                   mesh_acmr(geometry.orders[ORDER_SHUFFLED], mesh.patch_index_count, MESH_CACHE_SIZE),
+                   mesh_acmr(geometry.orders[ORDER_OPTIMIZED], mesh.patch_index_count, MESH_CACHE_SIZE));
+            printf("%-11s %-10s %9s %7s %9s %5s %11s %10s %10s %7s\n", "mode", "order", "Mtris", "draws", "MB",
+                   "runs", "frame ms", "Mverts/s", "Mtris/s", "VS/tri");
+            for (int m = 0; m < MODE_COUNT; m++) {
+                if (run_point(&geometry, m, options, statistics, samples) != 0) {
+                    fprintf(stderr, "GL error during the run\n");
+                    result = 1;
+                    break;
+                }
+            }
+        }
+        release(&geometry);
+        mesh_destroy(&mesh);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+done:
+    render_target_destroy(&target);
+    glDeleteProgram(geometry.placed_program);
+    glDeleteProgram(geometry.instanced_program);
+    free(samples);
+    bench_context_destroy(context);
+    return result;
+}
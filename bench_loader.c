@@ -0,0 +1,249 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "loader.h"
+#include "render_target.h"
+
+/*
+ * Asset streaming against worker count. A set of 1 MB assets, half
+ * 512 x 512 RGBA8 textures and half buffers, is loaded while the render
+ * thread keeps drawing frames (clear a 256 x 256 target, glFinish as a
+ * stand-in for the swap). With 0 workers the render thread uploads one
+ * asset per frame itself, which is what the suite's code does today; with
+ * K it submits everything to a loader and only collects between frames.
+ *
+ * "load ms" is the time until every asset has been collected, MB/s the
+ * payload over it, and the frame columns are what the render thread saw
+ * meanwhile: the point of a loader is that they stay flat. Each point runs
+ * options->repeat times or until POINT_BUDGET_MS, but at least MIN_RUNS,
+ * and every run checks the first bytes of every asset on the render
+ * context.
+ */
+
+#define ASSETS 256
+#define QUICK_ASSETS 32
+#define TEXTURE_SIZE 512
+#define ASSET_BYTES (TEXTURE_SIZE * TEXTURE_SIZE * 4)
+#define POINT_BUDGET_MS 3000.0
+#define MIN_RUNS 3
+#define MAX_FRAMES (1 << 20)
+
+static void render_frame(void)
+{
+    glClear(GL_COLOR_BUFFER_BIT);
+    glFinish();
+}
+
+/* 1 if the first bytes of the asset's object are its data's. */
+static int asset_arrived(const struct loader_request *request, unsigned char *check)
+{
+    if (request->failed) {
+        return 0;
+    }
+    if (request->kind == LOADER_BUFFER) {
+        glBindBuffer(GL_COPY_READ_BUFFER, request->name);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, 64, check);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    } else {
+        glBindTexture(GL_TEXTURE_2D, request->name);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, check);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    return memcmp(check, request->data, 64) == 0;
+}
+
+static void delete_asset(struct loader_request *request)
+{
+    if (request->kind == LOADER_BUFFER) {
+        glDeleteBuffers(1, &request->name);
+    } else {
+        glDeleteTextures(1, &request->name);
+    }
+    request->name = 0;
+}
+
+/*
+ * Loads every asset once, appending a time per frame at frame_ms[*frame_count]
+ * until MAX_FRAMES. Returns the wall time in ms, or a negative value on error.
+ */
+static double run_load(struct loader *loader, int workers, struct loader_request *requests, int assets,
+                       double *frame_ms, int *frame_count, unsigned char *check)
+{
+    int collected = 0, submitted = 0, bad = 0;
+
+    glFinish();
+    uint64_t start = bench_now_ns();
+
+    while (collected < assets) {
+        uint64_t frame_start = bench_now_ns();
+
+        if (workers == 0) {
+            loader_run(&requests[collected]);
+            glWaitSync(requests[collected].fence, 0, GL_TIMEOUT_IGNORED);
+            glDeleteSync(requests[collected].fence);
+            requests[collected].fence = NULL;
+            collected++;
+        } else {
+            while (submitted < assets && loader_submit(loader, &requests[submitted]) == 0) {
+                submitted++;
+            }
+            while (loader_collect(loader, 0) != NULL) {
+                collected++;
+            }
+        }
+        render_frame();
+        if (*frame_count < MAX_FRAMES) {
+            frame_ms[(*frame_count)++] = (bench_now_ns() - frame_start) / 1e6;
+        }
+    }
+    double elapsed_ms = (bench_now_ns() - start) / 1e6;
+
+    for (int i = 0; i < assets; i++) {
+        if (i < collected) {
+            bad += !asset_arrived(&requests[i], check);
+        }
+        delete_asset(&requests[i]);
+    }
+    if (collected < assets || bad > 0) {
+        fprintf(stderr, "%d of %d asset(s) did not arrive intact\n", assets - collected + bad, assets);
+        return -1.0;
+    }
+    return elapsed_ms;
+}
+
+int bench_loader(const struct bench_options *options)
+{
+    static const int worker_counts[] = { 0, 1, 2, 4, 8 };
+    const int assets = options->quick ? QUICK_ASSETS : ASSETS;
+    const int point_count = options->quick ? 3 : (int) (sizeof(worker_counts) / sizeof(worker_counts[0]));
+    const struct texture_upload_format *rgba8 = &texture_upload_formats[1];
+    glc_attrib attribs[] = {
+        GLC_ATTRIB_CORE_PROFILE,
+        GLC_ATTRIB_END
+    };
+    glc_pixel_format *pixel_format;
+    glc_context *context = NULL;
+    int result = 0;
+
+    if (glc_choose_pixel_format(attribs, &pixel_format, NULL) != GLC_NO_ERROR) {
+        fprintf(stderr, "could not choose a pixel format\n");
+        return 1;
+    }
+    if (glc_create_context(pixel_format, NULL, &context) != GLC_NO_ERROR ||
+        glc_set_current_context(context) != GLC_NO_ERROR) {
+        fprintf(stderr, "could not create a context\n");
+        if (context != NULL) {
+            glc_destroy_context(context);
+        }
+        glc_destroy_pixel_format(pixel_format);
+        return 1;
+    }
+
+    struct loader_request *requests = calloc(assets, sizeof(*requests));
+    unsigned char *data = malloc((size_t) assets * ASSET_BYTES);
+    unsigned char *check = malloc(ASSET_BYTES);
+    double *run_ms = calloc(options->repeat, sizeof(double));
+    double *frame_ms = calloc(MAX_FRAMES, sizeof(double));
+    struct render_target target;
+    struct render_target_desc desc = { 256, 256, GL_RGBA8, 0, 0, 1 };
+    int have_target = 0;
+
+    if (requests == NULL || data == NULL || check == NULL || run_ms == NULL || frame_ms == NULL) {
+        fprintf(stderr, "out of memory\n");
+        result = 1;
+    } else if (render_target_create(&target, &desc) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "could not create the render target\n");
+        result = 1;
+    } else {
+        have_target = 1;
+    }
+
+    if (result == 0) {
+        for (size_t i = 0; i < (size_t) assets * ASSET_BYTES; i++) {
+            data[i] = (unsigned char) (i * 2654435761u >> 13);
+        }
+        for (int a = 0; a < assets; a++) {
+            struct loader_request *request = &requests[a];
+
+            memcpy(data + (size_t) a * ASSET_BYTES, &a, sizeof(a));
+            request->kind = a % 2 ? LOADER_BUFFER : LOADER_TEXTURE;
+            request->data = data + (size_t) a * ASSET_BYTES;
+            request->size = ASSET_BYTES;
+            request->format = rgba8;
+            request->width = TEXTURE_SIZE;
+            request->height = TEXTURE_SIZE;
+        }
+        render_target_bind(&target);
+        glClearColor(0.2f, 0.3f, 0.4f, 1.0f);
+
+        printf("%d x 1 MB assets, half RGBA8 textures, half buffers, %s\n", assets, glGetString(GL_RENDERER));
+        printf("%7s %5s %10s %10s %8s %11s %11s %11s\n", "workers", "runs", "load ms", "MB/s", "frames",
+               "frame p50", "frame p99", "frame max");
+    }
+
+    for (int p = 0; p < point_count && result == 0; p++) {
+        int workers = worker_counts[p];
+        struct loader loader;
+        struct bench_stats run, frame;
+        int frame_count = 0, runs = 0;
+        double spent_ms = 0.0;
+
+        if (workers > 0 && loader_init(&loader, pixel_format, context, workers) != 0) {
+            fprintf(stderr, "could not start %d worker(s)\n", workers);
+            result = 1;
+            break;
+        }
+
+        for (int r = -options->warmup; r < options->repeat; r++) {
+            int warm_frames = 0;
+            // warm-up frames go where the timed ones will overwrite them
+            double ms = run_load(&loader, workers, requests, assets, frame_ms, r < 0 ? &warm_frames : &frame_count,
+                                 check);
+
+            if (ms < 0.0) {
+                result = 1;
+                break;
+            }
+            if (r < 0) {
+                continue;
+            }
+            run_ms[runs++] = ms;
+            spent_ms += ms;
+            if (runs >= MIN_RUNS && spent_ms > POINT_BUDGET_MS) {
+                break;
+            }
+        }
+        if (workers > 0) {
+            loader_destroy(&loader);
+        }
+        if (result != 0) {
+            break;
+        }
+
+        bench_stats_compute(run_ms, runs, &run);
+        bench_stats_compute(frame_ms, frame_count, &frame);
+        printf("%7d %5d %10.1f %10.1f %8.1f %11.3f %11.3f %11.3f\n", workers, runs, run.median,
+               assets * (ASSET_BYTES / 1e6) / (run.median / 1e3), (double) frame_count / runs, frame.median,
+               frame.p99, frame.max);
+    }
+
+    if (have_target) {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        render_target_destroy(&target);
+    }
+    if (glGetError() != GL_NO_ERROR) {
+        fprintf(stderr, "GL error during the run\n");
+        result = 1;
+    }
+
+    free(requests);
+    free(data);
+    free(check);
+    free(run_ms);
+    free(frame_ms);
+    glc_destroy_context(context);
+    glc_destroy_pixel_format(pixel_format);
+    return result;
+}
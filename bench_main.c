@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "gl_trace.h"
+
+static const struct {
+    const char *name;
+    const char *description;
+    int (*run)(const struct bench_options *options);
+} benches[] = {
+    { "bind", "bind churn replayed directly and through the bind cache", bench_bind },
+    { "buffer_readback", "buffer readback: glGetBufferSubData, mapped read, staging copy", bench_buffer_readback },
+    { "compare", "golden-image compare kernels on the CPU", bench_compare },
+    { "context", "context bring-up latency: choose, create, make current, destroy; pixel-format cache", bench_context },
+    { "draw", "draw-call throughput on the draw test's pipeline", bench_draw },
+    { "errors", "error checking: glGetError after every call vs. the debug callback", bench_errors },
+    { "feedback", "transform-feedback kernels vs. scalar/SSE2/AVX2 CPU loops", bench_feedback },
+    { "frame_loop", "sustained offscreen frame loop over 1-3 FBOs: frame time, readback latency, drift", bench_frame_loop },
+    { "geometry", "mesh throughput: unindexed, 16/32-bit indexed, cache-optimised, instanced, multi-draw", bench_geometry },
+    { "loader", "asset streaming on worker threads with shared contexts vs. on the render thread", bench_loader },
+    { "program_cache", "cold vs. warm program start-up through the binary cache", bench_program_cache },
+    { "readback", "glReadPixels vs. a PBO ring with fences", bench_readback },
+    { "reference", "CPU reference raster of expected frames up to 4K, per kernel and thread count, vs. the GPU", bench_reference },
+    { "render_targets", "fill rate and memory across resolution, formats, MSAA and MRT", bench_render_targets },
+    { "shader_corpus", "startup compile of 256 shader variants: serial, KHR_parallel_shader_compile, worker contexts", bench_shader_corpus },
+    { "stream", "per-frame vertex upload: orphaning, glBufferSubData, stream ring", bench_stream },
+    { "texture_upload", "texture streaming: glTexImage2D, glTexSubImage2D into storage, PBO ring", bench_texture_upload },
+    { "trace", "GL call tracing overhead on the draw-call hot path", bench_trace },
+    { "vertex_layout", "vertex layouts: AoS vs. SoA, half floats, packed normals, normalised 8/16-bit", bench_vertex_layout }
+};
+
+#define BENCH_COUNT (int) (sizeof(benches) / sizeof(benches[0]))
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [--repeat=N] [--warmup=N] [--quick] [benchmark...]\n\n", argv0);
+    for (int i = 0; i < BENCH_COUNT; i++) {
+        fprintf(stderr, "  %-16s %s\n", benches[i].name, benches[i].description);
+    }
+    fprintf(stderr, "\nWith no benchmark named, all of them run.\n");
+}
+
+int main(int argc, char **argv)
+{
+    struct bench_options options = { 20, 3, 0 };
+    int selected[BENCH_COUNT] = { 0 };
+    int any_selected = 0;
+    int failed = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--repeat=", 9) == 0) {
+            options.repeat = atoi(argv[i] + 9);
+        } else if (strncmp(argv[i], "--warmup=", 9) == 0) {
+            options.warmup = atoi(argv[i] + 9);
+        } else if (strcmp(argv[i], "--quick") == 0) {
+            options.quick = 1;
+        } else {
+            int found = 0;
+            for (int b = 0; b < BENCH_COUNT; b++) {
+                if (strcmp(argv[i], benches[b].name) == 0) {
+                    selected[b] = found = any_selected = 1;
+                }
+            }
+            if (!found) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    if (options.repeat < 1) {
+        options.repeat = 1;
+    }
+
+    gl_trace_init();
+
+    for (int b = 0; b < BENCH_COUNT; b++) {
+        if (any_selected && !selected[b]) {
+            continue;
+        }
+        printf("== %s: %s\n", benches[b].name, benches[b].description);
+        if (benches[b].run(&options) != 0) {
+            printf("== %s FAILED\n", benches[b].name);
+            failed++;
+        }
+        printf("\n");
+    }
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
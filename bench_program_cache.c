@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "program_cache.h"
+
+/*
+ * Cold vs. warm start of a set of programs through the program cache.
+ * Cold starts from an empty cache file, so every program is compiled and
+ * stored; warm reopens the file the cold run left and loads the binaries.
+ * Each run salts the sources so the driver's own shader cache (Mesa has
+ * one) cannot make the cold run warm.
+ */
+
+static const char *vs_template =
+    "#version 410\n"
+    "// run %llu program %d\n"
+    "layout (location = 0) in vec2 v;"
+    "out vec2 uv;"
+    "void main() {"
+    "   uv = v * 0.5 + 0.5;"
+    "   gl_Position = vec4(v, 0.0, 1.0);"
+    "}";
+
+static const char *fs_template =
+    "#version 410\n"
+    "// run %llu program %d\n"
+    "in vec2 uv;"
+    "layout (location = 0) out vec4 frag_color;"
+    "uniform sampler2D image;"
+    "void main() {"
+    "   vec4 sum = vec4(0.0);"
+    "   for (int i = -4; i <= 4; i++) {"
+    "       for (int j = -4; j <= 4; j++) {"
+    "           sum += texture(image, uv + vec2(i, j) * %d.0 / 1024.0) * exp(-float(i * i + j * j) / 8.0);"
+    "       }"
+    "   }"
+    "   frag_color = pow(sum / 20.0, vec4(1.0 / 2.2));"
+    "}";
+
+struct program_sources {
+    char vs[512];
+    char fs[1024];
+};
+
+/* Gets every program through the cache; returns the wall time in ms, or -1. */
+static double start_up(const char *path, const struct program_sources *sources, int count,
+                       struct program_cache_stats *stats)
+{
+    struct program_cache cache;
+    GLuint *programs = calloc(count, sizeof(*programs));
+    int failed = programs == NULL;
+
+    glFinish();
+    uint64_t start = bench_now_ns();
+
+    program_cache_open(&cache, path);
+    for (int i = 0; i < count && !failed; i++) {
+        programs[i] = program_cache_get(&cache, sources[i].vs, sources[i].fs);
+        failed = programs[i] == 0;
+    }
+    *stats = cache.stats;
+    program_cache_close(&cache);
+
+    glFinish();
+    double elapsed_ms = (bench_now_ns() - start) / 1e6;
+
+    for (int i = 0; programs != NULL && i < count; i++) {
+        glDeleteProgram(programs[i]);
+    }
+    free(programs);
+    return failed ? -1.0 : elapsed_ms;
+}
+
+int bench_program_cache(const struct bench_options *options)
+{
+    int count = options->quick ? 8 : 64;
+    struct program_sources *sources = calloc(count, sizeof(*sources));
+    double *cold_ms = calloc(options->repeat, sizeof(*cold_ms));
+    double *warm_ms = calloc(options->repeat, sizeof(*warm_ms));
+    struct program_cache_stats cold, warm;
+    int result = 0;
+
+    glc_context *context = bench_context_create();
+    if (context == NULL || sources == NULL || cold_ms == NULL || warm_ms == NULL) {
+        fprintf(stderr, "could not set up\n");
+        free(sources);
+        free(cold_ms);
+        free(warm_ms);
+        bench_context_destroy(context);
+        return 1;
+    }
+
+    GLint binary_formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binary_formats);
+    printf("%d programs, %d binary format(s), %s\n", count, binary_formats, glGetString(GL_RENDERER));
+
+    for (int r = -options->warmup; r < options->repeat && result == 0; r++) {
+        unsigned long long salt = bench_now_ns();
+        char path[] = "/tmp/open_gl_bench_program_cache_XXXXXX";
+        close(mkstemp(path));
+
+        for (int i = 0; i < count; i++) {
+            snprintf(sources[i].vs, sizeof(sources[i].vs), vs_template, salt, i);
+            snprintf(sources[i].fs, sizeof(sources[i].fs), fs_template, salt, i, i + 1);
+        }
+
+        double cold_run = start_up(path, sources, count, &cold);
+        double warm_run = start_up(path, sources, count, &warm);
+        unlink(path);
+
+        if (cold_run < 0.0 || warm_run < 0.0) {
+            fprintf(stderr, "a program did not compile\n");
+            result = 1;
+        } else if (r >= 0) {
+            cold_ms[r] = cold_run;
+            warm_ms[r] = warm_run;
+        }
+    }
+
+    if (result == 0) {
+        struct bench_stats cold_stats, warm_stats;
+
+        bench_stats_compute(cold_ms, options->repeat, &cold_stats);
+        bench_stats_compute(warm_ms, options->repeat, &warm_stats);
+
+        printf("%-5s %10s %10s %12s %6s %6s %9s %10s\n",
+               "start", "ms p50", "ms p99", "ms/program", "hits", "misses", "rejected", "saved ms");
+        printf("%-5s %10.2f %10.2f %12.3f %6llu %6llu %9llu %10s\n", "cold",
+               cold_stats.median, cold_stats.p99, cold_stats.median / count,
+               (unsigned long long) cold.hits, (unsigned long long) cold.misses,
+               (unsigned long long) cold.rejected, "-");
+        printf("%-5s %10.2f %10.2f %12.3f %6llu %6llu %9llu %10.2f\n", "warm",
+               warm_stats.median, warm_stats.p99, warm_stats.median / count,
+               (unsigned long long) warm.hits, (unsigned long long) warm.misses,
+               (unsigned long long) warm.rejected, (warm.saved_ns - warm.load_ns) / 1e6);
+    }
+
+    if (glGetError() != GL_NO_ERROR) {
+        fprintf(stderr, "GL error during the run\n");
+        result = 1;
+    }
+
+    free(sources);
+    free(cold_ms);
+    free(warm_ms);
+    bench_context_destroy(context);
+    return result;
+}
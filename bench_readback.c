@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "draw_pipeline.h"
+#include "readback.h"
+
+/*
+ * Synchronous glReadPixels against the PBO ring. Each frame clears to a
+ * frame-specific color and draws the suite's triangle, then reads the
+ * whole frame back. Latency is measured per frame from the moment it was
+ * submitted to the moment its pixels sit in client memory; throughput is
+ * frames (and bytes) delivered per second over the whole run. Every
+ * delivered frame is checked against the color it was cleared to.
+ */
+
+static int frame_shade(uint64_t frame)
+{
+    return (int) ((frame * 37) % 256);
+}
+
+static void render_frame(const struct draw_pipeline *pipeline, uint64_t frame)
+{
+    glClearColor(frame_shade(frame) / 255.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glDrawArrays(GL_TRIANGLES, 0, pipeline->vertex_count);
+}
+
+static int frame_is_correct(const GLubyte *pixels, uint64_t frame)
+{
+    return pixels[0] == frame_shade(frame) && pixels[1] == 0 && pixels[3] == 0xFF;
+}
+
+/*
+ * Runs `frames` frames through the given path (ring_depth 0 is plain
+ * glReadPixels). Appends one latency sample per frame to latencies_ms and
+ * returns the wall time of the run in ms, or a negative value on error.
+ */
+static double run_frames(const struct draw_pipeline *pipeline, struct readback_ring *ring, int ring_depth,
+                         int frames, GLubyte *pixels, double *latencies_ms)
+{
+    GLsizei w = pipeline->width;
+    GLsizei h = pipeline->height;
+    uint64_t *submitted_at = calloc(frames, sizeof(*submitted_at));
+    uint64_t tag;
+    int bad = 0;
+
+    if (submitted_at == NULL) {
+        return -1.0;
+    }
+
+    glFinish();
+    uint64_t start = bench_now_ns();
+
+    for (int f = 0; f < frames; f++) {
+        render_frame(pipeline, f);
+        submitted_at[f] = bench_now_ns();
+
+        if (ring_depth == 0) {
+            glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+            latencies_ms[f] = (bench_now_ns() - submitted_at[f]) / 1e6;
+            bad += !frame_is_correct(pixels, f);
+            continue;
+        }
+
+        if (ring->pending == ring_depth) {
+            if (readback_ring_collect(ring, pixels, UINT64_MAX, &tag) != 1) {
+                bad++;
+                break;
+            }
+            latencies_ms[tag] = (bench_now_ns() - submitted_at[tag]) / 1e6;
+            bad += !frame_is_correct(pixels, tag);
+        }
+        readback_ring_issue(ring, 0, 0, w, h, f);
+    }
+
+    while (ring_depth > 0 && ring->pending > 0) {
+        if (readback_ring_collect(ring, pixels, UINT64_MAX, &tag) != 1) {
+            bad++;
+            break;
+        }
+        latencies_ms[tag] = (bench_now_ns() - submitted_at[tag]) / 1e6;
+        bad += !frame_is_correct(pixels, tag);
+    }
+
+    double elapsed_ms = (bench_now_ns() - start) / 1e6;
+    free(submitted_at);
+
+    if (bad) {
+        fprintf(stderr, "%d frame(s) came back with the wrong contents\n", bad);
+        return -1.0;
+    }
+    return elapsed_ms;
+}
+
+int bench_readback(const struct bench_options *options)
+{
+    static const GLsizei full_sizes[] = { 512, 1024, 2048, 4096 };
+    static const GLsizei quick_sizes[] = { 512, 1024 };
+    static const int ring_depths[] = { 0, 2, 3 };
+
+    const GLsizei *sizes = options->quick ? quick_sizes : full_sizes;
+    int size_count = options->quick ? 2 : 4;
+    int frames = options->quick ? 6 : 16;
+    int result = 0;
+
+    glc_context *context = bench_context_create();
+    if (context == NULL) {
+        fprintf(stderr, "could not create a context\n");
+        return 1;
+    }
+
+    printf("RGBA8, %d frames per run, %s\n", frames, glGetString(GL_RENDERER));
+    printf("%-11s %9s %14s %14s %10s %10s\n",
+           "path", "size", "latency ms p50", "latency ms p99", "frames/s", "MB/s");
+
+    double *latencies_ms = calloc((size_t) frames * options->repeat, sizeof(*latencies_ms));
+    double *run_ms = calloc(options->repeat, sizeof(*run_ms));
+
+    for (int s = 0; s < size_count && result == 0; s++) {
+        GLsizei size = sizes[s];
+        struct draw_pipeline pipeline;
+        GLubyte *pixels = malloc((size_t) size * size * 4);
+
+        if (pixels == NULL || latencies_ms == NULL || run_ms == NULL ||
+            draw_pipeline_create(&pipeline, size, size, triangle, 3) != GL_FRAMEBUFFER_COMPLETE) {
+            fprintf(stderr, "could not set up %dx%d\n", size, size);
+            free(pixels);
+            result = 1;
+            break;
+        }
+        draw_pipeline_bind(&pipeline);
+
+        for (size_t d = 0; d < sizeof(ring_depths) / sizeof(ring_depths[0]) && result == 0; d++) {
+            struct readback_ring ring;
+            struct bench_stats latency, run;
+            char path[32];
+
+            if (ring_depths[d] > 0 &&
+                readback_ring_init(&ring, ring_depths[d], size, size, GL_RGBA, GL_UNSIGNED_BYTE) != 0) {
+                fprintf(stderr, "could not create a %d deep PBO ring\n", ring_depths[d]);
+                result = 1;
+                break;
+            }
+
+            for (int r = -options->warmup; r < options->repeat; r++) {
+                double *latency_slot = latencies_ms + (size_t) (r < 0 ? 0 : r) * frames;
+                double elapsed = run_frames(&pipeline, &ring, ring_depths[d], frames, pixels, latency_slot);
+
+                if (elapsed < 0.0) {
+                    result = 1;
+                    break;
+                }
+                if (r >= 0) {
+                    run_ms[r] = elapsed;
+                }
+            }
+
+            if (ring_depths[d] > 0) {
+                readback_ring_destroy(&ring);
+            }
+            if (result != 0) {
+                break;
+            }
+
+            bench_stats_compute(latencies_ms, frames * options->repeat, &latency);
+            bench_stats_compute(run_ms, options->repeat, &run);
+
+            double frames_per_s = frames / (run.median / 1e3);
+
+            if (ring_depths[d] == 0) {
+                snprintf(path, sizeof(path), "sync");
+            } else {
+                snprintf(path, sizeof(path), "pbo ring %d", ring_depths[d]);
+            }
+            printf("%-11s %4dx%-4d %14.3f %14.3f %10.1f %10.1f\n",
+                   path, size, size, latency.median, latency.p99, frames_per_s,
+                   frames_per_s * size * size * 4 / 1e6);
+        }
+
+        draw_pipeline_unbind();
+        draw_pipeline_destroy(&pipeline);
+        free(pixels);
+    }
+
+    if (glGetError() != GL_NO_ERROR) {
+        fprintf(stderr, "GL error during the run\n");
+        result = 1;
+    }
+
+    free(latencies_ms);
+    free(run_ms);
+    bench_context_destroy(context);
+    return result;
+}
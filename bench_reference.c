@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "draw_pipeline.h"
+#include "image_compare.h"
+#include "reference_raster.h"
+
+/*
+ * How fast reference_raster.h draws an expected frame, against the GPU
+ * drawing and reading back the same one. Two scenes at 512 x 512, 1080p
+ * and 4K: the draw test's triangle, and 2000 random triangles over the
+ * whole frame, kept inside it (see reference_raster.h). Every kernel the CPU has runs on 1 thread and on one per
+ * core; "mismatches" is how many pixels of its frame differ from the
+ * GPU's, which should be none.
+ */
+
+#define POINT_BUDGET_MS 2000.0
+#define MIN_RUNS 3
+#define RANDOM_TRIANGLES 2000
+
+struct size {
+    const char *label;
+    int width;
+    int height;
+};
+
+/* Draws the scene on the GPU into pixels; returns the draw and readback time in ms, or -1. */
+static double gpu_frame(const struct reference_scene *scene, int width, int height, uint8_t *pixels)
+{
+    struct draw_pipeline pipeline;
+
+    if (draw_pipeline_create(&pipeline, width, height, scene->positions, scene->vertex_count) !=
+        GL_FRAMEBUFFER_COMPLETE) {
+        draw_pipeline_destroy(&pipeline);
+        return -1.0;
+    }
+    draw_pipeline_bind(&pipeline);
+    glClearColor(scene->clear_color[0], scene->clear_color[1], scene->clear_color[2], scene->clear_color[3]);
+    glFinish();
+
+    uint64_t start = bench_now_ns();
+    glClear(GL_COLOR_BUFFER_BIT);
+    glDrawArrays(GL_TRIANGLES, 0, scene->vertex_count);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    double elapsed_ms = (bench_now_ns() - start) / 1e6;
+
+    draw_pipeline_unbind();
+    draw_pipeline_destroy(&pipeline);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    return elapsed_ms;
+}
+
+int bench_reference(const struct bench_options *options)
+{
+    static const struct size sizes[] = {
+        { "512x512", 512, 512 },
+        { "1080p", 1920, 1080 },
+        { "4K", 3840, 2160 },
+    };
+    static const enum reference_raster_isa isas[] = {
+        REFERENCE_RASTER_SCALAR, REFERENCE_RASTER_SSE2, REFERENCE_RASTER_AVX2
+    };
+    const int size_count = options->quick ? 2 : 3;
+    const uint8_t exact[4] = { 0, 0, 0, 0 };
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int thread_counts[2] = { 1, cores > 1 ? (int) cores : 1 };
+    float *random = malloc(RANDOM_TRIANGLES * 6 * sizeof(float));
+    struct reference_scene scenes[2] = {
+        { triangle, 3, { 0.0f, 0.0f, 0.0f, 1.0f }, { 1.0f, 1.0f, 1.0f, 1.0f } },
+        { random, RANDOM_TRIANGLES * 3, { 0.0f, 0.0f, 0.0f, 1.0f }, { 1.0f, 1.0f, 1.0f, 1.0f } },
+    };
+    const char *scene_names[2] = { "triangle", "random" };
+    double *run_ms = calloc(options->repeat, sizeof(double));
+    uint8_t *gpu = malloc((size_t) 3840 * 2160 * 4);
+    uint8_t *cpu = malloc((size_t) 3840 * 2160 * 4);
+    uint32_t seed = 1;
+    int result = 0;
+
+    glc_context *context = bench_context_create();
+    if (context == NULL || random == NULL || run_ms == NULL || gpu == NULL || cpu == NULL) {
+        fprintf(stderr, "could not set up\n");
+        free(random);
+        free(run_ms);
+        free(gpu);
+        free(cpu);
+        bench_context_destroy(context);
+        return 1;
+    }
+
+    // small triangles all over, a few pixels to a few hundred each, none crossing the frame's edge
+    for (int t = 0; t < RANDOM_TRIANGLES; t++) {
+        float center[2];
+
+        for (int c = 0; c < 2; c++) {
+            seed = seed * 1103515245u + 12345u;
+            center[c] = ((seed >> 8 & 0xFFFF) / 32768.0f - 1.0f) * 0.95f;
+        }
+        for (int v = 0; v < 6; v++) {
+            seed = seed * 1103515245u + 12345u;
+            random[t * 6 + v] = center[v % 2] + ((seed >> 8 & 0xFFFF) / 32768.0f - 1.0f) * 0.05f;
+        }
+    }
+
+    printf("%ld core(s), %d-pixel tiles, %d subpixel bits, %s\n", cores, REFERENCE_RASTER_TILE,
+           REFERENCE_RASTER_SUBPIXEL_BITS, glGetString(GL_RENDERER));
+    printf("%-8s %-8s %-7s %7s %5s %9s %9s %10s %9s %10s\n", "scene", "size", "kernel", "threads", "runs", "ms p50",
+           "ms p99", "Mpixel/s", "gpu ms", "mismatches");
+
+    for (int s = 0; s < 2 && result == 0; s++) {
+        for (int z = 0; z < size_count && result == 0; z++) {
+            const struct size *size = &sizes[z];
+            double gpu_ms = gpu_frame(&scenes[s], size->width, size->height, gpu);
+
+            if (gpu_ms < 0.0) {
+                fprintf(stderr, "could not draw %s at %s on the GPU\n", scene_names[s], size->label);
+                result = 1;
+                break;
+            }
+
+            for (int k = 0; k < 3 && result == 0; k++) {
+                for (int n = 0; n < 2 && result == 0; n++) {
+                    struct image_compare_result compare;
+                    struct bench_stats stats;
+                    double spent_ms = 0.0;
+                    int runs = 0;
+
+                    if (!reference_raster_isa_supported(isas[k]) || (n == 1 && thread_counts[1] == 1)) {
+                        continue;
+                    }
+                    for (int r = -options->warmup; r < options->repeat; r++) {
+                        uint64_t start = bench_now_ns();
+
+                        if (reference_raster_render_with(isas[k], thread_counts[n], &scenes[s], size->width,
+                                                         size->height, cpu) != 0) {
+                            fprintf(stderr, "the reference raster refused %s\n", scene_names[s]);
+                            result = 1;
+                            break;
+                        }
+                        double ms = (bench_now_ns() - start) / 1e6;
+
+                        if (r < 0) {
+                            continue;
+                        }
+                        run_ms[runs++] = ms;
+                        spent_ms += ms;
+                        if (runs >= MIN_RUNS && spent_ms > POINT_BUDGET_MS) {
+                            break;
+                        }
+                    }
+                    if (result != 0) {
+                        break;
+                    }
+
+                    image_compare_rgba8(cpu, gpu, size->width, size->height, exact, &compare);
+                    bench_stats_compute(run_ms, runs, &stats);
+                    printf("%-8s %-8s %-7s %7d %5d %9.3f %9.3f %10.1f %9.3f %10llu\n", scene_names[s], size->label,
+                           reference_raster_isa_name(isas[k]), thread_counts[n], runs, stats.median, stats.p99,
+                           (double) size->width * size->height / 1e3 / stats.median, gpu_ms,
+                           (unsigned long long) compare.mismatches);
+                }
+            }
+        }
+    }
+
+    if (glGetError() != GL_NO_ERROR) {
+        fprintf(stderr, "GL error during the run\n");
+        result = 1;
+    }
+
+    free(random);
+    free(run_ms);
+    free(gpu);
+    free(cpu);
+    bench_context_destroy(context);
+    return result;
+}
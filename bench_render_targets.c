@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "draw_pipeline.h"
+#include "render_target.h"
+
+/*
+ * Render-target scaling: a full-screen triangle drawn into offscreen
+ * targets swept one axis at a time around a base of RGBA8 color,
+ * DEPTH24 depth, no MSAA and one attachment. The axes are resolution (up
+ * to 8192 x 8192), color format, depth format, sample count (resolved
+ * with blits) and the number of color attachments written at once.
+ *
+ * Every frame clears and draws enough full-screen triangles to cover
+ * about FRAME_PIXELS pixels, so small targets are not all overhead. Fill
+ * rate is pixels covered per second, each pixel counted once however many
+ * attachments and samples it writes. Memory is what the formats take at
+ * their nominal sizes, resolve targets included; drivers pad and
+ * compress, so read it as a lower bound.
+ */
+
+#define FRAME_PIXELS (2048 * 2048 * 4)
+#define MEMORY_BUDGET_MB 2048
+
+static const char *vertex_source =
+    "#version 410\n"
+    "void main()\n"
+    "{\n"
+    "    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n"
+    "    gl_Position = vec4(corner * 2.0 - 1.0, 0.5, 1.0);\n"
+    "}\n";
+
+enum axis { AXIS_SIZE, AXIS_COLOR, AXIS_DEPTH, AXIS_SAMPLES, AXIS_TARGETS, AXIS_COUNT };
+
+static const char *axis_names[AXIS_COUNT] = { "resolution", "color format", "depth format", "MSAA", "render targets" };
+
+static const int sizes[] = { 256, 512, 1024, 2048, 4096, 8192 };
+static const GLenum color_formats[] = { GL_RGBA8, GL_RGBA16F, GL_RGBA32F };
+static const GLenum depth_formats[] = { GL_DEPTH_COMPONENT24, 0, GL_DEPTH_COMPONENT16, GL_DEPTH_COMPONENT32F,
+                                        GL_DEPTH24_STENCIL8 };
+static const int sample_counts[] = { 1, 2, 4, 8 };
+static const int target_counts[] = { 1, 2, 4, 8 };
+
+#define COUNT(array) ((int) (sizeof(array) / sizeof(array[0])))
+
+static const int axis_lengths[AXIS_COUNT] = { COUNT(sizes), COUNT(color_formats), COUNT(depth_formats),
+                                              COUNT(sample_counts), COUNT(target_counts) };
+
+/* Writes a constant, distinct color to each of color_count outputs. */
+static GLuint make_program(int color_count)
+{
+    char source[2048];
+    int used = snprintf(source, sizeof(source), "#version 410\n");
+
+    for (int i = 0; i < color_count; i++) {
+        used += snprintf(source + used, sizeof(source) - used, "layout(location = %d) out vec4 color%d;\n", i, i);
+    }
+    used += snprintf(source + used, sizeof(source) - used, "void main()\n{\n");
+    for (int i = 0; i < color_count; i++) {
+        used += snprintf(source + used, sizeof(source) - used, "    color%d = vec4(%d.0 / 8.0, 0.25, 0.5, 1.0);\n", i,
+                         i + 1);
+    }
+    snprintf(source + used, sizeof(source) - used, "}\n");
+
+    return draw_pipeline_compile_program(vertex_source, source);
+}
+
+static struct render_target_desc point_desc(enum axis axis, int point, int base_size)
+{
+    struct render_target_desc desc = { base_size, base_size, GL_RGBA8, GL_DEPTH_COMPONENT24, 1, 1 };
+
+    switch (axis) {
+    case AXIS_SIZE:    desc.width = desc.height = sizes[point]; break;
+    case AXIS_COLOR:   desc.color_format = color_formats[point]; break;
+    case AXIS_DEPTH:   desc.depth_format = depth_formats[point]; break;
+    case AXIS_SAMPLES: desc.samples = sample_counts[point]; break;
+    case AXIS_TARGETS: desc.color_count = target_counts[point]; break;
+    default:           break;
+    }
+    return desc;
+}
+
+static void draw_frame(const struct render_target *target, int draws)
+{
+    render_target_bind(target);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+    for (int i = 0; i < draws; i++) {
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+}
+
+/* Returns 0 if the point ran or was skipped, -1 on a GL failure. */
+static int run_point(const struct render_target_desc *desc, const struct bench_options *options, GLuint vao,
+                     double *frame_samples, double *resolve_samples)
+{
+    uint64_t pixels = (uint64_t) desc->width * (uint64_t) desc->height;
+    int draws = pixels < FRAME_PIXELS ? (int) (FRAME_PIXELS / pixels) : 1;
+    double mb = render_target_bytes(desc) / (1024.0 * 1024.0);
+    struct render_target target;
+    struct bench_stats frame, resolve;
+    char size[16];
+
+    snprintf(size, sizeof(size), "%dx%d", desc->width, desc->height);
+    printf("%-10s %-9s %-17s %7d %7d %9.1f", size, render_target_format_name(desc->color_format),
+           render_target_format_name(desc->depth_format), desc->samples, desc->color_count, mb);
+
+    if (mb > MEMORY_BUDGET_MB) {
+        printf("   skipped: over the %d MB budget\n", MEMORY_BUDGET_MB);
+        return 0;
+    }
+
+    GLenum status = render_target_create(&target, desc);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        printf("   skipped: %s\n", status == GL_INVALID_VALUE ? "over the context's limits" : "incomplete");
+        render_target_destroy(&target);
+        // an out-of-memory renderbuffer leaves an error behind; this is a skip, not a failure
+        while (glGetError() != GL_NO_ERROR) {
+        }
+        return 0;
+    }
+
+    GLuint program = make_program(desc->color_count);
+    if (program == 0) {
+        printf("\n");
+        fprintf(stderr, "could not build the %d-output program\n", desc->color_count);
+        render_target_destroy(&target);
+        return -1;
+    }
+    glUseProgram(program);
+    glBindVertexArray(vao);
+
+    for (int r = -options->warmup; r < options->repeat; r++) {
+        glFinish();
+        uint64_t start = bench_now_ns();
+        draw_frame(&target, draws);
+        glFinish();
+        uint64_t drawn = bench_now_ns();
+        render_target_resolve(&target);
+        glFinish();
+        uint64_t resolved = bench_now_ns();
+
+        if (r >= 0) {
+            frame_samples[r] = (drawn - start) / 1e6;
+            resolve_samples[r] = (resolved - drawn) / 1e6;
+        }
+    }
+
+    bench_stats_compute(frame_samples, options->repeat, &frame);
+    bench_stats_compute(resolve_samples, options->repeat, &resolve);
+    printf(" %7d %11.3f %10.1f", draws, frame.median, draws * pixels / (frame.median * 1e3));
+    if (desc->samples > 1) {
+        printf(" %11.3f\n", resolve.median);
+    } else {
+        printf(" %11s\n", "-");
+    }
+
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteProgram(program);
+    render_target_destroy(&target);
+    return glGetError() == GL_NO_ERROR ? 0 : -1;
+}
+
+int bench_render_targets(const struct bench_options *options)
+{
+    const int base_size = options->quick ? sizes[0] : 2048;
+    double *frame_samples, *resolve_samples;
+    GLint max_size = 0, max_samples = 0, max_draw_buffers = 0;
+    GLuint vao;
+    int result = 0;
+
+    glc_context *context = bench_context_create();
+    if (context == NULL) {
+        fprintf(stderr, "could not create a context\n");
+        return 1;
+    }
+
+    frame_samples = calloc(options->repeat, sizeof(double));
+    resolve_samples = calloc(options->repeat, sizeof(double));
+    if (frame_samples == NULL || resolve_samples == NULL) {
+        fprintf(stderr, "out of memory\n");
+        result = 1;
+        goto done;
+    }
+
+    glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &max_size);
+    glGetIntegerv(GL_MAX_SAMPLES, &max_samples);
+    glGetIntegerv(GL_MAX_DRAW_BUFFERS, &max_draw_buffers);
+    printf("about %d Mpixels per frame, renderbuffers up to %d, %d samples, %d draw buffers, %s\n",
+           FRAME_PIXELS >> 20, max_size, max_samples, max_draw_buffers, glGetString(GL_RENDERER));
+
+    // the full-screen triangle comes from gl_VertexID; core profile still wants a VAO bound
+    glGenVertexArrays(1, &vao);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_ALWAYS);
+
+    for (int axis = 0; axis < AXIS_COUNT && result == 0; axis++) {
+        int points = options->quick ? 2 : axis_lengths[axis];
+
+        printf("-- %s\n", axis_names[axis]);
+        printf("%-10s %-9s %-17s %7s %7s %9s %7s %11s %10s %11s\n", "size", "color", "depth", "samples",
+               "targets", "MB", "draws", "frame ms", "Mpix/s", "resolve ms");
+        for (int point = 0; point < points; point++) {
+            // the base point is in every sweep; print it once
+            if (axis != AXIS_SIZE && point == 0) {
+                continue;
+            }
+            struct render_target_desc desc = point_desc(axis, point, base_size);
+
+            if (run_point(&desc, options, vao, frame_samples, resolve_samples) != 0) {
+                fprintf(stderr, "GL error during the run\n");
+                result = 1;
+                break;
+            }
+        }
+    }
+
+    glDisable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+    glDeleteVertexArrays(1, &vao);
+
+done:
+    free(frame_samples);
+    free(resolve_samples);
+    bench_context_destroy(context);
+    return result;
+}
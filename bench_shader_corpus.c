@@ -0,0 +1,233 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "shader_corpus.h"
+
+/*
+ * Startup time of a generated corpus of shader variants (shader_corpus.h)
+ * compiled serially, through KHR_parallel_shader_compile, and on 1, 2 and
+ * 4 loader workers. Every run generates the corpus with a fresh salt so
+ * the driver's shader cache stays cold, and fails if a variant does not
+ * link. The workers' contexts are made before the clock starts, as an
+ * application would make them while it is still loading other things.
+ *
+ * "startup" is the wall time until every program is usable on the main
+ * context, "first" until the first one is, and the speed-up is the serial
+ * p50 over the point's. The per-program cost of each stage comes from the
+ * serial runs; the main thread columns are what the PARALLEL path spent
+ * issuing compiles and links before it could go on.
+ *
+ * SHADER_CORPUS_VARIANTS replaces the corpus size.
+ */
+
+#define VARIANTS 256
+#define QUICK_VARIANTS 32
+#define WARM_VARIANTS 4
+#define POINT_BUDGET_MS 10000.0
+#define MIN_RUNS 3
+
+struct point {
+    const char *label;
+    enum shader_corpus_mode mode;
+    int workers;
+};
+
+/* Times one compile of a fresh corpus, appending per-program costs; returns ms, or -1 on failure. */
+static double run_corpus(int variants, enum shader_corpus_mode mode, struct loader *loader, double *first_ms,
+                         double *compile_ms, double *link_ms, int *cost_count)
+{
+    struct shader_corpus corpus;
+    struct shader_corpus_result *results = calloc(variants, sizeof(*results));
+    double elapsed_ms = -1.0;
+
+    if (results == NULL || shader_corpus_generate(&corpus, variants, bench_now_ns()) != 0) {
+        free(results);
+        return -1.0;
+    }
+
+    glFinish();
+    uint64_t start = bench_now_ns();
+    int failed = shader_corpus_compile(&corpus, mode, loader, results);
+    glFinish();
+    double run_ms = (bench_now_ns() - start) / 1e6;
+
+    if (failed > 0) {
+        fprintf(stderr, "%d of %d variant(s) did not link\n", failed, variants);
+    } else {
+        elapsed_ms = run_ms;
+        *first_ms = results[0].ready_ns / 1e6;
+        for (int i = 0; i < variants; i++) {
+            if (results[i].ready_ns / 1e6 < *first_ms) {
+                *first_ms = results[i].ready_ns / 1e6;
+            }
+        }
+        for (int i = 0; compile_ms != NULL && i < variants; i++) {
+            compile_ms[*cost_count] = results[i].compile_ns / 1e6;
+            link_ms[(*cost_count)++] = results[i].link_ns / 1e6;
+        }
+    }
+
+    for (int i = 0; i < variants; i++) {
+        glDeleteProgram(results[i].program);
+    }
+    free(results);
+    shader_corpus_destroy(&corpus);
+    return elapsed_ms;
+}
+
+int bench_shader_corpus(const struct bench_options *options)
+{
+    static const struct point points[] = {
+        { "serial", SHADER_CORPUS_SERIAL, 0 },
+        { "parallel", SHADER_CORPUS_PARALLEL, 0 },
+        { "workers", SHADER_CORPUS_WORKERS, 1 },
+        { "workers", SHADER_CORPUS_WORKERS, 2 },
+        { "workers", SHADER_CORPUS_WORKERS, 4 },
+    };
+    const int point_count = (int) (sizeof(points) / sizeof(points[0]));
+    const char *variants_env = getenv("SHADER_CORPUS_VARIANTS");
+    int variants = options->quick ? QUICK_VARIANTS : VARIANTS;
+    glc_attrib attribs[] = {
+        GLC_ATTRIB_CORE_PROFILE,
+        GLC_ATTRIB_END
+    };
+    glc_pixel_format *pixel_format;
+    glc_context *context = NULL;
+    double serial_ms = 0.0;
+    int result = 0;
+
+    if (variants_env != NULL && atoi(variants_env) > 0) {
+        variants = atoi(variants_env);
+    }
+
+    if (glc_choose_pixel_format(attribs, &pixel_format, NULL) != GLC_NO_ERROR) {
+        fprintf(stderr, "could not choose a pixel format\n");
+        return 1;
+    }
+    if (glc_create_context(pixel_format, NULL, &context) != GLC_NO_ERROR ||
+        glc_set_current_context(context) != GLC_NO_ERROR) {
+        fprintf(stderr, "could not create a context\n");
+        if (context != NULL) {
+            glc_destroy_context(context);
+        }
+        glc_destroy_pixel_format(pixel_format);
+        return 1;
+    }
+
+    int parallel = shader_corpus_has_parallel_compile();
+    int max_runs = options->repeat > MIN_RUNS ? options->repeat : MIN_RUNS;
+    double *run_ms = calloc(max_runs, sizeof(double));
+    double *first_ms = calloc(max_runs, sizeof(double));
+    double *compile_ms = calloc((size_t) max_runs * variants, sizeof(double));
+    double *link_ms = calloc((size_t) max_runs * variants, sizeof(double));
+    double *issue_compile_ms = calloc((size_t) max_runs * variants, sizeof(double));
+    double *issue_link_ms = calloc((size_t) max_runs * variants, sizeof(double));
+    int serial_costs = 0, issue_costs = 0;
+
+    if (run_ms == NULL || first_ms == NULL || compile_ms == NULL || link_ms == NULL || issue_compile_ms == NULL ||
+        issue_link_ms == NULL) {
+        fprintf(stderr, "out of memory\n");
+        result = 1;
+    } else {
+        printf("%d variants (6 feature #defines x 1/2/4/8 lights), KHR_parallel_shader_compile: %s, %s\n", variants,
+               parallel ? "yes" : "no", glGetString(GL_RENDERER));
+        printf("%-8s %7s %5s %12s %12s %11s %11s %8s\n", "mode", "workers", "runs", "startup ms", "startup p99",
+               "first ms", "ms/program", "speedup");
+    }
+
+    for (int p = 0; p < point_count && result == 0; p++) {
+        const struct point *point = &points[p];
+        struct loader loader;
+        struct bench_stats run, first;
+        double spent_ms = 0.0;
+        int runs = 0;
+
+        if (point->mode == SHADER_CORPUS_PARALLEL && !parallel) {
+            printf("%-8s %7s skipped: no KHR_parallel_shader_compile\n", point->label, "-");
+            continue;
+        }
+        if (options->quick && point->workers > 2) {
+            continue;
+        }
+        if (point->mode == SHADER_CORPUS_WORKERS &&
+            loader_init(&loader, pixel_format, context, point->workers) != 0) {
+            fprintf(stderr, "could not start %d worker(s)\n", point->workers);
+            result = 1;
+            break;
+        }
+
+        // a few variants get the compiler's first-use costs out of the way
+        for (int w = 0; w < options->warmup && result == 0; w++) {
+            double unused;
+            if (run_corpus(WARM_VARIANTS, point->mode, &loader, &unused, NULL, NULL, NULL) < 0.0) {
+                result = 1;
+            }
+        }
+
+        while (result == 0 && runs < max_runs && (runs < MIN_RUNS || spent_ms < POINT_BUDGET_MS)) {
+            double *costs = point->mode == SHADER_CORPUS_SERIAL ? compile_ms
+                            : point->mode == SHADER_CORPUS_PARALLEL ? issue_compile_ms : NULL;
+            double *link_costs = point->mode == SHADER_CORPUS_SERIAL ? link_ms : issue_link_ms;
+            int *cost_count = point->mode == SHADER_CORPUS_SERIAL ? &serial_costs : &issue_costs;
+            double ms = run_corpus(variants, point->mode, &loader, &first_ms[runs], costs, link_costs, cost_count);
+
+            if (ms < 0.0) {
+                result = 1;
+                break;
+            }
+            run_ms[runs++] = ms;
+            spent_ms += ms;
+        }
+        if (point->mode == SHADER_CORPUS_WORKERS) {
+            loader_destroy(&loader);
+        }
+        if (result != 0) {
+            break;
+        }
+
+        bench_stats_compute(run_ms, runs, &run);
+        bench_stats_compute(first_ms, runs, &first);
+        if (point->mode == SHADER_CORPUS_SERIAL) {
+            serial_ms = run.median;
+        }
+        if (point->workers > 0) {
+            printf("%-8s %7d", point->label, point->workers);
+        } else {
+            printf("%-8s %7s", point->label, "-");
+        }
+        printf(" %5d %12.1f %12.1f %11.2f %11.3f %7.2fx\n", runs, run.median, run.p99, first.median,
+               run.median / variants, serial_ms / run.median);
+    }
+
+    if (result == 0) {
+        struct bench_stats compile, link, issue_compile, issue_link;
+
+        bench_stats_compute(compile_ms, serial_costs, &compile);
+        bench_stats_compute(link_ms, serial_costs, &link);
+        printf("per program, serial:         compile p50 %.3f p95 %.3f max %.3f ms, link p50 %.3f p95 %.3f max %.3f ms\n",
+               compile.median, compile.p95, compile.max, link.median, link.p95, link.max);
+        if (issue_costs > 0) {
+            bench_stats_compute(issue_compile_ms, issue_costs, &issue_compile);
+            bench_stats_compute(issue_link_ms, issue_costs, &issue_link);
+            printf("per program, parallel issue: compile p50 %.3f p95 %.3f max %.3f ms, link p50 %.3f p95 %.3f max %.3f ms\n",
+                   issue_compile.median, issue_compile.p95, issue_compile.max, issue_link.median, issue_link.p95,
+                   issue_link.max);
+        }
+    }
+
+    if (glGetError() != GL_NO_ERROR) {
+        fprintf(stderr, "GL error during the run\n");
+        result = 1;
+    }
+
+    free(run_ms);
+    free(first_ms);
+    free(compile_ms);
+    free(link_ms);
+    free(issue_compile_ms);
+    free(issue_link_ms);
+    glc_destroy_context(context);
+    glc_destroy_pixel_format(pixel_format);
+    return result;
+}
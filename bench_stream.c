@@ -0,0 +1,194 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "draw_pipeline.h"
+#include "stream_buffer.h"
+
+/*
+ * Per-frame vertex upload: every frame writes a payload of fresh vertex
+ * data and draws from it, so the upload has a real consumer. Compared:
+ *
+ *   orphan   glBufferData(payload) on one buffer every frame
+ *   subdata  glBufferSubData(payload) into one buffer of that size
+ *   ring     stream_buffer: unsynchronized map of the next ring range,
+ *            memcpy, one fence per frame
+ */
+
+enum upload_path { PATH_ORPHAN, PATH_SUBDATA, PATH_RING };
+
+static const char *path_names[] = { "orphan", "subdata", "ring" };
+
+#define MAX_RING_SIZE ((GLsizeiptr) 512 << 20)
+
+/* Uploads and draws one frame. Returns -1 if mapping failed. */
+static int upload_frame(enum upload_path path, struct stream_buffer *stream, GLuint buffer,
+                        const void *payload, GLsizeiptr bytes)
+{
+    GLintptr offset = 0;
+
+    switch (path) {
+    case PATH_ORPHAN:
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferData(GL_ARRAY_BUFFER, bytes, payload, GL_STREAM_DRAW);
+        break;
+    case PATH_SUBDATA:
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, payload);
+        break;
+    case PATH_RING: {
+        void *data = stream_buffer_map(stream, bytes, &offset);
+        if (data == NULL) {
+            return -1;
+        }
+        memcpy(data, payload, bytes);
+        stream_buffer_unmap(stream);
+        break;
+    }
+    }
+
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (const void *) offset);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    if (path == PATH_RING) {
+        stream_buffer_fence(stream);
+    }
+    return 0;
+}
+
+int bench_stream(const struct bench_options *options)
+{
+    static const GLsizeiptr full_sizes[] = { 4 << 10, 64 << 10, 1 << 20, 16 << 20, 256 << 20 };
+    static const GLsizeiptr quick_sizes[] = { 4 << 10, 64 << 10, 1 << 20 };
+
+    const GLsizeiptr *sizes = options->quick ? quick_sizes : full_sizes;
+    int size_count = options->quick ? 3 : 5;
+    int result = 0;
+
+    glc_context *context = bench_context_create();
+    if (context == NULL) {
+        fprintf(stderr, "could not create a context\n");
+        return 1;
+    }
+
+    struct draw_pipeline pipeline;
+    if (draw_pipeline_create(&pipeline, 64, 64, triangle, 3) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "could not create the pipeline\n");
+        bench_context_destroy(context);
+        return 1;
+    }
+    draw_pipeline_bind(&pipeline);
+
+    printf("one draw per frame from the uploaded data, %s\n", glGetString(GL_RENDERER));
+    printf("%-8s %9s %7s %14s %14s %10s %7s\n",
+           "path", "payload", "frames", "frame us p50", "frame us p99", "GB/s", "stalls");
+
+    for (int s = 0; s < size_count && result == 0; s++) {
+        GLsizeiptr bytes = sizes[s];
+        int frames = (int) ((64 << 20) / bytes);
+        frames = frames < 4 ? 4 : frames > 256 ? 256 : frames;
+
+        float *payload = malloc(bytes);
+        double *frame_us = calloc((size_t) frames * options->repeat, sizeof(*frame_us));
+        double *run_ms = calloc(options->repeat, sizeof(*run_ms));
+
+        if (payload == NULL || frame_us == NULL || run_ms == NULL) {
+            free(payload);
+            free(frame_us);
+            free(run_ms);
+            result = 1;
+            break;
+        }
+        for (GLsizeiptr i = 0; i < bytes / (GLsizeiptr) sizeof(float); i++) {
+            payload[i] = triangle[i % 6];
+        }
+
+        for (int p = PATH_ORPHAN; p <= PATH_RING && result == 0; p++) {
+            struct stream_buffer stream;
+            GLuint buffer = 0;
+
+            if (p == PATH_RING) {
+                GLsizeiptr ring_size = bytes * 3 < (4 << 20) ? (4 << 20) : bytes * 3;
+                if (ring_size > MAX_RING_SIZE) {
+                    ring_size = MAX_RING_SIZE;
+                }
+                if (stream_buffer_init(&stream, GL_ARRAY_BUFFER, ring_size) != 0) {
+                    fprintf(stderr, "could not create a %ld byte ring\n", (long) ring_size);
+                    result = 1;
+                    break;
+                }
+            } else {
+                glGenBuffers(1, &buffer);
+                glBindBuffer(GL_ARRAY_BUFFER, buffer);
+                glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+            }
+
+            uint64_t stalls = 0;
+
+            for (int r = -options->warmup; r < options->repeat && result == 0; r++) {
+                double *slot = frame_us + (size_t) (r < 0 ? 0 : r) * frames;
+                uint64_t waits_before = p == PATH_RING ? stream.waits : 0;
+
+                glFinish();
+                uint64_t start = bench_now_ns();
+                uint64_t frame_start = start;
+
+                for (int f = 0; f < frames; f++) {
+                    if (upload_frame(p, &stream, buffer, payload, bytes) != 0) {
+                        fprintf(stderr, "mapping failed\n");
+                        result = 1;
+                        break;
+                    }
+                    uint64_t now = bench_now_ns();
+                    slot[f] = (now - frame_start) / 1e3;
+                    frame_start = now;
+                }
+                glFinish();
+
+                if (r >= 0) {
+                    run_ms[r] = (bench_now_ns() - start) / 1e6;
+                    stalls += p == PATH_RING ? stream.waits - waits_before : 0;
+                }
+            }
+
+            if (p == PATH_RING) {
+                stream_buffer_destroy(&stream);
+            } else {
+                glDeleteBuffers(1, &buffer);
+            }
+            if (result != 0) {
+                break;
+            }
+
+            struct bench_stats frame, run;
+            bench_stats_compute(frame_us, frames * options->repeat, &frame);
+            bench_stats_compute(run_ms, options->repeat, &run);
+
+            char stall_column[16] = "-";
+            if (p == PATH_RING) {
+                snprintf(stall_column, sizeof(stall_column), "%llu", (unsigned long long) stalls);
+            }
+            printf("%-8s %8ldK %7d %14.1f %14.1f %10.2f %7s\n", path_names[p], (long) (bytes >> 10), frames,
+                   frame.median, frame.p99, (double) bytes * frames / (run.median / 1e3) / 1e9, stall_column);
+        }
+
+        free(payload);
+        free(frame_us);
+        free(run_ms);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, pipeline.vbo);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    if (glGetError() != GL_NO_ERROR) {
+        fprintf(stderr, "GL error during the run\n");
+        result = 1;
+    }
+
+    draw_pipeline_unbind();
+    draw_pipeline_destroy(&pipeline);
+    bench_context_destroy(context);
+    return result;
+}
@@ -0,0 +1,250 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "texture_upload.h"
+
+/*
+ * Texture streaming: one texture rewritten every frame from client memory,
+ * the way video frames are ingested, for every path of texture_upload.h,
+ * every format from R8 to RGBA16F and square sizes from 64 to 8192.
+ *
+ * "call ms" is how long the upload call keeps the calling thread; "usable
+ * ms" runs from the start of the call until a fence issued right behind
+ * the upload has signalled, i.e. until a draw could sample the frame.
+ * Fences are polled between uploads and waited for at the end of a run,
+ * as a streaming loop would. MB/s is client bytes over the wall time of a
+ * run of FRAMES frames. Each point runs options->repeat times or until
+ * POINT_BUDGET_MS, but at least MIN_RUNS, and then reads the texture back
+ * to check it holds the last frame. Points whose texture, client frame,
+ * check copy and ring would go over MEMORY_BUDGET_MB are skipped.
+ */
+
+#define FRAMES 8
+#define RING_SLOTS 2
+#define POINT_BUDGET_MS 2000.0
+#define MIN_RUNS 3
+#define MEMORY_BUDGET_MB 1536
+
+static void fill_frame(const struct texture_upload_format *format, unsigned char *pixels, size_t bytes)
+{
+    uint32_t state = 0x2545f491u;
+
+    for (size_t i = 0; i + 4 <= bytes; i += 4) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        memcpy(pixels + i, &state, 4);
+    }
+    if (format->type == GL_HALF_FLOAT) {
+        // keep every half finite, so no driver has a NaN to canonicalise
+        for (size_t i = 0; i + 2 <= bytes; i += 2) {
+            pixels[i + 1] &= 0xbb;
+        }
+    }
+}
+
+/* Changes the first row, so consecutive frames differ. */
+static void stamp_frame(unsigned char *pixels, int frame)
+{
+    pixels[0] = (unsigned char) frame;
+}
+
+/*
+ * Streams FRAMES frames into texture. Appends a call time and a usable
+ * time per frame and returns the wall time of the run in ms, or a
+ * negative value on error.
+ */
+static double run_frames(enum texture_upload_path path, struct texture_upload_ring *ring, GLuint texture,
+                         const struct texture_upload_format *format, GLsizei size, unsigned char *pixels,
+                         double *call_ms, double *usable_ms)
+{
+    uint64_t submitted_at[FRAMES];
+    GLsync fences[FRAMES];
+    int collected = 0, failed = 0;
+
+    glFinish();
+    uint64_t start = bench_now_ns();
+
+    for (int f = 0; f < FRAMES; f++) {
+        stamp_frame(pixels, f);
+        submitted_at[f] = bench_now_ns();
+        failed |= texture_upload(path, ring, texture, format, size, size, pixels) != 0;
+        call_ms[f] = (bench_now_ns() - submitted_at[f]) / 1e6;
+        fences[f] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+        while (collected <= f && glClientWaitSync(fences[collected], GL_SYNC_FLUSH_COMMANDS_BIT, 0) !=
+                                     GL_TIMEOUT_EXPIRED) {
+            usable_ms[collected] = (bench_now_ns() - submitted_at[collected]) / 1e6;
+            glDeleteSync(fences[collected++]);
+        }
+    }
+    for (; collected < FRAMES; collected++) {
+        while (glClientWaitSync(fences[collected], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000u) == GL_TIMEOUT_EXPIRED) {
+        }
+        usable_ms[collected] = (bench_now_ns() - submitted_at[collected]) / 1e6;
+        glDeleteSync(fences[collected]);
+    }
+
+    double elapsed_ms = (bench_now_ns() - start) / 1e6;
+    return failed ? -1.0 : elapsed_ms;
+}
+
+static int frame_arrived(GLuint texture, const struct texture_upload_format *format, const unsigned char *pixels,
+                         unsigned char *check, size_t bytes)
+{
+    GLint alignment;
+
+    glGetIntegerv(GL_PACK_ALIGNMENT, &alignment);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glGetTexImage(GL_TEXTURE_2D, 0, format->format, format->type, check);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, alignment);
+    return memcmp(check, pixels, bytes) == 0;
+}
+
+/* Returns 0 on success, -1 on a GL failure or a texture that did not get the frame. */
+static int run_point(enum texture_upload_path path, const struct texture_upload_format *format, GLsizei size,
+                     const struct bench_options *options, double *run_ms, double *call_ms, double *usable_ms)
+{
+    size_t bytes = (size_t) size * size * format->bytes_per_pixel;
+    // RGB is usually stored as RGBX
+    size_t texture_bytes = (size_t) size * size * (format->bytes_per_pixel == 3 ? 4 : format->bytes_per_pixel);
+    double mb = (texture_bytes + (2.0 + (path == TEXTURE_UPLOAD_PBO_RING ? RING_SLOTS : 0)) * bytes) /
+                (1024.0 * 1024.0);
+    struct texture_upload_ring ring;
+    struct bench_stats run, call, usable;
+    GLint max_size = 0;
+    GLuint texture;
+    int runs = 0, result = 0;
+
+    printf("%-8s %4dx%-4d %-11s", format->name, size, size, texture_upload_path_name(path));
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+    if (size > max_size) {
+        printf("   skipped: over GL_MAX_TEXTURE_SIZE\n");
+        return 0;
+    }
+    if (mb > MEMORY_BUDGET_MB) {
+        printf("   skipped: over the %d MB budget\n", MEMORY_BUDGET_MB);
+        return 0;
+    }
+
+    unsigned char *pixels = malloc(bytes);
+    unsigned char *check = malloc(bytes);
+    if (pixels == NULL || check == NULL) {
+        printf("   skipped: out of memory\n");
+        free(pixels);
+        free(check);
+        return 0;
+    }
+    fill_frame(format, pixels, bytes);
+
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    if (path != TEXTURE_UPLOAD_TEX_IMAGE) {
+        texture_upload_allocate(texture, format, size, size);
+    }
+    if (path == TEXTURE_UPLOAD_PBO_RING && texture_upload_ring_init(&ring, RING_SLOTS, bytes) != 0) {
+        printf("   could not create the PBO ring\n");
+        glDeleteTextures(1, &texture);
+        free(pixels);
+        free(check);
+        return -1;
+    }
+
+    double spent_ms = 0.0;
+    for (int r = -options->warmup; r < options->repeat; r++) {
+        int slot = r < 0 ? 0 : runs;
+        double ms = run_frames(path, &ring, texture, format, size, pixels, call_ms + slot * FRAMES,
+                               usable_ms + slot * FRAMES);
+
+        if (ms < 0.0) {
+            result = -1;
+            break;
+        }
+        if (r < 0) {
+            if (ms > POINT_BUDGET_MS / (MIN_RUNS + 1)) {
+                r = -1; // one warm-up is plenty for runs this slow
+            }
+            continue;
+        }
+        run_ms[runs++] = ms;
+        spent_ms += ms;
+        if (runs >= MIN_RUNS && spent_ms > POINT_BUDGET_MS) {
+            break;
+        }
+    }
+
+    if (result == 0 && !frame_arrived(texture, format, pixels, check, bytes)) {
+        printf("   the texture does not hold the last frame\n");
+        result = -1;
+    } else if (result == 0) {
+        bench_stats_compute(run_ms, runs, &run);
+        bench_stats_compute(call_ms, runs * FRAMES, &call);
+        bench_stats_compute(usable_ms, runs * FRAMES, &usable);
+        printf(" %5d %10.3f %10.3f %10.3f %10.1f", runs, call.median, usable.median, usable.p99,
+               FRAMES * bytes / (run.median * 1e3));
+        if (path == TEXTURE_UPLOAD_PBO_RING) {
+            printf(" %6llu", (unsigned long long) ring.waits);
+        }
+        printf("\n");
+    }
+
+    if (path == TEXTURE_UPLOAD_PBO_RING) {
+        texture_upload_ring_destroy(&ring);
+    }
+    glDeleteTextures(1, &texture);
+    free(pixels);
+    free(check);
+    if (glGetError() != GL_NO_ERROR) {
+        fprintf(stderr, "GL error during the run\n");
+        result = -1;
+    }
+    return result;
+}
+
+int bench_texture_upload(const struct bench_options *options)
+{
+    static const GLsizei sizes[] = { 64, 256, 1024, 4096, 8192 };
+    const int size_count = options->quick ? 3 : (int) (sizeof(sizes) / sizeof(sizes[0]));
+    int result = 0;
+
+    glc_context *context = bench_context_create();
+    if (context == NULL) {
+        fprintf(stderr, "could not create a context\n");
+        return 1;
+    }
+
+    double *run_ms = calloc(options->repeat, sizeof(double));
+    double *call_ms = calloc((size_t) options->repeat * FRAMES, sizeof(double));
+    double *usable_ms = calloc((size_t) options->repeat * FRAMES, sizeof(double));
+    if (run_ms == NULL || call_ms == NULL || usable_ms == NULL) {
+        fprintf(stderr, "out of memory\n");
+        result = 1;
+    }
+
+    printf("%d frames per run, %d-slot PBO ring, storage with %s, %s\n", FRAMES, RING_SLOTS,
+           texture_upload_has_storage() ? "glTexStorage2D" : "glTexImage2D", glGetString(GL_RENDERER));
+    printf("%-8s %9s %-11s %5s %10s %10s %10s %10s %6s\n", "format", "size", "path", "runs", "call ms",
+           "usable ms", "usable p99", "MB/s", "waits");
+
+    for (int f = 0; f < texture_upload_format_count && result == 0; f++) {
+        for (int s = 0; s < size_count && result == 0; s++) {
+            for (int p = 0; p < TEXTURE_UPLOAD_PATH_COUNT && result == 0; p++) {
+                if (run_point(p, &texture_upload_formats[f], sizes[s], options, run_ms, call_ms, usable_ms) != 0) {
+                    result = 1;
+                }
+            }
+        }
+    }
+
+    free(run_ms);
+    free(call_ms);
+    free(usable_ms);
+    bench_context_destroy(context);
+    return result;
+}
@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "draw_pipeline.h"
+#include "gl_trace.h" // last: it redefines the gl* calls it traces
+
+/*
+ * Cost of GL call tracing on the draw-call hot path: frames of 10000
+ * single-triangle glDrawArrays into a 16x16 target (so submission, not
+ * rasterising, dominates) through the traced wrappers, with
+ * recording off, sampling one call in GL_TRACE_SAMPLED_EVERY and timing every call,
+ * taking turns so drift hits all three equally.
+ */
+
+#define DRAWS 10000
+#define MODES 3
+
+static const char *const mode_names[MODES] = { "off", "sampled", "every" };
+static const int mode_every[MODES] = { 0, GL_TRACE_SAMPLED_EVERY, 1 };
+
+static void frame(const struct draw_pipeline *pipeline, double *submit_ms, double *total_ms)
+{
+    glFinish();
+    uint64_t start = bench_now_ns();
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    for (int i = 0; i < DRAWS; i++) {
+        glDrawArrays(GL_TRIANGLES, 0, pipeline->vertex_count);
+    }
+    *submit_ms = (bench_now_ns() - start) / 1e6;
+
+    glFinish();
+    *total_ms = (bench_now_ns() - start) / 1e6;
+}
+
+int bench_trace(const struct bench_options *options)
+{
+    const int was_enabled = gl_trace_enabled;
+    double *samples[MODES][2];  // [mode][submit/total]
+    struct bench_stats stats[MODES][2];
+    struct draw_pipeline pipeline;
+    int result = 0;
+
+    glc_context *context = bench_context_create();
+    if (context == NULL) {
+        fprintf(stderr, "could not create a context\n");
+        return 1;
+    }
+
+    for (int mode = 0; mode < MODES; mode++) {
+        samples[mode][0] = calloc(options->repeat, sizeof(double));
+        samples[mode][1] = calloc(options->repeat, sizeof(double));
+        result |= samples[mode][0] == NULL || samples[mode][1] == NULL;
+    }
+    if (result != 0 || draw_pipeline_create(&pipeline, 16, 16, triangle, 3) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "could not set up\n");
+        result = 1;
+        goto done;
+    }
+    draw_pipeline_bind(&pipeline);
+
+    for (int r = -options->warmup; r < options->repeat; r++) {
+        for (int mode = 0; mode < MODES; mode++) {
+            double submit, total;
+
+            gl_trace_set_enabled(mode_every[mode] != 0);
+            gl_trace_set_every(mode_every[mode]);
+            frame(&pipeline, &submit, &total);
+            if (r >= 0) {
+                samples[mode][0][r] = submit;
+                samples[mode][1][r] = total;
+            }
+        }
+    }
+    gl_trace_set_enabled(was_enabled);
+    gl_trace_set_every(1);
+
+    draw_pipeline_unbind();
+    draw_pipeline_destroy(&pipeline);
+
+    for (int mode = 0; mode < MODES; mode++) {
+        bench_stats_compute(samples[mode][0], options->repeat, &stats[mode][0]);
+        bench_stats_compute(samples[mode][1], options->repeat, &stats[mode][1]);
+    }
+
+    printf("%d glDrawArrays per frame, %s\n", DRAWS, glGetString(GL_RENDERER));
+    printf("%-8s %16s %16s %14s %14s\n", "tracing", "submit us/draw", "submit overhead", "frame ms p50", "frame overhead");
+    for (int mode = 0; mode < MODES; mode++) {
+        printf("%-8s %16.3f %15.1f%% %14.2f %13.1f%%\n", mode_names[mode],
+               stats[mode][0].median * 1e3 / DRAWS,
+               100.0 * (stats[mode][0].median / stats[0][0].median - 1.0),
+               stats[mode][1].median,
+               100.0 * (stats[mode][1].median / stats[0][1].median - 1.0));
+    }
+
+    if (glGetError() != GL_NO_ERROR) {
+        fprintf(stderr, "GL error during the run\n");
+        result = 1;
+    }
+
+done:
+    for (int mode = 0; mode < MODES; mode++) {
+        free(samples[mode][0]);
+        free(samples[mode][1]);
+    }
+    bench_context_destroy(context);
+    return result;
+}
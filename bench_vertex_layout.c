@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "draw_pipeline.h"
+#include "mesh.h"
+#include "render_target.h"
+#include "vertex_layout.h"
+
+/*
+ * Vertex layouts: one heightfield mesh of about 1M triangles (32K quick),
+ * packed in every layout of vertex_layout.h, uploaded and drawn with
+ * 32-bit indices into a 1024 x 1024 RGBA8 target. The vertex shader reads
+ * every attribute, so none of them can be skipped.
+ *
+ * Each layout is drawn with the triangles in vertex-cache-optimised order
+ * and shuffled. Shuffled indices hit the post-transform cache less and
+ * fetch vertices from all over the buffer, so the gap between the two
+ * shows how much a layout suffers when fetches stop being local. Fetch
+ * GB/s is vertex shader runs times bytes per vertex over the frame time.
+ * Where pipeline statistics queries are missing, each distinct vertex is
+ * counted once. Upload is glBufferData of the packed mesh, up to
+ * glFinish(). The error columns are the largest difference from the
+ * float data, in position (NDC) and normal units.
+ */
+
+#define WIDTH 1024
+#define HEIGHT 1024
+
+static const char *layout_vertex_shader =
+    "#version 410\n"
+    "layout(location = 0) in vec3 position;\n"
+    "layout(location = 1) in vec3 normal;\n"
+    "layout(location = 2) in vec2 uv;\n"
+    "layout(location = 3) in vec4 color;\n"
+    "out vec4 shade;\n"
+    "void main()\n"
+    "{\n"
+    "    float light = max(dot(normalize(normal), vec3(0.36, 0.48, 0.8)), 0.0);\n"
+    "    shade = vec4(color.rgb * (0.25 + 0.75 * light), color.a) * (0.75 + 0.25 * uv.x * uv.y);\n"
+    "    gl_Position = vec4(position.xy, position.z * 0.5, 1.0);\n"
+    "}\n";
+
+static const char *layout_fragment_shader =
+    "#version 410\n"
+    "in vec4 shade;\n"
+    "out vec4 color;\n"
+    "void main()\n"
+    "{\n"
+    "    color = shade;\n"
+    "}\n";
+
+enum index_order { ORDER_OPTIMIZED, ORDER_SHUFFLED, ORDER_COUNT };
+
+static const char *order_names[ORDER_COUNT] = { "optimized", "shuffled" };
+
+/* One index buffer per order, for the whole mesh. */
+static int upload_indices(const struct mesh *mesh, GLuint buffers[ORDER_COUNT])
+{
+    uint32_t *patch = malloc(mesh->patch_index_count * sizeof(uint32_t));
+    uint32_t *global = malloc(mesh->patch_index_count * sizeof(uint32_t));
+    GLsizeiptr patch_bytes = mesh->patch_index_count * sizeof(uint32_t);
+
+    if (patch == NULL || global == NULL) {
+        free(patch);
+        free(global);
+        return -1;
+    }
+
+    glGenBuffers(ORDER_COUNT, buffers);
+    for (int o = 0; o < ORDER_COUNT; o++) {
+        memcpy(patch, mesh->patch_indices, patch_bytes);
+        if (o == ORDER_SHUFFLED) {
+            mesh_shuffle_triangles(patch, mesh->patch_index_count, 0x2545f491u);
+        } else if (mesh_optimize_vertex_cache(patch, mesh->patch_index_count, mesh->patch_vertex_count) != 0) {
+            free(patch);
+            free(global);
+            return -1;
+        }
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[o]);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, patch_bytes * mesh->patch_count, NULL, GL_STATIC_DRAW);
+        for (int p = 0; p < mesh->patch_count; p++) {
+            for (uint32_t i = 0; i < mesh->patch_index_count; i++) {
+                global[i] = p * mesh->patch_vertex_count + patch[i];
+            }
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, patch_bytes * p, patch_bytes, global);
+        }
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    free(patch);
+    free(global);
+    return 0;
+}
+
+int bench_vertex_layout(const struct bench_options *options)
+{
+    const struct render_target_desc target_desc = { WIDTH, HEIGHT, GL_RGBA8, 0, 1, 1 };
+    struct render_target target = { 0 };
+    struct mesh mesh = { 0 };
+    struct vertex *vertices = NULL;
+    void *packed = NULL;
+    double *draw_ms = calloc(options->repeat, sizeof(double));
+    double *upload_ms = calloc(options->repeat, sizeof(double));
+    GLuint program = 0, index_buffers[ORDER_COUNT] = { 0 };
+    int result = 0;
+
+    glc_context *context = bench_context_create();
+    if (context == NULL) {
+        fprintf(stderr, "could not create a context\n");
+        free(draw_ms);
+        free(upload_ms);
+        return 1;
+    }
+
+    if (draw_ms == NULL || upload_ms == NULL || mesh_create_grid(&mesh, options->quick ? 32768 : 1 << 20) != 0) {
+        fprintf(stderr, "out of memory\n");
+        result = 1;
+        goto done;
+    }
+
+    uint32_t vertex_count = mesh.patch_count * mesh.patch_vertex_count;
+    GLsizei index_count = (GLsizei) (mesh.patch_count * mesh.patch_index_count);
+    vertices = malloc(vertex_count * sizeof(struct vertex));
+    packed = malloc(vertex_count * sizeof(struct vertex)); // no layout is bigger than the floats
+    program = draw_pipeline_compile_program(layout_vertex_shader, layout_fragment_shader);
+    if (vertices == NULL || packed == NULL || program == 0 || upload_indices(&mesh, index_buffers) != 0 ||
+        render_target_create(&target, &target_desc) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "could not set up\n");
+        result = 1;
+        goto done;
+    }
+    for (int p = 0; p < mesh.patch_count; p++) {
+        vertex_layout_fill_patch(&mesh, p, vertices + p * mesh.patch_vertex_count);
+    }
+
+    int statistics = bench_has_gl(4, 6, "GL_ARB_pipeline_statistics_query");
+    printf("%llu triangles, %u vertices, %dx%d RGBA8, %s\n", (unsigned long long) mesh_triangle_count(&mesh),
+           vertex_count, WIDTH, HEIGHT, glGetString(GL_RENDERER));
+    printf("%-11s %6s %8s %10s %9s %9s %-10s %10s %9s %7s %10s\n", "layout", "bytes", "MB", "upload ms", "pos err",
+           "norm err", "order", "frame ms", "Mtris/s", "VS/tri", "fetch GB/s");
+
+    render_target_bind(&target);
+    glUseProgram(program);
+
+    for (int l = 0; l < vertex_layout_count && result == 0; l++) {
+        const struct vertex_layout *layout = &vertex_layouts[l];
+        GLsizei stride = vertex_layout_stride(layout);
+        GLsizeiptr bytes = (GLsizeiptr) stride * vertex_count;
+        struct bench_stats upload;
+        GLuint vertex_buffer, vao;
+
+        vertex_layout_pack(layout, vertices, vertex_count, packed);
+        glGenBuffers(1, &vertex_buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+        for (int r = -options->warmup; r < options->repeat; r++) {
+            glFinish();
+            uint64_t start = bench_now_ns();
+            glBufferData(GL_ARRAY_BUFFER, bytes, packed, GL_STATIC_DRAW);
+            glFinish();
+            if (r >= 0) {
+                upload_ms[r] = (bench_now_ns() - start) / 1e6;
+            }
+        }
+        bench_stats_compute(upload_ms, options->repeat, &upload);
+
+        glGenVertexArrays(1, &vao);
+        glBindVertexArray(vao);
+        vertex_layout_set_pointers(layout, vertex_count);
+
+        for (int o = 0; o < ORDER_COUNT; o++) {
+            struct bench_stats frame;
+            GLuint64 invocations = vertex_count;
+
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffers[o]);
+            for (int r = -options->warmup; r < options->repeat; r++) {
+                glFinish();
+                uint64_t start = bench_now_ns();
+                glClear(GL_COLOR_BUFFER_BIT);
+                glDrawElements(GL_TRIANGLES, index_count, GL_UNSIGNED_INT, NULL);
+                glFinish();
+                if (r >= 0) {
+                    draw_ms[r] = (bench_now_ns() - start) / 1e6;
+                }
+            }
+            if (statistics) {
+                GLuint query;
+
+                glGenQueries(1, &query);
+                glBeginQuery(GL_VERTEX_SHADER_INVOCATIONS, query);
+                glDrawElements(GL_TRIANGLES, index_count, GL_UNSIGNED_INT, NULL);
+                glEndQuery(GL_VERTEX_SHADER_INVOCATIONS);
+                glGetQueryObjectui64v(query, GL_QUERY_RESULT, &invocations);
+                glDeleteQueries(1, &query);
+            }
+            bench_stats_compute(draw_ms, options->repeat, &frame);
+
+            if (o == 0) {
+                printf("%-11s %6d %8.1f %10.3f %9.2e %9.2e", layout->name, stride, bytes / (1024.0 * 1024.0),
+                       upload.median, vertex_layout_max_error(layout, VERTEX_POSITION, vertices, vertex_count),
+                       vertex_layout_max_error(layout, VERTEX_NORMAL, vertices, vertex_count));
+            } else {
+                printf("%-11s %6s %8s %10s %9s %9s", "", "", "", "", "", "");
+            }
+            printf(" %-10s %10.3f %9.2f", order_names[o], frame.median,
+                   mesh_triangle_count(&mesh) / (frame.median * 1e3));
+            if (statistics) {
+                printf(" %7.2f", (double) invocations / mesh_triangle_count(&mesh));
+            } else {
+                printf(" %7s", "-");
+            }
+            printf(" %10.2f\n", (double) invocations * stride / (frame.median * 1e6));
+        }
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glDeleteVertexArrays(1, &vao);
+        glDeleteBuffers(1, &vertex_buffer);
+
+        if (glGetError() != GL_NO_ERROR) {
+            fprintf(stderr, "GL error during the run\n");
+            result = 1;
+        }
+    }
+
+    glUseProgram(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+done:
+    render_target_destroy(&target);
+    glDeleteBuffers(ORDER_COUNT, index_buffers);
+    glDeleteProgram(program);
+    mesh_destroy(&mesh);
+    free(vertices);
+    free(packed);
+    free(draw_ms);
+    free(upload_ms);
+    bench_context_destroy(context);
+    return result;
+}
@@ -0,0 +1,190 @@
+#include "bind_cache.h"
+
+#include <string.h>
+
+#ifndef GL_TEXTURE_CUBE_MAP_ARRAY
+#define GL_TEXTURE_CUBE_MAP_ARRAY 0x9009
+#endif
+
+static const GLenum texture_targets[BIND_CACHE_TEXTURE_TARGETS] = {
+    GL_TEXTURE_2D, GL_TEXTURE_3D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_1D,
+    GL_TEXTURE_1D_ARRAY, GL_TEXTURE_RECTANGLE, GL_TEXTURE_BUFFER, GL_TEXTURE_2D_MULTISAMPLE,
+    GL_TEXTURE_2D_MULTISAMPLE_ARRAY, GL_TEXTURE_CUBE_MAP_ARRAY
+};
+
+/* GL_ELEMENT_ARRAY_BUFFER's slot, which follows the vertex array. */
+#define ELEMENT_ARRAY_BUFFER_SLOT 1
+
+static const GLenum buffer_targets[BIND_CACHE_BUFFER_TARGETS] = {
+    GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+    GL_PIXEL_PACK_BUFFER, GL_PIXEL_UNPACK_BUFFER, GL_TEXTURE_BUFFER, GL_TRANSFORM_FEEDBACK_BUFFER
+};
+
+static int target_index(const GLenum *targets, int count, GLenum target)
+{
+    for (int i = 0; i < count; i++) {
+        if (targets[i] == target) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Returns 1 if the bind has to reach GL, and records it as bound. */
+static int update(struct bind_cache *cache, GLuint *slot, GLuint name)
+{
+    cache->stats.calls++;
+    if (slot != NULL && *slot == name) {
+        cache->stats.elided++;
+        return 0;
+    }
+    if (slot != NULL) {
+        *slot = name;
+    }
+    return 1;
+}
+
+void bind_cache_init(struct bind_cache *cache)
+{
+    memset(&cache->stats, 0, sizeof(cache->stats));
+    bind_cache_invalidate(cache);
+}
+
+void bind_cache_invalidate(struct bind_cache *cache)
+{
+    struct bind_cache_stats stats = cache->stats;
+
+    // every GLuint in the struct but the stats is a binding
+    memset(cache, 0xff, sizeof(*cache));
+    cache->stats = stats;
+}
+
+void bind_cache_bind_framebuffer(struct bind_cache *cache, GLenum target, GLuint framebuffer)
+{
+    if (target == GL_FRAMEBUFFER) {
+        cache->stats.calls++;
+        if (cache->draw_framebuffer == framebuffer && cache->read_framebuffer == framebuffer) {
+            cache->stats.elided++;
+            return;
+        }
+        cache->draw_framebuffer = cache->read_framebuffer = framebuffer;
+        glBindFramebuffer(target, framebuffer);
+        return;
+    }
+
+    GLuint *slot = target == GL_DRAW_FRAMEBUFFER ? &cache->draw_framebuffer :
+                   target == GL_READ_FRAMEBUFFER ? &cache->read_framebuffer : NULL;
+    if (update(cache, slot, framebuffer)) {
+        glBindFramebuffer(target, framebuffer);
+    }
+}
+
+void bind_cache_bind_renderbuffer(struct bind_cache *cache, GLenum target, GLuint renderbuffer)
+{
+    if (update(cache, target == GL_RENDERBUFFER ? &cache->renderbuffer : NULL, renderbuffer)) {
+        glBindRenderbuffer(target, renderbuffer);
+    }
+}
+
+void bind_cache_active_texture(struct bind_cache *cache, GLenum texture)
+{
+    GLuint unit = texture - GL_TEXTURE0;
+
+    if (unit >= BIND_CACHE_TEXTURE_UNITS) {
+        update(cache, NULL, unit);
+        cache->active_texture = BIND_CACHE_UNKNOWN;
+        glActiveTexture(texture);
+    } else if (update(cache, &cache->active_texture, unit)) {
+        glActiveTexture(texture);
+    }
+}
+
+void bind_cache_bind_texture(struct bind_cache *cache, GLenum target, GLuint texture)
+{
+    int index = target_index(texture_targets, BIND_CACHE_TEXTURE_TARGETS, target);
+    GLuint unit = cache->active_texture;
+    GLuint *slot = index >= 0 && unit < BIND_CACHE_TEXTURE_UNITS ? &cache->textures[unit][index] : NULL;
+
+    if (update(cache, slot, texture)) {
+        glBindTexture(target, texture);
+    }
+}
+
+void bind_cache_bind_buffer(struct bind_cache *cache, GLenum target, GLuint buffer)
+{
+    int index = target_index(buffer_targets, BIND_CACHE_BUFFER_TARGETS, target);
+
+    if (update(cache, index >= 0 ? &cache->buffers[index] : NULL, buffer)) {
+        glBindBuffer(target, buffer);
+    }
+}
+
+void bind_cache_bind_vertex_array(struct bind_cache *cache, GLuint array)
+{
+    if (update(cache, &cache->vertex_array, array)) {
+        glBindVertexArray(array);
+        cache->buffers[ELEMENT_ARRAY_BUFFER_SLOT] = BIND_CACHE_UNKNOWN; // it is the new array's
+    }
+}
+
+void bind_cache_use_program(struct bind_cache *cache, GLuint program)
+{
+    if (update(cache, &cache->program, program)) {
+        glUseProgram(program);
+    }
+}
+
+static void forget(GLuint *slots, int count, GLsizei n, const GLuint *names)
+{
+    for (int i = 0; i < count; i++) {
+        for (GLsizei k = 0; k < n; k++) {
+            if (slots[i] == names[k] && names[k] != 0) {
+                slots[i] = 0;
+            }
+        }
+    }
+}
+
+void bind_cache_delete_framebuffers(struct bind_cache *cache, GLsizei n, const GLuint *framebuffers)
+{
+    glDeleteFramebuffers(n, framebuffers);
+    forget(&cache->draw_framebuffer, 1, n, framebuffers);
+    forget(&cache->read_framebuffer, 1, n, framebuffers);
+}
+
+void bind_cache_delete_renderbuffers(struct bind_cache *cache, GLsizei n, const GLuint *renderbuffers)
+{
+    glDeleteRenderbuffers(n, renderbuffers);
+    forget(&cache->renderbuffer, 1, n, renderbuffers);
+}
+
+void bind_cache_delete_textures(struct bind_cache *cache, GLsizei n, const GLuint *textures)
+{
+    glDeleteTextures(n, textures);
+    // GL unbinds a deleted texture from every unit, not just the active one
+    forget(&cache->textures[0][0], BIND_CACHE_TEXTURE_UNITS * BIND_CACHE_TEXTURE_TARGETS, n, textures);
+}
+
+void bind_cache_delete_buffers(struct bind_cache *cache, GLsizei n, const GLuint *buffers)
+{
+    glDeleteBuffers(n, buffers);
+    forget(cache->buffers, BIND_CACHE_BUFFER_TARGETS, n, buffers);
+}
+
+void bind_cache_delete_vertex_arrays(struct bind_cache *cache, GLsizei n, const GLuint *arrays)
+{
+    GLuint bound = cache->vertex_array;
+
+    glDeleteVertexArrays(n, arrays);
+    forget(&cache->vertex_array, 1, n, arrays);
+    if (cache->vertex_array != bound) {
+        cache->buffers[ELEMENT_ARRAY_BUFFER_SLOT] = BIND_CACHE_UNKNOWN;
+    }
+}
+
+void bind_cache_delete_program(struct bind_cache *cache, GLuint program)
+{
+    // a program in use stays in use after glDeleteProgram, so the binding stands
+    (void) cache;
+    glDeleteProgram(program);
+}
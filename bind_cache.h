@@ -0,0 +1,71 @@
+#ifndef BIND_CACHE_H
+#define BIND_CACHE_H
+
+#include <stdint.h>
+
+#include "glc.h"
+
+/*
+ * A shadow copy of a context's framebuffer, renderbuffer, texture, buffer,
+ * vertex array and program bindings that turns binding what is already
+ * bound into a no-op. One per context.
+ *
+ * The shadow only stays true if every bind on the context goes through
+ * it. Anything that binds behind its back (other code, glBindBufferBase,
+ * gl_state_restore(), a context switch) must be followed by
+ * bind_cache_invalidate(). Deleting a bound object unbinds it, so objects
+ * are deleted through the cache too. Every binding starts out unknown,
+ * which makes the first bind of each always reach GL.
+ *
+ * GL_ELEMENT_ARRAY_BUFFER belongs to the vertex array, so binding a
+ * vertex array forgets it.
+ */
+
+#define BIND_CACHE_UNKNOWN 0xffffffffu
+#define BIND_CACHE_TEXTURE_UNITS 16
+#define BIND_CACHE_TEXTURE_TARGETS 11
+#define BIND_CACHE_BUFFER_TARGETS 9
+
+struct bind_cache_stats {
+    uint64_t calls;     /* bind calls made through the cache */
+    uint64_t elided;    /* of those, the ones that never reached GL */
+};
+
+struct bind_cache {
+    GLuint draw_framebuffer;
+    GLuint read_framebuffer;
+    GLuint renderbuffer;
+    GLuint vertex_array;
+    GLuint program;
+    GLuint buffers[BIND_CACHE_BUFFER_TARGETS];
+    GLuint active_texture;  /* unit index, or BIND_CACHE_UNKNOWN */
+    GLuint textures[BIND_CACHE_TEXTURE_UNITS][BIND_CACHE_TEXTURE_TARGETS];
+    struct bind_cache_stats stats;
+};
+
+void bind_cache_init(struct bind_cache *cache);
+
+/* Marks every binding unknown; stats are kept. */
+void bind_cache_invalidate(struct bind_cache *cache);
+
+/*
+ * Same arguments as the GL calls. Targets and units the cache does not
+ * know are passed straight through and never elided.
+ */
+void bind_cache_bind_framebuffer(struct bind_cache *cache, GLenum target, GLuint framebuffer);
+void bind_cache_bind_renderbuffer(struct bind_cache *cache, GLenum target, GLuint renderbuffer);
+void bind_cache_active_texture(struct bind_cache *cache, GLenum texture);
+void bind_cache_bind_texture(struct bind_cache *cache, GLenum target, GLuint texture);
+void bind_cache_bind_buffer(struct bind_cache *cache, GLenum target, GLuint buffer);
+void bind_cache_bind_vertex_array(struct bind_cache *cache, GLuint array);
+void bind_cache_use_program(struct bind_cache *cache, GLuint program);
+
+/* Delete like GL does and reset the bindings GL resets. */
+void bind_cache_delete_framebuffers(struct bind_cache *cache, GLsizei n, const GLuint *framebuffers);
+void bind_cache_delete_renderbuffers(struct bind_cache *cache, GLsizei n, const GLuint *renderbuffers);
+void bind_cache_delete_textures(struct bind_cache *cache, GLsizei n, const GLuint *textures);
+void bind_cache_delete_buffers(struct bind_cache *cache, GLsizei n, const GLuint *buffers);
+void bind_cache_delete_vertex_arrays(struct bind_cache *cache, GLsizei n, const GLuint *arrays);
+void bind_cache_delete_program(struct bind_cache *cache, GLuint program);
+
+#endif
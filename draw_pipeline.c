@@ -0,0 +1,126 @@
+#include "draw_pipeline.h"
+
+#include <string.h>
+
+const char *vertex_shader =
+    "#version 410\n"
+    "layout (location = 0) in vec2 v;"
+    "void main() {"
+    "   gl_Position = vec4(v, 0.0, 1.0);"
+    "}";
+
+const char *fragment_shader =
+    "#version 410\n"
+    "layout (location = 0) out vec4 frag_color;"
+    "void main() {"
+    "   frag_color = vec4(1.0, 1.0, 1.0, 1.0);" // All white color
+    "}";
+
+const float triangle[6] = {
+    0.0f,  0.5f,
+    0.5f, -0.5f,
+   -0.5f, -0.5f
+};
+
+GLuint draw_pipeline_compile_program(const char *vs_source, const char *fs_source)
+{
+    GLint vs_is_compiled = 0;
+    GLint fs_is_compiled = 0;
+    GLint is_linked = 0;
+
+    GLuint vs = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vs, 1, &vs_source, NULL);
+    glCompileShader(vs);
+    glGetShaderiv(vs, GL_COMPILE_STATUS, &vs_is_compiled);
+
+    GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fs, 1, &fs_source, NULL);
+    glCompileShader(fs);
+    glGetShaderiv(fs, GL_COMPILE_STATUS, &fs_is_compiled);
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, fs);
+    glAttachShader(program, vs);
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE); // for program_cache
+    glLinkProgram(program);
+    glGetProgramiv(program, GL_LINK_STATUS, &is_linked);
+
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    if (!vs_is_compiled || !fs_is_compiled || !is_linked) {
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+GLenum draw_pipeline_create(struct draw_pipeline *pipeline, GLsizei width, GLsizei height,
+                            const float *vertices, GLsizei vertex_count)
+{
+    memset(pipeline, 0, sizeof(*pipeline));
+    pipeline->width = width;
+    pipeline->height = height;
+    pipeline->vertex_count = vertex_count;
+
+    glGenFramebuffers(1, &pipeline->framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, pipeline->framebuffer);
+
+    glGenRenderbuffers(1, &pipeline->color_renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, pipeline->color_renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, pipeline->color_renderbuffer);
+
+    glGenRenderbuffers(1, &pipeline->depth_renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, pipeline->depth_renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, pipeline->depth_renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    GLenum draw_buffers = GL_COLOR_ATTACHMENT0;
+    glDrawBuffers(1, &draw_buffers);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glGenBuffers(1, &pipeline->vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, pipeline->vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertex_count * 2 * sizeof(float), vertices, GL_STATIC_DRAW);
+
+    glGenVertexArrays(1, &pipeline->vao);
+    glBindVertexArray(pipeline->vao);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    pipeline->program = draw_pipeline_compile_program(vertex_shader, fragment_shader);
+
+    return status;
+}
+
+void draw_pipeline_bind(const struct draw_pipeline *pipeline)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, pipeline->framebuffer);
+    glViewport(0, 0, pipeline->width, pipeline->height);
+    glBindVertexArray(pipeline->vao);
+    glUseProgram(pipeline->program);
+}
+
+void draw_pipeline_unbind(void)
+{
+    glUseProgram(0);
+    glBindVertexArray(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void draw_pipeline_destroy(struct draw_pipeline *pipeline)
+{
+    glDeleteProgram(pipeline->program);
+    glDeleteVertexArrays(1, &pipeline->vao);
+    glDeleteBuffers(1, &pipeline->vbo);
+    glDeleteRenderbuffers(1, &pipeline->color_renderbuffer);
+    glDeleteRenderbuffers(1, &pipeline->depth_renderbuffer);
+    glDeleteFramebuffers(1, &pipeline->framebuffer);
+    memset(pipeline, 0, sizeof(*pipeline));
+}
@@ -0,0 +1,46 @@
+#ifndef DRAW_PIPELINE_H
+#define DRAW_PIPELINE_H
+
+#include "glc.h"
+
+/*
+ * The pipeline of we_can_use_a_shader_program_and_issue_a_draw_call
+ * (FBO with RGBA8 color and DEPTH_COMPONENT16 depth renderbuffers, a VBO
+ * of vec2 positions behind a VAO and the all-white program) packaged so
+ * benchmarks can build the exact same thing.
+ */
+
+extern const char *vertex_shader;
+extern const char *fragment_shader;
+extern const float triangle[6];
+
+struct draw_pipeline {
+    GLsizei width;
+    GLsizei height;
+    GLuint framebuffer;
+    GLuint color_renderbuffer;
+    GLuint depth_renderbuffer;
+    GLuint vbo;
+    GLuint vao;
+    GLuint program;
+    GLsizei vertex_count;
+};
+
+/* Compiles and links a vertex/fragment pair; returns 0 if either step fails. */
+GLuint draw_pipeline_compile_program(const char *vs_source, const char *fs_source);
+
+/*
+ * vertices holds vertex_count vec2 positions; pass triangle and 3 for the
+ * suite's triangle. Returns glCheckFramebufferStatus() of the new FBO.
+ * Leaves every binding at 0.
+ */
+GLenum draw_pipeline_create(struct draw_pipeline *pipeline, GLsizei width, GLsizei height,
+                            const float *vertices, GLsizei vertex_count);
+
+/* Binds the FBO, VAO and program and sets the viewport to the FBO size. */
+void draw_pipeline_bind(const struct draw_pipeline *pipeline);
+void draw_pipeline_unbind(void);
+
+void draw_pipeline_destroy(struct draw_pipeline *pipeline);
+
+#endif
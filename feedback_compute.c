@@ -0,0 +1,394 @@
+#include "feedback_compute.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+enum uniform { UNIFORM_A, UNIFORM_DT, UNIFORM_GRAVITY, UNIFORM_DAMPING, UNIFORM_RESTITUTION };
+
+static const char *uniform_names[] = { "a", "dt", "gravity", "damping", "restitution" };
+
+// precise keeps the compiler from fusing into FMAs the CPU versions do not use
+static const char *saxpy_shader =
+    "#version 410\n"
+    "layout(location = 0) in vec4 x;\n"
+    "layout(location = 1) in vec4 y;\n"
+    "uniform float a;\n"
+    "precise out vec4 out_y;\n"
+    "void main()\n"
+    "{\n"
+    "    out_y = a * x + y;\n"
+    "}\n";
+
+static const char *particles_shader =
+    "#version 410\n"
+    "layout(location = 0) in vec4 position;\n"
+    "layout(location = 1) in vec4 velocity;\n"
+    "uniform float dt;\n"
+    "uniform float gravity;\n"
+    "uniform float damping;\n"
+    "uniform float restitution;\n"
+    "precise out vec4 out_position;\n"
+    "precise out vec4 out_velocity;\n"
+    "void main()\n"
+    "{\n"
+    "    precise vec4 v = velocity * damping + vec4(0.0, -gravity, 0.0, 0.0) * dt;\n"
+    "    precise vec4 p = position + v * dt;\n"
+    "    if (p.y < 0.0) {\n"
+    "        p.y = -p.y;\n"
+    "        v.y = -v.y * restitution;\n"
+    "    }\n"
+    "    out_position = p;\n"
+    "    out_velocity = v;\n"
+    "}\n";
+
+static const char *saxpy_varyings[] = { "out_y" };
+static const char *particles_varyings[] = { "out_position", "out_velocity" };
+
+const char *feedback_kernel_name(enum feedback_kernel kernel)
+{
+    switch (kernel) {
+    case FEEDBACK_SAXPY:     return "saxpy";
+    case FEEDBACK_PARTICLES: return "particles";
+    default:                 return "unknown";
+    }
+}
+
+GLsizeiptr feedback_element_bytes(enum feedback_kernel kernel)
+{
+    return kernel == FEEDBACK_SAXPY ? sizeof(float) : sizeof(struct particle);
+}
+
+int feedback_compute_init(struct feedback_compute *compute, enum feedback_kernel kernel)
+{
+    const char *source = kernel == FEEDBACK_SAXPY ? saxpy_shader : particles_shader;
+    GLint is_compiled = 0, is_linked = 0;
+
+    memset(compute, 0, sizeof(*compute));
+    compute->kernel = kernel;
+
+    GLuint vs = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vs, 1, &source, NULL);
+    glCompileShader(vs);
+    glGetShaderiv(vs, GL_COMPILE_STATUS, &is_compiled);
+
+    compute->program = glCreateProgram();
+    glAttachShader(compute->program, vs);
+    // the varyings to capture have to be named before linking
+    if (kernel == FEEDBACK_SAXPY) {
+        glTransformFeedbackVaryings(compute->program, 1, saxpy_varyings, GL_INTERLEAVED_ATTRIBS);
+    } else {
+        glTransformFeedbackVaryings(compute->program, 2, particles_varyings, GL_INTERLEAVED_ATTRIBS);
+    }
+    glLinkProgram(compute->program);
+    glGetProgramiv(compute->program, GL_LINK_STATUS, &is_linked);
+    glDeleteShader(vs);
+
+    if (!is_compiled || !is_linked) {
+        glDeleteProgram(compute->program);
+        compute->program = 0;
+        return -1;
+    }
+
+    for (int u = 0; u < (int) (sizeof(uniform_names) / sizeof(uniform_names[0])); u++) {
+        compute->uniforms[u] = glGetUniformLocation(compute->program, uniform_names[u]);
+    }
+    glGenVertexArrays(1, &compute->vao);
+    glGenTransformFeedbacks(1, &compute->transform_feedback);
+
+    // nothing is drawn, but a draw still needs a complete framebuffer and a
+    // surfaceless context has no default one
+    glGenRenderbuffers(1, &compute->renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, compute->renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, 1, 1);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glGenFramebuffers(1, &compute->framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, compute->framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, compute->renderbuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return 0;
+}
+
+void feedback_compute_destroy(struct feedback_compute *compute)
+{
+    glDeleteFramebuffers(1, &compute->framebuffer);
+    glDeleteRenderbuffers(1, &compute->renderbuffer);
+    glDeleteTransformFeedbacks(1, &compute->transform_feedback);
+    glDeleteVertexArrays(1, &compute->vao);
+    glDeleteProgram(compute->program);
+    memset(compute, 0, sizeof(*compute));
+}
+
+int feedback_compute_run(struct feedback_compute *compute, const GLuint *inputs, GLuint output, uint32_t count,
+                         const struct feedback_params *params)
+{
+    GLsizei points;
+
+    if (compute->kernel == FEEDBACK_SAXPY) {
+        if (count % 4 != 0) {
+            return -1;
+        }
+        points = (GLsizei) (count / 4);
+    } else {
+        points = (GLsizei) count;
+    }
+
+    glUseProgram(compute->program);
+    glUniform1f(compute->uniforms[UNIFORM_A], params->a);
+    glUniform1f(compute->uniforms[UNIFORM_DT], params->dt);
+    glUniform1f(compute->uniforms[UNIFORM_GRAVITY], params->gravity);
+    glUniform1f(compute->uniforms[UNIFORM_DAMPING], params->damping);
+    glUniform1f(compute->uniforms[UNIFORM_RESTITUTION], params->restitution);
+
+    glBindVertexArray(compute->vao);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    if (compute->kernel == FEEDBACK_SAXPY) {
+        glBindBuffer(GL_ARRAY_BUFFER, inputs[0]);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, NULL);
+        glBindBuffer(GL_ARRAY_BUFFER, inputs[1]);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 0, NULL);
+    } else {
+        glBindBuffer(GL_ARRAY_BUFFER, inputs[0]);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(struct particle), NULL);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(struct particle),
+                              (const void *) offsetof(struct particle, velocity));
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, compute->framebuffer);
+    glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, compute->transform_feedback);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, output);
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, points);
+    glEndTransformFeedback();
+    glDisable(GL_RASTERIZER_DISCARD);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+    glBindVertexArray(0);
+    glUseProgram(0);
+    return 0;
+}
+
+static void saxpy_scalar(const float *x, const float *y, float *out, uint32_t begin, uint32_t count, float a)
+{
+    for (uint32_t i = begin; i < count; i++) {
+        out[i] = a * x[i] + y[i];
+    }
+}
+
+static void particles_scalar(const struct particle *in, struct particle *out, uint32_t begin, uint32_t count,
+                             const struct feedback_params *params)
+{
+    const float gravity[4] = { 0.0f, -params->gravity, 0.0f, 0.0f };
+
+    for (uint32_t i = begin; i < count; i++) {
+        struct particle p = in[i];
+
+        for (int c = 0; c < 4; c++) {
+            p.velocity[c] = p.velocity[c] * params->damping + gravity[c] * params->dt;
+            p.position[c] = p.position[c] + p.velocity[c] * params->dt;
+        }
+        if (p.position[1] < 0.0f) {
+            p.position[1] = -p.position[1];
+            p.velocity[1] = -p.velocity[1] * params->restitution;
+        }
+        out[i] = p;
+    }
+}
+
+#ifdef HAVE_X86_KERNELS
+
+__attribute__((target("sse2")))
+static void saxpy_sse2(const float *x, const float *y, float *out, uint32_t count, float a)
+{
+    const __m128 va = _mm_set1_ps(a);
+    uint32_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 vx = _mm_loadu_ps(x + i);
+        __m128 vy = _mm_loadu_ps(y + i);
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_mul_ps(va, vx), vy));
+    }
+    saxpy_scalar(x, y, out, i, count, a);
+}
+
+/* One particle per step: position and velocity are a register each. */
+__attribute__((target("sse2")))
+static void particles_sse2(const struct particle *in, struct particle *out, uint32_t count,
+                           const struct feedback_params *params)
+{
+    const __m128 damping = _mm_set1_ps(params->damping);
+    const __m128 dt = _mm_set1_ps(params->dt);
+    const __m128 gravity_dt = _mm_mul_ps(_mm_set_ps(0.0f, 0.0f, -params->gravity, 0.0f), dt);
+    const __m128 restitution = _mm_set1_ps(params->restitution);
+    const __m128 y_lane = _mm_castsi128_ps(_mm_set_epi32(0, 0, -1, 0));
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 zero = _mm_setzero_ps();
+
+    for (uint32_t i = 0; i < count; i++) {
+        __m128 p = _mm_loadu_ps(in[i].position);
+        __m128 v = _mm_loadu_ps(in[i].velocity);
+
+        v = _mm_add_ps(_mm_mul_ps(v, damping), gravity_dt);
+        p = _mm_add_ps(p, _mm_mul_ps(v, dt));
+
+        __m128 below = _mm_and_ps(_mm_cmplt_ps(p, zero), y_lane);
+        __m128 bounced = _mm_mul_ps(_mm_xor_ps(v, sign), restitution);
+        p = _mm_xor_ps(p, _mm_and_ps(below, sign));
+        v = _mm_or_ps(_mm_andnot_ps(below, v), _mm_and_ps(below, bounced));
+
+        _mm_storeu_ps(out[i].position, p);
+        _mm_storeu_ps(out[i].velocity, v);
+    }
+}
+
+__attribute__((target("avx2")))
+static void saxpy_avx2(const float *x, const float *y, float *out, uint32_t count, float a)
+{
+    const __m256 va = _mm256_set1_ps(a);
+    uint32_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256 vx = _mm256_loadu_ps(x + i);
+        __m256 vy = _mm256_loadu_ps(y + i);
+        _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_mul_ps(va, vx), vy));
+    }
+    saxpy_scalar(x, y, out, i, count, a);
+}
+
+/* Two particles per step: the positions of both in one register, the velocities in another. */
+__attribute__((target("avx2")))
+static void particles_avx2(const struct particle *in, struct particle *out, uint32_t count,
+                           const struct feedback_params *params)
+{
+    const __m256 damping = _mm256_set1_ps(params->damping);
+    const __m256 dt = _mm256_set1_ps(params->dt);
+    const __m256 gravity_dt = _mm256_mul_ps(
+        _mm256_set_ps(0.0f, 0.0f, -params->gravity, 0.0f, 0.0f, 0.0f, -params->gravity, 0.0f), dt);
+    const __m256 restitution = _mm256_set1_ps(params->restitution);
+    const __m256 y_lane = _mm256_castsi256_ps(_mm256_set_epi32(0, 0, -1, 0, 0, 0, -1, 0));
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256 zero = _mm256_setzero_ps();
+    uint32_t i = 0;
+
+    for (; i + 2 <= count; i += 2) {
+        __m256 first = _mm256_loadu_ps(in[i].position);       // position, velocity of i
+        __m256 second = _mm256_loadu_ps(in[i + 1].position);
+        __m256 p = _mm256_permute2f128_ps(first, second, 0x20);
+        __m256 v = _mm256_permute2f128_ps(first, second, 0x31);
+
+        v = _mm256_add_ps(_mm256_mul_ps(v, damping), gravity_dt);
+        p = _mm256_add_ps(p, _mm256_mul_ps(v, dt));
+
+        __m256 below = _mm256_and_ps(_mm256_cmp_ps(p, zero, _CMP_LT_OQ), y_lane);
+        __m256 bounced = _mm256_mul_ps(_mm256_xor_ps(v, sign), restitution);
+        p = _mm256_xor_ps(p, _mm256_and_ps(below, sign));
+        v = _mm256_or_ps(_mm256_andnot_ps(below, v), _mm256_and_ps(below, bounced));
+
+        _mm256_storeu_ps(out[i].position, _mm256_permute2f128_ps(p, v, 0x20));
+        _mm256_storeu_ps(out[i + 1].position, _mm256_permute2f128_ps(p, v, 0x31));
+    }
+    particles_scalar(in, out, i, count, params);
+}
+
+#endif
+
+int feedback_cpu_isa_supported(enum feedback_cpu_isa isa)
+{
+    switch (isa) {
+    case FEEDBACK_CPU_AUTO:
+    case FEEDBACK_CPU_SCALAR:
+        return 1;
+#ifdef HAVE_X86_KERNELS
+    case FEEDBACK_CPU_SSE2:
+        return __builtin_cpu_supports("sse2");
+    case FEEDBACK_CPU_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return 0;
+    }
+}
+
+const char *feedback_cpu_isa_name(enum feedback_cpu_isa isa)
+{
+    switch (isa) {
+    case FEEDBACK_CPU_AUTO:   return "auto";
+    case FEEDBACK_CPU_SCALAR: return "scalar";
+    case FEEDBACK_CPU_SSE2:   return "sse2";
+    case FEEDBACK_CPU_AVX2:   return "avx2";
+    default:                  return "unknown";
+    }
+}
+
+static enum feedback_cpu_isa best_isa(void)
+{
+    if (feedback_cpu_isa_supported(FEEDBACK_CPU_AVX2)) {
+        return FEEDBACK_CPU_AVX2;
+    }
+    if (feedback_cpu_isa_supported(FEEDBACK_CPU_SSE2)) {
+        return FEEDBACK_CPU_SSE2;
+    }
+    return FEEDBACK_CPU_SCALAR;
+}
+
+int feedback_cpu_run_with(enum feedback_cpu_isa isa, enum feedback_kernel kernel, const void *const *inputs,
+                          void *output, uint32_t count, const struct feedback_params *params)
+{
+    if (isa == FEEDBACK_CPU_AUTO) {
+        isa = best_isa();
+    }
+    if (!feedback_cpu_isa_supported(isa)) {
+        return -1;
+    }
+
+    if (kernel == FEEDBACK_SAXPY) {
+        const float *x = inputs[0], *y = inputs[1];
+
+        switch (isa) {
+#ifdef HAVE_X86_KERNELS
+        case FEEDBACK_CPU_SSE2: saxpy_sse2(x, y, output, count, params->a); break;
+        case FEEDBACK_CPU_AVX2: saxpy_avx2(x, y, output, count, params->a); break;
+#endif
+        default:                saxpy_scalar(x, y, output, 0, count, params->a); break;
+        }
+    } else {
+        const struct particle *in = inputs[0];
+
+        switch (isa) {
+#ifdef HAVE_X86_KERNELS
+        case FEEDBACK_CPU_SSE2: particles_sse2(in, output, count, params); break;
+        case FEEDBACK_CPU_AVX2: particles_avx2(in, output, count, params); break;
+#endif
+        default:                particles_scalar(in, output, 0, count, params); break;
+        }
+    }
+    return 0;
+}
+
+float feedback_max_error(enum feedback_kernel kernel, const void *actual, const void *expected, uint32_t count)
+{
+    const float *a = actual, *e = expected;
+    size_t floats = (size_t) count * feedback_element_bytes(kernel) / sizeof(float);
+    float error = 0.0f;
+
+    for (size_t i = 0; i < floats; i++) {
+        float scale = fabsf(e[i]) > 1.0f ? fabsf(e[i]) : 1.0f;
+        float difference = fabsf(a[i] - e[i]) / scale;
+
+        // NaN compares false, so it has to be caught on its own
+        if (difference > error || difference != difference) {
+            error = difference != difference ? INFINITY : difference;
+        }
+    }
+    return error;
+}
@@ -0,0 +1,91 @@
+#ifndef FEEDBACK_COMPUTE_H
+#define FEEDBACK_COMPUTE_H
+
+#include <stdint.h>
+
+#include "glc.h"
+
+/*
+ * Per-element math on the GPU without compute shaders (macOS stops at
+ * 4.1): a vertex shader is the kernel, one point per work item, with
+ * rasterisation discarded and the results captured by transform
+ * feedback. Two kernels:
+ *
+ *   SAXPY      y' = a * x + y over floats, four per point, so counts are
+ *              multiples of 4
+ *   PARTICLES  one step of damped, gravity-driven motion with a bounce
+ *              off the y = 0 floor, over struct particle
+ *
+ * Every kernel also has a CPU version, in plain C, SSE2 and AVX2 (picked
+ * at run time like image_compare), to check the GPU against and to
+ * compare its speed with. The CPU versions are bit-identical to each other;
+ * the GPU is only expected to come within FEEDBACK_COMPUTE_TOLERANCE.
+ */
+
+#define FEEDBACK_COMPUTE_TOLERANCE 1e-5f     /* relative, or absolute below 1 */
+
+enum feedback_kernel {
+    FEEDBACK_SAXPY,
+    FEEDBACK_PARTICLES,
+    FEEDBACK_KERNEL_COUNT
+};
+
+enum feedback_cpu_isa {
+    FEEDBACK_CPU_AUTO = 0,
+    FEEDBACK_CPU_SCALAR,
+    FEEDBACK_CPU_SSE2,
+    FEEDBACK_CPU_AVX2
+};
+
+struct particle {
+    float position[4];      /* w is carried through */
+    float velocity[4];      /* w is 0 */
+};
+
+struct feedback_params {
+    float a;                /* SAXPY */
+    float dt;               /* PARTICLES */
+    float gravity;
+    float damping;
+    float restitution;
+};
+
+struct feedback_compute {
+    enum feedback_kernel kernel;
+    GLuint program;
+    GLuint vao;
+    GLuint transform_feedback;
+    GLuint framebuffer;     /* 1x1, so a draw never depends on the default one */
+    GLuint renderbuffer;
+    GLint uniforms[5];
+};
+
+const char *feedback_kernel_name(enum feedback_kernel kernel);
+
+/* Bytes one element takes in the kernel's input and output streams. */
+GLsizeiptr feedback_element_bytes(enum feedback_kernel kernel);
+
+/* Returns 0 on success, -1 if the kernel does not compile or link. */
+int feedback_compute_init(struct feedback_compute *compute, enum feedback_kernel kernel);
+void feedback_compute_destroy(struct feedback_compute *compute);
+
+/*
+ * Runs the kernel over count elements. SAXPY reads x from inputs[0] and
+ * y from inputs[1]; PARTICLES reads inputs[0]. Output may be an input of
+ * a previous run but not of this one. Returns -1 if count does not fit
+ * the kernel. Leaves every binding at 0.
+ */
+int feedback_compute_run(struct feedback_compute *compute, const GLuint *inputs, GLuint output, uint32_t count,
+                         const struct feedback_params *params);
+
+int feedback_cpu_isa_supported(enum feedback_cpu_isa isa);
+const char *feedback_cpu_isa_name(enum feedback_cpu_isa isa);
+
+/* The CPU version of run, on the same data in memory. -1 if the CPU cannot run isa. */
+int feedback_cpu_run_with(enum feedback_cpu_isa isa, enum feedback_kernel kernel, const void *const *inputs,
+                          void *output, uint32_t count, const struct feedback_params *params);
+
+/* Largest difference between two outputs, relative where the values are over 1. */
+float feedback_max_error(enum feedback_kernel kernel, const void *actual, const void *expected, uint32_t count);
+
+#endif
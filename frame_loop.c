@@ -0,0 +1,127 @@
+#include "frame_loop.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+static int frame_shade(uint64_t frame)
+{
+    return (int) ((frame * 37) % 256);
+}
+
+int frame_loop_init(struct frame_loop *loop, const struct frame_loop_config *config)
+{
+    struct render_target_desc desc = { config->width, config->height, GL_RGBA8, GL_DEPTH_COMPONENT16, 0, 1 };
+    int created = 0;
+
+    memset(loop, 0, sizeof(*loop));
+    if (config->buffers < 1 || config->buffers > FRAME_LOOP_MAX_BUFFERS || config->frames < 1 ||
+        config->draws < 0) {
+        return -1;
+    }
+    loop->config = *config;
+
+    loop->pixels = malloc((size_t) config->width * config->height * 4);
+    if (loop->pixels == NULL) {
+        return -1;
+    }
+    if (draw_pipeline_create(&loop->pipeline, config->width, config->height, triangle, 3) !=
+        GL_FRAMEBUFFER_COMPLETE) {
+        draw_pipeline_destroy(&loop->pipeline);
+        free(loop->pixels);
+        return -1;
+    }
+    for (; created < config->buffers; created++) {
+        if (render_target_create(&loop->targets[created], &desc) != GL_FRAMEBUFFER_COMPLETE) {
+            render_target_destroy(&loop->targets[created]);
+            break;
+        }
+    }
+    if (created < config->buffers ||
+        readback_ring_init(&loop->ring, config->buffers, config->width, config->height, GL_RGBA,
+                           GL_UNSIGNED_BYTE) != 0) {
+        loop->config.buffers = created;
+        frame_loop_destroy(loop);
+        return -1;
+    }
+    return 0;
+}
+
+void frame_loop_destroy(struct frame_loop *loop)
+{
+    readback_ring_destroy(&loop->ring);
+    for (int i = 0; i < loop->config.buffers; i++) {
+        render_target_destroy(&loop->targets[i]);
+    }
+    draw_pipeline_destroy(&loop->pipeline);
+    free(loop->pixels);
+    memset(loop, 0, sizeof(*loop));
+}
+
+/* Collects the oldest readback; returns -1 if it failed, else whether its pixels were wrong. */
+static int collect(struct frame_loop *loop, const uint64_t *started, double *latency_ms)
+{
+    uint64_t tag;
+
+    if (readback_ring_collect(&loop->ring, loop->pixels, UINT64_MAX, &tag) != 1) {
+        return -1;
+    }
+    latency_ms[tag] = (now_ns() - started[tag]) / 1e6;
+    // the triangle stays clear of the corner
+    return loop->pixels[0] != frame_shade(tag) || loop->pixels[1] != 0 || loop->pixels[3] != 0xFF;
+}
+
+int frame_loop_run(struct frame_loop *loop, double *frame_ms, double *latency_ms, struct frame_loop_result *result)
+{
+    const struct frame_loop_config *config = &loop->config;
+    uint64_t *started = malloc(config->frames * sizeof(*started));
+    int wrong, failed = 0;
+
+    memset(result, 0, sizeof(*result));
+    if (started == NULL) {
+        return -1;
+    }
+
+    draw_pipeline_bind(&loop->pipeline);
+    glFinish();
+    uint64_t start = now_ns();
+
+    for (int f = 0; f < config->frames && !failed; f++) {
+        started[f] = now_ns();
+
+        // the buffer about to be drawn into is the one the oldest readback is from
+        if (loop->ring.pending == config->buffers) {
+            wrong = collect(loop, started, latency_ms);
+            failed = wrong < 0;
+            result->wrong_frames += wrong > 0;
+        }
+
+        render_target_bind(&loop->targets[f % config->buffers]);
+        glClearColor(frame_shade(f) / 255.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        for (int d = 0; d < config->draws; d++) {
+            glDrawArrays(GL_TRIANGLES, 0, loop->pipeline.vertex_count);
+        }
+        failed |= readback_ring_issue(&loop->ring, 0, 0, config->width, config->height, f) != 0;
+
+        frame_ms[f] = (now_ns() - started[f]) / 1e6;
+    }
+    while (!failed && loop->ring.pending > 0) {
+        wrong = collect(loop, started, latency_ms);
+        failed = wrong < 0;
+        result->wrong_frames += wrong > 0;
+    }
+    result->elapsed_ms = (now_ns() - start) / 1e6;
+
+    draw_pipeline_unbind();
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    free(started);
+    return failed ? -1 : 0;
+}
@@ -0,0 +1,61 @@
+#ifndef FRAME_LOOP_H
+#define FRAME_LOOP_H
+
+#include "draw_pipeline.h"
+#include "readback.h"
+#include "render_target.h"
+
+/*
+ * A sustained offscreen render loop on the draw test's pipeline, for what
+ * one-frame tests cannot show: pipelining, the driver's queue depth, and
+ * drift over thousands of frames.
+ *
+ * Frame f clears buffer f % buffers (an RGBA8 + DEPTH_COMPONENT16 target
+ * like the draw test's FBO) to a color of its own, draws the suite's
+ * triangle draws times, and queues a readback of the whole frame into a
+ * PBO ring with one slot per buffer. Before a buffer is drawn into again,
+ * the readback of the frame that last used it is collected, so with 2 or
+ * 3 buffers the GPU renders one frame while the previous ones are read.
+ *
+ * frame_ms[f] is how long frame f's turn of the loop took: collecting the
+ * oldest readback, then clearing, drawing and queueing its own. Frames run
+ * back to back, so that is the frame interval. latency_ms[f] is the time
+ * from the start of frame f until its pixels were in client memory.
+ * Every frame's pixels are checked against its clear color.
+ */
+
+#define FRAME_LOOP_MAX_BUFFERS 3
+
+struct frame_loop_config {
+    int buffers;        /* 1 to FRAME_LOOP_MAX_BUFFERS */
+    int frames;
+    int draws;          /* the per-frame work */
+    GLsizei width;
+    GLsizei height;
+};
+
+struct frame_loop {
+    struct frame_loop_config config;
+    struct draw_pipeline pipeline;
+    struct render_target targets[FRAME_LOOP_MAX_BUFFERS];
+    struct readback_ring ring;
+    GLubyte *pixels;
+};
+
+struct frame_loop_result {
+    double elapsed_ms;
+    int wrong_frames;   /* delivered with pixels other than their own */
+};
+
+/* Returns 0 on success, -1 on failure with nothing left allocated. Leaves every binding at 0. */
+int frame_loop_init(struct frame_loop *loop, const struct frame_loop_config *config);
+void frame_loop_destroy(struct frame_loop *loop);
+
+/*
+ * Renders config->frames frames; frame_ms and latency_ms hold one entry
+ * per frame. Returns 0, or -1 if a readback failed. Leaves every binding
+ * at 0.
+ */
+int frame_loop_run(struct frame_loop *loop, double *frame_ms, double *latency_ms, struct frame_loop_result *result);
+
+#endif
@@ -0,0 +1,155 @@
+#include "gl_errors.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* macOS headers stop at 4.1 and know nothing of KHR_debug. */
+#ifndef GL_DEBUG_OUTPUT
+#define GL_DEBUG_OUTPUT 0x92E0
+#define GL_DEBUG_TYPE_ERROR 0x824C
+#define GL_DEBUG_TYPE_PERFORMANCE 0x8250
+#endif
+
+typedef void (*debug_proc)(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
+                           const GLchar *message, const void *user);
+typedef void (*debug_message_callback_proc)(debug_proc callback, const void *user);
+typedef void (*debug_message_control_proc)(GLenum source, GLenum type, GLenum severity, GLsizei count,
+                                           const GLuint *ids, GLboolean enabled);
+
+static void push(struct gl_errors *errors, GLenum type, GLuint id, const char *text, size_t length)
+{
+    pthread_mutex_lock(&errors->lock);
+    if (type == GL_DEBUG_TYPE_PERFORMANCE) {
+        errors->warning_count++;
+    } else {
+        errors->error_count++;
+    }
+    if (errors->message_count < GL_ERRORS_MAX_MESSAGES) {
+        struct gl_error_message *message = &errors->messages[errors->message_count++];
+
+        if (length >= sizeof(message->text)) {
+            length = sizeof(message->text) - 1;
+        }
+        message->type = type;
+        message->id = id;
+        memcpy(message->text, text, length);
+        message->text[length] = '\0';
+    }
+    pthread_mutex_unlock(&errors->lock);
+}
+
+static void on_debug_message(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
+                             const GLchar *message, const void *user)
+{
+    (void) source;
+    (void) severity;
+
+    if (type != GL_DEBUG_TYPE_ERROR && type != GL_DEBUG_TYPE_PERFORMANCE) {
+        return;
+    }
+    push((struct gl_errors *) user, type, id, message, length >= 0 ? (size_t) length : strlen(message));
+}
+
+static int has_khr_debug(void)
+{
+    GLint major = 0, minor = 0, extensions = 0;
+
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major > 4 || (major == 4 && minor >= 3)) {
+        return 1;
+    }
+
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+    for (GLint i = 0; i < extensions; i++) {
+        if (strcmp((const char *) glGetStringi(GL_EXTENSIONS, i), "GL_KHR_debug") == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void gl_errors_init(struct gl_errors *errors, int poll)
+{
+    memset(errors, 0, sizeof(*errors));
+    pthread_mutex_init(&errors->lock, NULL);
+
+    if (poll || !has_khr_debug()) {
+        return;
+    }
+
+    debug_message_callback_proc callback = (debug_message_callback_proc) glc_get_proc_address("glDebugMessageCallback");
+    debug_message_control_proc control = (debug_message_control_proc) glc_get_proc_address("glDebugMessageControl");
+    if (callback == NULL || control == NULL) {
+        return;
+    }
+
+    // low severity is filtered out by default, and many performance warnings are low
+    control(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, NULL, GL_TRUE);
+    callback(on_debug_message, errors);
+    glEnable(GL_DEBUG_OUTPUT);
+    errors->debug_output = 1;
+}
+
+void gl_errors_destroy(struct gl_errors *errors)
+{
+    if (errors->debug_output) {
+        debug_message_callback_proc callback = (debug_message_callback_proc) glc_get_proc_address("glDebugMessageCallback");
+
+        glDisable(GL_DEBUG_OUTPUT);
+        callback(NULL, NULL);
+        errors->debug_output = 0;
+    }
+    pthread_mutex_destroy(&errors->lock);
+}
+
+void gl_errors_clear(struct gl_errors *errors)
+{
+    while (glGetError() != GL_NO_ERROR) {
+    }
+
+    pthread_mutex_lock(&errors->lock);
+    errors->message_count = 0;
+    errors->error_count = 0;
+    errors->warning_count = 0;
+    pthread_mutex_unlock(&errors->lock);
+}
+
+int gl_errors_collect(struct gl_errors *errors)
+{
+    if (!errors->debug_output) {
+        char text[64];
+
+        for (GLenum error = glGetError(); error != GL_NO_ERROR; error = glGetError()) {
+            int length = snprintf(text, sizeof(text), "glGetError() returned 0x%04x", error);
+            push(errors, error, 0, text, (size_t) length);
+        }
+    }
+
+    pthread_mutex_lock(&errors->lock);
+    int count = errors->error_count;
+    pthread_mutex_unlock(&errors->lock);
+    return count;
+}
+
+int gl_errors_format(struct gl_errors *errors, char *report, size_t report_size)
+{
+    size_t used = 0;
+
+    report[0] = '\0';
+    pthread_mutex_lock(&errors->lock);
+    for (int i = 0; i < errors->message_count && used < report_size; i++) {
+        const struct gl_error_message *message = &errors->messages[i];
+        int n = snprintf(report + used, report_size - used, "  %s %u: %s\n",
+                         message->type == GL_DEBUG_TYPE_PERFORMANCE ? "warning" : "error",
+                         message->id, message->text);
+        used += n > 0 ? (size_t) n : 0;
+    }
+    int dropped = errors->error_count + errors->warning_count - errors->message_count;
+    if (dropped > 0 && used < report_size) {
+        snprintf(report + used, report_size - used, "  and %d more\n", dropped);
+    }
+    int count = errors->error_count;
+    pthread_mutex_unlock(&errors->lock);
+    return count;
+}
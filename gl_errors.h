@@ -0,0 +1,59 @@
+#ifndef GL_ERRORS_H
+#define GL_ERRORS_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+#include "glc.h"
+
+/*
+ * Collects GL errors and performance warnings into a per-context queue, to
+ * be looked at once at the end of a test rather than after every call.
+ *
+ * Where the context has KHR_debug (core since 4.3; macOS stops at 4.1)
+ * gl_errors_init() installs a glDebugMessageCallback, which the driver may
+ * call from any thread, so the queue is locked. The callback costs nothing
+ * until something goes wrong, whereas every glGetError() is a call into
+ * the driver that may have to sync with its worker threads. Without
+ * KHR_debug, or with GL_ERRORS=poll, gl_errors_collect() falls back to
+ * draining glGetError(); that sees errors but no warnings.
+ *
+ * Either way the error flags are left alone until collect or clear, so a
+ * test can still call glGetError() for an error it caused on purpose, and
+ * then gl_errors_clear() so the queue does not report it.
+ */
+
+#define GL_ERRORS_MAX_MESSAGES 16
+#define GL_ERRORS_MESSAGE_LENGTH 160
+
+struct gl_error_message {
+    GLenum type;        /* GL_DEBUG_TYPE_*, or the glGetError() code when polled */
+    GLuint id;
+    char text[GL_ERRORS_MESSAGE_LENGTH];
+};
+
+struct gl_errors {
+    int debug_output;   /* 1 if the callback is installed, 0 if polling */
+    pthread_mutex_t lock;
+    struct gl_error_message messages[GL_ERRORS_MAX_MESSAGES];
+    int message_count;
+    int error_count;    /* including any that did not fit in messages */
+    int warning_count;
+};
+
+/* Uses the current context; pass poll to skip KHR_debug even if present. */
+void gl_errors_init(struct gl_errors *errors, int poll);
+
+/* Removes the callback from the current context. */
+void gl_errors_destroy(struct gl_errors *errors);
+
+/* Forgets everything queued so far, including pending glGetError() flags. */
+void gl_errors_clear(struct gl_errors *errors);
+
+/* Brings the queue up to date and returns the number of errors in it. */
+int gl_errors_collect(struct gl_errors *errors);
+
+/* One line per queued message; returns the number of errors. */
+int gl_errors_format(struct gl_errors *errors, char *report, size_t report_size);
+
+#endif
@@ -0,0 +1,356 @@
+#include "gl_state.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+
+enum {
+    BINDING_PROGRAM,
+    BINDING_VERTEX_ARRAY,
+    BINDING_ELEMENT_ARRAY_BUFFER,
+    BINDING_ARRAY_BUFFER,
+    BINDING_PIXEL_PACK_BUFFER,
+    BINDING_PIXEL_UNPACK_BUFFER,
+    BINDING_COPY_READ_BUFFER,
+    BINDING_COPY_WRITE_BUFFER,
+    BINDING_TRANSFORM_FEEDBACK_BUFFER,
+    BINDING_UNIFORM_BUFFER,
+    BINDING_DRAW_FRAMEBUFFER,
+    BINDING_READ_FRAMEBUFFER,
+    BINDING_RENDERBUFFER,
+    BINDING_ACTIVE_TEXTURE,
+    BINDING_TEXTURE_2D
+};
+
+/* buffer_target is set for bindings restored with glBindBuffer. */
+static const struct {
+    GLenum pname;
+    const char *name;
+    GLenum buffer_target;
+} bindings[GL_STATE_BINDING_COUNT] = {
+    [BINDING_PROGRAM] =                   { GL_CURRENT_PROGRAM, "GL_CURRENT_PROGRAM", 0 },
+    [BINDING_VERTEX_ARRAY] =              { GL_VERTEX_ARRAY_BINDING, "GL_VERTEX_ARRAY_BINDING", 0 },
+    [BINDING_ELEMENT_ARRAY_BUFFER] =      { GL_ELEMENT_ARRAY_BUFFER_BINDING, "GL_ELEMENT_ARRAY_BUFFER_BINDING", 0 },
+    [BINDING_ARRAY_BUFFER] =              { GL_ARRAY_BUFFER_BINDING, "GL_ARRAY_BUFFER_BINDING", GL_ARRAY_BUFFER },
+    [BINDING_PIXEL_PACK_BUFFER] =         { GL_PIXEL_PACK_BUFFER_BINDING, "GL_PIXEL_PACK_BUFFER_BINDING", GL_PIXEL_PACK_BUFFER },
+    [BINDING_PIXEL_UNPACK_BUFFER] =       { GL_PIXEL_UNPACK_BUFFER_BINDING, "GL_PIXEL_UNPACK_BUFFER_BINDING", GL_PIXEL_UNPACK_BUFFER },
+    [BINDING_COPY_READ_BUFFER] =          { GL_COPY_READ_BUFFER_BINDING, "GL_COPY_READ_BUFFER_BINDING", GL_COPY_READ_BUFFER },
+    [BINDING_COPY_WRITE_BUFFER] =         { GL_COPY_WRITE_BUFFER_BINDING, "GL_COPY_WRITE_BUFFER_BINDING", GL_COPY_WRITE_BUFFER },
+    [BINDING_TRANSFORM_FEEDBACK_BUFFER] = { GL_TRANSFORM_FEEDBACK_BUFFER_BINDING, "GL_TRANSFORM_FEEDBACK_BUFFER_BINDING", GL_TRANSFORM_FEEDBACK_BUFFER },
+    [BINDING_UNIFORM_BUFFER] =            { GL_UNIFORM_BUFFER_BINDING, "GL_UNIFORM_BUFFER_BINDING", GL_UNIFORM_BUFFER },
+    [BINDING_DRAW_FRAMEBUFFER] =          { GL_DRAW_FRAMEBUFFER_BINDING, "GL_DRAW_FRAMEBUFFER_BINDING", 0 },
+    [BINDING_READ_FRAMEBUFFER] =          { GL_READ_FRAMEBUFFER_BINDING, "GL_READ_FRAMEBUFFER_BINDING", 0 },
+    [BINDING_RENDERBUFFER] =              { GL_RENDERBUFFER_BINDING, "GL_RENDERBUFFER_BINDING", 0 },
+    [BINDING_ACTIVE_TEXTURE] =            { GL_ACTIVE_TEXTURE, "GL_ACTIVE_TEXTURE", 0 },
+    [BINDING_TEXTURE_2D] =                { GL_TEXTURE_BINDING_2D, "GL_TEXTURE_BINDING_2D", 0 }
+};
+
+static const struct {
+    GLenum cap;
+    const char *name;
+} caps[GL_STATE_CAP_COUNT] = {
+    { GL_BLEND,                     "GL_BLEND" },
+    { GL_CULL_FACE,                 "GL_CULL_FACE" },
+    { GL_DEPTH_TEST,                "GL_DEPTH_TEST" },
+    { GL_DEPTH_CLAMP,               "GL_DEPTH_CLAMP" },
+    { GL_DITHER,                    "GL_DITHER" },
+    { GL_FRAMEBUFFER_SRGB,          "GL_FRAMEBUFFER_SRGB" },
+    { GL_MULTISAMPLE,               "GL_MULTISAMPLE" },
+    { GL_POLYGON_OFFSET_FILL,       "GL_POLYGON_OFFSET_FILL" },
+    { GL_PRIMITIVE_RESTART,         "GL_PRIMITIVE_RESTART" },
+    { GL_PROGRAM_POINT_SIZE,        "GL_PROGRAM_POINT_SIZE" },
+    { GL_RASTERIZER_DISCARD,        "GL_RASTERIZER_DISCARD" },
+    { GL_SAMPLE_ALPHA_TO_COVERAGE,  "GL_SAMPLE_ALPHA_TO_COVERAGE" },
+    { GL_SCISSOR_TEST,              "GL_SCISSOR_TEST" },
+    { GL_STENCIL_TEST,              "GL_STENCIL_TEST" }
+};
+
+static void delete_program(GLsizei n, const GLuint *names)
+{
+    for (GLsizei i = 0; i < n; i++) {
+        glDeleteProgram(names[i]);
+    }
+}
+
+static void delete_shader(GLsizei n, const GLuint *names)
+{
+    for (GLsizei i = 0; i < n; i++) {
+        glDeleteShader(names[i]);
+    }
+}
+
+/* What the driver hands out next; the probe deletes it again. */
+#define NEXT_NAME(type, gen, delete_objects)    \
+    static GLuint next_##type(void)             \
+    {                                           \
+        GLuint name = 0;                        \
+        gen(1, &name);                          \
+        delete_objects(1, &name);               \
+        return name;                            \
+    }
+
+NEXT_NAME(buffer, glGenBuffers, glDeleteBuffers)
+NEXT_NAME(texture, glGenTextures, glDeleteTextures)
+NEXT_NAME(framebuffer, glGenFramebuffers, glDeleteFramebuffers)
+NEXT_NAME(renderbuffer, glGenRenderbuffers, glDeleteRenderbuffers)
+NEXT_NAME(vertex_array, glGenVertexArrays, glDeleteVertexArrays)
+NEXT_NAME(query, glGenQueries, glDeleteQueries)
+NEXT_NAME(sampler, glGenSamplers, glDeleteSamplers)
+
+/* Programs and shaders share their names. */
+static GLuint next_shader_or_program(void)
+{
+    GLuint name = glCreateShader(GL_VERTEX_SHADER);
+    glDeleteShader(name);
+    return name;
+}
+
+static const struct {
+    GLboolean (*is_object)(GLuint name);
+    void (*delete_objects)(GLsizei n, const GLuint *names);
+    GLuint (*next_name)(void);
+    const char *name;
+} object_types[GL_STATE_OBJECT_TYPE_COUNT] = {
+    { glIsBuffer,            glDeleteBuffers,        next_buffer,             "buffer" },
+    { glIsTexture,           glDeleteTextures,       next_texture,            "texture" },
+    { glIsFramebuffer,       glDeleteFramebuffers,   next_framebuffer,        "framebuffer" },
+    { glIsRenderbuffer,      glDeleteRenderbuffers,  next_renderbuffer,       "renderbuffer" },
+    { glIsVertexArray,       glDeleteVertexArrays,   next_vertex_array,       "vertex array" },
+    { glIsProgram,           delete_program,         next_shader_or_program,  "program" },
+    { glIsShader,            delete_shader,          next_shader_or_program,  "shader" },
+    { glIsQuery,             glDeleteQueries,        next_query,              "query" },
+    { glIsSampler,           glDeleteSamplers,       next_sampler,            "sampler" }
+};
+
+struct report {
+    char *buffer;
+    size_t size;
+    size_t length;
+    int count;
+};
+
+static void report_add(struct report *report, const char *format, ...)
+{
+    report->count++;
+
+    if (report->buffer == NULL || report->length + 1 >= report->size) {
+        return;
+    }
+
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(report->buffer + report->length, report->size - report->length, format, args);
+    va_end(args);
+
+    if (written > 0) {
+        report->length += (size_t) written;
+        if (report->length >= report->size) {
+            report->length = report->size - 1;
+        }
+    }
+}
+
+/*
+ * Calls found(name) for every object of type t in the window and returns
+ * the name the driver hands out next, below which the window is clean once
+ * found() deleted what it was given.
+ */
+static GLuint probe_leaks(struct gl_state_leak_window *window, size_t t, void (*found)(size_t t, GLuint name, void *data),
+                          void *data)
+{
+    GLuint next = object_types[t].next_name();
+
+    // an ever-higher allocator never gives the same name twice
+    if (next <= window->next) {
+        window->reuses_names = 1;
+    }
+    window->next = next;
+
+    GLuint first = window->reuses_names ? window->base : window->first;
+    GLuint last = next - 1 + (window->reuses_names ? GL_STATE_LEAK_SCAN_SLACK : 0);
+
+    for (GLuint name = first; name <= last; name++) {
+        if (object_types[t].is_object(name)) {
+            found(t, name, data);
+            if (window->reuses_names && name + GL_STATE_LEAK_SCAN_SLACK > last) {
+                last = name + GL_STATE_LEAK_SCAN_SLACK;
+            }
+        }
+    }
+    return next;
+}
+
+static void capture_values(struct gl_state *state)
+{
+    for (int i = 0; i < GL_STATE_BINDING_COUNT; i++) {
+        glGetIntegerv(bindings[i].pname, &state->bindings[i]);
+    }
+    for (int i = 0; i < GL_STATE_CAP_COUNT; i++) {
+        state->caps[i] = glIsEnabled(caps[i].cap);
+    }
+
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, state->clear_color);
+    glGetFloatv(GL_DEPTH_CLEAR_VALUE, &state->clear_depth);
+    glGetIntegerv(GL_STENCIL_CLEAR_VALUE, &state->clear_stencil);
+    glGetBooleanv(GL_DEPTH_WRITEMASK, &state->depth_mask);
+    glGetBooleanv(GL_COLOR_WRITEMASK, state->color_mask);
+    glGetIntegerv(GL_DRAW_BUFFER, &state->draw_buffer);
+    glGetIntegerv(GL_READ_BUFFER, &state->read_buffer);
+    glGetIntegerv(GL_VIEWPORT, state->viewport);
+}
+
+void gl_state_capture(struct gl_state *state)
+{
+    capture_values(state);
+    for (int t = 0; t < GL_STATE_OBJECT_TYPE_COUNT; t++) {
+        GLuint next = object_types[t].next_name();
+        state->leak_windows[t] = (struct gl_state_leak_window) { next, next, next, 0 };
+    }
+}
+
+static void report_leak(size_t t, GLuint name, void *report)
+{
+    report_add(report, "%s %u was never deleted\n", object_types[t].name, name);
+}
+
+static void delete_leak(size_t t, GLuint name, void *unused)
+{
+    (void) unused;
+    object_types[t].delete_objects(1, &name);
+}
+
+int gl_state_check(struct gl_state *defaults, char *report_buffer, size_t report_size)
+{
+    struct report report = { report_buffer, report_size, 0, 0 };
+    struct gl_state current;
+
+    if (report_buffer != NULL && report_size > 0) {
+        report_buffer[0] = '\0';
+    }
+
+    capture_values(&current);
+
+    for (int i = 0; i < GL_STATE_BINDING_COUNT; i++) {
+        if (current.bindings[i] != defaults->bindings[i]) {
+            report_add(&report, "%s is %d, expected %d\n", bindings[i].name,
+                       current.bindings[i], defaults->bindings[i]);
+        }
+    }
+    for (int i = 0; i < GL_STATE_CAP_COUNT; i++) {
+        if (current.caps[i] != defaults->caps[i]) {
+            report_add(&report, "%s left %s\n", caps[i].name,
+                       current.caps[i] ? "enabled" : "disabled");
+        }
+    }
+    for (int i = 0; i < 4; i++) {
+        if (current.clear_color[i] != defaults->clear_color[i]) {
+            report_add(&report, "clear color is (%g, %g, %g, %g)\n",
+                       current.clear_color[0], current.clear_color[1],
+                       current.clear_color[2], current.clear_color[3]);
+            break;
+        }
+    }
+    if (current.clear_depth != defaults->clear_depth) {
+        report_add(&report, "clear depth is %g\n", current.clear_depth);
+    }
+    if (current.clear_stencil != defaults->clear_stencil) {
+        report_add(&report, "clear stencil is %d\n", current.clear_stencil);
+    }
+    if (current.depth_mask != defaults->depth_mask) {
+        report_add(&report, "depth mask is %s\n", current.depth_mask ? "GL_TRUE" : "GL_FALSE");
+    }
+    for (int i = 0; i < 4; i++) {
+        if (current.color_mask[i] != defaults->color_mask[i]) {
+            report_add(&report, "color mask is (%d, %d, %d, %d)\n",
+                       current.color_mask[0], current.color_mask[1],
+                       current.color_mask[2], current.color_mask[3]);
+            break;
+        }
+    }
+    if (current.draw_buffer != defaults->draw_buffer) {
+        report_add(&report, "draw buffer is 0x%04x, expected 0x%04x\n",
+                   current.draw_buffer, defaults->draw_buffer);
+    }
+    if (current.read_buffer != defaults->read_buffer) {
+        report_add(&report, "read buffer is 0x%04x, expected 0x%04x\n",
+                   current.read_buffer, defaults->read_buffer);
+    }
+
+    for (size_t t = 0; t < GL_STATE_OBJECT_TYPE_COUNT; t++) {
+        probe_leaks(&defaults->leak_windows[t], t, report_leak, &report);
+    }
+
+    return report.count;
+}
+
+void gl_state_restore(struct gl_state *defaults)
+{
+    struct gl_state current;
+
+    // leaked objects go first so that deleting them cannot disturb bindings
+    for (size_t t = 0; t < GL_STATE_OBJECT_TYPE_COUNT; t++) {
+        defaults->leak_windows[t].first = probe_leaks(&defaults->leak_windows[t], t, delete_leak, NULL);
+    }
+
+    capture_values(&current);
+
+#define CHANGED(binding) (current.bindings[binding] != defaults->bindings[binding])
+
+    if (CHANGED(BINDING_PROGRAM)) {
+        glUseProgram(defaults->bindings[BINDING_PROGRAM]);
+    }
+    // the element array binding belongs to the vertex array
+    if (CHANGED(BINDING_VERTEX_ARRAY)) {
+        glBindVertexArray(defaults->bindings[BINDING_VERTEX_ARRAY]);
+    }
+    for (int i = 0; i < GL_STATE_BINDING_COUNT; i++) {
+        if (bindings[i].buffer_target != 0 && CHANGED(i)) {
+            glBindBuffer(bindings[i].buffer_target, defaults->bindings[i]);
+        }
+    }
+    if (CHANGED(BINDING_DRAW_FRAMEBUFFER)) {
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, defaults->bindings[BINDING_DRAW_FRAMEBUFFER]);
+    }
+    if (CHANGED(BINDING_READ_FRAMEBUFFER)) {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, defaults->bindings[BINDING_READ_FRAMEBUFFER]);
+    }
+    if (CHANGED(BINDING_RENDERBUFFER)) {
+        glBindRenderbuffer(GL_RENDERBUFFER, defaults->bindings[BINDING_RENDERBUFFER]);
+    }
+    if (CHANGED(BINDING_TEXTURE_2D)) {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, defaults->bindings[BINDING_TEXTURE_2D]);
+    }
+    glActiveTexture(defaults->bindings[BINDING_ACTIVE_TEXTURE]);
+
+#undef CHANGED
+
+    for (int i = 0; i < GL_STATE_CAP_COUNT; i++) {
+        if (current.caps[i] != defaults->caps[i]) {
+            if (defaults->caps[i]) {
+                glEnable(caps[i].cap);
+            } else {
+                glDisable(caps[i].cap);
+            }
+        }
+    }
+
+    glClearColor(defaults->clear_color[0], defaults->clear_color[1],
+                 defaults->clear_color[2], defaults->clear_color[3]);
+    glClearDepth(defaults->clear_depth);
+    glClearStencil(defaults->clear_stencil);
+    glDepthMask(defaults->depth_mask);
+    glColorMask(defaults->color_mask[0], defaults->color_mask[1],
+                defaults->color_mask[2], defaults->color_mask[3]);
+    if (current.draw_buffer != defaults->draw_buffer) {
+        glDrawBuffer(defaults->draw_buffer);
+    }
+    if (current.read_buffer != defaults->read_buffer) {
+        glReadBuffer(defaults->read_buffer);
+    }
+    glViewport(defaults->viewport[0], defaults->viewport[1],
+               defaults->viewport[2], defaults->viewport[3]);
+
+    while (glGetError() != GL_NO_ERROR) {
+        // drain errors left over from the previous test
+    }
+}
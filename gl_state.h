@@ -0,0 +1,72 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <stddef.h>
+
+#include "glc.h"
+
+/*
+ * Snapshot / verify / restore of the GL state tests are expected to leave
+ * alone. A snapshot is taken once on a freshly created context; after each
+ * test the context is compared against it and then put back.
+ *
+ * Leaked objects are found by asking glIs* about the names the driver may
+ * have handed out since the last restore. The driver is asked for one new
+ * name of each type (and it is deleted again): names at or above it were
+ * never handed out, and a restore that deleted everything below it can
+ * skip those from then on. That holds for drivers that hand out ever
+ * higher names, as Mesa does. A driver seen to hand out a name again is
+ * probed from the snapshot's names every time, and up to
+ * GL_STATE_LEAK_SCAN_SLACK names past the highest object found, to step
+ * over freed names in between. Objects made before the snapshot belong
+ * to it and are never probed, such as the test fixture's own queries.
+ *
+ * Objects made through a name_pool are the pool's to report: a name it
+ * made before the last restore is not probed again.
+ */
+
+#define GL_STATE_LEAK_SCAN_SLACK 64
+
+#define GL_STATE_BINDING_COUNT 15
+#define GL_STATE_CAP_COUNT 14
+#define GL_STATE_OBJECT_TYPE_COUNT 9
+
+struct gl_state_leak_window {
+    GLuint base;        /* what the driver handed out at the snapshot */
+    GLuint first;       /* lowest name that may still be an unseen object */
+    GLuint next;        /* what the driver handed out when last asked */
+    int reuses_names;
+};
+
+struct gl_state {
+    GLint bindings[GL_STATE_BINDING_COUNT];
+    GLboolean caps[GL_STATE_CAP_COUNT];
+    GLfloat clear_color[4];
+    GLfloat clear_depth;
+    GLint clear_stencil;
+    GLboolean depth_mask;
+    GLboolean color_mask[4];
+    GLint draw_buffer;
+    GLint read_buffer;
+    GLint viewport[4];
+    /* moved along by gl_state_check() and gl_state_restore() */
+    struct gl_state_leak_window leak_windows[GL_STATE_OBJECT_TYPE_COUNT];
+};
+
+void gl_state_capture(struct gl_state *state);
+
+/*
+ * Compares the current context against a snapshot and probes for objects
+ * that were never deleted. Writes a human readable list of every deviation
+ * into report and returns how many were found.
+ */
+int gl_state_check(struct gl_state *defaults, char *report, size_t report_size);
+
+/*
+ * Puts the current context back into the snapshotted state and deletes any
+ * object found by the leak probe. The viewport is restored but never
+ * reported: every test that renders sets its own.
+ */
+void gl_state_restore(struct gl_state *defaults);
+
+#endif
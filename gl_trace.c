@@ -0,0 +1,207 @@
+#include "gl_trace.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct trace_event {
+    const char *name;
+    uint64_t start_ticks;
+    uint64_t end_ticks;
+    uint32_t calls;     /* the calls this one was picked from, itself included */
+};
+
+/*
+ * Only the owning thread writes events and head; head is published with a
+ * release store so gl_trace_flush() on another thread sees whole events.
+ */
+struct trace_ring {
+    struct trace_ring *next;
+    int tid;
+    uint64_t head;
+    uint64_t flushed;
+    struct trace_event events[GL_TRACE_RING_EVENTS];
+};
+
+int gl_trace_enabled;
+__thread uint32_t gl_trace_countdown = 1;
+
+static const char *output_path;
+/* Ticks are turned into ns by interpolating between two (ticks, ns) points. */
+static uint64_t base_ticks;
+static uint64_t base_ns;
+static struct trace_ring *rings;
+static int thread_count;
+static int every = 1;
+static __thread struct trace_ring *thread_ring;
+static __thread uint32_t thread_interval = 1;   /* what gl_trace_countdown last started from */
+static __thread uint32_t thread_random;
+
+static struct trace_ring *register_ring(void)
+{
+    struct trace_ring *ring = calloc(1, sizeof(*ring));
+
+    if (ring == NULL) {
+        return NULL;
+    }
+    ring->tid = __atomic_add_fetch(&thread_count, 1, __ATOMIC_RELAXED);
+
+    ring->next = __atomic_load_n(&rings, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&rings, &ring->next, ring, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    }
+    return ring;
+}
+
+/* Uniform in 1..2 * every - 1, so a loop whose length divides every is not always caught at the same call. */
+static uint32_t next_interval(struct trace_ring *ring)
+{
+    if (every <= 1) {
+        return 1;
+    }
+    if (thread_random == 0) {
+        thread_random = 2654435761u * (uint32_t) ring->tid;
+    }
+    // xorshift32
+    thread_random ^= thread_random << 13;
+    thread_random ^= thread_random >> 17;
+    thread_random ^= thread_random << 5;
+    return 1 + thread_random % (2 * (uint32_t) every - 1);
+}
+
+void gl_trace_record(const char *name, uint64_t start_ticks, uint64_t end_ticks)
+{
+    struct trace_ring *ring = thread_ring;
+
+    if (ring == NULL) {
+        ring = thread_ring = register_ring();
+        if (ring == NULL) {
+            return;
+        }
+    }
+
+    uint64_t head = ring->head;
+    struct trace_event *event = &ring->events[head & (GL_TRACE_RING_EVENTS - 1)];
+    event->name = name;
+    event->start_ticks = start_ticks;
+    event->end_ticks = end_ticks;
+    event->calls = thread_interval;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+    gl_trace_countdown = thread_interval = next_interval(ring);
+}
+
+/* In a forked child the parent's events are the parent's to write. */
+static void forget_events(void)
+{
+    for (struct trace_ring *ring = __atomic_load_n(&rings, __ATOMIC_ACQUIRE); ring != NULL; ring = ring->next) {
+        ring->flushed = ring->head;
+    }
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+void gl_trace_flush(void)
+{
+    if (output_path == NULL) {
+        return;
+    }
+
+    // the longer since init, the better the tick rate; 10 ms is plenty
+    uint64_t ns = now_ns();
+    while (ns - base_ns < 10000000u) {
+        ns = now_ns();
+    }
+    const double ns_per_tick = (double) (ns - base_ns) / (double) (gl_trace_ticks() - base_ticks);
+
+    int fd = open(output_path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (fd < 0) {
+        return;
+    }
+    FILE *file = fdopen(fd, "a");
+    if (file == NULL) {
+        close(fd);
+        return;
+    }
+
+    flock(fd, LOCK_EX);
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size == 0) {
+        fputs("[\n", file);
+    }
+
+    const int pid = (int) getpid();
+
+    for (struct trace_ring *ring = __atomic_load_n(&rings, __ATOMIC_ACQUIRE); ring != NULL; ring = ring->next) {
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        uint64_t first = ring->flushed;
+
+        if (head - first > GL_TRACE_RING_EVENTS) {
+            first = head - GL_TRACE_RING_EVENTS;
+            fprintf(stderr, "gl_trace: thread %d dropped %llu event(s)\n",
+                    ring->tid, (unsigned long long) (first - ring->flushed));
+        }
+        for (uint64_t i = first; i < head; i++) {
+            const struct trace_event *event = &ring->events[i & (GL_TRACE_RING_EVENTS - 1)];
+            fprintf(file, "{\"name\":\"%s\",\"cat\":\"gl\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+                    "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"calls\":%u}},\n",
+                    event->name, pid, ring->tid,
+                    (base_ns + (double) (int64_t) (event->start_ticks - base_ticks) * ns_per_tick) / 1e3,
+                    (double) (event->end_ticks - event->start_ticks) * ns_per_tick / 1e3, event->calls);
+        }
+        ring->flushed = head;
+    }
+
+    fflush(file);
+    flock(fd, LOCK_UN);
+    fclose(file);
+}
+
+void gl_trace_set_enabled(int enabled)
+{
+    gl_trace_enabled = enabled;
+}
+
+void gl_trace_set_every(int calls)
+{
+    every = calls > 1 ? calls : 1;
+    gl_trace_countdown = thread_interval = 1;
+}
+
+void gl_trace_init(void)
+{
+    const char *path = getenv("GL_TRACE");
+
+    if (path == NULL || path[0] == '\0' || output_path != NULL) {
+        return;
+    }
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "gl_trace: cannot write %s\n", path);
+        return;
+    }
+    close(fd);
+
+    const char *every_env = getenv("GL_TRACE_EVERY");
+    if (every_env != NULL && atoi(every_env) > 0) {
+        gl_trace_set_every(atoi(every_env));
+    }
+
+    base_ns = now_ns();
+    base_ticks = gl_trace_ticks();
+    output_path = path;
+    pthread_atfork(NULL, NULL, forget_events);
+    atexit(gl_trace_flush);
+    gl_trace_enabled = 1;
+}
@@ -0,0 +1,227 @@
+#ifndef GL_TRACE_H
+#define GL_TRACE_H
+
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "glc.h"
+
+/*
+ * GL call tracing. Including this header in a source file routes the gl*
+ * entry points listed below through wrappers that record call name,
+ * thread, start time and duration. Include it after every other header.
+ *
+ * Tracing is off unless gl_trace_init() finds GL_TRACE set to an output
+ * path; while off, a wrapper costs one predictable branch. While on, every
+ * call is timed. Reading the tick counter twice costs a tenth of a cheap
+ * draw call on some machines, so GL_TRACE_EVERY=N times a random one in
+ * N calls per thread instead and only counts down the others, which keeps
+ * the draw-call hot path within a few percent of untraced (N =
+ * GL_TRACE_SAMPLED_EVERY is what open_gl_bench measures). Every event
+ * carries how many calls it stands for, so totals per call scale back up.
+ *
+ * Each thread records into its own ring of GL_TRACE_RING_EVENTS events, so
+ * recording takes no lock; when a ring wraps the oldest events are
+ * dropped. Events are stamped with the CPU's tick counter, which costs a
+ * fraction of a clock_gettime(), and converted to time when they are
+ * written out.
+ *
+ * At exit every process appends its events to the GL_TRACE file in Chrome
+ * trace event format (JSON array form, which may be left unterminated),
+ * so forked tests and shards all land in one file. Load it in
+ * chrome://tracing or ui.perfetto.dev.
+ */
+
+#define GL_TRACE_RING_EVENTS (1 << 16)
+#define GL_TRACE_SAMPLED_EVERY 16
+
+extern int gl_trace_enabled;
+/* Calls until this thread times one; 0 once it is due. */
+extern __thread uint32_t gl_trace_countdown;
+
+/* Reads GL_TRACE; if set, truncates that file and dumps to it at exit. */
+void gl_trace_init(void);
+
+/* Turns recording on or off, e.g. to measure the overhead. */
+void gl_trace_set_enabled(int enabled);
+
+/* Times one call in every (on average) from now on; 1, the default, times them all. */
+void gl_trace_set_every(int every);
+
+/* Appends the events recorded so far to the output file and forgets them. */
+void gl_trace_flush(void);
+
+void gl_trace_record(const char *name, uint64_t start_ticks, uint64_t end_ticks);
+
+static inline uint64_t gl_trace_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t ticks;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+#endif
+}
+
+static inline uint64_t gl_trace_begin(void)
+{
+    if (__builtin_expect(gl_trace_enabled, 0) && __builtin_expect(--gl_trace_countdown == 0, 0)) {
+        return gl_trace_ticks();
+    }
+    return 0;
+}
+
+static inline void gl_trace_end(const char *name, uint64_t start_ticks)
+{
+    if (__builtin_expect(start_ticks != 0, 0)) {
+        gl_trace_record(name, start_ticks, gl_trace_ticks());
+    }
+}
+
+#define GL_TRACE_VOID(name, params, args)           \
+    static inline void gl_trace_##name params       \
+    {                                               \
+        uint64_t start = gl_trace_begin();          \
+        name args;                                  \
+        gl_trace_end(#name, start);                 \
+    }
+
+#define GL_TRACE_RETURN(type, name, params, args)   \
+    static inline type gl_trace_##name params       \
+    {                                               \
+        uint64_t start = gl_trace_begin();          \
+        type result = name args;                    \
+        gl_trace_end(#name, start);                 \
+        return result;                              \
+    }
+
+GL_TRACE_VOID(glAttachShader, (GLuint program, GLuint shader), (program, shader))
+GL_TRACE_VOID(glBindBuffer, (GLenum target, GLuint buffer), (target, buffer))
+GL_TRACE_VOID(glBindFramebuffer, (GLenum target, GLuint framebuffer), (target, framebuffer))
+GL_TRACE_VOID(glBindRenderbuffer, (GLenum target, GLuint renderbuffer), (target, renderbuffer))
+GL_TRACE_VOID(glBindTexture, (GLenum target, GLuint texture), (target, texture))
+GL_TRACE_VOID(glBindVertexArray, (GLuint array), (array))
+GL_TRACE_VOID(glBufferData, (GLenum target, GLsizeiptr size, const void *data, GLenum usage),
+              (target, size, data, usage))
+GL_TRACE_RETURN(GLenum, glCheckFramebufferStatus, (GLenum target), (target))
+GL_TRACE_VOID(glClear, (GLbitfield mask), (mask))
+GL_TRACE_VOID(glClearColor, (GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha), (red, green, blue, alpha))
+GL_TRACE_VOID(glCompileShader, (GLuint shader), (shader))
+GL_TRACE_RETURN(GLuint, glCreateProgram, (void), ())
+GL_TRACE_RETURN(GLuint, glCreateShader, (GLenum type), (type))
+GL_TRACE_VOID(glDeleteBuffers, (GLsizei n, const GLuint *buffers), (n, buffers))
+GL_TRACE_VOID(glDeleteFramebuffers, (GLsizei n, const GLuint *framebuffers), (n, framebuffers))
+GL_TRACE_VOID(glDeleteProgram, (GLuint program), (program))
+GL_TRACE_VOID(glDeleteRenderbuffers, (GLsizei n, const GLuint *renderbuffers), (n, renderbuffers))
+GL_TRACE_VOID(glDeleteShader, (GLuint shader), (shader))
+GL_TRACE_VOID(glDeleteTextures, (GLsizei n, const GLuint *textures), (n, textures))
+GL_TRACE_VOID(glDeleteVertexArrays, (GLsizei n, const GLuint *arrays), (n, arrays))
+GL_TRACE_VOID(glDepthMask, (GLboolean flag), (flag))
+GL_TRACE_VOID(glDisable, (GLenum cap), (cap))
+GL_TRACE_VOID(glDrawArrays, (GLenum mode, GLint first, GLsizei count), (mode, first, count))
+GL_TRACE_VOID(glDrawArraysInstanced, (GLenum mode, GLint first, GLsizei count, GLsizei instancecount),
+              (mode, first, count, instancecount))
+GL_TRACE_VOID(glDrawBuffers, (GLsizei n, const GLenum *bufs), (n, bufs))
+GL_TRACE_VOID(glEnable, (GLenum cap), (cap))
+GL_TRACE_VOID(glEnableVertexAttribArray, (GLuint index), (index))
+GL_TRACE_VOID(glFinish, (void), ())
+GL_TRACE_VOID(glFramebufferRenderbuffer,
+              (GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer),
+              (target, attachment, renderbuffertarget, renderbuffer))
+GL_TRACE_VOID(glFramebufferTexture, (GLenum target, GLenum attachment, GLuint texture, GLint level),
+              (target, attachment, texture, level))
+GL_TRACE_VOID(glGenBuffers, (GLsizei n, GLuint *buffers), (n, buffers))
+GL_TRACE_VOID(glGenFramebuffers, (GLsizei n, GLuint *framebuffers), (n, framebuffers))
+GL_TRACE_VOID(glGenRenderbuffers, (GLsizei n, GLuint *renderbuffers), (n, renderbuffers))
+GL_TRACE_VOID(glGenTextures, (GLsizei n, GLuint *textures), (n, textures))
+GL_TRACE_VOID(glGenVertexArrays, (GLsizei n, GLuint *arrays), (n, arrays))
+GL_TRACE_VOID(glGetBufferSubData, (GLenum target, GLintptr offset, GLsizeiptr size, void *data),
+              (target, offset, size, data))
+GL_TRACE_RETURN(GLenum, glGetError, (void), ())
+GL_TRACE_VOID(glGetIntegerv, (GLenum pname, GLint *data), (pname, data))
+GL_TRACE_VOID(glGetProgramiv, (GLuint program, GLenum pname, GLint *params), (program, pname, params))
+GL_TRACE_VOID(glGetShaderiv, (GLuint shader, GLenum pname, GLint *params), (shader, pname, params))
+GL_TRACE_RETURN(GLboolean, glIsBuffer, (GLuint buffer), (buffer))
+GL_TRACE_VOID(glLinkProgram, (GLuint program), (program))
+GL_TRACE_VOID(glMultiDrawArrays, (GLenum mode, const GLint *first, const GLsizei *count, GLsizei drawcount),
+              (mode, first, count, drawcount))
+GL_TRACE_VOID(glReadPixels,
+              (GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void *pixels),
+              (x, y, width, height, format, type, pixels))
+GL_TRACE_VOID(glRenderbufferStorage, (GLenum target, GLenum internalformat, GLsizei width, GLsizei height),
+              (target, internalformat, width, height))
+GL_TRACE_VOID(glShaderSource, (GLuint shader, GLsizei count, const GLchar *const *string, const GLint *length),
+              (shader, count, string, length))
+GL_TRACE_VOID(glTexImage2D,
+              (GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border,
+               GLenum format, GLenum type, const void *pixels),
+              (target, level, internalformat, width, height, border, format, type, pixels))
+GL_TRACE_VOID(glTexParameteri, (GLenum target, GLenum pname, GLint param), (target, pname, param))
+GL_TRACE_VOID(glUseProgram, (GLuint program), (program))
+GL_TRACE_VOID(glVertexAttribPointer,
+              (GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer),
+              (index, size, type, normalized, stride, pointer))
+GL_TRACE_VOID(glViewport, (GLint x, GLint y, GLsizei width, GLsizei height), (x, y, width, height))
+
+#define glAttachShader gl_trace_glAttachShader
+#define glBindBuffer gl_trace_glBindBuffer
+#define glBindFramebuffer gl_trace_glBindFramebuffer
+#define glBindRenderbuffer gl_trace_glBindRenderbuffer
+#define glBindTexture gl_trace_glBindTexture
+#define glBindVertexArray gl_trace_glBindVertexArray
+#define glBufferData gl_trace_glBufferData
+#define glCheckFramebufferStatus gl_trace_glCheckFramebufferStatus
+#define glClear gl_trace_glClear
+#define glClearColor gl_trace_glClearColor
+#define glCompileShader gl_trace_glCompileShader
+#define glCreateProgram gl_trace_glCreateProgram
+#define glCreateShader gl_trace_glCreateShader
+#define glDeleteBuffers gl_trace_glDeleteBuffers
+#define glDeleteFramebuffers gl_trace_glDeleteFramebuffers
+#define glDeleteProgram gl_trace_glDeleteProgram
+#define glDeleteRenderbuffers gl_trace_glDeleteRenderbuffers
+#define glDeleteShader gl_trace_glDeleteShader
+#define glDeleteTextures gl_trace_glDeleteTextures
+#define glDeleteVertexArrays gl_trace_glDeleteVertexArrays
+#define glDepthMask gl_trace_glDepthMask
+#define glDisable gl_trace_glDisable
+#define glDrawArrays gl_trace_glDrawArrays
+#define glDrawArraysInstanced gl_trace_glDrawArraysInstanced
+#define glDrawBuffers gl_trace_glDrawBuffers
+#define glEnable gl_trace_glEnable
+#define glEnableVertexAttribArray gl_trace_glEnableVertexAttribArray
+#define glFinish gl_trace_glFinish
+#define glFramebufferRenderbuffer gl_trace_glFramebufferRenderbuffer
+#define glFramebufferTexture gl_trace_glFramebufferTexture
+#define glGenBuffers gl_trace_glGenBuffers
+#define glGenFramebuffers gl_trace_glGenFramebuffers
+#define glGenRenderbuffers gl_trace_glGenRenderbuffers
+#define glGenTextures gl_trace_glGenTextures
+#define glGenVertexArrays gl_trace_glGenVertexArrays
+#define glGetBufferSubData gl_trace_glGetBufferSubData
+#define glGetError gl_trace_glGetError
+#define glGetIntegerv gl_trace_glGetIntegerv
+#define glGetProgramiv gl_trace_glGetProgramiv
+#define glGetShaderiv gl_trace_glGetShaderiv
+#define glIsBuffer gl_trace_glIsBuffer
+#define glLinkProgram gl_trace_glLinkProgram
+#define glMultiDrawArrays gl_trace_glMultiDrawArrays
+#define glReadPixels gl_trace_glReadPixels
+#define glRenderbufferStorage gl_trace_glRenderbufferStorage
+#define glShaderSource gl_trace_glShaderSource
+#define glTexImage2D gl_trace_glTexImage2D
+#define glTexParameteri gl_trace_glTexParameteri
+#define glUseProgram gl_trace_glUseProgram
+#define glVertexAttribPointer gl_trace_glVertexAttribPointer
+#define glViewport gl_trace_glViewport
+
+#endif
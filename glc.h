@@ -0,0 +1,70 @@
+#ifndef GLC_H
+#define GLC_H
+
+/*
+ * glc: a thin OpenGL context abstraction shaped after CGL.
+ *
+ * The call sequence mirrors the one the suite has always used
+ * (choose pixel format -> create context -> destroy pixel format ->
+ * make current -> destroy context) so that a test reads the same on
+ * every backend. Two backends exist:
+ *
+ *   glc_cgl.c  CGL, macOS
+ *   glc_egl.c  EGL on a surfaceless Mesa display (llvmpipe), headless Linux
+ *
+ * The Makefile picks one of them per platform.
+ */
+
+#ifdef __APPLE__
+#include <OpenGL/OpenGL.h>
+#include <OpenGL/gl3.h>
+#else
+#define GL_GLEXT_PROTOTYPES
+#include <GL/glcorearb.h>
+#endif
+
+/* The profile every test runs against unless it asks for something else. */
+#define GLC_CORE_PROFILE_MAJOR_VERSION 4
+#define GLC_CORE_PROFILE_MINOR_VERSION 1
+
+typedef enum glc_error {
+    GLC_NO_ERROR = 0,
+    GLC_BAD_ATTRIBUTE,
+    GLC_BAD_PIXEL_FORMAT,
+    GLC_BAD_CONTEXT,
+    GLC_BAD_DISPLAY,
+    GLC_BAD_MATCH,
+    GLC_BAD_ALLOC
+} glc_error;
+
+/* Zero terminated attribute list passed to glc_choose_pixel_format(). */
+typedef enum glc_attrib {
+    GLC_ATTRIB_END = 0,
+    GLC_ATTRIB_CORE_PROFILE,    /* GLC_CORE_PROFILE_*_VERSION core profile */
+    GLC_ATTRIB_DOUBLE_BUFFER,   /* ignored by surfaceless backends */
+    GLC_ATTRIB_ACCELERATED      /* no slow / software-caveat formats */
+} glc_attrib;
+
+typedef struct glc_pixel_format glc_pixel_format;
+typedef struct glc_context glc_context;
+
+glc_error glc_choose_pixel_format(const glc_attrib *attribs,
+                                  glc_pixel_format **pixel_format,
+                                  GLint *number_pixel_formats);
+glc_error glc_destroy_pixel_format(glc_pixel_format *pixel_format);
+
+/* share may be NULL; otherwise the new context shares objects with it. */
+glc_error glc_create_context(glc_pixel_format *pixel_format,
+                             glc_context *share,
+                             glc_context **context);
+/* Pass NULL to release the calling thread's current context. */
+glc_error glc_set_current_context(glc_context *context);
+glc_context *glc_get_current_context(void);
+glc_error glc_destroy_context(glc_context *context);
+
+/* Entry points beyond what the platform GL library exports directly. */
+void *glc_get_proc_address(const char *name);
+
+const char *glc_backend_name(void);
+
+#endif
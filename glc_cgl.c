@@ -0,0 +1,133 @@
+#include "glc.h"
+
+#include <dlfcn.h>
+#include <stdlib.h>
+
+struct glc_pixel_format {
+    CGLPixelFormatObj obj;
+};
+
+struct glc_context {
+    CGLContextObj obj;
+};
+
+static __thread glc_context *current_context;
+
+static glc_error from_cgl_error(CGLError err)
+{
+    switch (err) {
+    case kCGLNoError:          return GLC_NO_ERROR;
+    case kCGLBadAttribute:     return GLC_BAD_ATTRIBUTE;
+    case kCGLBadPixelFormat:   return GLC_BAD_PIXEL_FORMAT;
+    case kCGLBadContext:       return GLC_BAD_CONTEXT;
+    case kCGLBadDisplay:       return GLC_BAD_DISPLAY;
+    case kCGLBadMatch:         return GLC_BAD_MATCH;
+    case kCGLBadAlloc:         return GLC_BAD_ALLOC;
+    default:                   return GLC_BAD_ATTRIBUTE;
+    }
+}
+
+glc_error glc_choose_pixel_format(const glc_attrib *attribs,
+                                  glc_pixel_format **pixel_format,
+                                  GLint *number_pixel_formats)
+{
+    CGLPixelFormatAttribute cgl_attribs[16];
+    int n = 0;
+
+    for (; *attribs != GLC_ATTRIB_END; attribs++) {
+        if (n >= 14) {
+            return GLC_BAD_ATTRIBUTE;
+        }
+
+        switch (*attribs) {
+        case GLC_ATTRIB_CORE_PROFILE:
+            cgl_attribs[n++] = kCGLPFAOpenGLProfile;
+            cgl_attribs[n++] = (CGLPixelFormatAttribute) kCGLOGLPVersion_GL4_Core;
+            break;
+        case GLC_ATTRIB_DOUBLE_BUFFER:
+            cgl_attribs[n++] = kCGLPFADoubleBuffer;
+            break;
+        case GLC_ATTRIB_ACCELERATED:
+            cgl_attribs[n++] = kCGLPFAAccelerated;
+            break;
+        default:
+            return GLC_BAD_ATTRIBUTE;
+        }
+    }
+    cgl_attribs[n] = (CGLPixelFormatAttribute) 0;
+
+    glc_pixel_format *format = calloc(1, sizeof(*format));
+    if (format == NULL) {
+        return GLC_BAD_ALLOC;
+    }
+
+    CGLError err = CGLChoosePixelFormat(cgl_attribs, &format->obj, number_pixel_formats);
+    if (err != kCGLNoError) {
+        free(format);
+        return from_cgl_error(err);
+    }
+
+    *pixel_format = format;
+    return GLC_NO_ERROR;
+}
+
+glc_error glc_destroy_pixel_format(glc_pixel_format *pixel_format)
+{
+    CGLError err = CGLDestroyPixelFormat(pixel_format->obj);
+    free(pixel_format);
+    return from_cgl_error(err);
+}
+
+glc_error glc_create_context(glc_pixel_format *pixel_format,
+                             glc_context *share,
+                             glc_context **context)
+{
+    glc_context *ctx = calloc(1, sizeof(*ctx));
+    if (ctx == NULL) {
+        return GLC_BAD_ALLOC;
+    }
+
+    CGLError err = CGLCreateContext(pixel_format->obj, share ? share->obj : NULL, &ctx->obj);
+    if (err != kCGLNoError) {
+        free(ctx);
+        return from_cgl_error(err);
+    }
+
+    *context = ctx;
+    return GLC_NO_ERROR;
+}
+
+glc_error glc_set_current_context(glc_context *context)
+{
+    CGLError err = CGLSetCurrentContext(context ? context->obj : NULL);
+    if (err == kCGLNoError) {
+        current_context = context;
+    }
+    return from_cgl_error(err);
+}
+
+glc_context *glc_get_current_context(void)
+{
+    return current_context;
+}
+
+glc_error glc_destroy_context(glc_context *context)
+{
+    if (current_context == context) {
+        current_context = NULL;
+    }
+
+    CGLError err = CGLDestroyContext(context->obj);
+    free(context);
+    return from_cgl_error(err);
+}
+
+void *glc_get_proc_address(const char *name)
+{
+    return dlsym(RTLD_DEFAULT, name);
+}
+
+const char *glc_backend_name(void)
+{
+    return "cgl";
+}
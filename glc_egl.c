@@ -0,0 +1,222 @@
+#include "glc.h"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Contexts live on a surfaceless Mesa display, so no X server or GPU is
+ * needed: with no DRM device around Mesa falls back to llvmpipe. Every
+ * context is made current without a drawable, which means tests must
+ * render into FBOs (they all do).
+ */
+
+struct glc_pixel_format {
+    EGLConfig config;
+    int core_profile;
+};
+
+struct glc_context {
+    EGLContext obj;
+};
+
+static pthread_once_t display_once = PTHREAD_ONCE_INIT;
+static EGLDisplay display = EGL_NO_DISPLAY;
+
+static __thread glc_context *current_context;
+
+static int has_extension(const char *extensions, const char *name)
+{
+    size_t len = strlen(name);
+
+    while (extensions != NULL && (extensions = strstr(extensions, name)) != NULL) {
+        if (extensions[len] == ' ' || extensions[len] == '\0') {
+            return 1;
+        }
+        extensions += len;
+    }
+    return 0;
+}
+
+static void open_display(void)
+{
+    const char *client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    EGLDisplay dpy = EGL_NO_DISPLAY;
+
+    if (has_extension(client_extensions, "EGL_MESA_platform_surfaceless")) {
+        dpy = eglGetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    }
+    if (dpy == EGL_NO_DISPLAY) {
+        dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    if (dpy == EGL_NO_DISPLAY || !eglInitialize(dpy, NULL, NULL)) {
+        return;
+    }
+    if (!has_extension(eglQueryString(dpy, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context")) {
+        eglTerminate(dpy);
+        return;
+    }
+
+    display = dpy;
+}
+
+static glc_error from_egl_error(EGLint err)
+{
+    switch (err) {
+    case EGL_SUCCESS:           return GLC_NO_ERROR;
+    case EGL_BAD_ATTRIBUTE:     return GLC_BAD_ATTRIBUTE;
+    case EGL_BAD_CONFIG:        return GLC_BAD_PIXEL_FORMAT;
+    case EGL_BAD_CONTEXT:       return GLC_BAD_CONTEXT;
+    case EGL_NOT_INITIALIZED:
+    case EGL_BAD_DISPLAY:       return GLC_BAD_DISPLAY;
+    case EGL_BAD_MATCH:         return GLC_BAD_MATCH;
+    case EGL_BAD_ALLOC:         return GLC_BAD_ALLOC;
+    default:                    return GLC_BAD_ATTRIBUTE;
+    }
+}
+
+glc_error glc_choose_pixel_format(const glc_attrib *attribs,
+                                  glc_pixel_format **pixel_format,
+                                  GLint *number_pixel_formats)
+{
+    EGLint egl_attribs[16] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, 8
+    };
+    int n = 12;
+    int core_profile = 0;
+
+    pthread_once(&display_once, open_display);
+    if (display == EGL_NO_DISPLAY) {
+        return GLC_BAD_DISPLAY;
+    }
+
+    for (; *attribs != GLC_ATTRIB_END; attribs++) {
+        switch (*attribs) {
+        case GLC_ATTRIB_CORE_PROFILE:
+            core_profile = 1;
+            break;
+        case GLC_ATTRIB_DOUBLE_BUFFER:
+            /* Pbuffer configs have no back buffer to ask for. */
+            break;
+        case GLC_ATTRIB_ACCELERATED:
+            if (n + 2 >= 15) {
+                return GLC_BAD_ATTRIBUTE;
+            }
+            egl_attribs[n++] = EGL_CONFIG_CAVEAT;
+            egl_attribs[n++] = EGL_NONE;
+            break;
+        default:
+            return GLC_BAD_ATTRIBUTE;
+        }
+    }
+    egl_attribs[n] = EGL_NONE;
+
+    EGLConfig config;
+    EGLint count = 0;
+    if (!eglChooseConfig(display, egl_attribs, &config, 1, &count)) {
+        return from_egl_error(eglGetError());
+    }
+    if (count == 0) {
+        return GLC_BAD_PIXEL_FORMAT;
+    }
+
+    glc_pixel_format *format = calloc(1, sizeof(*format));
+    if (format == NULL) {
+        return GLC_BAD_ALLOC;
+    }
+    format->config = config;
+    format->core_profile = core_profile;
+
+    if (number_pixel_formats != NULL) {
+        *number_pixel_formats = count;
+    }
+    *pixel_format = format;
+    return GLC_NO_ERROR;
+}
+
+glc_error glc_destroy_pixel_format(glc_pixel_format *pixel_format)
+{
+    free(pixel_format);
+    return GLC_NO_ERROR;
+}
+
+glc_error glc_create_context(glc_pixel_format *pixel_format,
+                             glc_context *share,
+                             glc_context **context)
+{
+    EGLint core_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, GLC_CORE_PROFILE_MAJOR_VERSION,
+        EGL_CONTEXT_MINOR_VERSION, GLC_CORE_PROFILE_MINOR_VERSION,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLint default_attribs[] = { EGL_NONE };
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        return from_egl_error(eglGetError());
+    }
+
+    glc_context *ctx = calloc(1, sizeof(*ctx));
+    if (ctx == NULL) {
+        return GLC_BAD_ALLOC;
+    }
+
+    ctx->obj = eglCreateContext(display, pixel_format->config,
+                                share ? share->obj : EGL_NO_CONTEXT,
+                                pixel_format->core_profile ? core_attribs : default_attribs);
+    if (ctx->obj == EGL_NO_CONTEXT) {
+        free(ctx);
+        return from_egl_error(eglGetError());
+    }
+
+    *context = ctx;
+    return GLC_NO_ERROR;
+}
+
+glc_error glc_set_current_context(glc_context *context)
+{
+    if (display == EGL_NO_DISPLAY) {
+        return GLC_BAD_DISPLAY;
+    }
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                        context ? context->obj : EGL_NO_CONTEXT)) {
+        return from_egl_error(eglGetError());
+    }
+
+    current_context = context;
+    return GLC_NO_ERROR;
+}
+
+glc_context *glc_get_current_context(void)
+{
+    return current_context;
+}
+
+glc_error glc_destroy_context(glc_context *context)
+{
+    if (current_context == context) {
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        current_context = NULL;
+    }
+
+    EGLBoolean ok = eglDestroyContext(display, context->obj);
+    free(context);
+    return ok ? GLC_NO_ERROR : from_egl_error(eglGetError());
+}
+
+void *glc_get_proc_address(const char *name)
+{
+    return (void *) eglGetProcAddress(name);
+}
+
+const char *glc_backend_name(void)
+{
+    return "egl";
+}
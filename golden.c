@@ -0,0 +1,75 @@
+#include "golden.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static const char *env_or(const char *name, const char *fallback)
+{
+    const char *value = getenv(name);
+    return value != NULL && value[0] != '\0' ? value : fallback;
+}
+
+int golden_write_pam(const char *path, const uint8_t *pixels, int width, int height)
+{
+    FILE *file = fopen(path, "wb");
+    const size_t row_size = (size_t) width * 4;
+    int failed = 0;
+
+    if (file == NULL) {
+        return -1;
+    }
+    fprintf(file, "P7\nWIDTH %d\nHEIGHT %d\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n", width, height);
+    for (int y = height - 1; y >= 0 && !failed; y--) {
+        failed = fwrite(pixels + row_size * y, 1, row_size, file) != row_size;
+    }
+    failed |= fclose(file) != 0;
+
+    return failed ? -1 : 0;
+}
+
+static void write_failure_images(const char *name, const uint8_t *actual, const uint8_t *expected,
+                                 int width, int height, const uint8_t tolerance[4])
+{
+    const char *dir = env_or("GOLDEN_OUTPUT_DIR", ".");
+    const size_t pixel_count = (size_t) width * height;
+    uint8_t *diff = malloc(pixel_count * 4);
+    char path[1024];
+
+    snprintf(path, sizeof(path), "%s/%s.actual.pam", dir, name);
+    golden_write_pam(path, actual, width, height);
+
+    if (diff == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < pixel_count; i++) {
+        const uint8_t *a = actual + i * 4;
+        const uint8_t *e = expected + i * 4;
+        int bad = 0;
+
+        for (int c = 0; c < 4; c++) {
+            bad |= abs(a[c] - e[c]) > tolerance[c];
+        }
+        diff[i * 4 + 0] = bad ? 0xFF : a[0] / 4;
+        diff[i * 4 + 1] = bad ? 0x00 : a[1] / 4;
+        diff[i * 4 + 2] = bad ? 0x00 : a[2] / 4;
+        diff[i * 4 + 3] = 0xFF;
+    }
+
+    snprintf(path, sizeof(path), "%s/%s.diff.pam", dir, name);
+    golden_write_pam(path, diff, width, height);
+    free(diff);
+}
+
+uint64_t golden_check_expected_rgba8(const char *name, const uint8_t *pixels, const uint8_t *expected, int width,
+                                     int height, const uint8_t tolerance[4], struct image_compare_result *result)
+{
+    char path[1024];
+
+    image_compare_rgba8(pixels, expected, width, height, tolerance, result);
+    if (result->mismatches > 0) {
+        write_failure_images(name, pixels, expected, width, height, tolerance);
+        snprintf(path, sizeof(path), "%s/%s.expected.pam", env_or("GOLDEN_OUTPUT_DIR", "."), name);
+        golden_write_pam(path, expected, width, height);
+    }
+    return result->mismatches;
+}
@@ -0,0 +1,27 @@
+#ifndef GOLDEN_H
+#define GOLDEN_H
+
+#include <stdint.h>
+
+#include "image_compare.h"
+
+/*
+ * Golden frames: whole frames checked against an expected frame computed
+ * on the fly (reference_raster.h). Frames are passed in as glReadPixels
+ * returns them, bottom row first; images are written as RGBA PAM files
+ * (P7, top row first).
+ *
+ * When a frame does not match, <name>.actual.pam, <name>.expected.pam and
+ * <name>.diff.pam are written to GOLDEN_OUTPUT_DIR (default: the working
+ * directory). The diff image shows mismatching pixels in red over a
+ * darkened copy of the frame.
+ */
+
+/* Returns 0 on success, -1 on failure. */
+int golden_write_pam(const char *path, const uint8_t *pixels, int width, int height);
+
+/* Compares a frame with the expected one; returns the number of mismatching pixels. */
+uint64_t golden_check_expected_rgba8(const char *name, const uint8_t *pixels, const uint8_t *expected, int width,
+                                     int height, const uint8_t tolerance[4], struct image_compare_result *result);
+
+#endif
@@ -0,0 +1,191 @@
+#include "gpu_timer.h"
+
+#include <string.h>
+#include <time.h>
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+void gpu_timer_init(struct gpu_timer *timer)
+{
+    memset(timer, 0, sizeof(*timer));
+    timer->open_query = -1;
+
+    for (int f = 0; f <= GPU_TIMER_LATENCY; f++) {
+        struct gpu_timer_frame *frame = &timer->frames[f];
+
+        glGenQueries(1, &frame->timestamp);
+        for (int q = 0; q < GPU_TIMER_MAX_PHASES; q++) {
+            glGenQueries(1, &frame->queries[q].begin);
+            glGenQueries(1, &frame->queries[q].end);
+        }
+    }
+
+    // GL_TIMESTAMP read through glGetInteger64v is the GPU clock now, not when the GPU gets there
+    GLint64 gpu_now = 0;
+    uint64_t before = now_ns();
+    glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+    uint64_t after = now_ns();
+    timer->gpu_minus_cpu_ns = (int64_t) gpu_now - (int64_t) (before + (after - before) / 2);
+}
+
+void gpu_timer_destroy(struct gpu_timer *timer)
+{
+    for (int f = 0; f <= GPU_TIMER_LATENCY; f++) {
+        struct gpu_timer_frame *frame = &timer->frames[f];
+
+        glDeleteQueries(1, &frame->timestamp);
+        for (int q = 0; q < GPU_TIMER_MAX_PHASES; q++) {
+            glDeleteQueries(1, &frame->queries[q].begin);
+            glDeleteQueries(1, &frame->queries[q].end);
+        }
+    }
+    memset(timer, 0, sizeof(*timer));
+}
+
+static int phase_index(struct gpu_timer *timer, const char *name)
+{
+    for (int i = 0; i < timer->total_count; i++) {
+        if (strcmp(timer->totals[i].name, name) == 0) {
+            return i;
+        }
+    }
+    if (timer->total_count == GPU_TIMER_MAX_PHASES) {
+        return -1;
+    }
+    timer->totals[timer->total_count].name = name;
+    return timer->total_count++;
+}
+
+/* Reads a frame's results. Returns 0 without touching it if wait is 0 and they are not in yet. */
+static int collect(struct gpu_timer *timer, struct gpu_timer_frame *frame, int wait)
+{
+    GLint available = 0;
+    GLuint last = frame->query_count > 0 ? frame->queries[frame->query_count - 1].end : frame->timestamp;
+
+    if (!frame->in_flight) {
+        return 1;
+    }
+    // queries complete in order, so the frame's last one speaks for all of them
+    glGetQueryObjectiv(last, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available && !wait) {
+        return 0;
+    }
+
+    GLuint64 gpu_start = 0;
+    glGetQueryObjectui64v(frame->timestamp, GL_QUERY_RESULT, &gpu_start);
+    int64_t latency = (int64_t) gpu_start - timer->gpu_minus_cpu_ns - (int64_t) frame->cpu_start_ns;
+    timer->start_latency_ns += latency > 0 ? (uint64_t) latency : 0;
+
+    for (int q = 0; q < frame->query_count; q++) {
+        struct gpu_timer_total *total = &timer->totals[frame->queries[q].phase];
+        GLuint64 begin = 0, end = 0;
+
+        glGetQueryObjectui64v(frame->queries[q].begin, GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(frame->queries[q].end, GL_QUERY_RESULT, &end);
+        const uint64_t gpu_ns = end > begin ? end - begin : 0;
+        total->gpu_ns += gpu_ns;
+        total->cpu_ns += frame->queries[q].cpu_ns;
+        total->samples++;
+        if (timer->collected != NULL) {
+            timer->collected(timer->collected_data, frame->tag, total->name, gpu_ns, frame->queries[q].cpu_ns);
+        }
+    }
+
+    frame->in_flight = 0;
+    frame->query_count = 0;
+    timer->frames_collected++;
+    return 1;
+}
+
+void gpu_timer_begin_frame(struct gpu_timer *timer)
+{
+    // pick up whatever has landed, oldest first, without waiting
+    for (int age = GPU_TIMER_LATENCY + 1; age >= 1; age--) {
+        int f = (timer->current + GPU_TIMER_LATENCY + 1 - age) % (GPU_TIMER_LATENCY + 1);
+        if (!collect(timer, &timer->frames[f], 0)) {
+            break;
+        }
+    }
+
+    struct gpu_timer_frame *frame = &timer->frames[timer->current];
+    if (frame->in_flight) {
+        timer->stalls++;
+        collect(timer, frame, 1);
+    }
+
+    frame->in_flight = 1;
+    frame->query_count = 0;
+    frame->tag = 0;
+    frame->cpu_start_ns = now_ns();
+    glQueryCounter(frame->timestamp, GL_TIMESTAMP);
+}
+
+void gpu_timer_end_frame(struct gpu_timer *timer)
+{
+    if (timer->open_query >= 0) {
+        gpu_timer_end(timer);
+    }
+    timer->current = (timer->current + 1) % (GPU_TIMER_LATENCY + 1);
+}
+
+void gpu_timer_set_frame_tag(struct gpu_timer *timer, int tag)
+{
+    timer->frames[timer->current].tag = tag;
+}
+
+void gpu_timer_begin(struct gpu_timer *timer, const char *name)
+{
+    struct gpu_timer_frame *frame = &timer->frames[timer->current];
+    int phase = phase_index(timer, name);
+
+    if (timer->open_query >= 0 || phase < 0 || frame->query_count == GPU_TIMER_MAX_PHASES) {
+        return;
+    }
+
+    struct gpu_timer_query *query = &frame->queries[frame->query_count];
+    query->phase = phase;
+    timer->open_query = frame->query_count++;
+    timer->open_cpu_start_ns = now_ns();
+    glQueryCounter(query->begin, GL_TIMESTAMP);
+}
+
+void gpu_timer_end(struct gpu_timer *timer)
+{
+    if (timer->open_query < 0) {
+        return;
+    }
+    struct gpu_timer_query *query = &timer->frames[timer->current].queries[timer->open_query];
+    glQueryCounter(query->end, GL_TIMESTAMP);
+    query->cpu_ns = now_ns() - timer->open_cpu_start_ns;
+    timer->open_query = -1;
+}
+
+void gpu_timer_collect_all(struct gpu_timer *timer)
+{
+    for (int age = GPU_TIMER_LATENCY + 1; age >= 1; age--) {
+        int f = (timer->current + GPU_TIMER_LATENCY + 1 - age) % (GPU_TIMER_LATENCY + 1);
+        collect(timer, &timer->frames[f], 1);
+    }
+}
+
+void gpu_timer_report(const struct gpu_timer *timer, FILE *out, const char *label)
+{
+    fprintf(out, "%s: %llu frame(s), GPU starts %.3f ms after the CPU, %llu stall(s)\n", label,
+            (unsigned long long) timer->frames_collected,
+            timer->frames_collected ? timer->start_latency_ns / 1e6 / timer->frames_collected : 0.0,
+            (unsigned long long) timer->stalls);
+    fprintf(out, "  %-12s %12s %12s %8s\n", "phase", "cpu ms/frame", "gpu ms/frame", "bound");
+
+    for (int i = 0; i < timer->total_count; i++) {
+        const struct gpu_timer_total *total = &timer->totals[i];
+        double n = total->samples ? (double) total->samples : 1.0;
+
+        fprintf(out, "  %-12s %12.3f %12.3f %8s\n", total->name, total->cpu_ns / 1e6 / n, total->gpu_ns / 1e6 / n,
+                total->gpu_ns > total->cpu_ns ? "gpu" : "cpu");
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "glc.h"
+
+/*
+ * Per-phase GPU and CPU time. gpu_timer_begin() and gpu_timer_end() each
+ * drop a GL_TIMESTAMP query and read a CPU clock; a timer's phases do not
+ * nest, but unlike GL_TIME_ELAPSED, of which only one may be running,
+ * timestamps let phases of different timers overlap, e.g. a test's own
+ * inside the test fixture's.
+ * Each frame also drops a GL_TIMESTAMP, which together with the GPU/CPU
+ * clock offset taken at init tells how long the GPU took to start on
+ * the frame after the CPU did.
+ *
+ * Results are read lazily: a frame's queries are only looked at
+ * GPU_TIMER_LATENCY frames later, and only if the GPU says they are
+ * available, so timing never stalls the pipeline. Only when every slot
+ * is still in flight does begin_frame wait, and it counts that as a stall.
+ * A frame can carry a tag, and a collected callback is told each phase's
+ * times with the tag of the frame they were taken in, for results that
+ * belong to something which is over by the time they land.
+ */
+
+#define GPU_TIMER_MAX_PHASES 16
+#define GPU_TIMER_LATENCY 3
+
+struct gpu_timer_query {
+    int phase;          /* index into totals */
+    GLuint begin;
+    GLuint end;
+    uint64_t cpu_ns;
+};
+
+struct gpu_timer_frame {
+    struct gpu_timer_query queries[GPU_TIMER_MAX_PHASES];
+    int query_count;
+    int tag;
+    GLuint timestamp;
+    uint64_t cpu_start_ns;
+    int in_flight;
+};
+
+struct gpu_timer_total {
+    const char *name;
+    uint64_t gpu_ns;
+    uint64_t cpu_ns;
+    uint64_t samples;
+};
+
+typedef void (*gpu_timer_collected_fn)(void *data, int tag, const char *phase, uint64_t gpu_ns, uint64_t cpu_ns);
+
+struct gpu_timer {
+    struct gpu_timer_frame frames[GPU_TIMER_LATENCY + 1];
+    int current;
+    int open_query;     /* index in the current frame, -1 if no phase is open */
+    uint64_t open_cpu_start_ns;
+    struct gpu_timer_total totals[GPU_TIMER_MAX_PHASES];
+    int total_count;
+    int64_t gpu_minus_cpu_ns;
+    uint64_t start_latency_ns;  /* CPU frame start to GPU frame start, summed */
+    uint64_t frames_collected;
+    uint64_t stalls;
+    gpu_timer_collected_fn collected;   /* NULL, or called per phase as it is collected */
+    void *collected_data;
+};
+
+void gpu_timer_init(struct gpu_timer *timer);
+void gpu_timer_destroy(struct gpu_timer *timer);
+
+void gpu_timer_begin_frame(struct gpu_timer *timer);
+void gpu_timer_end_frame(struct gpu_timer *timer);
+
+/* Tags the current frame; begin_frame starts every frame at 0. */
+void gpu_timer_set_frame_tag(struct gpu_timer *timer, int tag);
+
+/* name must outlive the timer; phases with the same name add up. */
+void gpu_timer_begin(struct gpu_timer *timer, const char *name);
+void gpu_timer_end(struct gpu_timer *timer);
+
+/* Waits for and collects every frame still in flight. */
+void gpu_timer_collect_all(struct gpu_timer *timer);
+
+/* Per-phase totals and averages; collect_all first for complete numbers. */
+void gpu_timer_report(const struct gpu_timer *timer, FILE *out, const char *label);
+
+#endif
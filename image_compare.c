@@ -0,0 +1,264 @@
+#include "image_compare.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+/* Mismatches found in one row, in pixels. */
+struct row_stats {
+    int first;
+    int last;
+    uint64_t count;
+    int max_difference;
+};
+
+static void row_stats_reset(struct row_stats *row)
+{
+    row->first = -1;
+    row->last = -1;
+    row->count = 0;
+}
+
+static void row_stats_add_mask(struct row_stats *row, int x, unsigned bad_mask)
+{
+    if (bad_mask == 0) {
+        return;
+    }
+    if (row->first < 0) {
+        row->first = x + __builtin_ctz(bad_mask);
+    }
+    row->last = x + 31 - __builtin_clz(bad_mask);
+    row->count += (uint64_t) __builtin_popcount(bad_mask);
+}
+
+static void compare_pixels_scalar(const uint8_t *actual, const uint8_t *expected, int x0, int x1,
+                                  const uint8_t tolerance[4], struct row_stats *row)
+{
+    for (int x = x0; x < x1; x++) {
+        int bad = 0;
+
+        for (int c = 0; c < 4; c++) {
+            int d = abs(actual[x * 4 + c] - expected[x * 4 + c]);
+
+            if (d > row->max_difference) {
+                row->max_difference = d;
+            }
+            bad |= d > tolerance[c];
+        }
+        row_stats_add_mask(row, x, (unsigned) bad);
+    }
+}
+
+static void add_row(struct image_compare_result *result, int y, const struct row_stats *row)
+{
+    if (row->max_difference > result->max_channel_difference) {
+        result->max_channel_difference = row->max_difference;
+    }
+    if (row->count == 0) {
+        return;
+    }
+
+    result->mismatches += row->count;
+    if (result->min_y < 0) {
+        result->min_y = y;
+    }
+    result->max_y = y;
+    if (result->min_x < 0 || row->first < result->min_x) {
+        result->min_x = row->first;
+    }
+    if (row->last > result->max_x) {
+        result->max_x = row->last;
+    }
+}
+
+static void compare_scalar(const uint8_t *actual, const uint8_t *expected, int width, int height,
+                           const uint8_t tolerance[4], struct image_compare_result *result)
+{
+    struct row_stats row = { -1, -1, 0, 0 };
+
+    for (int y = 0; y < height; y++) {
+        const size_t offset = (size_t) y * width * 4;
+
+        row_stats_reset(&row);
+        compare_pixels_scalar(actual + offset, expected + offset, 0, width, tolerance, &row);
+        add_row(result, y, &row);
+    }
+}
+
+#ifdef HAVE_X86_KERNELS
+
+static int max_byte(const uint8_t *bytes, int count)
+{
+    int m = 0;
+
+    for (int i = 0; i < count; i++) {
+        if (bytes[i] > m) {
+            m = bytes[i];
+        }
+    }
+    return m;
+}
+
+__attribute__((target("sse2")))
+static void compare_sse2(const uint8_t *actual, const uint8_t *expected, int width, int height,
+                         const uint8_t tolerance[4], struct image_compare_result *result)
+{
+    int32_t tolerance_pixel;
+    memcpy(&tolerance_pixel, tolerance, 4);
+
+    const __m128i tol = _mm_set1_epi32(tolerance_pixel);
+    const __m128i zero = _mm_setzero_si128();
+    struct row_stats row = { -1, -1, 0, 0 };
+    __m128i max_difference = zero;
+
+    for (int y = 0; y < height; y++) {
+        const uint8_t *a = actual + (size_t) y * width * 4;
+        const uint8_t *e = expected + (size_t) y * width * 4;
+        int x = 0;
+
+        row_stats_reset(&row);
+
+        for (; x + 4 <= width; x += 4) {
+            __m128i va = _mm_loadu_si128((const __m128i *) (a + x * 4));
+            __m128i ve = _mm_loadu_si128((const __m128i *) (e + x * 4));
+            __m128i diff = _mm_or_si128(_mm_subs_epu8(va, ve), _mm_subs_epu8(ve, va));
+            // a channel is over tolerance where diff - tolerance does not saturate to 0
+            __m128i pixel_ok = _mm_cmpeq_epi32(_mm_subs_epu8(diff, tol), zero);
+
+            max_difference = _mm_max_epu8(max_difference, diff);
+            row_stats_add_mask(&row, x, ~(unsigned) _mm_movemask_ps(_mm_castsi128_ps(pixel_ok)) & 0xFu);
+        }
+        compare_pixels_scalar(a, e, x, width, tolerance, &row);
+        add_row(result, y, &row);
+    }
+
+    uint8_t bytes[16];
+    _mm_storeu_si128((__m128i *) bytes, max_difference);
+    if (max_byte(bytes, 16) > result->max_channel_difference) {
+        result->max_channel_difference = max_byte(bytes, 16);
+    }
+}
+
+__attribute__((target("avx2")))
+static void compare_avx2(const uint8_t *actual, const uint8_t *expected, int width, int height,
+                         const uint8_t tolerance[4], struct image_compare_result *result)
+{
+    int32_t tolerance_pixel;
+    memcpy(&tolerance_pixel, tolerance, 4);
+
+    const __m256i tol = _mm256_set1_epi32(tolerance_pixel);
+    const __m256i zero = _mm256_setzero_si256();
+    struct row_stats row = { -1, -1, 0, 0 };
+    __m256i max_difference = zero;
+
+    for (int y = 0; y < height; y++) {
+        const uint8_t *a = actual + (size_t) y * width * 4;
+        const uint8_t *e = expected + (size_t) y * width * 4;
+        int x = 0;
+
+        row_stats_reset(&row);
+
+        for (; x + 8 <= width; x += 8) {
+            __m256i va = _mm256_loadu_si256((const __m256i *) (a + x * 4));
+            __m256i ve = _mm256_loadu_si256((const __m256i *) (e + x * 4));
+            __m256i diff = _mm256_or_si256(_mm256_subs_epu8(va, ve), _mm256_subs_epu8(ve, va));
+            __m256i pixel_ok = _mm256_cmpeq_epi32(_mm256_subs_epu8(diff, tol), zero);
+
+            max_difference = _mm256_max_epu8(max_difference, diff);
+            row_stats_add_mask(&row, x, ~(unsigned) _mm256_movemask_ps(_mm256_castsi256_ps(pixel_ok)) & 0xFFu);
+        }
+        compare_pixels_scalar(a, e, x, width, tolerance, &row);
+        add_row(result, y, &row);
+    }
+
+    uint8_t bytes[32];
+    _mm256_storeu_si256((__m256i *) bytes, max_difference);
+    if (max_byte(bytes, 32) > result->max_channel_difference) {
+        result->max_channel_difference = max_byte(bytes, 32);
+    }
+}
+
+#endif
+
+int image_compare_kernel_supported(enum image_compare_kernel kernel)
+{
+    switch (kernel) {
+    case IMAGE_COMPARE_AUTO:
+    case IMAGE_COMPARE_SCALAR:
+        return 1;
+#ifdef HAVE_X86_KERNELS
+    case IMAGE_COMPARE_SSE2:
+        return __builtin_cpu_supports("sse2");
+    case IMAGE_COMPARE_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return 0;
+    }
+}
+
+const char *image_compare_kernel_name(enum image_compare_kernel kernel)
+{
+    switch (kernel) {
+    case IMAGE_COMPARE_AUTO:    return "auto";
+    case IMAGE_COMPARE_SCALAR:  return "scalar";
+    case IMAGE_COMPARE_SSE2:    return "sse2";
+    case IMAGE_COMPARE_AVX2:    return "avx2";
+    default:                    return "unknown";
+    }
+}
+
+static enum image_compare_kernel best_kernel(void)
+{
+    if (image_compare_kernel_supported(IMAGE_COMPARE_AVX2)) {
+        return IMAGE_COMPARE_AVX2;
+    }
+    if (image_compare_kernel_supported(IMAGE_COMPARE_SSE2)) {
+        return IMAGE_COMPARE_SSE2;
+    }
+    return IMAGE_COMPARE_SCALAR;
+}
+
+int image_compare_rgba8_with(enum image_compare_kernel kernel,
+                             const uint8_t *actual, const uint8_t *expected,
+                             int width, int height, const uint8_t tolerance[4],
+                             struct image_compare_result *result)
+{
+    if (kernel == IMAGE_COMPARE_AUTO) {
+        kernel = best_kernel();
+    }
+    if (!image_compare_kernel_supported(kernel)) {
+        return -1;
+    }
+
+    result->mismatches = 0;
+    result->max_channel_difference = 0;
+    result->min_x = result->min_y = result->max_x = result->max_y = -1;
+
+    switch (kernel) {
+#ifdef HAVE_X86_KERNELS
+    case IMAGE_COMPARE_SSE2:
+        compare_sse2(actual, expected, width, height, tolerance, result);
+        break;
+    case IMAGE_COMPARE_AVX2:
+        compare_avx2(actual, expected, width, height, tolerance, result);
+        break;
+#endif
+    default:
+        compare_scalar(actual, expected, width, height, tolerance, result);
+        break;
+    }
+    return 0;
+}
+
+uint64_t image_compare_rgba8(const uint8_t *actual, const uint8_t *expected,
+                             int width, int height, const uint8_t tolerance[4],
+                             struct image_compare_result *result)
+{
+    image_compare_rgba8_with(IMAGE_COMPARE_AUTO, actual, expected, width, height, tolerance, result);
+    return result->mismatches;
+}
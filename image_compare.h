@@ -0,0 +1,46 @@
+#ifndef IMAGE_COMPARE_H
+#define IMAGE_COMPARE_H
+
+#include <stdint.h>
+
+/*
+ * Full-frame comparison of tightly packed RGBA8 images.
+ *
+ * A pixel mismatches when any channel differs from the expected one by
+ * more than that channel's tolerance. The kernel runs 8 pixels per step
+ * with AVX2, 4 with SSE2, and falls back to plain C elsewhere; the best
+ * one the CPU supports is picked at run time.
+ */
+
+enum image_compare_kernel {
+    IMAGE_COMPARE_AUTO = 0,
+    IMAGE_COMPARE_SCALAR,
+    IMAGE_COMPARE_SSE2,
+    IMAGE_COMPARE_AVX2
+};
+
+struct image_compare_result {
+    uint64_t mismatches;
+    int max_channel_difference;
+    /* Bounding box of the mismatching pixels, inclusive. All -1 if none. */
+    int min_x;
+    int min_y;
+    int max_x;
+    int max_y;
+};
+
+int image_compare_kernel_supported(enum image_compare_kernel kernel);
+const char *image_compare_kernel_name(enum image_compare_kernel kernel);
+
+/* Returns the number of mismatching pixels. */
+uint64_t image_compare_rgba8(const uint8_t *actual, const uint8_t *expected,
+                             int width, int height, const uint8_t tolerance[4],
+                             struct image_compare_result *result);
+
+/* Same, on a specific kernel. Returns -1 if the CPU cannot run it, 0 otherwise. */
+int image_compare_rgba8_with(enum image_compare_kernel kernel,
+                             const uint8_t *actual, const uint8_t *expected,
+                             int width, int height, const uint8_t tolerance[4],
+                             struct image_compare_result *result);
+
+#endif
@@ -9,5 +9,10 @@ pushd check-0.11.0
 autoreconf --install
 ./configure
 make
-make install
+if [ "$(uname -s)" = "Linux" ]; then
+    sudo make install
+    sudo ldconfig
+else
+    make install
+fi
 popd
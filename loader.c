@@ -0,0 +1,196 @@
+#include "loader.h"
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#include "draw_pipeline.h"
+
+static void delete_object(struct loader_request *request)
+{
+    if (request->kind == LOADER_BUFFER) {
+        glDeleteBuffers(1, &request->name);
+    } else if (request->kind == LOADER_TEXTURE) {
+        glDeleteTextures(1, &request->name);
+    } else {
+        glDeleteProgram(request->name);
+    }
+    request->name = 0;
+}
+
+void loader_run(struct loader_request *request)
+{
+    request->name = 0;
+    request->fence = NULL;
+    request->failed = 0;
+
+    if (request->kind == LOADER_BUFFER) {
+        glGenBuffers(1, &request->name);
+        // the copy target, so no binding the caller may care about moves
+        glBindBuffer(GL_COPY_WRITE_BUFFER, request->name);
+        glBufferData(GL_COPY_WRITE_BUFFER, request->size, request->data, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    } else if (request->kind == LOADER_PROGRAM) {
+        request->name = draw_pipeline_compile_program(request->vs_source, request->fs_source);
+        request->failed = request->name == 0;
+    } else {
+        glGenTextures(1, &request->name);
+        glBindTexture(GL_TEXTURE_2D, request->name);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        texture_upload_allocate(request->name, request->format, request->width, request->height);
+        texture_upload(TEXTURE_UPLOAD_TEX_SUB_IMAGE, NULL, request->name, request->format, request->width,
+                       request->height, request->data);
+    }
+
+    if (glGetError() != GL_NO_ERROR) {
+        delete_object(request);
+        request->failed = 1;
+    }
+    request->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    // another context will wait on the fence, which it can only do once it has been flushed
+    glFlush();
+}
+
+static void *worker_main(void *argument)
+{
+    struct loader_worker *worker = argument;
+    struct loader *loader = worker->loader;
+
+    glc_set_current_context(worker->context);
+
+    pthread_mutex_lock(&loader->lock);
+    for (;;) {
+        while (!loader->stop && loader->queue_count == 0) {
+            pthread_cond_wait(&loader->submitted, &loader->lock);
+        }
+        if (loader->stop) {
+            break;
+        }
+        struct loader_request *request = loader->queue[loader->queue_head];
+        loader->queue_head = (loader->queue_head + 1) % LOADER_MAX_PENDING;
+        loader->queue_count--;
+        pthread_mutex_unlock(&loader->lock);
+
+        loader_run(request);
+        request->worker = worker->index;
+
+        pthread_mutex_lock(&loader->lock);
+        loader->done[(loader->done_head + loader->done_count) % LOADER_MAX_PENDING] = request;
+        loader->done_count++;
+        pthread_cond_signal(&loader->finished);
+    }
+    pthread_mutex_unlock(&loader->lock);
+
+    glc_set_current_context(NULL);
+    return NULL;
+}
+
+int loader_init(struct loader *loader, glc_pixel_format *pixel_format, glc_context *render_context,
+                int worker_count)
+{
+    memset(loader, 0, sizeof(*loader));
+
+    if (worker_count < 1 || worker_count > LOADER_MAX_WORKERS) {
+        return -1;
+    }
+
+    pthread_mutex_init(&loader->lock, NULL);
+    pthread_cond_init(&loader->submitted, NULL);
+    pthread_cond_init(&loader->finished, NULL);
+
+    for (int i = 0; i < worker_count; i++) {
+        struct loader_worker *worker = &loader->workers[i];
+
+        worker->loader = loader;
+        worker->index = i;
+        if (glc_create_context(pixel_format, render_context, &worker->context) != GLC_NO_ERROR) {
+            loader_destroy(loader);
+            return -1;
+        }
+        if (pthread_create(&worker->thread, NULL, worker_main, worker) != 0) {
+            glc_destroy_context(worker->context);
+            loader_destroy(loader);
+            return -1;
+        }
+        loader->worker_count++;
+    }
+    return 0;
+}
+
+void loader_destroy(struct loader *loader)
+{
+    pthread_mutex_lock(&loader->lock);
+    loader->stop = 1;
+    pthread_cond_broadcast(&loader->submitted);
+    pthread_mutex_unlock(&loader->lock);
+
+    for (int i = 0; i < loader->worker_count; i++) {
+        pthread_join(loader->workers[i].thread, NULL);
+        glc_destroy_context(loader->workers[i].context);
+    }
+
+    for (int i = 0; i < loader->done_count; i++) {
+        struct loader_request *request = loader->done[(loader->done_head + i) % LOADER_MAX_PENDING];
+
+        glDeleteSync(request->fence);
+        delete_object(request);
+        request->fence = NULL;
+    }
+
+    pthread_cond_destroy(&loader->finished);
+    pthread_cond_destroy(&loader->submitted);
+    pthread_mutex_destroy(&loader->lock);
+    memset(loader, 0, sizeof(*loader));
+}
+
+int loader_submit(struct loader *loader, struct loader_request *request)
+{
+    pthread_mutex_lock(&loader->lock);
+    if (loader->in_flight == LOADER_MAX_PENDING) {
+        pthread_mutex_unlock(&loader->lock);
+        return -1;
+    }
+    loader->queue[(loader->queue_head + loader->queue_count) % LOADER_MAX_PENDING] = request;
+    loader->queue_count++;
+    loader->in_flight++;
+    pthread_cond_signal(&loader->submitted);
+    pthread_mutex_unlock(&loader->lock);
+    return 0;
+}
+
+struct loader_request *loader_collect(struct loader *loader, uint64_t timeout_ns)
+{
+    struct loader_request *request = NULL;
+    struct timespec deadline;
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += (time_t) (timeout_ns / 1000000000u);
+    deadline.tv_nsec += (long) (timeout_ns % 1000000000u);
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&loader->lock);
+    while (loader->done_count == 0 && timeout_ns > 0) {
+        if (pthread_cond_timedwait(&loader->finished, &loader->lock, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    if (loader->done_count > 0) {
+        request = loader->done[loader->done_head];
+        loader->done_head = (loader->done_head + 1) % LOADER_MAX_PENDING;
+        loader->done_count--;
+        loader->in_flight--;
+    }
+    pthread_mutex_unlock(&loader->lock);
+
+    if (request != NULL) {
+        // the GPU waits; the render thread goes on recording
+        glWaitSync(request->fence, 0, GL_TIMEOUT_IGNORED);
+        glDeleteSync(request->fence);
+        request->fence = NULL;
+    }
+    return request;
+}
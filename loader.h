@@ -0,0 +1,108 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "glc.h"
+#include "texture_upload.h"
+
+/*
+ * Asset loading off the render thread. loader_init() gives each of K
+ * worker threads a context of its own that shares objects with the render
+ * context. A worker takes submitted requests, creates and fills the
+ * buffer or texture (or compiles and links the program) on its context,
+ * and drops a fence behind the work;
+ * the render thread picks finished requests up with loader_collect(),
+ * which makes its context wait for the fence on the GPU (glWaitSync)
+ * rather than on the CPU. The object is usable by the render context's
+ * commands from then on, and belongs to the caller.
+ *
+ * Only buffers, textures and programs are shared between contexts; vertex
+ * arrays and framebuffers that use them have to be made on the render
+ * context.
+ *
+ * Requests are the caller's memory and must stay put from submit until
+ * they come back from collect; data must too. Submit and collect are
+ * meant for one thread, the render thread.
+ */
+
+#define LOADER_MAX_WORKERS 16
+#define LOADER_MAX_PENDING 256
+
+enum loader_kind {
+    LOADER_BUFFER,
+    LOADER_TEXTURE,
+    LOADER_PROGRAM
+};
+
+struct loader_request {
+    enum loader_kind kind;
+    const void *data;
+    GLsizeiptr size;                                /* LOADER_BUFFER */
+    const struct texture_upload_format *format;     /* LOADER_TEXTURE */
+    GLsizei width;
+    GLsizei height;
+    const char *vs_source;                          /* LOADER_PROGRAM, data unused */
+    const char *fs_source;
+
+    /* Filled in by the worker. */
+    GLuint name;
+    GLsync fence;
+    int worker;
+    int failed;     /* the object could not be created, or the program did not link; name is 0 */
+};
+
+struct loader_worker {
+    struct loader *loader;
+    int index;
+    glc_context *context;
+    pthread_t thread;
+};
+
+struct loader {
+    struct loader_worker workers[LOADER_MAX_WORKERS];
+    int worker_count;
+
+    pthread_mutex_t lock;
+    pthread_cond_t submitted;       /* a request was queued, or stop was set */
+    pthread_cond_t finished;        /* a request is done */
+    struct loader_request *queue[LOADER_MAX_PENDING];
+    int queue_head;                 /* oldest queued */
+    int queue_count;
+    struct loader_request *done[LOADER_MAX_PENDING];
+    int done_head;
+    int done_count;
+    int in_flight;                  /* submitted and not yet collected */
+    int stop;
+};
+
+/*
+ * Starts worker_count workers whose contexts are made from pixel_format
+ * and share with render_context. Returns 0 on success, -1 on failure, with
+ * nothing left running.
+ */
+int loader_init(struct loader *loader, glc_pixel_format *pixel_format, glc_context *render_context,
+                int worker_count);
+
+/*
+ * Stops the workers once they are through the requests they are on; the
+ * ones still queued are dropped. Call with the render context current:
+ * objects of finished requests nobody collected are deleted.
+ */
+void loader_destroy(struct loader *loader);
+
+/* Queues request. Returns 0, or -1 if LOADER_MAX_PENDING requests are in flight. */
+int loader_submit(struct loader *loader, struct loader_request *request);
+
+/*
+ * Hands back a finished request, its fence already waited on by the
+ * current context. Waits at most timeout_ns for one; 0 only polls.
+ * Returns NULL if none finished in time.
+ */
+struct loader_request *loader_collect(struct loader *loader, uint64_t timeout_ns);
+
+/* Does request on the calling thread's current context, as a worker would. */
+void loader_run(struct loader_request *request);
+
+#endif
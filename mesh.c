@@ -0,0 +1,267 @@
+#include "mesh.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+int mesh_create_grid(struct mesh *mesh, uint64_t triangles)
+{
+    const uint64_t patch_triangles = 2 * MESH_PATCH_QUADS * MESH_PATCH_QUADS;
+
+    memset(mesh, 0, sizeof(*mesh));
+    if (triangles >= patch_triangles) {
+        mesh->columns = mesh->rows = MESH_PATCH_QUADS;
+        mesh->patch_count = (int) ((triangles + patch_triangles / 2) / patch_triangles);
+    } else {
+        mesh->rows = (int) sqrt(triangles / 2.0);
+        mesh->rows = mesh->rows > 0 ? mesh->rows : 1;
+        mesh->columns = (int) (triangles / 2 / mesh->rows);
+        mesh->columns = mesh->columns > 0 ? mesh->columns : 1;
+        mesh->patch_count = 1;
+    }
+    mesh->patches_per_row = (int) ceil(sqrt(mesh->patch_count));
+    mesh->patch_vertex_count = (uint32_t) (mesh->columns + 1) * (mesh->rows + 1);
+    mesh->patch_index_count = (uint32_t) mesh->columns * mesh->rows * 6;
+
+    mesh->patch_vertices = malloc(mesh->patch_vertex_count * 2 * sizeof(float));
+    mesh->patch_indices = malloc(mesh->patch_index_count * sizeof(uint32_t));
+    if (mesh->patch_vertices == NULL || mesh->patch_indices == NULL) {
+        mesh_destroy(mesh);
+        return -1;
+    }
+
+    for (int y = 0; y <= mesh->rows; y++) {
+        for (int x = 0; x <= mesh->columns; x++) {
+            float *v = mesh->patch_vertices + 2 * (y * (mesh->columns + 1) + x);
+
+            v[0] = (float) x / mesh->columns;
+            v[1] = (float) y / mesh->rows;
+        }
+    }
+
+    uint32_t *index = mesh->patch_indices;
+    for (int y = 0; y < mesh->rows; y++) {
+        for (int x = 0; x < mesh->columns; x++) {
+            uint32_t bottom_left = y * (mesh->columns + 1) + x;
+            uint32_t top_left = bottom_left + mesh->columns + 1;
+
+            *index++ = bottom_left;
+            *index++ = bottom_left + 1;
+            *index++ = top_left;
+            *index++ = top_left;
+            *index++ = bottom_left + 1;
+            *index++ = top_left + 1;
+        }
+    }
+    return 0;
+}
+
+void mesh_destroy(struct mesh *mesh)
+{
+    free(mesh->patch_vertices);
+    free(mesh->patch_indices);
+    memset(mesh, 0, sizeof(*mesh));
+}
+
+uint64_t mesh_triangle_count(const struct mesh *mesh)
+{
+    return (uint64_t) mesh->patch_count * (mesh->patch_index_count / 3);
+}
+
+void mesh_place_patch(const struct mesh *mesh, int patch, float *vertices)
+{
+    float cell = 2.0f / mesh->patches_per_row;
+    float left = -1.0f + (patch % mesh->patches_per_row) * cell;
+    float bottom = -1.0f + (patch / mesh->patches_per_row) * cell;
+
+    for (uint32_t i = 0; i < mesh->patch_vertex_count; i++) {
+        vertices[2 * i] = left + mesh->patch_vertices[2 * i] * cell;
+        vertices[2 * i + 1] = bottom + mesh->patch_vertices[2 * i + 1] * cell;
+    }
+}
+
+static uint32_t next_random(uint32_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+void mesh_shuffle_triangles(uint32_t *indices, uint32_t index_count, uint32_t seed)
+{
+    uint32_t state = seed ? seed : 1;
+
+    for (uint32_t i = index_count / 3; i > 1; i--) {
+        uint32_t j = next_random(&state) % i;
+        uint32_t t[3];
+
+        memcpy(t, indices + 3 * (i - 1), sizeof(t));
+        memcpy(indices + 3 * (i - 1), indices + 3 * j, sizeof(t));
+        memcpy(indices + 3 * j, t, sizeof(t));
+    }
+}
+
+/* Forsyth's scoring: recently used vertices and vertices with few triangles left score high. */
+static float vertex_score(int cache_position, uint32_t remaining)
+{
+    float score = 0.0f;
+
+    if (remaining == 0) {
+        return -1.0f;
+    }
+    if (cache_position >= 0) {
+        // the last triangle's vertices score the same, whatever order they went in
+        score = cache_position < 3 ? 0.75f
+                                   : powf(1.0f - (cache_position - 3) / (float) (MESH_CACHE_SIZE - 3), 1.5f);
+    }
+    return score + 2.0f / sqrtf((float) remaining);
+}
+
+int mesh_optimize_vertex_cache(uint32_t *indices, uint32_t index_count, uint32_t vertex_count)
+{
+    uint32_t triangle_count = index_count / 3;
+    uint32_t *remaining = calloc(vertex_count, sizeof(uint32_t));
+    uint32_t *first = malloc((vertex_count + 1) * sizeof(uint32_t));
+    uint32_t *adjacency = malloc(index_count * sizeof(uint32_t));
+    int *cache_position = malloc(vertex_count * sizeof(int));
+    float *vertex_scores = malloc(vertex_count * sizeof(float));
+    float *triangle_scores = malloc(triangle_count * sizeof(float));
+    unsigned char *emitted = calloc(triangle_count, 1);
+    uint32_t *output = malloc(index_count * sizeof(uint32_t));
+    uint32_t cache[MESH_CACHE_SIZE + 3], new_cache[MESH_CACHE_SIZE + 3];
+    int cache_count = 0, result = -1;
+
+    if (remaining == NULL || first == NULL || adjacency == NULL || cache_position == NULL || vertex_scores == NULL ||
+        triangle_scores == NULL || emitted == NULL || output == NULL) {
+        goto done;
+    }
+
+    // triangles per vertex, packed: vertex v's are adjacency[first[v]..first[v] + remaining[v])
+    for (uint32_t i = 0; i < index_count; i++) {
+        remaining[indices[i]]++;
+    }
+    first[0] = 0;
+    for (uint32_t v = 0; v < vertex_count; v++) {
+        first[v + 1] = first[v] + remaining[v];
+        remaining[v] = 0;
+    }
+    for (uint32_t i = 0; i < index_count; i++) {
+        uint32_t v = indices[i];
+        adjacency[first[v] + remaining[v]++] = i / 3;
+    }
+
+    for (uint32_t v = 0; v < vertex_count; v++) {
+        cache_position[v] = -1;
+        vertex_scores[v] = vertex_score(-1, remaining[v]);
+    }
+    uint32_t best = 0;
+    for (uint32_t t = 0; t < triangle_count; t++) {
+        triangle_scores[t] = vertex_scores[indices[3 * t]] + vertex_scores[indices[3 * t + 1]] +
+                             vertex_scores[indices[3 * t + 2]];
+        if (triangle_scores[t] > triangle_scores[best]) {
+            best = t;
+        }
+    }
+
+    uint32_t cursor = 0;
+    for (uint32_t out = 0; out < triangle_count; out++) {
+        if (best == UINT32_MAX) {
+            // nothing in the cache has triangles left: take the next one in the input order
+            while (emitted[cursor]) {
+                cursor++;
+            }
+            best = cursor;
+        }
+
+        const uint32_t *triangle = indices + 3 * best;
+        memcpy(output + 3 * out, triangle, 3 * sizeof(uint32_t));
+        emitted[best] = 1;
+
+        int new_count = 0;
+        for (int k = 0; k < 3; k++) {
+            uint32_t v = triangle[k];
+            uint32_t *list = adjacency + first[v];
+
+            for (uint32_t a = 0; a < remaining[v]; a++) {
+                if (list[a] == best) {
+                    list[a] = list[--remaining[v]];
+                    break;
+                }
+            }
+            new_cache[new_count++] = v;
+        }
+        for (int c = 0; c < cache_count; c++) {
+            uint32_t v = cache[c];
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+                new_cache[new_count++] = v;
+            }
+        }
+
+        // rescore everything whose position changed, including what just fell out
+        for (int c = 0; c < new_count; c++) {
+            uint32_t v = new_cache[c];
+            cache_position[v] = c < MESH_CACHE_SIZE ? c : -1;
+            vertex_scores[v] = vertex_score(cache_position[v], remaining[v]);
+        }
+        best = UINT32_MAX;
+        float best_score = -1.0f;
+        for (int c = 0; c < new_count; c++) {
+            uint32_t v = new_cache[c];
+            const uint32_t *list = adjacency + first[v];
+
+            for (uint32_t a = 0; a < remaining[v]; a++) {
+                uint32_t t = list[a];
+                triangle_scores[t] = vertex_scores[indices[3 * t]] + vertex_scores[indices[3 * t + 1]] +
+                                     vertex_scores[indices[3 * t + 2]];
+                if (triangle_scores[t] > best_score) {
+                    best_score = triangle_scores[t];
+                    best = t;
+                }
+            }
+        }
+
+        cache_count = new_count < MESH_CACHE_SIZE ? new_count : MESH_CACHE_SIZE;
+        memcpy(cache, new_cache, cache_count * sizeof(uint32_t));
+    }
+
+    memcpy(indices, output, index_count * sizeof(uint32_t));
+    result = 0;
+
+done:
+    free(remaining);
+    free(first);
+    free(adjacency);
+    free(cache_position);
+    free(vertex_scores);
+    free(triangle_scores);
+    free(emitted);
+    free(output);
+    return result;
+}
+
+double mesh_acmr(const uint32_t *indices, uint32_t index_count, int cache_size)
+{
+    uint32_t cache[256];
+    int count = 0, next = 0;
+    uint64_t misses = 0;
+
+    cache_size = cache_size < 256 ? cache_size : 256;
+    for (uint32_t i = 0; i < index_count; i++) {
+        int hit = 0;
+
+        for (int c = 0; c < count; c++) {
+            if (cache[c] == indices[i]) {
+                hit = 1;
+                break;
+            }
+        }
+        if (!hit) {
+            misses++;
+            cache[next] = indices[i];
+            next = (next + 1) % cache_size;
+            count += count < cache_size;
+        }
+    }
+    return index_count ? (double) misses / (index_count / 3) : 0.0;
+}
@@ -0,0 +1,50 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <stdint.h>
+
+/*
+ * Test geometry: a regular grid of identical patches, each a grid of
+ * columns x rows quads split into two triangles. Only one patch is kept
+ * on the CPU. Every patch has the same topology, so index orders are
+ * computed once per mesh however many triangles it has. A patch never
+ * has more than 65536 vertices, so its indices always fit in 16 bits.
+ *
+ * Index orders can be shuffled (the worst case for a post-transform
+ * vertex cache) or optimised for one with Forsyth's linear-speed
+ * algorithm, and scored by simulating a FIFO cache.
+ */
+
+#define MESH_PATCH_QUADS 128    /* a patch is at most this many quads on a side */
+#define MESH_CACHE_SIZE 32      /* cache size the optimiser assumes */
+
+struct mesh {
+    int columns;                    /* quads per patch row */
+    int rows;
+    int patch_count;
+    int patches_per_row;            /* patches sit in a patches_per_row-wide grid */
+    uint32_t patch_vertex_count;
+    uint32_t patch_index_count;
+    float *patch_vertices;          /* x, y per vertex, in [0, 1] */
+    uint32_t *patch_indices;        /* three per triangle, counter-clockwise, row by row */
+};
+
+/* A grid of about triangles triangles. Returns -1 if out of memory. */
+int mesh_create_grid(struct mesh *mesh, uint64_t triangles);
+void mesh_destroy(struct mesh *mesh);
+
+uint64_t mesh_triangle_count(const struct mesh *mesh);
+
+/* Writes patch_vertex_count x, y pairs: the patch moved to its cell of [-1, 1]^2. */
+void mesh_place_patch(const struct mesh *mesh, int patch, float *vertices);
+
+/* Triangles keep their vertices and winding; only their order changes. */
+void mesh_shuffle_triangles(uint32_t *indices, uint32_t index_count, uint32_t seed);
+
+/* Reorders triangles for a MESH_CACHE_SIZE-entry vertex cache. Returns -1 if out of memory. */
+int mesh_optimize_vertex_cache(uint32_t *indices, uint32_t index_count, uint32_t vertex_count);
+
+/* Average cache miss ratio: vertices shaded per triangle with a FIFO cache of cache_size entries. */
+double mesh_acmr(const uint32_t *indices, uint32_t index_count, int cache_size);
+
+#endif
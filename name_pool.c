@@ -0,0 +1,233 @@
+#include "name_pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+struct object_type {
+    const char *name;
+    void (*gen)(GLsizei n, GLuint *names);
+    void (*delete_objects)(GLsizei n, const GLuint *names);
+    GLboolean (*is_object)(GLuint name);
+};
+
+static const struct object_type object_types[NAME_POOL_TYPE_COUNT] = {
+    [NAME_POOL_BUFFER]       = { "buffer", glGenBuffers, glDeleteBuffers, glIsBuffer },
+    [NAME_POOL_TEXTURE]      = { "texture", glGenTextures, glDeleteTextures, glIsTexture },
+    [NAME_POOL_FRAMEBUFFER]  = { "framebuffer", glGenFramebuffers, glDeleteFramebuffers, glIsFramebuffer },
+    [NAME_POOL_RENDERBUFFER] = { "renderbuffer", glGenRenderbuffers, glDeleteRenderbuffers, glIsRenderbuffer },
+    [NAME_POOL_VERTEX_ARRAY] = { "vertex array", glGenVertexArrays, glDeleteVertexArrays, glIsVertexArray },
+    [NAME_POOL_QUERY]        = { "query", glGenQueries, glDeleteQueries, glIsQuery },
+};
+
+void name_pool_init(struct name_pool *pool)
+{
+    memset(pool, 0, sizeof(*pool));
+}
+
+void name_pool_destroy(struct name_pool *pool)
+{
+    for (int t = 0; t < NAME_POOL_TYPE_COUNT; t++) {
+        struct name_pool_list *list = &pool->lists[t];
+
+        for (int i = 0; i < list->live_count; i++) {
+            object_types[t].delete_objects(1, &list->live[i].name);
+        }
+        if (list->free_count > 0) {
+            object_types[t].delete_objects(list->free_count, list->free);
+        }
+        free(list->live);
+    }
+    memset(pool, 0, sizeof(*pool));
+}
+
+static int track(struct name_pool_list *list, GLuint name, const char *file, int line)
+{
+    if (list->live_count == list->live_capacity) {
+        int capacity = list->live_capacity ? 2 * list->live_capacity : NAME_POOL_BATCH;
+        struct name_pool_object *live = realloc(list->live, capacity * sizeof(*live));
+        if (live == NULL) {
+            return -1;
+        }
+        list->live = live;
+        list->live_capacity = capacity;
+    }
+
+    list->live[list->live_count++] = (struct name_pool_object) { name, file, line };
+    if (list->live_count > list->stats.peak_live) {
+        list->stats.peak_live = list->live_count;
+    }
+    return 0;
+}
+
+/* Returns 1 if name was live. Searches from the newest: objects tend to die young. */
+static int untrack(struct name_pool_list *list, GLuint name)
+{
+    for (int i = list->live_count - 1; i >= 0; i--) {
+        if (list->live[i].name == name) {
+            list->live[i] = list->live[--list->live_count];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int name_pool_gen_at(struct name_pool *pool, enum name_pool_type type, GLsizei n, GLuint *names,
+                     const char *file, int line)
+{
+    struct name_pool_list *list = &pool->lists[type];
+
+    for (GLsizei i = 0; i < n; i++) {
+        if (list->free_count == 0) {
+            object_types[type].gen(NAME_POOL_BATCH, list->free);
+            list->free_count = NAME_POOL_BATCH;
+            list->stats.gen_calls++;
+        }
+        names[i] = list->free[--list->free_count];
+        if (track(list, names[i], file, line) != 0) {
+            // an untracked name would never show up as a leak: hand none out
+            list->free[list->free_count++] = names[i];
+            list->stats.handed_out += i;
+            name_pool_delete(pool, type, i, names);
+            memset(names, 0, n * sizeof(*names));
+            return -1;
+        }
+    }
+    list->stats.handed_out += n;
+    return 0;
+}
+
+void name_pool_delete(struct name_pool *pool, enum name_pool_type type, GLsizei n, const GLuint *names)
+{
+    struct name_pool_list *list = &pool->lists[type];
+    GLuint doomed[NAME_POOL_BATCH];
+    GLsizei doomed_count = 0;
+
+    for (GLsizei i = 0; i < n; i++) {
+        int was_live = untrack(list, names[i]);
+
+        if (names[i] == 0) {
+            continue;
+        }
+        list->stats.deleted += was_live;
+        // a pooled name that never became an object can be handed out again
+        if (was_live && !object_types[type].is_object(names[i]) &&
+            list->free_count < (int) (sizeof(list->free) / sizeof(list->free[0]))) {
+            list->free[list->free_count++] = names[i];
+            list->stats.recycled++;
+            continue;
+        }
+        doomed[doomed_count++] = names[i];
+        if (doomed_count == NAME_POOL_BATCH) {
+            object_types[type].delete_objects(doomed_count, doomed);
+            doomed_count = 0;
+        }
+    }
+    if (doomed_count > 0) {
+        object_types[type].delete_objects(doomed_count, doomed);
+    }
+}
+
+int name_pool_live_count(const struct name_pool *pool)
+{
+    int count = 0;
+
+    for (int t = 0; t < NAME_POOL_TYPE_COUNT; t++) {
+        count += pool->lists[t].live_count;
+    }
+    return count;
+}
+
+int name_pool_report_leaks(const struct name_pool *pool, char *report, size_t report_size)
+{
+    size_t used = 0;
+    int count = 0;
+
+    report[0] = '\0';
+    for (int t = 0; t < NAME_POOL_TYPE_COUNT; t++) {
+        const struct name_pool_list *list = &pool->lists[t];
+
+        for (int i = 0; i < list->live_count; i++, count++) {
+            if (used < report_size) {
+                int written = snprintf(report + used, report_size - used, "%s %u from %s:%d was never deleted\n",
+                                       object_types[t].name, list->live[i].name, list->live[i].file,
+                                       list->live[i].line);
+                used += written > 0 ? (size_t) written : 0;
+            }
+        }
+    }
+    return count;
+}
+
+void name_pool_delete_live(struct name_pool *pool)
+{
+    for (int t = 0; t < NAME_POOL_TYPE_COUNT; t++) {
+        struct name_pool_list *list = &pool->lists[t];
+
+        for (int i = 0; i < list->live_count; i++) {
+            object_types[t].delete_objects(1, &list->live[i].name);
+        }
+        list->live_count = 0;
+    }
+}
+
+void name_pool_add_stats(struct name_pool_stats totals[NAME_POOL_TYPE_COUNT], const struct name_pool *pool)
+{
+    for (int t = 0; t < NAME_POOL_TYPE_COUNT; t++) {
+        const struct name_pool_stats *stats = &pool->lists[t].stats;
+
+        totals[t].gen_calls += stats->gen_calls;
+        totals[t].handed_out += stats->handed_out;
+        totals[t].recycled += stats->recycled;
+        totals[t].deleted += stats->deleted;
+        if (stats->peak_live > totals[t].peak_live) {
+            totals[t].peak_live = stats->peak_live;
+        }
+    }
+}
+
+/* live may be NULL: totals over pools that are gone have no live count. */
+static void print_stats(const struct name_pool_stats stats[NAME_POOL_TYPE_COUNT], const int *live, FILE *out,
+                        const char *label)
+{
+    uint64_t handed_out = 0;
+
+    for (int t = 0; t < NAME_POOL_TYPE_COUNT; t++) {
+        handed_out += stats[t].handed_out;
+    }
+    if (handed_out == 0) {
+        return;
+    }
+
+    fprintf(out, "%s:\n  %-14s %11s %10s %10s %10s %10s\n", label, "type", "glGen calls", "handed out",
+            "recycled", "live", "peak live");
+    for (int t = 0; t < NAME_POOL_TYPE_COUNT; t++) {
+        char live_count[16] = "-";
+
+        if (stats[t].handed_out == 0) {
+            continue;
+        }
+        if (live != NULL) {
+            snprintf(live_count, sizeof(live_count), "%d", live[t]);
+        }
+        fprintf(out, "  %-14s %11llu %10llu %10llu %10s %10d\n", object_types[t].name,
+                (unsigned long long) stats[t].gen_calls, (unsigned long long) stats[t].handed_out,
+                (unsigned long long) stats[t].recycled, live_count, stats[t].peak_live);
+    }
+}
+
+void name_pool_print_stats(const struct name_pool *pool, FILE *out, const char *label)
+{
+    struct name_pool_stats stats[NAME_POOL_TYPE_COUNT];
+    int live[NAME_POOL_TYPE_COUNT];
+
+    for (int t = 0; t < NAME_POOL_TYPE_COUNT; t++) {
+        stats[t] = pool->lists[t].stats;
+        live[t] = pool->lists[t].live_count;
+    }
+    print_stats(stats, live, out, label);
+}
+
+void name_pool_print_totals(const struct name_pool_stats totals[NAME_POOL_TYPE_COUNT], FILE *out, const char *label)
+{
+    print_stats(totals, NULL, out, label);
+}
@@ -0,0 +1,94 @@
+#ifndef NAME_POOL_H
+#define NAME_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "glc.h"
+
+/*
+ * Hands out GL object names from batches of NAME_POOL_BATCH made by one
+ * glGen* call per type, and keeps every live object with the file and
+ * line that asked for it, so leaks can be reported with their origin.
+ *
+ * Deleting through the pool deletes the objects in one glDelete* call.
+ * A name that never became an object (it was never bound, so glIs*
+ * says no) goes back to the pool instead and is handed out again; GL has
+ * no way to keep the name of an object that was deleted, and keeping
+ * the object itself would carry its state and memory over to the next
+ * user. Names still in the pool are not objects, so they are invisible to
+ * gl_state's leak probe.
+ */
+
+#define NAME_POOL_BATCH 32
+
+enum name_pool_type {
+    NAME_POOL_BUFFER,
+    NAME_POOL_TEXTURE,
+    NAME_POOL_FRAMEBUFFER,
+    NAME_POOL_RENDERBUFFER,
+    NAME_POOL_VERTEX_ARRAY,
+    NAME_POOL_QUERY,
+    NAME_POOL_TYPE_COUNT
+};
+
+struct name_pool_object {
+    GLuint name;
+    const char *file;
+    int line;
+};
+
+struct name_pool_stats {
+    uint64_t gen_calls;     /* glGen* calls, one per batch */
+    uint64_t handed_out;
+    uint64_t recycled;      /* names handed back unused, to be handed out again */
+    uint64_t deleted;
+    int peak_live;
+};
+
+struct name_pool_list {
+    GLuint free[2 * NAME_POOL_BATCH];
+    int free_count;
+    struct name_pool_object *live;
+    int live_count;
+    int live_capacity;
+    struct name_pool_stats stats;
+};
+
+struct name_pool {
+    struct name_pool_list lists[NAME_POOL_TYPE_COUNT];
+};
+
+void name_pool_init(struct name_pool *pool);
+
+/* Deletes every object still live and every name still pooled. */
+void name_pool_destroy(struct name_pool *pool);
+
+/* Returns -1 and sets every name to 0 if there is no memory left to track them. */
+#define name_pool_gen(pool, type, n, names) name_pool_gen_at(pool, type, n, names, __FILE__, __LINE__)
+int name_pool_gen_at(struct name_pool *pool, enum name_pool_type type, GLsizei n, GLuint *names,
+                     const char *file, int line);
+
+/* Names that did not come from the pool are deleted all the same. */
+void name_pool_delete(struct name_pool *pool, enum name_pool_type type, GLsizei n, const GLuint *names);
+
+int name_pool_live_count(const struct name_pool *pool);
+
+/* One line per live object with where it came from; returns how many there are. */
+int name_pool_report_leaks(const struct name_pool *pool, char *report, size_t report_size);
+
+/* Deletes every object still live, e.g. what a failed test left; pooled names stay pooled. */
+void name_pool_delete_live(struct name_pool *pool);
+
+/* Per type: glGen* calls, names handed out, recycled, live and peak live. Nothing if unused. */
+void name_pool_print_stats(const struct name_pool *pool, FILE *out, const char *label);
+
+/*
+ * Adds a pool's stats to totals kept per type, e.g. over pools in other
+ * processes; a peak live count is the highest any one pool reached.
+ */
+void name_pool_add_stats(struct name_pool_stats totals[NAME_POOL_TYPE_COUNT], const struct name_pool *pool);
+void name_pool_print_totals(const struct name_pool_stats totals[NAME_POOL_TYPE_COUNT], FILE *out, const char *label);
+
+#endif
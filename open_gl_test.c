@@ -1,95 +1,264 @@
 #include <check.h>
+#include <stdio.h>
 #include <stdlib.h>
-#include <OpenGL/OpenGL.h>
-#include <OpenGL/gl3.h>
-
-const char *vertex_shader =
-    "#version 410\n"
-    "layout (location = 0) in vec2 v;"
-    "void main() {"
-    "   gl_Position = vec4(v, 0.0, 1.0);"
-    "}";
-
-const char *fragment_shader =
-    "#version 410\n"
-    "layout (location = 0) out vec4 frag_color;"
-    "void main() {"
-    "   frag_color = vec4(1.0, 1.0, 1.0, 1.0);" // All white color
-    "}";
-
-const float triangle[] = {
-    0.0f,  0.5f,
-    0.5f, -0.5f,
-   -0.5f, -0.5f
-};
+#include <string.h>
+#include <unistd.h>
+
+#include "bind_cache.h"
+#include "draw_pipeline.h"
+#include "feedback_compute.h"
+#include "frame_loop.h"
+#include "gl_errors.h"
+#include "gl_state.h"
+#include "golden.h"
+#include "gpu_timer.h"
+#include "image_compare.h"
+#include "loader.h"
+#include "mesh.h"
+#include "name_pool.h"
+#include "pixel_format_cache.h"
+#include "program_cache.h"
+#include "readback.h"
+#include "reference_raster.h"
+#include "render_target.h"
+#include "shader_corpus.h"
+#include "glc.h"
+#include "shard_runner.h"
+#include "stream_buffer.h"
+#include "test_report.h"
+#include "texture_upload.h"
+#include "vertex_layout.h"
+#include "gl_trace.h" // last: it redefines the gl* calls it traces
+
+/*
+ * Context bring-up is the most expensive thing the suite does, so a core
+ * profile context is created once per process, by the first test that runs
+ * in it, and every test starts from it with the default state put back
+ * (checked fixture). With --no-fork and on each shard worker that is one
+ * context for the whole run. In fork mode the unchecked fixture runs in the
+ * parent and each test in a child of it; a context made before fork() would
+ * reach the child without the driver's threads (llvmpipe's rasterizer
+ * threads, for one) and its first draw would wait for them forever, so each
+ * child makes its own. Tests that are about creating contexts still create
+ * their own.
+ *
+ * Tests must leave the shared context the way they found it: any binding,
+ * capability or clear value left changed and any object left undeleted
+ * fails the test that did it.
+ *
+ * Programs come from an on-disk program cache (PROGRAM_CACHE, by default
+ * open_gl_test.program_cache in the working directory), so only the
+ * first run pays for compiling them.
+ *
+ * GL errors are collected per test through the debug output callback,
+ * or with glGetError() where there is none (see gl_errors.h); a test that
+ * raised an error and did not clear it fails. GL_ERRORS=poll forces the
+ * fallback.
+ *
+ * Objects the tests make come from a name pool (see name_pool.h), so a
+ * leak is reported with the line that made it; the pool's batching and
+ * peak live counts are printed at teardown. In fork mode each child adds
+ * its pool's counts to totals in the test report's shared mapping, and
+ * the parent prints those.
+ *
+ * The fixtures also time each test and its phases for --json, --junit and
+ * --baseline (see test_report.h), on the GPU too: each test is a frame of
+ * the fixture's gpu_timer, with a phase for setup, body and verify. The
+ * results are picked up once the GPU has them, a few tests later, and
+ * credited to the test that was timed, so timing never stalls the
+ * pipeline; the rest are collected at teardown. A forked child collects
+ * its one test after the test's own times are taken.
+ */
+static glc_context *shared_context;
+static pid_t fixture_pid;   /* of the process that ran the unchecked setup */
+static struct gl_state default_state;
+static struct gl_errors context_errors;
+static struct name_pool context_names;
+static struct program_cache program_cache;
+static struct gpu_timer fixture_timer;
+static int fixture_frame_open;
+static const char *const fixture_phases[TEST_REPORT_PHASE_COUNT] = { "setup", "body", "verify" };
+
+/* The tag of a fixture timer frame is the test_report sample of the test it timed. */
+static void fixture_gpu_time_collected(void *data, int sample, const char *phase, uint64_t gpu_ns, uint64_t cpu_ns)
+{
+    (void) data;
+    (void) cpu_ns;
+    for (int p = 0; p < TEST_REPORT_PHASE_COUNT; p++) {
+        if (strcmp(phase, fixture_phases[p]) == 0) {
+            test_report_add_gpu_time(sample, p, gpu_ns);
+        }
+    }
+}
 
-START_TEST(we_can_use_a_shader_program_and_issue_a_draw_call)
+static void shared_context_make(void)
 {
-    CGLPixelFormatAttribute attribs[3] = {
-        kCGLPFAOpenGLProfile,
-        (CGLPixelFormatAttribute) kCGLOGLPVersion_GL4_Core,
-        (CGLPixelFormatAttribute) 0
+    glc_attrib attribs[] = {
+        GLC_ATTRIB_CORE_PROFILE,
+        GLC_ATTRIB_END
     };
-    CGLPixelFormatObj pixel_format;
+    glc_pixel_format *pixel_format;
     GLint number_pixel_formats = 0;
-    CGLContextObj context;
 
-    CGLChoosePixelFormat(attribs, &pixel_format, &number_pixel_formats);
-    CGLCreateContext(pixel_format, NULL, &context);
-    CGLDestroyPixelFormat(pixel_format);
-    CGLSetCurrentContext(context);
+    test_report_begin_context();
+    ck_assert_int_eq(glc_choose_pixel_format(attribs, &pixel_format, &number_pixel_formats), GLC_NO_ERROR);
+    ck_assert_int_eq(glc_create_context(pixel_format, NULL, &shared_context), GLC_NO_ERROR);
+    glc_destroy_pixel_format(pixel_format);
+
+    glc_set_current_context(shared_context);
+    test_report_end_context();
+
+    const char *errors_mode = getenv("GL_ERRORS");
+    gl_errors_init(&context_errors, errors_mode != NULL && strcmp(errors_mode, "poll") == 0);
+    gpu_timer_init(&fixture_timer); // before the snapshot, so its queries are not leaks
+    fixture_timer.collected = fixture_gpu_time_collected;
+    fixture_frame_open = 0;
+    gl_state_capture(&default_state);
+    name_pool_init(&context_names);
+
+    const char *cache_path = getenv("PROGRAM_CACHE");
+    program_cache_open(&program_cache, cache_path != NULL ? cache_path : "open_gl_test.program_cache");
+}
+
+static void shared_context_setup(void)
+{
+    shared_context = NULL; // made by the first test of each process, see above
+    fixture_pid = getpid();
+    if (test_report_name_stats() != NULL) {
+        memset(test_report_name_stats(), 0, NAME_POOL_TYPE_COUNT * sizeof(struct name_pool_stats));
+    }
+}
+
+static void shared_context_teardown(void)
+{
+    if (shared_context == NULL) {
+        // fork mode: every test ran, and made its context, in a child
+        if (test_report_name_stats() != NULL) {
+            name_pool_print_totals(test_report_name_stats(), stderr, "object names");
+        }
+        return;
+    }
+
+    const struct program_cache_stats *stats = &program_cache.stats;
+
+    if (stats->hits + stats->misses > 0) {
+        fprintf(stderr, "program cache: %llu hit(s), %llu miss(es), %.1f ms of compiling saved\n",
+                (unsigned long long) stats->hits, (unsigned long long) stats->misses,
+                (stats->saved_ns - stats->load_ns) / 1e6);
+    }
+    name_pool_print_stats(&context_names, stderr, "object names");
+    glc_set_current_context(shared_context);
+    gpu_timer_collect_all(&fixture_timer);
+    gpu_timer_destroy(&fixture_timer);
+    name_pool_destroy(&context_names);
+    program_cache_close(&program_cache);
+    gl_errors_destroy(&context_errors);
+    glc_destroy_context(shared_context);
+    shared_context = NULL;
+}
+
+static void shared_context_reset(void)
+{
+    if (shared_context == NULL) {
+        shared_context_make();
+    }
+    test_report_begin_test();
+    ck_assert_int_eq(glc_set_current_context(shared_context), GLC_NO_ERROR);
+    if (fixture_frame_open) {
+        // left by a test that failed or made another context current: its phases ran on, so drop them
+        gpu_timer_set_frame_tag(&fixture_timer, -1);
+        gpu_timer_end_frame(&fixture_timer);
+    }
+    gpu_timer_begin_frame(&fixture_timer); // collects whatever earlier tests' results are in, without waiting
+    gpu_timer_set_frame_tag(&fixture_timer, test_report_current_sample());
+    gpu_timer_begin(&fixture_timer, fixture_phases[TEST_REPORT_SETUP]);
+    fixture_frame_open = 1;
+
+    name_pool_delete_live(&context_names); // what a failed test left; gl_state_restore() no longer probes those names
+    gl_state_restore(&default_state);
+    gl_errors_clear(&context_errors);
+    gpu_timer_end(&fixture_timer);
+    gpu_timer_begin(&fixture_timer, fixture_phases[TEST_REPORT_BODY]);
+    test_report_begin_phase(TEST_REPORT_BODY);
+}
+
+static void shared_context_verify(void)
+{
+    char report[2048];
+
+    test_report_begin_phase(TEST_REPORT_VERIFY);
+    gl_trace_flush(); // a forked test's process may end without running atexit handlers
+
+    if (glc_get_current_context() != shared_context) {
+        test_report_end_test();
+        return; // the test made a context of its own current
+    }
+    gpu_timer_end(&fixture_timer);
+    gpu_timer_begin(&fixture_timer, fixture_phases[TEST_REPORT_VERIFY]);
+
+    if (gl_errors_collect(&context_errors) > 0) {
+        int errors = gl_errors_format(&context_errors, report, sizeof(report));
+        ck_abort_msg("test raised %d GL error(s):\n%s", errors, report);
+    }
+
+    int leaks = name_pool_report_leaks(&context_names, report, sizeof(report));
+    ck_assert_msg(leaks == 0, "test leaked %d object(s):\n%s", leaks, report);
+    if (getpid() != fixture_pid && test_report_name_stats() != NULL) {
+        name_pool_add_stats(test_report_name_stats(), &context_names); // the child's pool goes with it
+    }
+
+    int deviations = gl_state_check(&default_state, report, sizeof(report));
+    ck_assert_msg(deviations == 0, "test left %d change(s) to the shared context behind:\n%s", deviations, report);
+
+    gpu_timer_end_frame(&fixture_timer);
+    fixture_frame_open = 0;
+    test_report_end_test();
+    if (getpid() != fixture_pid) {
+        gpu_timer_collect_all(&fixture_timer); // fork mode: this child ends with its one test
+    }
+}
 
+START_TEST(we_can_use_a_shader_program_and_issue_a_draw_call)
+{
     GLuint framebuffer_name = 0;
-    glGenFramebuffers(1, &framebuffer_name);
+    name_pool_gen(&context_names, NAME_POOL_FRAMEBUFFER, 1, &framebuffer_name);
     glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_name);
 
     GLuint width = 512;
     GLuint height = 512;
 
     GLuint color_renderbuffer;
-    glGenRenderbuffers(1, &color_renderbuffer);
+    name_pool_gen(&context_names, NAME_POOL_RENDERBUFFER, 1, &color_renderbuffer);
     glBindRenderbuffer(GL_RENDERBUFFER, color_renderbuffer);
     glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_renderbuffer);
 
     GLuint depth_renderbuffer;
-    glGenRenderbuffers(1, &depth_renderbuffer);
+    name_pool_gen(&context_names, NAME_POOL_RENDERBUFFER, 1, &depth_renderbuffer);
     glBindRenderbuffer(GL_RENDERBUFFER, depth_renderbuffer);
     glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, width, height);
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_renderbuffer);
 
     GLenum draw_buffers = GL_COLOR_ATTACHMENT0;
     glDrawBuffers(1, &draw_buffers);
+    glViewport(0, 0, width, height); // a context without a drawable starts with an empty viewport
 
     GLenum err1 = glCheckFramebufferStatus(GL_FRAMEBUFFER);
 
     GLuint vbo, vao;
-    glGenBuffers(1, &vbo);
+    name_pool_gen(&context_names, NAME_POOL_BUFFER, 1, &vbo);
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
     glBufferData(GL_ARRAY_BUFFER, sizeof(triangle), triangle, GL_STATIC_DRAW);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-    glGenVertexArrays(1, &vao);
+    name_pool_gen(&context_names, NAME_POOL_VERTEX_ARRAY, 1, &vao);
     glBindVertexArray(vao);
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
     glBindVertexArray(0);
 
-    GLuint vs = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vs, 1, &vertex_shader, NULL);
-    glCompileShader(vs);
-
-    GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fs, 1, &fragment_shader, NULL);
-    glCompileShader(fs);
-
-    GLuint shader_program = glCreateProgram();
-    glAttachShader(shader_program, fs);
-    glAttachShader(shader_program, vs);
-    glLinkProgram(shader_program);
-    glDeleteShader(vs);
-    glDeleteShader(fs);
+    GLuint shader_program = program_cache_get(&program_cache, vertex_shader, fragment_shader);
 
     glClearColor(0.0, 0.0, 0.0, 1.0);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -105,47 +274,954 @@ START_TEST(we_can_use_a_shader_program_and_issue_a_draw_call)
     GLubyte pixels[4] = { };
     glReadPixels(256, 256, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels); // read the middle pixel which should be white
 
+    GLubyte *frame = malloc(width * height * 4);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, frame);
+
     glDeleteProgram(shader_program);
 
-    glDeleteBuffers(1, &vbo);
-    glDeleteVertexArrays(1, &vao);
-    glDeleteFramebuffers(1, &framebuffer_name);
+    name_pool_delete(&context_names, NAME_POOL_BUFFER, 1, &vbo);
+    name_pool_delete(&context_names, NAME_POOL_VERTEX_ARRAY, 1, &vao);
+    name_pool_delete(&context_names, NAME_POOL_RENDERBUFFER, 1, &color_renderbuffer);
+    name_pool_delete(&context_names, NAME_POOL_RENDERBUFFER, 1, &depth_renderbuffer);
+    name_pool_delete(&context_names, NAME_POOL_FRAMEBUFFER, 1, &framebuffer_name);
+
+    glClearColor(0.0, 0.0, 0.0, 0.0);
+    glDepthMask(GL_TRUE);
 
     GLenum err2 = glGetError();
 
-    CGLDestroyContext(context);
+    // the expected frame is drawn on the CPU by the same stages instead of kept as a golden image
+    struct reference_scene scene = { triangle, 3, { 0.0f, 0.0f, 0.0f, 1.0f }, { 1.0f, 1.0f, 1.0f, 1.0f } };
+    GLubyte *expected = malloc(width * height * 4);
+    int rendered = reference_raster_render(&scene, width, height, expected);
+
+    const uint8_t tolerance[4] = { 2, 2, 2, 0 };
+    struct image_compare_result result;
+    uint64_t mismatches = golden_check_expected_rgba8("draw_call_512x512", frame, expected, width, height, tolerance,
+                                                      &result);
+    free(frame);
+    free(expected);
 
+    ck_assert_uint_ne(shader_program, 0);
     ck_assert_int_eq(err1, GL_FRAMEBUFFER_COMPLETE);
     ck_assert_int_eq(err2, GL_NO_ERROR);
     ck_assert_int_eq(pixels[0], 0xFF);
     ck_assert_int_eq(pixels[1], 0xFF);
     ck_assert_int_eq(pixels[2], 0xFF);
     ck_assert_int_eq(pixels[3], 0xFF);
+    ck_assert_int_eq(rendered, 0);
+    // a few pixels right on the triangle's edges may round either way on other rasterizers
+    ck_assert_msg(mismatches <= 32,
+                  "%llu pixel(s) differ from the reference in (%d, %d)-(%d, %d), see draw_call_512x512.diff.pam",
+                  (unsigned long long) mismatches, result.min_x, result.min_y, result.max_x, result.max_y);
 }
 END_TEST
 
-START_TEST(we_can_read_from_a_fbo_with_glReadPixels)
+START_TEST(every_image_compare_kernel_finds_the_same_mismatches)
 {
-    CGLPixelFormatAttribute attribs[3] = {
-        kCGLPFAOpenGLProfile,
-        (CGLPixelFormatAttribute) kCGLOGLPVersion_GL4_Core,
-        (CGLPixelFormatAttribute) 0
-    };
-    CGLPixelFormatObj pixel_format;
-    GLint number_pixel_formats = 0;
-    CGLContextObj context;
+    enum { width = 37, height = 23 }; // odd sizes so every kernel has a scalar tail
+    static uint8_t expected[width * height * 4];
+    static uint8_t actual[width * height * 4];
+    const uint8_t tolerance[4] = { 1, 2, 3, 0 };
+
+    for (int i = 0; i < width * height * 4; i++) {
+        expected[i] = actual[i] = (uint8_t) (i * 7);
+    }
+    actual[(5 * width + 3) * 4 + 0] += 2;   // over tolerance
+    actual[(5 * width + 9) * 4 + 1] += 2;   // within tolerance
+    actual[(17 * width + 35) * 4 + 2] -= 9; // over tolerance
+    actual[(11 * width + 20) * 4 + 3] ^= 1; // over tolerance
+
+    for (int k = IMAGE_COMPARE_SCALAR; k <= IMAGE_COMPARE_AVX2; k++) {
+        struct image_compare_result result;
+
+        if (image_compare_rgba8_with(k, actual, expected, width, height, tolerance, &result) != 0) {
+            continue; // not on this CPU
+        }
+        ck_assert_msg(result.mismatches == 3, "%s kernel found %llu mismatches",
+                      image_compare_kernel_name(k), (unsigned long long) result.mismatches);
+        ck_assert_int_eq(result.max_channel_difference, 9);
+        ck_assert_int_eq(result.min_x, 3);
+        ck_assert_int_eq(result.max_x, 35);
+        ck_assert_int_eq(result.min_y, 5);
+        ck_assert_int_eq(result.max_y, 17);
+    }
+}
+END_TEST
+
+START_TEST(the_draw_pipeline_renders_the_triangle_like_the_draw_test)
+{
+    struct draw_pipeline pipeline;
+
+    GLenum status = draw_pipeline_create(&pipeline, 512, 512, triangle, 3);
+
+    draw_pipeline_bind(&pipeline);
+    glClearColor(0.0, 0.0, 0.0, 1.0);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glDrawArrays(GL_TRIANGLES, 0, pipeline.vertex_count);
+
+    GLubyte middle[4] = { };
+    GLubyte corner[4] = { };
+    glReadPixels(256, 256, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, middle);
+    glReadPixels(0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, corner);
+
+    draw_pipeline_unbind();
+    draw_pipeline_destroy(&pipeline);
+    glClearColor(0.0, 0.0, 0.0, 0.0);
+
+    ck_assert_int_eq(status, GL_FRAMEBUFFER_COMPLETE);
+    ck_assert_int_eq(glGetError(), GL_NO_ERROR);
+    ck_assert_int_eq(middle[0], 0xFF);
+    ck_assert_int_eq(middle[3], 0xFF);
+    ck_assert_int_eq(corner[0], 0x00);
+    ck_assert_int_eq(corner[3], 0xFF);
+}
+END_TEST
+
+START_TEST(the_readback_ring_returns_every_frame_in_order)
+{
+    struct draw_pipeline pipeline;
+    struct readback_ring ring;
+    GLubyte pixels[16 * 16 * 4];
+    uint64_t tags[5];
+    GLubyte reds[5];
+    int collected = 0;
+
+    draw_pipeline_create(&pipeline, 16, 16, triangle, 3);
+    int err1 = readback_ring_init(&ring, 2, 16, 16, GL_RGBA, GL_UNSIGNED_BYTE);
+    draw_pipeline_bind(&pipeline);
+
+    for (int frame = 0; frame < 5; frame++) {
+        if (ring.pending == 2) {
+            readback_ring_collect(&ring, pixels, UINT64_MAX, &tags[collected]);
+            reds[collected++] = pixels[0];
+        }
+        glClearColor(frame * 50 / 255.0f, 0.0, 0.0, 1.0);
+        glClear(GL_COLOR_BUFFER_BIT);
+        readback_ring_issue(&ring, 0, 0, 16, 16, frame);
+    }
+    int err2 = readback_ring_issue(&ring, 0, 0, 16, 16, 99); // ring is full
+
+    while (readback_ring_collect(&ring, pixels, UINT64_MAX, &tags[collected]) == 1) {
+        reds[collected++] = pixels[0];
+    }
+
+    draw_pipeline_unbind();
+    readback_ring_destroy(&ring);
+    draw_pipeline_destroy(&pipeline);
+    glClearColor(0.0, 0.0, 0.0, 0.0);
+
+    ck_assert_int_eq(err1, 0);
+    ck_assert_int_eq(err2, -1);
+    ck_assert_int_eq(glGetError(), GL_NO_ERROR);
+    ck_assert_int_eq(collected, 5);
+    for (int i = 0; i < 5; i++) {
+        ck_assert_uint_eq(tags[i], i);
+        ck_assert_int_eq(reds[i], i * 50);
+    }
+}
+END_TEST
+
+START_TEST(the_gpu_timer_collects_every_phase_of_every_frame)
+{
+    struct draw_pipeline pipeline;
+    struct gpu_timer timer;
+    GLubyte pixel[4];
+
+    draw_pipeline_create(&pipeline, 64, 64, triangle, 3);
+    draw_pipeline_bind(&pipeline);
+    gpu_timer_init(&timer);
+
+    for (int frame = 0; frame < 6; frame++) {
+        gpu_timer_begin_frame(&timer);
+        gpu_timer_begin(&timer, "clear");
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        gpu_timer_end(&timer);
+        gpu_timer_begin(&timer, "draw");
+        glDrawArrays(GL_TRIANGLES, 0, pipeline.vertex_count);
+        gpu_timer_end(&timer);
+        gpu_timer_end_frame(&timer);
+    }
+    glReadPixels(32, 32, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+    gpu_timer_collect_all(&timer);
+
+    struct gpu_timer copy = timer;
+    gpu_timer_destroy(&timer);
+    draw_pipeline_unbind();
+    draw_pipeline_destroy(&pipeline);
+
+    ck_assert_int_eq(glGetError(), GL_NO_ERROR);
+    ck_assert_uint_eq(copy.frames_collected, 6);
+    ck_assert_int_eq(copy.total_count, 2);
+    ck_assert_str_eq(copy.totals[0].name, "clear");
+    ck_assert_str_eq(copy.totals[1].name, "draw");
+    ck_assert_uint_eq(copy.totals[0].samples, 6);
+    ck_assert_uint_eq(copy.totals[1].samples, 6);
+    ck_assert_uint_gt(copy.totals[1].cpu_ns, 0);
+    ck_assert_int_eq(pixel[0], 0xFF);
+}
+END_TEST
+
+START_TEST(the_bind_cache_skips_rebinds_and_follows_what_gl_resets)
+{
+    struct bind_cache cache;
+    GLuint buffers[2], arrays[2], framebuffer;
+    GLint bound = -1;
+
+    bind_cache_init(&cache);
+    glGenBuffers(2, buffers);
+    glGenVertexArrays(2, arrays);
+    glGenFramebuffers(1, &framebuffer);
+
+    bind_cache_bind_buffer(&cache, GL_ARRAY_BUFFER, buffers[0]);
+    bind_cache_bind_buffer(&cache, GL_ARRAY_BUFFER, buffers[0]);
+    bind_cache_bind_buffer(&cache, GL_COPY_READ_BUFFER, buffers[0]);
+    ck_assert_uint_eq(cache.stats.calls, 3);
+    ck_assert_uint_eq(cache.stats.elided, 1);
+
+    // the element array binding belongs to the vertex array
+    bind_cache_bind_vertex_array(&cache, arrays[0]);
+    bind_cache_bind_buffer(&cache, GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+    bind_cache_bind_vertex_array(&cache, arrays[1]);
+    bind_cache_bind_buffer(&cache, GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+    glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &bound);
+    ck_assert_int_eq(bound, buffers[1]);
+
+    // deleting a bound buffer unbinds it, so binding the (maybe recycled) name must reach GL
+    bind_cache_delete_buffers(&cache, 1, &buffers[0]);
+    glGenBuffers(1, &buffers[0]);
+    bind_cache_bind_buffer(&cache, GL_ARRAY_BUFFER, buffers[0]);
+    glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &bound);
+    ck_assert_int_eq(bound, buffers[0]);
+
+    // GL_FRAMEBUFFER is both targets: only elided when both already match
+    bind_cache_bind_framebuffer(&cache, GL_FRAMEBUFFER, 0);
+    bind_cache_bind_framebuffer(&cache, GL_READ_FRAMEBUFFER, framebuffer);
+    bind_cache_bind_framebuffer(&cache, GL_FRAMEBUFFER, 0);
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &bound);
+    ck_assert_int_eq(bound, 0);
+    ck_assert_uint_eq(cache.stats.elided, 1);
+
+    bind_cache_bind_buffer(&cache, GL_ARRAY_BUFFER, 0);
+    bind_cache_bind_vertex_array(&cache, 0);
+    bind_cache_delete_framebuffers(&cache, 1, &framebuffer);
+    bind_cache_delete_vertex_arrays(&cache, 2, arrays);
+    bind_cache_delete_buffers(&cache, 2, buffers);
+}
+END_TEST
+
+START_TEST(the_name_pool_batches_recycles_and_reports_where_leaks_came_from)
+{
+    struct name_pool pool;
+    GLuint names[3], unused, leaked;
+    char report[512];
+
+    name_pool_init(&pool);
+
+    name_pool_gen(&pool, NAME_POOL_BUFFER, 3, names);
+    ck_assert_uint_eq(pool.lists[NAME_POOL_BUFFER].stats.gen_calls, 1);
+    ck_assert_int_eq(pool.lists[NAME_POOL_BUFFER].free_count, NAME_POOL_BATCH - 3);
+
+    // a name that never became an object comes back, one that did is deleted
+    glBindBuffer(GL_ARRAY_BUFFER, names[0]);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    name_pool_delete(&pool, NAME_POOL_BUFFER, 2, names);
+    ck_assert_uint_eq(pool.lists[NAME_POOL_BUFFER].stats.recycled, 1);
+    ck_assert_int_eq(glIsBuffer(names[0]), GL_FALSE);
+    name_pool_gen(&pool, NAME_POOL_BUFFER, 1, &unused);
+    ck_assert_uint_eq(unused, names[1]);
+    ck_assert_int_eq(pool.lists[NAME_POOL_BUFFER].stats.peak_live, 3);
+
+    name_pool_gen(&pool, NAME_POOL_RENDERBUFFER, 1, &leaked);
+    int leaked_line = __LINE__ - 1;
+    glBindRenderbuffer(GL_RENDERBUFFER, leaked);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    char expected[128];
+    snprintf(expected, sizeof(expected), "renderbuffer %u from %s:%d", leaked, __FILE__, leaked_line);
+    ck_assert_int_eq(name_pool_report_leaks(&pool, report, sizeof(report)), 3);
+    ck_assert_msg(strstr(report, expected) != NULL, "%s", report);
+
+    // destroy deletes what is left, pooled names included
+    name_pool_destroy(&pool);
+    ck_assert_int_eq(glIsRenderbuffer(leaked), GL_FALSE);
+}
+END_TEST
 
-    CGLChoosePixelFormat(attribs, &pixel_format, &number_pixel_formats);
-    CGLCreateContext(pixel_format, NULL, &context);
-    CGLDestroyPixelFormat(pixel_format);
-    CGLSetCurrentContext(context);
+START_TEST(a_multisampled_render_target_resolves_every_attachment)
+{
+    static const char *fs =
+        "#version 410\n"
+        "layout(location = 0) out vec4 color0;\n"
+        "layout(location = 1) out vec4 color1;\n"
+        "layout(location = 2) out vec4 color2;\n"
+        "layout(location = 3) out vec4 color3;\n"
+        "void main()\n"
+        "{\n"
+        "    color0 = vec4(1.0, 0.0, 0.0, 1.0);\n"
+        "    color1 = vec4(0.0, 1.0, 0.0, 1.0);\n"
+        "    color2 = vec4(0.0, 0.0, 1.0, 1.0);\n"
+        "    color3 = vec4(1.0, 1.0, 0.0, 1.0);\n"
+        "}\n";
+    const struct render_target_desc desc = { 32, 32, GL_RGBA16F, GL_DEPTH24_STENCIL8, 4, 4 };
+    struct render_target target;
+    GLubyte pixel[4];
+    GLuint vbo, vao;
+
+    ck_assert_int_eq(render_target_bytes(&desc), 32 * 32 * (4 * (4 * 8 + 4) + 4 * 8));
+    ck_assert_int_eq(render_target_create(&target, &desc), GL_FRAMEBUFFER_COMPLETE);
+    ck_assert_uint_ne(target.resolve_framebuffer, 0);
+
+    GLuint shader_program = program_cache_get(&program_cache, vertex_shader, fs);
+    ck_assert_uint_ne(shader_program, 0);
+    name_pool_gen(&context_names, NAME_POOL_BUFFER, 1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(triangle), triangle, GL_STATIC_DRAW);
+    name_pool_gen(&context_names, NAME_POOL_VERTEX_ARRAY, 1, &vao);
+    glBindVertexArray(vao);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, NULL);
+
+    render_target_bind(&target);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glUseProgram(shader_program);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    render_target_resolve(&target);
+
+    // the middle of the target is inside the triangle, the top-right corner is not
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, render_target_result_framebuffer(&target));
+    for (int i = 0; i < desc.color_count; i++) {
+        const GLubyte expected[4][4] = { { 255, 0, 0, 255 }, { 0, 255, 0, 255 }, { 0, 0, 255, 255 },
+                                         { 255, 255, 0, 255 } };
+
+        glReadBuffer(GL_COLOR_ATTACHMENT0 + i);
+        glReadPixels(16, 12, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+        ck_assert_msg(memcmp(pixel, expected[i], 4) == 0, "attachment %d: %u %u %u %u", i, pixel[0], pixel[1],
+                      pixel[2], pixel[3]);
+        glReadPixels(28, 28, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+        ck_assert_int_eq(pixel[3], 0);
+    }
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+    glUseProgram(0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glDeleteProgram(shader_program);
+    name_pool_delete(&context_names, NAME_POOL_VERTEX_ARRAY, 1, &vao);
+    name_pool_delete(&context_names, NAME_POOL_BUFFER, 1, &vbo);
+    render_target_destroy(&target);
+
+    // asking for more than the limits fails up front and creates nothing
+    const struct render_target_desc too_many = { 16, 16, GL_RGBA8, 0, 1, RENDER_TARGET_MAX_COLORS + 1 };
+    ck_assert_int_eq(render_target_create(&target, &too_many), GL_INVALID_VALUE);
+    render_target_destroy(&target);
+}
+END_TEST
+
+/* Orders triangles after rotating each to start at its smallest index, which keeps the winding. */
+static int compare_triangles(const void *a, const void *b)
+{
+    return memcmp(a, b, 3 * sizeof(uint32_t));
+}
+
+static void canonical_triangles(uint32_t *indices, uint32_t index_count)
+{
+    for (uint32_t t = 0; t < index_count; t += 3) {
+        uint32_t *v = indices + t;
+
+        while (v[0] > v[1] || v[0] > v[2]) {
+            uint32_t first = v[0];
+            v[0] = v[1];
+            v[1] = v[2];
+            v[2] = first;
+        }
+    }
+    qsort(indices, index_count / 3, 3 * sizeof(uint32_t), compare_triangles);
+}
+
+START_TEST(the_vertex_cache_optimizer_keeps_every_triangle_and_lowers_the_miss_ratio)
+{
+    struct mesh mesh;
+
+    ck_assert_int_eq(mesh_create_grid(&mesh, 512), 0);
+    ck_assert_int_eq(mesh_triangle_count(&mesh), 512);
+    ck_assert_int_eq(mesh.patch_vertex_count, 17 * 17);
+
+    size_t bytes = mesh.patch_index_count * sizeof(uint32_t);
+    uint32_t *original = malloc(bytes);
+    uint32_t *reordered = malloc(bytes);
+    memcpy(original, mesh.patch_indices, bytes);
+    memcpy(reordered, mesh.patch_indices, bytes);
+
+    mesh_shuffle_triangles(reordered, mesh.patch_index_count, 7);
+    double shuffled = mesh_acmr(reordered, mesh.patch_index_count, MESH_CACHE_SIZE);
+    ck_assert_int_eq(mesh_optimize_vertex_cache(reordered, mesh.patch_index_count, mesh.patch_vertex_count), 0);
+    double optimized = mesh_acmr(reordered, mesh.patch_index_count, MESH_CACHE_SIZE);
+
+    // a grid has about one vertex per two triangles, so 0.5 is the floor
+    ck_assert_msg(optimized < 0.75 && optimized < shuffled / 2, "ACMR %.3f shuffled, %.3f optimized", shuffled,
+                  optimized);
+    ck_assert(optimized < mesh_acmr(original, mesh.patch_index_count, MESH_CACHE_SIZE));
+
+    canonical_triangles(original, mesh.patch_index_count);
+    canonical_triangles(reordered, mesh.patch_index_count);
+    ck_assert(memcmp(original, reordered, bytes) == 0);
+
+    free(original);
+    free(reordered);
+    mesh_destroy(&mesh);
+}
+END_TEST
+
+START_TEST(every_vertex_layout_renders_what_the_float_layout_renders)
+{
+    static const char *vs =
+        "#version 410\n"
+        "layout(location = 0) in vec3 position;\n"
+        "layout(location = 1) in vec3 normal;\n"
+        "layout(location = 2) in vec2 uv;\n"
+        "layout(location = 3) in vec4 color;\n"
+        "out vec4 shade;\n"
+        "void main()\n"
+        "{\n"
+        "    shade = vec4(color.rgb * max(normal.z, 0.0), 1.0) * (0.5 + 0.5 * uv.x);\n"
+        "    gl_Position = vec4(position.xy, position.z * 0.5, 1.0);\n"
+        "}\n";
+    static const char *fs =
+        "#version 410\n"
+        "in vec4 shade;\n"
+        "out vec4 color;\n"
+        "void main()\n"
+        "{\n"
+        "    color = shade;\n"
+        "}\n";
+    const struct render_target_desc desc = { 64, 64, GL_RGBA8, 0, 1, 1 };
+    const uint8_t tolerance[4] = { 4, 4, 4, 0 };
+    struct render_target target;
+    struct mesh mesh;
+    static GLubyte expected[64 * 64 * 4], actual[64 * 64 * 4];
+    GLuint buffers[2], vao;
+
+    ck_assert_int_eq(mesh_create_grid(&mesh, 512), 0);
+    struct vertex *vertices = malloc(mesh.patch_vertex_count * sizeof(struct vertex));
+    unsigned char *packed = malloc(mesh.patch_vertex_count * sizeof(struct vertex));
+    vertex_layout_fill_patch(&mesh, 0, vertices);
+
+    ck_assert_int_eq(render_target_create(&target, &desc), GL_FRAMEBUFFER_COMPLETE);
+    GLuint shader_program = program_cache_get(&program_cache, vs, fs);
+    ck_assert_uint_ne(shader_program, 0);
+    name_pool_gen(&context_names, NAME_POOL_BUFFER, 2, buffers);
+
+    render_target_bind(&target);
+    glUseProgram(shader_program);
+    for (int l = 0; l < vertex_layout_count; l++) {
+        struct image_compare_result result;
+
+        vertex_layout_pack(&vertex_layouts[l], vertices, mesh.patch_vertex_count, packed);
+        glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+        glBufferData(GL_ARRAY_BUFFER, vertex_layout_stride(&vertex_layouts[l]) * mesh.patch_vertex_count, packed,
+                     GL_STATIC_DRAW);
+        name_pool_gen(&context_names, NAME_POOL_VERTEX_ARRAY, 1, &vao);
+        glBindVertexArray(vao);
+        vertex_layout_set_pointers(&vertex_layouts[l], mesh.patch_vertex_count);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.patch_index_count * sizeof(uint32_t), mesh.patch_indices,
+                     GL_STATIC_DRAW);
+
+        glClear(GL_COLOR_BUFFER_BIT);
+        glDrawElements(GL_TRIANGLES, mesh.patch_index_count, GL_UNSIGNED_INT, NULL);
+        glReadPixels(0, 0, 64, 64, GL_RGBA, GL_UNSIGNED_BYTE, l == 0 ? expected : actual);
+
+        glBindVertexArray(0);
+        name_pool_delete(&context_names, NAME_POOL_VERTEX_ARRAY, 1, &vao);
+        if (l > 0) {
+            ck_assert_msg(image_compare_rgba8(actual, expected, 64, 64, tolerance, &result) == 0,
+                          "%s: %llu pixel(s) off by up to %d", vertex_layouts[l].name,
+                          (unsigned long long) result.mismatches, result.max_channel_difference);
+        }
+    }
+    // the heightfield is lit and covers every pixel, so a broken layout cannot match by accident
+    ck_assert_int_ne(expected[4 * (32 * 64 + 16)], expected[4 * (32 * 64 + 48)]);
+
+    glUseProgram(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteProgram(shader_program);
+    name_pool_delete(&context_names, NAME_POOL_BUFFER, 2, buffers);
+    render_target_destroy(&target);
+    free(vertices);
+    free(packed);
+    mesh_destroy(&mesh);
+}
+END_TEST
+
+START_TEST(transform_feedback_kernels_match_the_cpu_reference)
+{
+    const struct feedback_params params = { -1.5f, 0.05f, 9.81f, 0.99f, 0.75f };
+    const uint32_t count = 1024;
+    struct particle *particles = malloc(count * sizeof(struct particle));
+    float *x = malloc(count * sizeof(float)), *y = malloc(count * sizeof(float));
+    void *expected = malloc(count * sizeof(struct particle));
+    void *actual = malloc(count * sizeof(struct particle));
+    void *simd = malloc(count * sizeof(struct particle));
+
+    for (uint32_t i = 0; i < count; i++) {
+        x[i] = (float) i / count - 0.5f;
+        y[i] = 100.0f - (float) i / 7.0f;
+        // every fourth particle starts just above the floor and falls through it
+        particles[i] = (struct particle) { { (float) i, i % 4 == 0 ? 0.01f : 1.0f + i, -(float) i, 1.0f },
+                                           { 1.0f, i % 4 == 0 ? -2.0f : 0.5f, 0.25f, 0.0f } };
+    }
+
+    for (int k = 0; k < FEEDBACK_KERNEL_COUNT; k++) {
+        const void *inputs[2] = { k == FEEDBACK_SAXPY ? (void *) x : (void *) particles, y };
+        GLsizeiptr bytes = count * feedback_element_bytes(k);
+        struct feedback_compute compute;
+        GLuint buffers[3];
+
+        ck_assert_int_eq(feedback_compute_init(&compute, k), 0);
+        name_pool_gen(&context_names, NAME_POOL_BUFFER, 3, buffers);
+        for (int b = 0; b < 3; b++) {
+            glBindBuffer(GL_ARRAY_BUFFER, buffers[b]);
+            glBufferData(GL_ARRAY_BUFFER, bytes, b < 2 ? inputs[k == FEEDBACK_SAXPY ? b : 0] : NULL,
+                         GL_STATIC_DRAW);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        ck_assert_int_eq(feedback_compute_run(&compute, buffers, buffers[2], count, &params), 0);
+        glBindBuffer(GL_COPY_READ_BUFFER, buffers[2]);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, bytes, actual);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        ck_assert_int_eq(feedback_compute_run(&compute, buffers, buffers[2], count - 1, &params),
+                         k == FEEDBACK_SAXPY ? -1 : 0);
+
+        ck_assert_int_eq(feedback_cpu_run_with(FEEDBACK_CPU_SCALAR, k, inputs, expected, count, &params), 0);
+        float error = feedback_max_error(k, actual, expected, count);
+        ck_assert_msg(error <= FEEDBACK_COMPUTE_TOLERANCE, "%s: the GPU is off by %g", feedback_kernel_name(k),
+                      error);
+
+        for (enum feedback_cpu_isa isa = FEEDBACK_CPU_SSE2; isa <= FEEDBACK_CPU_AVX2; isa++) {
+            if (!feedback_cpu_isa_supported(isa)) {
+                ck_assert_int_eq(feedback_cpu_run_with(isa, k, inputs, simd, count, &params), -1);
+                continue;
+            }
+            // an odd count leaves a tail for the scalar loop
+            memset(simd, 0, bytes);
+            ck_assert_int_eq(feedback_cpu_run_with(isa, k, inputs, simd, count - 1, &params), 0);
+            ck_assert_msg(memcmp(simd, expected, bytes - feedback_element_bytes(k)) == 0, "%s: %s differs",
+                          feedback_kernel_name(k), feedback_cpu_isa_name(isa));
+        }
+
+        name_pool_delete(&context_names, NAME_POOL_BUFFER, 3, buffers);
+        feedback_compute_destroy(&compute);
+    }
+    // the floor was hit, so the bounce was checked too
+    ck_assert(((struct particle *) expected)[0].velocity[1] > 0.0f);
+
+    free(particles);
+    free(x);
+    free(y);
+    free(expected);
+    free(actual);
+    free(simd);
+}
+END_TEST
+
+START_TEST(every_texture_upload_path_delivers_every_format)
+{
+    // odd sizes, so GL_RGB and GL_RED rows need an unpack alignment of 1
+    const GLsizei width = 61, height = 37;
+    const int frames = 3;
+    unsigned char *pixels = malloc((size_t) width * height * 8);
+    unsigned char *check = malloc((size_t) width * height * 8);
+
+    for (int f = 0; f < texture_upload_format_count; f++) {
+        const struct texture_upload_format *format = &texture_upload_formats[f];
+        size_t bytes = (size_t) width * height * format->bytes_per_pixel;
+
+        for (int p = 0; p < TEXTURE_UPLOAD_PATH_COUNT; p++) {
+            struct texture_upload_ring ring;
+            GLuint texture;
+
+            name_pool_gen(&context_names, NAME_POOL_TEXTURE, 1, &texture);
+            if (p != TEXTURE_UPLOAD_TEX_IMAGE) {
+                texture_upload_allocate(texture, format, width, height);
+            }
+            // two slots for three frames, so a slot is reused after its fence
+            ck_assert_int_eq(texture_upload_ring_init(&ring, 2, bytes), 0);
+
+            for (int frame = 0; frame < frames; frame++) {
+                for (size_t i = 0; i < bytes; i++) {
+                    pixels[i] = (unsigned char) (i * 7 + frame * 31);
+                }
+                if (format->type == GL_HALF_FLOAT) {
+                    for (size_t i = 1; i < bytes; i += 2) {
+                        pixels[i] &= 0xbb;  // finite halves only
+                    }
+                }
+                ck_assert_int_eq(texture_upload(p, &ring, texture, format, width, height, pixels), 0);
+            }
+
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glGetTexImage(GL_TEXTURE_2D, 0, format->format, format->type, check);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            glPixelStorei(GL_PACK_ALIGNMENT, 4);
+            ck_assert_msg(memcmp(check, pixels, bytes) == 0, "%s through %s: the texture is not the last frame",
+                          format->name, texture_upload_path_name(p));
+
+            GLint alignment;
+            glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+            ck_assert_int_eq(alignment, 4);
+
+            texture_upload_ring_destroy(&ring);
+            name_pool_delete(&context_names, NAME_POOL_TEXTURE, 1, &texture);
+        }
+    }
+    ck_assert_int_eq(texture_upload_alignment(61 * 3), 1);
+    ck_assert_int_eq(texture_upload_alignment(64 * 3), 8);
+    ck_assert_int_eq(texture_upload_alignment(6), 2);
+
+    free(pixels);
+    free(check);
+}
+END_TEST
+
+START_TEST(the_loader_hands_buffers_and_textures_over_from_worker_threads)
+{
+    glc_attrib attribs[] = { GLC_ATTRIB_CORE_PROFILE, GLC_ATTRIB_END };
+    struct loader_request requests[9];
+    unsigned char data[8][16 * 16 * 4], check[16 * 16 * 4];
+    glc_pixel_format *pixel_format;
+    struct loader loader;
+    int seen[2] = { 0, 0 };
+
+    ck_assert_int_eq(glc_choose_pixel_format(attribs, &pixel_format, NULL), GLC_NO_ERROR);
+    ck_assert_int_eq(loader_init(&loader, pixel_format, shared_context, 2), 0);
+
+    memset(requests, 0, sizeof(requests));
+    for (int i = 0; i < 8; i++) {
+        for (size_t b = 0; b < sizeof(data[i]); b++) {
+            data[i][b] = (unsigned char) (b * 13 + i * 41);
+        }
+        requests[i].kind = i % 2 ? LOADER_BUFFER : LOADER_TEXTURE;
+        requests[i].data = data[i];
+        requests[i].size = sizeof(data[i]);
+        requests[i].format = &texture_upload_formats[1];
+        requests[i].width = 16;
+        requests[i].height = 16;
+        ck_assert_int_eq(loader_submit(&loader, &requests[i]), 0);
+    }
+    // a buffer GL refuses to make comes back failed, not lost
+    requests[8].kind = LOADER_BUFFER;
+    requests[8].size = -1;
+    ck_assert_int_eq(loader_submit(&loader, &requests[8]), 0);
+
+    for (int i = 0; i < 9; i++) {
+        struct loader_request *request = loader_collect(&loader, 10000000000u);
+
+        ck_assert_ptr_ne(request, NULL);
+        ck_assert_ptr_eq(request->fence, NULL);
+        ck_assert(request->worker == 0 || request->worker == 1);
+        seen[request->kind]++;
+        if (request == &requests[8]) {
+            ck_assert_int_eq(request->failed, 1);
+            ck_assert_uint_eq(request->name, 0);
+            continue;
+        }
+
+        // the objects were made on the workers' contexts and read here
+        ck_assert_int_eq(request->failed, 0);
+        if (request->kind == LOADER_BUFFER) {
+            ck_assert(glIsBuffer(request->name));
+            glBindBuffer(GL_COPY_READ_BUFFER, request->name);
+            glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(check), check);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            glDeleteBuffers(1, &request->name);
+        } else {
+            ck_assert(glIsTexture(request->name));
+            glBindTexture(GL_TEXTURE_2D, request->name);
+            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, check);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            glDeleteTextures(1, &request->name);
+        }
+        ck_assert(memcmp(check, request->data, sizeof(check)) == 0);
+    }
+    ck_assert_int_eq(seen[LOADER_TEXTURE], 4);
+    ck_assert_int_eq(seen[LOADER_BUFFER], 5);
+    ck_assert_ptr_eq(loader_collect(&loader, 0), NULL);
+
+    loader_destroy(&loader);
+    glc_destroy_pixel_format(pixel_format);
+    ck_assert_ptr_eq(glc_get_current_context(), shared_context);
+}
+END_TEST
+
+START_TEST(the_frame_loop_delivers_every_frame_through_every_buffer)
+{
+    struct frame_loop_config config = { 3, 12, 2, 64, 64 };
+    struct frame_loop_config too_many = { FRAME_LOOP_MAX_BUFFERS + 1, 12, 2, 64, 64 };
+    struct frame_loop loop;
+    struct frame_loop_result result;
+    double frame_ms[12], latency_ms[12];
+    GLint binding;
+
+    ck_assert_int_eq(frame_loop_init(&loop, &too_many), -1);
+
+    for (int buffers = 1; buffers <= FRAME_LOOP_MAX_BUFFERS; buffers++) {
+        config.buffers = buffers;
+        ck_assert_int_eq(frame_loop_init(&loop, &config), 0);
+        memset(latency_ms, 0, sizeof(latency_ms));
+
+        ck_assert_int_eq(frame_loop_run(&loop, frame_ms, latency_ms, &result), 0);
+        ck_assert_int_eq(result.wrong_frames, 0);
+        ck_assert_int_eq(loop.ring.pending, 0);
+        for (int f = 0; f < config.frames; f++) {
+            ck_assert_msg(frame_ms[f] > 0.0, "frame %d took no time with %d buffer(s)", f, buffers);
+            // a frame is read back after it started, so a 0 means it never was
+            ck_assert_msg(latency_ms[f] > 0.0, "frame %d was not delivered with %d buffer(s)", f, buffers);
+        }
+        ck_assert_msg(result.elapsed_ms > 0.0, "the run took no time");
+
+        frame_loop_destroy(&loop);
+    }
+
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &binding);
+    ck_assert_int_eq(binding, 0);
+    glGetIntegerv(GL_CURRENT_PROGRAM, &binding);
+    ck_assert_int_eq(binding, 0);
+    ck_assert_int_eq(glGetError(), GL_NO_ERROR);
+}
+END_TEST
+
+START_TEST(every_shader_corpus_variant_links_serially_in_parallel_and_on_workers)
+{
+    static const enum shader_corpus_mode modes[] = { SHADER_CORPUS_SERIAL, SHADER_CORPUS_PARALLEL, SHADER_CORPUS_WORKERS };
+    glc_attrib attribs[] = { GLC_ATTRIB_CORE_PROFILE, GLC_ATTRIB_END };
+    struct shader_corpus corpus, resalted;
+    struct shader_corpus_result results[8];
+    glc_pixel_format *pixel_format;
+    struct loader loader;
+
+    ck_assert_int_eq(glc_choose_pixel_format(attribs, &pixel_format, NULL), GLC_NO_ERROR);
+    ck_assert_int_eq(loader_init(&loader, pixel_format, shared_context, 2), 0);
+    ck_assert_int_eq(shader_corpus_generate(&corpus, 8, 1), 0);
+    ck_assert_int_eq(shader_corpus_generate(&resalted, 8, 2), 0);
+
+    // the salt keeps a driver's shader cache from hitting on another run's corpus
+    for (int i = 0; i < 8; i++) {
+        ck_assert_uint_eq(corpus.variants[i].features, (unsigned) i);
+        ck_assert_int_eq(corpus.variants[i].light_count, 1);
+        ck_assert_str_ne(corpus.variants[i].fs_source, resalted.variants[i].fs_source);
+        for (int j = 0; j < i; j++) {
+            ck_assert_str_ne(corpus.variants[i].vs_source, corpus.variants[j].vs_source);
+        }
+    }
+
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        ck_assert_int_eq(shader_corpus_compile(&corpus, modes[m], &loader, results), 0);
+
+        for (int i = 0; i < 8; i++) {
+            GLuint program = results[i].program;
+            unsigned features = corpus.variants[i].features;
+
+            ck_assert_msg(program != 0 && glIsProgram(program), "mode %zu variant %d did not link", m, i);
+            ck_assert_msg(results[i].ready_ns > 0, "mode %zu variant %d was never ready", m, i);
+            // the defines reach the compiler: each feature's uniform exists only with it
+            ck_assert_int_ne(glGetUniformLocation(program, "light_position[0]"), -1);
+            ck_assert_int_eq(glGetUniformLocation(program, "bones[0]") != -1, (features & SHADER_CORPUS_SKINNING) != 0);
+            ck_assert_int_eq(glGetUniformLocation(program, "normal_map") != -1,
+                             (features & SHADER_CORPUS_NORMAL_MAP) != 0);
+            ck_assert_int_eq(glGetUniformLocation(program, "shadow_map") != -1, (features & SHADER_CORPUS_SHADOWS) != 0);
+            glDeleteProgram(program);
+        }
+    }
+
+    shader_corpus_destroy(&resalted);
+    shader_corpus_destroy(&corpus);
+    ck_assert_ptr_eq(corpus.variants, NULL);
+    loader_destroy(&loader);
+    glc_destroy_pixel_format(pixel_format);
+    ck_assert_ptr_eq(glc_get_current_context(), shared_context);
+    ck_assert_int_eq(glGetError(), GL_NO_ERROR);
+}
+END_TEST
+
+START_TEST(the_reference_raster_draws_what_the_gpu_draws_on_every_kernel)
+{
+    enum { width = 100, height = 70, triangles = 24 }; // 2 x 2 tiles, neither a whole one
+    static GLubyte gpu[width * height * 4], cpu[width * height * 4], first[width * height * 4];
+    float vertices[triangles * 6];
+    struct reference_scene scene = { vertices, triangles * 3, { 0.0f, 0.0f, 0.0f, 1.0f }, { 1.0f, 1.0f, 1.0f, 1.0f } };
+    struct draw_pipeline pipeline;
+    const uint8_t exact[4] = { 0, 0, 0, 0 };
+    struct image_compare_result result;
+    uint32_t seed = 5;
+
+    // half the triangles have every vertex on a pixel center, so edges run through centers and the
+    // tie rule decides them, the first two making a rectangle for horizontal and vertical edges;
+    // the other half lie anywhere, so pixels next to their corners test the bounding boxes
+    const float rectangle[12] = { 10, 20, 40, 20, 40, 50, 10, 20, 40, 50, 10, 50 };
+    for (int i = 0; i < triangles * 3; i++) {
+        float x, y;
+
+        if (i < 6) {
+            x = rectangle[i * 2];
+            y = rectangle[i * 2 + 1];
+        } else {
+            seed = seed * 1103515245u + 12345u;
+            x = (float) (seed >> 8 & 0xFFFF) * width / 65536;
+            seed = seed * 1103515245u + 12345u;
+            y = (float) (seed >> 8 & 0xFFFF) * height / 65536;
+        }
+        if (i / 3 % 2 == 0) {
+            x = (int) x + 0.5f;
+            y = (int) y + 0.5f;
+        }
+        vertices[i * 2] = x * 2.0f / width - 1.0f;
+        vertices[i * 2 + 1] = y * 2.0f / height - 1.0f;
+    }
+
+    ck_assert_int_eq(draw_pipeline_create(&pipeline, width, height, vertices, triangles * 3), GL_FRAMEBUFFER_COMPLETE);
+    draw_pipeline_bind(&pipeline);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glDrawArrays(GL_TRIANGLES, 0, triangles * 3);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, gpu);
+    draw_pipeline_unbind();
+    draw_pipeline_destroy(&pipeline);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+
+    ck_assert_int_eq(reference_raster_render_with(REFERENCE_RASTER_SCALAR, 1, &scene, width, height, first), 0);
+    for (int isa = REFERENCE_RASTER_SCALAR; isa <= REFERENCE_RASTER_AVX2; isa++) {
+        if (!reference_raster_isa_supported(isa)) {
+            ck_assert_int_eq(reference_raster_render_with(isa, 1, &scene, width, height, cpu), -1);
+            continue;
+        }
+        for (int threads = 1; threads <= 3; threads += 2) {
+            memset(cpu, 0x55, sizeof(cpu));
+            ck_assert_int_eq(reference_raster_render_with(isa, threads, &scene, width, height, cpu), 0);
+            ck_assert_msg(memcmp(cpu, first, sizeof(cpu)) == 0, "%s on %d thread(s) differs from scalar",
+                          reference_raster_isa_name(isa), threads);
+        }
+    }
+
+    // llvmpipe snaps, ties and rounds as the reference does, so it must match to the pixel;
+    // other rasterizers may put a few pixels right on the edges the other way, as in the draw test
+    const int llvmpipe = strstr((const char *) glGetString(GL_RENDERER), "llvmpipe") != NULL;
+    image_compare_rgba8(gpu, first, width, height, exact, &result);
+    ck_assert_msg(result.mismatches <= (llvmpipe ? 0u : 32u), "%llu pixel(s) differ from the GPU's in (%d, %d)-(%d, %d)",
+                  (unsigned long long) result.mismatches, result.min_x, result.min_y, result.max_x, result.max_y);
+
+    // an edge that passes 0.0003 pixels from (25.5, 501.5) at 1080p, on the side the fused
+    // multiply-add of llvmpipe's viewport transform puts it, and on the other if it were rounded twice
+    const float near_miss[6] = { -0.960455298f, -0.12815246f, -0.976834059f, -0.0564178415f, -0.938445985f,
+                                 -0.112477109f };
+    struct reference_scene near_miss_scene = { near_miss, 3, { 0.0f, 0.0f, 0.0f, 1.0f }, { 1.0f, 1.0f, 1.0f, 1.0f } };
+    if (llvmpipe) {
+        GLubyte *gpu_1080p = malloc((size_t) 1920 * 1080 * 4), *cpu_1080p = malloc((size_t) 1920 * 1080 * 4);
+
+        ck_assert(gpu_1080p != NULL && cpu_1080p != NULL);
+        ck_assert_int_eq(draw_pipeline_create(&pipeline, 1920, 1080, near_miss, 3), GL_FRAMEBUFFER_COMPLETE);
+        draw_pipeline_bind(&pipeline);
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glReadPixels(0, 0, 1920, 1080, GL_RGBA, GL_UNSIGNED_BYTE, gpu_1080p);
+        draw_pipeline_unbind();
+        draw_pipeline_destroy(&pipeline);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        ck_assert_int_eq(reference_raster_render(&near_miss_scene, 1920, 1080, cpu_1080p), 0);
+        image_compare_rgba8(gpu_1080p, cpu_1080p, 1920, 1080, exact, &result);
+        free(gpu_1080p);
+        free(cpu_1080p);
+        ck_assert_msg(result.mismatches == 0,
+                      "%llu pixel(s) of the near miss differ from the GPU's in (%d, %d)-(%d, %d)",
+                      (unsigned long long) result.mismatches, result.min_x, result.min_y, result.max_x, result.max_y);
+    }
+
+    // a vertex the fixed point cannot hold is refused, not drawn wrong
+    vertices[0] = 1e6f;
+    ck_assert_int_eq(reference_raster_render(&scene, width, height, cpu), -1);
+    ck_assert_int_eq(glGetError(), GL_NO_ERROR);
+}
+END_TEST
+
+START_TEST(the_regression_gate_flags_a_shifted_sample_and_not_noise)
+{
+    const double baseline[] = { 10.2, 9.8, 10.1, 10.4, 9.9, 10.0, 10.3, 9.7 };
+    const double same[] = { 10.0, 10.2, 9.9, 10.1, 9.8, 10.3, 9.7, 10.4 };
+    const double slower[] = { 11.2, 11.0, 11.5, 10.9, 11.3, 11.1, 11.4, 10.8 };
+    const double faster[] = { 9.0, 9.1, 8.9, 9.2, 8.8, 9.3, 9.4, 8.7 };
+
+    ck_assert(test_report_mann_whitney(baseline, 8, same, 8) > 0.3);
+    ck_assert(test_report_mann_whitney(baseline, 8, slower, 8) < TEST_REPORT_ALPHA);
+    // one-sided: getting faster is not a regression
+    ck_assert(test_report_mann_whitney(baseline, 8, faster, 8) > 0.99);
+    // all ties carry no evidence either way
+    ck_assert(test_report_mann_whitney(same, 1, same, 1) >= 0.5);
+}
+END_TEST
+
+START_TEST(the_stream_buffer_hands_out_ranges_around_the_ring)
+{
+    struct draw_pipeline pipeline;
+    struct stream_buffer stream;
+    GLintptr offsets[10];
+    GLubyte pixels[10][4];
+    float chunk[250];   // 1000 bytes: the triangle, then filler
+
+    draw_pipeline_create(&pipeline, 16, 16, triangle, 3);
+    int err1 = stream_buffer_init(&stream, GL_ARRAY_BUFFER, 4096);
+    draw_pipeline_bind(&pipeline);
+    glBindBuffer(GL_ARRAY_BUFFER, stream.buffer);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
 
+    for (int frame = 0; frame < 10; frame++) {
+        for (int i = 0; i < 250; i++) {
+            chunk[i] = i < 6 ? triangle[i] : (float) frame;
+        }
+        void *data = stream_buffer_map(&stream, sizeof(chunk), &offsets[frame]);
+        memcpy(data, chunk, sizeof(chunk));
+        stream_buffer_unmap(&stream);
+
+        glClear(GL_COLOR_BUFFER_BIT);
+        glDrawArrays(GL_TRIANGLES, offsets[frame] / (2 * sizeof(float)), 3);
+        stream_buffer_fence(&stream);
+        glReadPixels(8, 8, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels[frame]);
+    }
+
+    float last_chunk[250];
+    glGetBufferSubData(GL_ARRAY_BUFFER, offsets[9], sizeof(last_chunk), last_chunk);
+
+    glBindBuffer(GL_ARRAY_BUFFER, pipeline.vbo);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    draw_pipeline_unbind();
+    stream_buffer_destroy(&stream);
+    draw_pipeline_destroy(&pipeline);
+
+    ck_assert_int_eq(err1, 0);
+    ck_assert_int_eq(glGetError(), GL_NO_ERROR);
+    for (int frame = 0; frame < 10; frame++) {
+        ck_assert_int_eq(offsets[frame], (frame % 4) * 1024); // 4 aligned 1000 byte ranges per lap
+        ck_assert_int_eq(pixels[frame][0], 0xFF);
+    }
+    ck_assert(last_chunk[5] == triangle[5]);
+    ck_assert(last_chunk[249] == 9.0f);
+}
+END_TEST
+
+START_TEST(we_can_read_from_a_fbo_with_glReadPixels)
+{
     GLuint framebuffer_name = 0;
-    glGenFramebuffers(1, &framebuffer_name);
+    name_pool_gen(&context_names, NAME_POOL_FRAMEBUFFER, 1, &framebuffer_name);
     glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_name);
 
     GLuint rendered_texture;
-    glGenTextures(1, &rendered_texture);
+    name_pool_gen(&context_names, NAME_POOL_TEXTURE, 1, &rendered_texture);
     glBindTexture(GL_TEXTURE_2D, rendered_texture);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, 0);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -161,8 +1237,11 @@ START_TEST(we_can_read_from_a_fbo_with_glReadPixels)
     GLubyte pixels[4] = { };
     glReadPixels(0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
 
+    name_pool_delete(&context_names, NAME_POOL_TEXTURE, 1, &rendered_texture);
+    name_pool_delete(&context_names, NAME_POOL_FRAMEBUFFER, 1, &framebuffer_name);
+    glClearColor(0.0, 0.0, 0.0, 0.0);
+
     GLenum err = glGetError();
-    CGLDestroyContext(context);
 
     ck_assert_int_eq(err, GL_NO_ERROR);
     ck_assert_int_eq(pixels[0], 0xFF);
@@ -174,319 +1253,179 @@ END_TEST
 
 START_TEST(we_can_bind_a_buffer_to_the_transform_feedback_target)
 {
-    CGLPixelFormatAttribute attribs[3] = {
-        kCGLPFAOpenGLProfile,
-        (CGLPixelFormatAttribute) kCGLOGLPVersion_GL4_Core,
-        (CGLPixelFormatAttribute) 0
-    };
-    CGLPixelFormatObj pixel_format;
-    GLint number_pixel_formats = 0;
-    CGLContextObj context;
-
-    CGLChoosePixelFormat(attribs, &pixel_format, &number_pixel_formats);
-    CGLCreateContext(pixel_format, NULL, &context);
-    CGLDestroyPixelFormat(pixel_format);
-    CGLSetCurrentContext(context);
-
     GLuint buffer;
 
-    glGenBuffers(1, &buffer);
-    GLenum err1 = glGetError();
-
+    // any error along the way fails the test in shared_context_verify
+    name_pool_gen(&context_names, NAME_POOL_BUFFER, 1, &buffer);
     glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, buffer);
-    GLenum err2 = glGetError();
+    glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, 0);
+    name_pool_delete(&context_names, NAME_POOL_BUFFER, 1, &buffer);
 
-    glDeleteBuffers(1, &buffer);
-    GLenum err3 = glGetError();
-
-    CGLDestroyContext(context);
-
-    ck_assert_int_eq(err1, GL_NO_ERROR);
-    ck_assert_int_eq(err2, GL_NO_ERROR);
-    ck_assert_int_eq(err3, GL_NO_ERROR);
+    ck_assert_int_eq(glIsBuffer(buffer), GL_FALSE);
 }
 END_TEST
 
 START_TEST(we_can_create_a_vertex_array_object)
 {
-    CGLPixelFormatAttribute attribs[3] = {
-        kCGLPFAOpenGLProfile,
-        (CGLPixelFormatAttribute) kCGLOGLPVersion_GL4_Core,
-        (CGLPixelFormatAttribute) 0
-    };
-    CGLPixelFormatObj pixel_format;
-    GLint number_pixel_formats = 0;
-    CGLContextObj context;
-
-    CGLChoosePixelFormat(attribs, &pixel_format, &number_pixel_formats);
-    CGLCreateContext(pixel_format, NULL, &context);
-    CGLDestroyPixelFormat(pixel_format);
-    CGLSetCurrentContext(context);
-
     GLuint vao;
 
-    glGenVertexArrays(1, &vao);
-    GLenum err1 = glGetError();
+    // any error along the way fails the test in shared_context_verify
+    name_pool_gen(&context_names, NAME_POOL_VERTEX_ARRAY, 1, &vao);
     glBindVertexArray(vao);
-    GLenum err2 = glGetError();
     glEnableVertexAttribArray(0);
-    GLenum err3 = glGetError();
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-    GLenum err4 = glGetError();
-    glDeleteVertexArrays(1, &vao);
-    GLenum err5 = glGetError();
-
-    CGLDestroyContext(context);
+    glBindVertexArray(0);
+    name_pool_delete(&context_names, NAME_POOL_VERTEX_ARRAY, 1, &vao);
 
-    ck_assert_int_eq(err1, GL_NO_ERROR);
-    ck_assert_int_eq(err2, GL_NO_ERROR);
-    ck_assert_int_eq(err3, GL_NO_ERROR);
-    ck_assert_int_eq(err4, GL_NO_ERROR);
-    ck_assert_int_eq(err5, GL_NO_ERROR);
+    ck_assert_int_eq(glIsVertexArray(vao), GL_FALSE);
 }
 END_TEST
 
 START_TEST(we_can_bind_a_framebuffer_to_a_renderbuffer)
 {
-    CGLPixelFormatAttribute attribs[3] = {
-        kCGLPFAOpenGLProfile,
-        (CGLPixelFormatAttribute) kCGLOGLPVersion_GL4_Core,
-        (CGLPixelFormatAttribute) 0
-    };
-    CGLPixelFormatObj pixel_format;
-    GLint number_pixel_formats = 0;
-    CGLContextObj context;
-
-    CGLChoosePixelFormat(attribs, &pixel_format, &number_pixel_formats);
-    CGLCreateContext(pixel_format, NULL, &context);
-    CGLDestroyPixelFormat(pixel_format);
-    CGLSetCurrentContext(context);
-
     GLuint framebuffer_name = 0;
-    glGenFramebuffers(1, &framebuffer_name);
+    // any error along the way fails the test in shared_context_verify
+    name_pool_gen(&context_names, NAME_POOL_FRAMEBUFFER, 1, &framebuffer_name);
     glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_name);
 
     GLuint width = 256;
     GLuint height = 256;
 
     GLuint color_renderbuffer;
-    glGenRenderbuffers(1, &color_renderbuffer);
+    name_pool_gen(&context_names, NAME_POOL_RENDERBUFFER, 1, &color_renderbuffer);
     glBindRenderbuffer(GL_RENDERBUFFER, color_renderbuffer);
     glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_renderbuffer);
 
-    GLenum err1 = glGetError();
-
     GLuint depth_renderbuffer;
-    glGenRenderbuffers(1, &depth_renderbuffer);
+    name_pool_gen(&context_names, NAME_POOL_RENDERBUFFER, 1, &depth_renderbuffer);
     glBindRenderbuffer(GL_RENDERBUFFER, depth_renderbuffer);
     glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, width, height);
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_renderbuffer);
 
-    GLenum err2 = glGetError();
-
     GLenum draw_buffers[1] = {GL_COLOR_ATTACHMENT0};
     glDrawBuffers(1, draw_buffers); // "1" is the size of DrawBuffers
 
     GLenum err = glCheckFramebufferStatus(GL_FRAMEBUFFER);
 
-    glDeleteFramebuffers(1, &framebuffer_name);
-    CGLDestroyContext(context);
+    name_pool_delete(&context_names, NAME_POOL_RENDERBUFFER, 1, &color_renderbuffer);
+    name_pool_delete(&context_names, NAME_POOL_RENDERBUFFER, 1, &depth_renderbuffer);
+    name_pool_delete(&context_names, NAME_POOL_FRAMEBUFFER, 1, &framebuffer_name);
 
     ck_assert_int_eq(err, GL_FRAMEBUFFER_COMPLETE);
-    ck_assert_int_eq(err1, GL_NO_ERROR);
-    ck_assert_int_eq(err2, GL_NO_ERROR);
-
 }
 END_TEST
 
 
 START_TEST(we_can_bind_a_framebuffer_to_a_texture_for_drawing)
 {
-    CGLPixelFormatAttribute attribs[3] = {
-        kCGLPFAOpenGLProfile,
-        (CGLPixelFormatAttribute) kCGLOGLPVersion_GL4_Core,
-        (CGLPixelFormatAttribute) 0
-    };
-    CGLPixelFormatObj pixel_format;
-    GLint number_pixel_formats = 0;
-    CGLContextObj context;
-
-    CGLChoosePixelFormat(attribs, &pixel_format, &number_pixel_formats);
-    CGLCreateContext(pixel_format, NULL, &context);
-    CGLDestroyPixelFormat(pixel_format);
-    CGLSetCurrentContext(context);
-
     GLuint framebuffer_name = 0;
-    glGenFramebuffers(1, &framebuffer_name);
+    // any error along the way fails the test in shared_context_verify
+    name_pool_gen(&context_names, NAME_POOL_FRAMEBUFFER, 1, &framebuffer_name);
     glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_name);
 
     GLuint rendered_texture;
-    glGenTextures(1, &rendered_texture);
+    name_pool_gen(&context_names, NAME_POOL_TEXTURE, 1, &rendered_texture);
     glBindTexture(GL_TEXTURE_2D, rendered_texture);
     glTexImage2D(GL_TEXTURE_2D, 0,GL_RGB, 1, 1, 0,GL_RGB, GL_UNSIGNED_BYTE, 0);
-    GLenum err1 = glGetError();
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    GLenum err2 = glGetError();
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    GLenum err3 = glGetError();
     glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, rendered_texture, 0);
-    GLenum err4 = glGetError();
 
     GLenum draw_buffers[1] = {GL_COLOR_ATTACHMENT0};
     glDrawBuffers(1, draw_buffers); // "1" is the size of DrawBuffers
 
-    GLenum err5 = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-
-    ck_assert_int_eq(err1, GL_NO_ERROR);
-    ck_assert_int_eq(err2, GL_NO_ERROR);
-    ck_assert_int_eq(err3, GL_NO_ERROR);
-    ck_assert_int_eq(err4, GL_NO_ERROR);
-    ck_assert_int_eq(err5, GL_FRAMEBUFFER_COMPLETE);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
 
-    glDeleteFramebuffers(1, &framebuffer_name);
+    name_pool_delete(&context_names, NAME_POOL_TEXTURE, 1, &rendered_texture);
+    name_pool_delete(&context_names, NAME_POOL_FRAMEBUFFER, 1, &framebuffer_name);
 
-    CGLDestroyContext(context);
+    ck_assert_int_eq(status, GL_FRAMEBUFFER_COMPLETE);
 }
 END_TEST
 
 START_TEST(glGetError_returns_an_erorr_code_when_there_is_an_error)
 {
-    CGLPixelFormatAttribute attribs[3] = {
-        kCGLPFAOpenGLProfile,
-        (CGLPixelFormatAttribute) kCGLOGLPVersion_GL4_Core,
-        (CGLPixelFormatAttribute) 0
-    };
-    CGLPixelFormatObj pixel_format;
-    GLint number_pixel_formats = 0;
-    CGLContextObj context;
-
-    CGLChoosePixelFormat(attribs, &pixel_format, &number_pixel_formats);
-    CGLCreateContext(pixel_format, NULL, &context);
-    CGLDestroyPixelFormat(pixel_format);
-    CGLSetCurrentContext(context);
-
     glClearColor(1.0, 1.0, 1.0, 1.0);
     glClear(GL_COLOR); // this is not a valid input for glClear. Should be GL_COLOR_BUFFER_BIT
 
     GLenum err = glGetError();
 
+    glClearColor(0.0, 0.0, 0.0, 0.0);
+    gl_errors_clear(&context_errors); // raised on purpose
+
     ck_assert_int_eq(err, GL_INVALID_VALUE);
+}
+END_TEST
 
-    CGLDestroyContext(context);
+START_TEST(gl_errors_queues_an_error_whether_it_listens_or_polls)
+{
+    struct gl_errors polled;
+    char report[512];
+
+    gl_errors_init(&polled, 1);
+    glClear(GL_COLOR); // GL_INVALID_VALUE
+
+    // the shared context's queue has it already if the callback is installed
+    ck_assert_int_eq(gl_errors_collect(&context_errors), 1);
+    ck_assert_int_eq(gl_errors_format(&context_errors, report, sizeof(report)), 1);
+    ck_assert_msg(strstr(report, "error") != NULL, "%s", report);
+
+    if (context_errors.debug_output) {
+        // the flag is still set for whoever polls next
+        ck_assert_int_eq(gl_errors_collect(&polled), 1);
+        ck_assert_int_eq(polled.messages[0].type, GL_INVALID_VALUE);
+    }
+
+    gl_errors_clear(&context_errors);
+    ck_assert_int_eq(gl_errors_collect(&context_errors), 0);
+    ck_assert_int_eq(glGetError(), GL_NO_ERROR);
+    gl_errors_destroy(&polled);
 }
 END_TEST
 
 START_TEST(we_can_create_a_texture)
 {
-    CGLPixelFormatAttribute attribs[3] = {
-        kCGLPFAOpenGLProfile,
-        (CGLPixelFormatAttribute) kCGLOGLPVersion_GL4_Core,
-        (CGLPixelFormatAttribute) 0
-    };
-    CGLPixelFormatObj pixel_format;
-    GLint number_pixel_formats = 0;
-    CGLContextObj context;
-
-    CGLChoosePixelFormat(attribs, &pixel_format, &number_pixel_formats);
-    CGLCreateContext(pixel_format, NULL, &context);
-    CGLDestroyPixelFormat(pixel_format);
-    CGLSetCurrentContext(context);
-
     GLuint texture;
-    glGenTextures(1, &texture);
-    GLenum err1 = glGetError();
-    glBindTexture(GL_TEXTURE_2D, texture);
-    GLenum err2 = glGetError();
-    glDeleteTextures(1, &texture);
-    GLenum err3 = glGetError();
 
-    CGLDestroyContext(context);
-    GLenum err4 = glGetError();
+    // any error along the way fails the test in shared_context_verify
+    name_pool_gen(&context_names, NAME_POOL_TEXTURE, 1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    name_pool_delete(&context_names, NAME_POOL_TEXTURE, 1, &texture);
 
-    ck_assert_int_eq(err1, GL_NO_ERROR);
-    ck_assert_int_eq(err2, GL_NO_ERROR);
-    ck_assert_int_eq(err3, GL_NO_ERROR);
-    ck_assert_int_eq(err4, GL_NO_ERROR);
+    ck_assert_int_eq(glIsTexture(texture), GL_FALSE);
 }
 END_TEST
 
 START_TEST(we_can_create_a_frame_buffer_object)
 {
-    CGLPixelFormatAttribute attribs[3] = {
-        kCGLPFAOpenGLProfile,
-        (CGLPixelFormatAttribute) kCGLOGLPVersion_GL4_Core,
-        (CGLPixelFormatAttribute) 0
-    };
-    CGLPixelFormatObj pixel_format;
-    GLint number_pixel_formats = 0;
-    CGLContextObj context;
-
-    CGLChoosePixelFormat(attribs, &pixel_format, &number_pixel_formats);
-    CGLCreateContext(pixel_format, NULL, &context);
-    CGLDestroyPixelFormat(pixel_format);
-    CGLSetCurrentContext(context);
-
     GLuint framebuffer_name = 0;
-    glGenFramebuffers(1, &framebuffer_name);
-    GLenum err1 = glGetError();
 
+    // any error along the way fails the test in shared_context_verify
+    name_pool_gen(&context_names, NAME_POOL_FRAMEBUFFER, 1, &framebuffer_name);
     glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_name);
-    GLenum err2 = glGetError();
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    name_pool_delete(&context_names, NAME_POOL_FRAMEBUFFER, 1, &framebuffer_name);
 
-    glDeleteFramebuffers(1, &framebuffer_name);
-    GLenum err3 = glGetError();
-
-    CGLDestroyContext(context);
-    GLenum err4 = glGetError();
-
-    ck_assert_int_eq(err1, GL_NO_ERROR);
-    ck_assert_int_eq(err2, GL_NO_ERROR);
-    ck_assert_int_eq(err3, GL_NO_ERROR);
-    ck_assert_int_eq(err4, GL_NO_ERROR);
+    ck_assert_int_eq(glIsFramebuffer(framebuffer_name), GL_FALSE);
 }
 END_TEST
 
 START_TEST(we_can_put_data_into_and_get_data_out_of_a_buffer)
 {
-    CGLPixelFormatAttribute attribs[3] = {
-        kCGLPFAOpenGLProfile,
-        (CGLPixelFormatAttribute) kCGLOGLPVersion_GL4_Core,
-        (CGLPixelFormatAttribute) 0
-    };
-    CGLPixelFormatObj pixel_format;
-    GLint number_pixel_formats = 0;
-    CGLContextObj context;
-
-    CGLChoosePixelFormat(attribs, &pixel_format, &number_pixel_formats);
-    CGLCreateContext(pixel_format, NULL, &context);
-    CGLDestroyPixelFormat(pixel_format);
-    CGLSetCurrentContext(context);
-
     float data[5] = {1.0f, 2.0f, 3.0f, 4.0f, 5.0f};
     float output[5] = { };
 
     GLuint buffer;
 
-    glGenBuffers(1, &buffer);
-    GLenum err1 = glGetError();
-
+    // any error along the way fails the test in shared_context_verify
+    name_pool_gen(&context_names, NAME_POOL_BUFFER, 1, &buffer);
     glBindBuffer(GL_ARRAY_BUFFER, buffer);
     glBufferData(GL_ARRAY_BUFFER, sizeof(data), data, GL_STATIC_DRAW);
-    GLenum err2 = glGetError();
-
     glGetBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(output), output);
-    GLenum err3 = glGetError();
-
-    glDeleteBuffers(1, &buffer);
-    GLenum err4 = glGetError();
-
-    CGLDestroyContext(context);
-
-    ck_assert_int_eq(err1, GL_NO_ERROR);
-    ck_assert_int_eq(err2, GL_NO_ERROR);
-    ck_assert_int_eq(err3, GL_NO_ERROR);
-    ck_assert_int_eq(err4, GL_NO_ERROR);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    name_pool_delete(&context_names, NAME_POOL_BUFFER, 1, &buffer);
 
     ck_assert(data[0] ==  output[0]);
     ck_assert(data[1] ==  output[1]);
@@ -496,53 +1435,60 @@ START_TEST(we_can_put_data_into_and_get_data_out_of_a_buffer)
 }
 END_TEST
 
-START_TEST(we_can_create_a_buffer)
+START_TEST(every_buffer_readback_path_returns_the_buffer_contents)
 {
-    CGLPixelFormatAttribute attribs[3] = {
-        kCGLPFAOpenGLProfile,
-        (CGLPixelFormatAttribute) kCGLOGLPVersion_GL4_Core,
-        (CGLPixelFormatAttribute) 0
-    };
-    CGLPixelFormatObj pixel_format;
-    GLint number_pixel_formats = 0;
-    CGLContextObj context;
+    enum { size = 1 << 20, offset = 4096 };
+    uint32_t *data = malloc(size);
+    uint32_t *output = malloc(size - offset);
+    int results[READBACK_BUFFER_PATH_COUNT];
+    int matches[READBACK_BUFFER_PATH_COUNT];
+
+    for (int i = 0; i < size / 4; i++) {
+        data[i] = i * 2654435761u;
+    }
+
+    GLuint buffer, staging;
+    name_pool_gen(&context_names, NAME_POOL_BUFFER, 1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+    name_pool_gen(&context_names, NAME_POOL_BUFFER, 1, &staging);
+    glBindBuffer(GL_ARRAY_BUFFER, staging);
+    glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_READ);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-    CGLChoosePixelFormat(attribs, &pixel_format, &number_pixel_formats);
-    CGLCreateContext(pixel_format, NULL, &context);
-    CGLDestroyPixelFormat(pixel_format);
-    CGLSetCurrentContext(context);
+    for (int path = 0; path < READBACK_BUFFER_PATH_COUNT; path++) {
+        memset(output, 0, size - offset);
+        results[path] = readback_buffer(path, buffer, offset, size - offset, staging, output);
+        matches[path] = memcmp(output, data + offset / 4, size - offset) == 0;
+    }
+
+    name_pool_delete(&context_names, NAME_POOL_BUFFER, 1, &buffer);
+    name_pool_delete(&context_names, NAME_POOL_BUFFER, 1, &staging);
+    free(data);
+    free(output);
+
+    // a path that raised an error fails the test in shared_context_verify
+    for (int path = 0; path < READBACK_BUFFER_PATH_COUNT; path++) {
+        ck_assert_msg(results[path] == 0 && matches[path], "%s read back the wrong data",
+                      readback_buffer_path_name(path));
+    }
+}
+END_TEST
 
+START_TEST(we_can_create_a_buffer)
+{
     GLuint buffer;
 
-    glGenBuffers(1, &buffer);
-    GLenum err1 = glGetError();
+    // any error along the way fails the test in shared_context_verify
+    name_pool_gen(&context_names, NAME_POOL_BUFFER, 1, &buffer);
+    name_pool_delete(&context_names, NAME_POOL_BUFFER, 1, &buffer);
 
-    glDeleteBuffers(1, &buffer);
-    GLenum err2 = glGetError();
-
-    CGLDestroyContext(context);
-
-    ck_assert_int_eq(err1, GL_NO_ERROR);
-    ck_assert_int_eq(err2, GL_NO_ERROR);
+    ck_assert_int_ne(buffer, 0);
 }
 END_TEST
 
 START_TEST(we_can_compile_a_shader)
 {
-    CGLPixelFormatAttribute attribs[3] = {
-        kCGLPFAOpenGLProfile,
-        (CGLPixelFormatAttribute) kCGLOGLPVersion_GL4_Core,
-        (CGLPixelFormatAttribute) 0
-    };
-    CGLPixelFormatObj pixel_format;
-    GLint number_pixel_formats = 0;
-    CGLContextObj context;
-
-    CGLChoosePixelFormat(attribs, &pixel_format, &number_pixel_formats);
-    CGLCreateContext(pixel_format, NULL, &context);
-    CGLDestroyPixelFormat(pixel_format);
-    CGLSetCurrentContext(context);
-
     GLuint vs = glCreateShader(GL_VERTEX_SHADER);
     glShaderSource(vs, 1, &vertex_shader, NULL);
     glCompileShader(vs);
@@ -568,7 +1514,6 @@ START_TEST(we_can_compile_a_shader)
     glGetProgramiv(shader_program, GL_LINK_STATUS, &is_linked);
 
     glDeleteProgram(shader_program);
-    CGLDestroyContext(context);
 
     ck_assert_int_eq(vs_is_compiled, GL_TRUE);
     ck_assert_int_eq(fs_is_compiled, GL_TRUE);
@@ -576,176 +1521,401 @@ START_TEST(we_can_compile_a_shader)
 }
 END_TEST
 
-START_TEST(we_can_query_for_the_OpenGL_version)
+START_TEST(the_program_cache_hits_on_reopen_and_recompiles_a_rejected_binary)
 {
-    CGLPixelFormatAttribute attribs[3] = {
-        kCGLPFAOpenGLProfile,
-        (CGLPixelFormatAttribute) kCGLOGLPVersion_GL4_Core,
-        (CGLPixelFormatAttribute) 0
-    };
-    CGLPixelFormatObj pixel_format;
-    GLint number_pixel_formats = 0;
-    CGLContextObj context;
+    char path[] = "/tmp/open_gl_test_program_cache_XXXXXX";
+    close(mkstemp(path));
+    struct program_cache cache;
+    struct program_cache_stats cold, warm, rejected;
+    GLint binary_formats = 0;
+
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binary_formats);
+
+    program_cache_open(&cache, path);
+    GLuint program1 = program_cache_get(&cache, vertex_shader, fragment_shader);
+    cold = cache.stats;
+    program_cache_close(&cache);
+
+    program_cache_open(&cache, path);
+    GLuint program2 = program_cache_get(&cache, vertex_shader, fragment_shader);
+    warm = cache.stats;
+    program_cache_close(&cache);
+
+    // flip the last bytes of the stored binary
+    FILE *file = fopen(path, "r+b");
+    fseek(file, -16, SEEK_END);
+    fwrite("not a program binary", 1, 16, file);
+    fclose(file);
+
+    // an error raised before the rejected load is still there for the caller to see
+    glClear(GL_COLOR); // GL_INVALID_VALUE
+    program_cache_open(&cache, path);
+    GLuint program3 = program_cache_get(&cache, vertex_shader, fragment_shader);
+    rejected = cache.stats;
+    program_cache_close(&cache);
+    GLenum earlier_error = glGetError();
+    gl_errors_clear(&context_errors); // raised on purpose
+
+    GLint is_linked = 0;
+    glGetProgramiv(program3, GL_LINK_STATUS, &is_linked);
 
+    glDeleteProgram(program1);
+    glDeleteProgram(program2);
+    glDeleteProgram(program3);
+    unlink(path);
+
+    ck_assert_int_eq(glGetError(), GL_NO_ERROR);
+    ck_assert_int_eq(earlier_error, GL_INVALID_VALUE);
+    ck_assert_uint_ne(program1, 0);
+    ck_assert_uint_ne(program2, 0);
+    ck_assert_int_eq(is_linked, GL_TRUE);
+    ck_assert_uint_eq(cold.misses, 1);
+    ck_assert_uint_eq(cold.hits, 0);
+    if (binary_formats == 0) {
+        return; // nothing can be cached; every get compiles
+    }
+    ck_assert_uint_eq(cold.stored, 1);
+    ck_assert_uint_eq(warm.hits, 1);
+    ck_assert_uint_eq(warm.misses, 0);
+    ck_assert_uint_gt(warm.saved_ns, 0);
+    ck_assert_uint_eq(rejected.rejected, 1);
+    ck_assert_uint_eq(rejected.misses, 1);
+}
+END_TEST
+
+START_TEST(left_over_state_and_objects_are_reported_and_restored)
+{
+    char report[512];
+    GLuint buffer;
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glEnable(GL_BLEND);
+    glDepthMask(GL_FALSE);
+
+    int deviations = gl_state_check(&default_state, report, sizeof(report));
+
+    gl_state_restore(&default_state);
+    int deviations_after_restore = gl_state_check(&default_state, NULL, 0);
+
+    ck_assert_int_eq(deviations, 4); // binding, cap, depth mask, buffer object
+    ck_assert_ptr_ne(strstr(report, "GL_ARRAY_BUFFER_BINDING"), NULL);
+    ck_assert_ptr_ne(strstr(report, "GL_BLEND"), NULL);
+    ck_assert_ptr_ne(strstr(report, "depth mask"), NULL);
+    ck_assert_ptr_ne(strstr(report, "was never deleted"), NULL);
+    ck_assert_int_eq(deviations_after_restore, 0);
+    ck_assert_int_eq(glIsBuffer(buffer), GL_FALSE);
+}
+END_TEST
+
+START_TEST(we_can_query_for_the_OpenGL_version)
+{
     GLint major_version = 0;
     GLint minor_version = 0;
 
-    CGLChoosePixelFormat(attribs, &pixel_format, &number_pixel_formats);
-    CGLCreateContext(pixel_format, NULL, &context);
-    CGLDestroyPixelFormat(pixel_format);
-    CGLSetCurrentContext(context);
-
     glGetIntegerv(GL_MAJOR_VERSION, &major_version);
     glGetIntegerv(GL_MINOR_VERSION, &minor_version);
 
-    CGLDestroyContext(context);
     ck_assert_int_eq(major_version, 4);
+#ifdef __APPLE__
     ck_assert_int_eq(minor_version, 1);
+#else
+    ck_assert_int_ge(minor_version, 1); // Mesa hands out its newest core profile
+#endif
 }
 END_TEST
 
 #ifndef __travis__ /* This test FAILS on travis */
 START_TEST(we_can_create_an_accelerated_OpenGL_context)
 {
-    CGLError err1, err2, err3, err4, err5;
-    CGLPixelFormatAttribute attribs[] =
+    glc_error err1, err2, err3, err4, err5;
+    glc_attrib attribs[] =
     {
-        kCGLPFAAccelerated,
-        0
+        GLC_ATTRIB_ACCELERATED,
+        GLC_ATTRIB_END
     };
-    CGLPixelFormatObj pixel_format;
+    glc_pixel_format *pixel_format;
     GLint number_pixel_formats = 0;
-    CGLContextObj context;
-
-    err1 = CGLChoosePixelFormat(attribs, &pixel_format, &number_pixel_formats);
-    err2 = CGLCreateContext(pixel_format, NULL, &context);
-    err3 = CGLDestroyPixelFormat(pixel_format);
-    err4 = CGLSetCurrentContext(context);
-    err5 = CGLDestroyContext(context);
-
-    ck_assert_int_eq(err1, kCGLNoError);
-    ck_assert_int_eq(err2, kCGLNoError);
-    ck_assert_int_eq(err3, kCGLNoError);
-    ck_assert_int_eq(err4, kCGLNoError);
-    ck_assert_int_eq(err5, kCGLNoError);
+    glc_context *context;
+
+    err1 = glc_choose_pixel_format(attribs, &pixel_format, &number_pixel_formats);
+    err2 = glc_create_context(pixel_format, NULL, &context);
+    err3 = glc_destroy_pixel_format(pixel_format);
+    err4 = glc_set_current_context(context);
+    err5 = glc_destroy_context(context);
+
+    ck_assert_int_eq(err1, GLC_NO_ERROR);
+    ck_assert_int_eq(err2, GLC_NO_ERROR);
+    ck_assert_int_eq(err3, GLC_NO_ERROR);
+    ck_assert_int_eq(err4, GLC_NO_ERROR);
+    ck_assert_int_eq(err5, GLC_NO_ERROR);
 }
 END_TEST
 #endif
 
 START_TEST(we_can_create_an_OpenGL_context_with_double_buffering)
 {
-    CGLError err1, err2, err3, err4, err5;
-    CGLPixelFormatAttribute attribs[] =
+    glc_error err1, err2, err3, err4, err5;
+    glc_attrib attribs[] =
     {
-        kCGLPFADoubleBuffer,
-        0
+        GLC_ATTRIB_DOUBLE_BUFFER,
+        GLC_ATTRIB_END
     };
-    CGLPixelFormatObj pixel_format;
+    glc_pixel_format *pixel_format;
     GLint number_pixel_formats = 0;
-    CGLContextObj context;
-
-    err1 = CGLChoosePixelFormat(attribs, &pixel_format, &number_pixel_formats);
-    err2 = CGLCreateContext(pixel_format, NULL, &context);
-    err3 = CGLDestroyPixelFormat(pixel_format);
-    err4 = CGLSetCurrentContext(context);
-    err5 = CGLDestroyContext(context);
-
-    ck_assert_int_eq(err1, kCGLNoError);
-    ck_assert_int_eq(err2, kCGLNoError);
-    ck_assert_int_eq(err3, kCGLNoError);
-    ck_assert_int_eq(err4, kCGLNoError);
-    ck_assert_int_eq(err5, kCGLNoError);
+    glc_context *context;
+
+    err1 = glc_choose_pixel_format(attribs, &pixel_format, &number_pixel_formats);
+    err2 = glc_create_context(pixel_format, NULL, &context);
+    err3 = glc_destroy_pixel_format(pixel_format);
+    err4 = glc_set_current_context(context);
+    err5 = glc_destroy_context(context);
+
+    ck_assert_int_eq(err1, GLC_NO_ERROR);
+    ck_assert_int_eq(err2, GLC_NO_ERROR);
+    ck_assert_int_eq(err3, GLC_NO_ERROR);
+    ck_assert_int_eq(err4, GLC_NO_ERROR);
+    ck_assert_int_eq(err5, GLC_NO_ERROR);
 }
 END_TEST
 
 START_TEST(we_can_create_an_OpenGL_context)
 {
-    CGLError err1, err2, err3, err4, err5;
-    CGLPixelFormatAttribute attribs[] =
+    glc_error err1, err2, err3, err4, err5;
+    glc_attrib attribs[] =
     {
-        0
+        GLC_ATTRIB_END
     };
-    CGLPixelFormatObj pixel_format;
+    glc_pixel_format *pixel_format;
     GLint number_pixel_formats = 0;
-    CGLContextObj context;
+    glc_context *context;
+
+    err1 = glc_choose_pixel_format(attribs, &pixel_format, &number_pixel_formats);
+    err2 = glc_create_context(pixel_format, NULL, &context);
+    err3 = glc_destroy_pixel_format(pixel_format);
+    err4 = glc_set_current_context(context);
+    err5 = glc_destroy_context(context);
+
+    ck_assert_int_eq(err1, GLC_NO_ERROR);
+    ck_assert_int_eq(err2, GLC_NO_ERROR);
+    ck_assert_int_eq(err3, GLC_NO_ERROR);
+    ck_assert_int_eq(err4, GLC_NO_ERROR);
+    ck_assert_int_eq(err5, GLC_NO_ERROR);
+}
+END_TEST
 
-    err1 = CGLChoosePixelFormat(attribs, &pixel_format, &number_pixel_formats);
-    err2 = CGLCreateContext(pixel_format, NULL, &context);
-    err3 = CGLDestroyPixelFormat(pixel_format);
-    err4 = CGLSetCurrentContext(context);
-    err5 = CGLDestroyContext(context);
+START_TEST(the_pixel_format_cache_chooses_once_per_attribute_set)
+{
+    glc_attrib core_double[] = { GLC_ATTRIB_CORE_PROFILE, GLC_ATTRIB_DOUBLE_BUFFER, GLC_ATTRIB_END };
+    glc_attrib double_core[] = { GLC_ATTRIB_DOUBLE_BUFFER, GLC_ATTRIB_CORE_PROFILE, GLC_ATTRIB_DOUBLE_BUFFER,
+                                 GLC_ATTRIB_END };
+    glc_attrib none[] = { GLC_ATTRIB_END };
+    glc_attrib bad[] = { GLC_ATTRIB_CORE_PROFILE, (glc_attrib) 99, GLC_ATTRIB_END };
+    glc_pixel_format *first, *second, *other, *unchanged;
+    struct pixel_format_cache cache;
+    GLint number_pixel_formats = 0;
 
-    ck_assert_int_eq(err1, kCGLNoError);
-    ck_assert_int_eq(err2, kCGLNoError);
-    ck_assert_int_eq(err3, kCGLNoError);
-    ck_assert_int_eq(err4, kCGLNoError);
-    ck_assert_int_eq(err5, kCGLNoError);
+    pixel_format_cache_init(&cache);
+    ck_assert_int_eq(pixel_format_cache_choose(&cache, core_double, &first, &number_pixel_formats), GLC_NO_ERROR);
+    ck_assert_int_gt(number_pixel_formats, 0);
+    ck_assert_int_eq(pixel_format_cache_choose(&cache, double_core, &second, NULL), GLC_NO_ERROR);
+    ck_assert_ptr_eq(first, second);
+    ck_assert_int_eq(pixel_format_cache_choose(&cache, none, &other, NULL), GLC_NO_ERROR);
+    ck_assert_ptr_ne(first, other);
+
+    unchanged = other;
+    ck_assert_int_eq(pixel_format_cache_choose(&cache, bad, &unchanged, NULL), GLC_BAD_ATTRIBUTE);
+    ck_assert_ptr_eq(unchanged, other);
+    ck_assert_int_eq(cache.entry_count, 2);
+    ck_assert_uint_eq(cache.hits, 1);
+    ck_assert_uint_eq(cache.misses, 2);
+
+    // a cached format serves any number of contexts
+    for (int i = 0; i < 2; i++) {
+        glc_context *context;
+
+        ck_assert_int_eq(glc_create_context(first, NULL, &context), GLC_NO_ERROR);
+        ck_assert_int_eq(glc_set_current_context(context), GLC_NO_ERROR);
+        ck_assert_ptr_ne(glGetString(GL_VERSION), NULL);
+        ck_assert_int_eq(glc_destroy_context(context), GLC_NO_ERROR);
+    }
+    pixel_format_cache_destroy(&cache);
+    ck_assert_int_eq(glc_set_current_context(shared_context), GLC_NO_ERROR);
 }
 END_TEST
 
 START_TEST(we_can_choose_an_OpenGL_pixel_format)
 {
-    CGLError err = 0;
-    CGLPixelFormatAttribute attribs[] = {(CGLPixelFormatAttribute) 0};
-    CGLPixelFormatObj pixel_format;
+    glc_error err = 0;
+    glc_attrib attribs[] = {GLC_ATTRIB_END};
+    glc_pixel_format *pixel_format;
 
     GLint number_pixel_formats = 0;
 
-    err = CGLChoosePixelFormat(attribs, &pixel_format, &number_pixel_formats);
+    err = glc_choose_pixel_format(attribs, &pixel_format, &number_pixel_formats);
 
     ck_assert_int_eq(err, 0);
 
-    CGLDestroyPixelFormat(pixel_format);
+    glc_destroy_pixel_format(pixel_format);
 }
 END_TEST
 
-Suite *make_engine_suite()
+/* Tests are dealt out round-robin; shard 0 of 1 is the whole suite. */
+#define add_sharded_test(tc, test) \
+    do { \
+        test_report_add_test(#test, test_index, test_index % shard_count == shard); \
+        if (test_index++ % shard_count == shard) { \
+            tcase_add_test(tc, test); \
+        } \
+    } while (0)
+
+static const char suite_name[] = "OpenGL CI Test";
+
+Suite *make_engine_suite(int shard, int shard_count)
 {
     Suite *s;
     TCase *tc;
+    int test_index = 0;
 
-    s = suite_create("OpenGL CI Test");
+    test_report_begin_suite(shard);
+    s = suite_create(suite_name);
     tc = tcase_create("Core");
+    tcase_add_unchecked_fixture(tc, shared_context_setup, shared_context_teardown);
+    tcase_add_checked_fixture(tc, shared_context_reset, shared_context_verify);
 
 #ifndef __travis__
-    tcase_add_test(tc, we_can_create_an_accelerated_OpenGL_context);
+    add_sharded_test(tc, we_can_create_an_accelerated_OpenGL_context);
 #endif
-    tcase_add_test(tc, we_can_choose_an_OpenGL_pixel_format);
-    tcase_add_test(tc, we_can_create_an_OpenGL_context);
-    tcase_add_test(tc, we_can_create_an_OpenGL_context_with_double_buffering);
-    tcase_add_test(tc, we_can_query_for_the_OpenGL_version);
-    tcase_add_test(tc, we_can_compile_a_shader);
-    tcase_add_test(tc, we_can_create_a_buffer);
-    tcase_add_test(tc, we_can_put_data_into_and_get_data_out_of_a_buffer);
-    tcase_add_test(tc, we_can_create_a_frame_buffer_object);
-    tcase_add_test(tc, we_can_create_a_texture);
-    tcase_add_test(tc, glGetError_returns_an_erorr_code_when_there_is_an_error);
-    tcase_add_test(tc, we_can_bind_a_framebuffer_to_a_texture_for_drawing);
-    tcase_add_test(tc, we_can_bind_a_framebuffer_to_a_renderbuffer);
-    tcase_add_test(tc, we_can_create_a_vertex_array_object);
-    tcase_add_test(tc, we_can_bind_a_buffer_to_the_transform_feedback_target);
-    tcase_add_test(tc, we_can_read_from_a_fbo_with_glReadPixels);
-    tcase_add_test(tc, we_can_use_a_shader_program_and_issue_a_draw_call);
+    add_sharded_test(tc, we_can_choose_an_OpenGL_pixel_format);
+    add_sharded_test(tc, we_can_create_an_OpenGL_context);
+    add_sharded_test(tc, the_pixel_format_cache_chooses_once_per_attribute_set);
+    add_sharded_test(tc, we_can_create_an_OpenGL_context_with_double_buffering);
+    add_sharded_test(tc, we_can_query_for_the_OpenGL_version);
+    add_sharded_test(tc, we_can_compile_a_shader);
+    add_sharded_test(tc, the_program_cache_hits_on_reopen_and_recompiles_a_rejected_binary);
+    add_sharded_test(tc, we_can_create_a_buffer);
+    add_sharded_test(tc, we_can_put_data_into_and_get_data_out_of_a_buffer);
+    add_sharded_test(tc, every_buffer_readback_path_returns_the_buffer_contents);
+    add_sharded_test(tc, we_can_create_a_frame_buffer_object);
+    add_sharded_test(tc, we_can_create_a_texture);
+    add_sharded_test(tc, glGetError_returns_an_erorr_code_when_there_is_an_error);
+    add_sharded_test(tc, gl_errors_queues_an_error_whether_it_listens_or_polls);
+    add_sharded_test(tc, we_can_bind_a_framebuffer_to_a_texture_for_drawing);
+    add_sharded_test(tc, we_can_bind_a_framebuffer_to_a_renderbuffer);
+    add_sharded_test(tc, we_can_create_a_vertex_array_object);
+    add_sharded_test(tc, we_can_bind_a_buffer_to_the_transform_feedback_target);
+    add_sharded_test(tc, we_can_read_from_a_fbo_with_glReadPixels);
+    add_sharded_test(tc, we_can_use_a_shader_program_and_issue_a_draw_call);
+    add_sharded_test(tc, every_image_compare_kernel_finds_the_same_mismatches);
+    add_sharded_test(tc, left_over_state_and_objects_are_reported_and_restored);
+    add_sharded_test(tc, the_draw_pipeline_renders_the_triangle_like_the_draw_test);
+    add_sharded_test(tc, the_readback_ring_returns_every_frame_in_order);
+    add_sharded_test(tc, the_stream_buffer_hands_out_ranges_around_the_ring);
+    add_sharded_test(tc, the_gpu_timer_collects_every_phase_of_every_frame);
+    add_sharded_test(tc, the_bind_cache_skips_rebinds_and_follows_what_gl_resets);
+    add_sharded_test(tc, the_name_pool_batches_recycles_and_reports_where_leaks_came_from);
+    add_sharded_test(tc, a_multisampled_render_target_resolves_every_attachment);
+    add_sharded_test(tc, the_vertex_cache_optimizer_keeps_every_triangle_and_lowers_the_miss_ratio);
+    add_sharded_test(tc, every_vertex_layout_renders_what_the_float_layout_renders);
+    add_sharded_test(tc, transform_feedback_kernels_match_the_cpu_reference);
+    add_sharded_test(tc, every_texture_upload_path_delivers_every_format);
+    add_sharded_test(tc, the_loader_hands_buffers_and_textures_over_from_worker_threads);
+    add_sharded_test(tc, the_frame_loop_delivers_every_frame_through_every_buffer);
+    add_sharded_test(tc, every_shader_corpus_variant_links_serially_in_parallel_and_on_workers);
+    add_sharded_test(tc, the_reference_raster_draws_what_the_gpu_draws_on_every_kernel);
+    add_sharded_test(tc, the_regression_gate_flags_a_shifted_sample_and_not_noise);
 
     suite_add_tcase(s, tc);
 
     return s;
 }
 
-int main()
+int main(int argc, char **argv)
 {
-    int number_failed;
+    int number_failed = 0;
     Suite *s;
     SRunner *sr;
-
-    s = make_engine_suite();
-
-    sr = srunner_create(s);
-
-    srunner_run_all(sr, CK_NORMAL);
-
-    number_failed = srunner_ntests_failed(sr);
-    srunner_free(sr);
+    int no_fork = 0;
+    int shard_count = 0;
+    int repeat = 1;
+    const char *json_path = NULL;
+    const char *junit_path = NULL;
+    const char *baseline_path = NULL;
+    double threshold = 25.0;
+
+    gl_trace_init(); // GL_TRACE=trace.json records every traced gl* call
+    test_report_init(); // before anything forks: the tests report their times through it
+
+    // --no-fork runs every test in this process on the shared context
+    // instead of paying for a fork() per test. CK_FORK=no does the same.
+    // --shards[=N] spreads the tests over N workers, one context each;
+    // N defaults to the number of cores.
+    // --repeat=N runs the suite N times; --json=FILE and --junit=FILE write
+    // per-test times over all runs, and --baseline=FILE fails the run if
+    // tests got slower than in that earlier --json report by more than
+    // --regression-threshold=PERCENT (25 by default).
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--no-fork") == 0) {
+            no_fork = 1;
+        } else if (strcmp(argv[i], "--shards") == 0) {
+            shard_count = shard_runner_default_shard_count();
+        } else if (strncmp(argv[i], "--shards=", 9) == 0) {
+            shard_count = atoi(argv[i] + 9);
+        } else if (strncmp(argv[i], "--repeat=", 9) == 0) {
+            repeat = atoi(argv[i] + 9);
+        } else if (strncmp(argv[i], "--json=", 7) == 0) {
+            json_path = argv[i] + 7;
+        } else if (strncmp(argv[i], "--junit=", 8) == 0) {
+            junit_path = argv[i] + 8;
+        } else if (strncmp(argv[i], "--baseline=", 11) == 0) {
+            baseline_path = argv[i] + 11;
+        } else if (strncmp(argv[i], "--regression-threshold=", 23) == 0) {
+            threshold = atof(argv[i] + 23);
+        }
+    }
+
+    if (repeat < 1 || repeat > TEST_REPORT_MAX_RUNS) {
+        fprintf(stderr, "--repeat must be between 1 and %d\n", TEST_REPORT_MAX_RUNS);
+        return EXIT_FAILURE;
+    }
+
+    for (int run = 0; run < repeat; run++) {
+        test_report_begin_run(run);
+
+        if (shard_count > 0) {
+            number_failed += shard_runner_run(make_engine_suite, shard_count, CK_NORMAL, test_report_collect);
+            continue;
+        }
+
+        s = make_engine_suite(0, 1);
+
+        sr = srunner_create(s);
+        if (no_fork) {
+            srunner_set_fork_status(sr, CK_NOFORK);
+        }
+
+        srunner_run_all(sr, CK_NORMAL);
+        test_report_collect(sr);
+
+        number_failed += srunner_ntests_failed(sr);
+        srunner_free(sr);
+    }
+
+    if (json_path != NULL && test_report_write_json(json_path, suite_name) != 0) {
+        fprintf(stderr, "could not write %s\n", json_path);
+        number_failed++;
+    }
+    if (junit_path != NULL && test_report_write_junit(junit_path, suite_name) != 0) {
+        fprintf(stderr, "could not write %s\n", junit_path);
+        number_failed++;
+    }
+    if (baseline_path != NULL) {
+        int regressions = test_report_gate(baseline_path, threshold, stdout);
+        if (regressions < 0) {
+            fprintf(stderr, "no baseline to compare with in %s\n", baseline_path);
+        }
+        number_failed += regressions != 0;
+    }
 
     return (number_failed==0) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,95 @@
+#include "pixel_format_cache.h"
+
+#include <string.h>
+
+void pixel_format_cache_init(struct pixel_format_cache *cache)
+{
+    memset(cache, 0, sizeof(*cache));
+    pthread_mutex_init(&cache->lock, NULL);
+}
+
+void pixel_format_cache_destroy(struct pixel_format_cache *cache)
+{
+    for (int i = 0; i < cache->entry_count; i++) {
+        glc_destroy_pixel_format(cache->entries[i].pixel_format);
+    }
+    pthread_mutex_destroy(&cache->lock);
+    memset(cache, 0, sizeof(*cache));
+}
+
+/* Sorts attribs into key without duplicates; returns their count, or -1 if there are too many. */
+static int make_key(const glc_attrib *attribs, glc_attrib *key)
+{
+    int count = 0;
+
+    for (; *attribs != GLC_ATTRIB_END; attribs++) {
+        int at = 0;
+
+        while (at < count && key[at] < *attribs) {
+            at++;
+        }
+        if (at < count && key[at] == *attribs) {
+            continue;
+        }
+        if (count == PIXEL_FORMAT_CACHE_MAX_ATTRIBS - 1) {
+            return -1;
+        }
+        memmove(&key[at + 1], &key[at], (count - at) * sizeof(*key));
+        key[at] = *attribs;
+        count++;
+    }
+    key[count] = GLC_ATTRIB_END;
+    return count;
+}
+
+static struct pixel_format_cache_entry *find(struct pixel_format_cache *cache, const glc_attrib *key, int count)
+{
+    for (int i = 0; i < cache->entry_count; i++) {
+        struct pixel_format_cache_entry *entry = &cache->entries[i];
+
+        if (entry->attrib_count == count && memcmp(entry->attribs, key, count * sizeof(*key)) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+glc_error pixel_format_cache_choose(struct pixel_format_cache *cache, const glc_attrib *attribs,
+                                    glc_pixel_format **pixel_format, GLint *number_pixel_formats)
+{
+    glc_attrib key[PIXEL_FORMAT_CACHE_MAX_ATTRIBS];
+    int count = make_key(attribs, key);
+    glc_error err = GLC_NO_ERROR;
+
+    if (count < 0) {
+        return GLC_BAD_ATTRIBUTE;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    struct pixel_format_cache_entry *entry = find(cache, key, count);
+    if (entry != NULL) {
+        cache->hits++;
+    } else if (cache->entry_count == PIXEL_FORMAT_CACHE_MAX_ENTRIES) {
+        err = GLC_BAD_ALLOC;
+    } else {
+        // choosing under the lock keeps two threads from both missing on the same list
+        entry = &cache->entries[cache->entry_count];
+        err = glc_choose_pixel_format(key, &entry->pixel_format, &entry->number_pixel_formats);
+        if (err == GLC_NO_ERROR) {
+            memcpy(entry->attribs, key, sizeof(key));
+            entry->attrib_count = count;
+            cache->entry_count++;
+            cache->misses++;
+        } else {
+            entry = NULL;
+        }
+    }
+    if (entry != NULL) {
+        *pixel_format = entry->pixel_format;
+        if (number_pixel_formats != NULL) {
+            *number_pixel_formats = entry->number_pixel_formats;
+        }
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return err;
+}
@@ -0,0 +1,51 @@
+#ifndef PIXEL_FORMAT_CACHE_H
+#define PIXEL_FORMAT_CACHE_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "glc.h"
+
+/*
+ * Keeps the pixel formats glc_choose_pixel_format() returns, so a process
+ * that brings contexts up on demand chooses each one once. Entries are
+ * keyed by attribute list; the order of the attributes and repeats do not
+ * matter, so { CORE_PROFILE, ACCELERATED } and { ACCELERATED, CORE_PROFILE }
+ * share an entry. The cache owns the formats it hands out: they stay valid
+ * for any number of glc_create_context() calls, on any thread, until
+ * pixel_format_cache_destroy(). Failed choices are not cached.
+ */
+
+#define PIXEL_FORMAT_CACHE_MAX_ENTRIES 16
+#define PIXEL_FORMAT_CACHE_MAX_ATTRIBS 8
+
+struct pixel_format_cache_entry {
+    glc_attrib attribs[PIXEL_FORMAT_CACHE_MAX_ATTRIBS];     /* sorted, without duplicates */
+    int attrib_count;
+    glc_pixel_format *pixel_format;
+    GLint number_pixel_formats;
+};
+
+struct pixel_format_cache {
+    pthread_mutex_t lock;
+    struct pixel_format_cache_entry entries[PIXEL_FORMAT_CACHE_MAX_ENTRIES];
+    int entry_count;
+    uint64_t hits;
+    uint64_t misses;
+};
+
+void pixel_format_cache_init(struct pixel_format_cache *cache);
+
+/* Destroys every cached format; contexts created from them live on. */
+void pixel_format_cache_destroy(struct pixel_format_cache *cache);
+
+/*
+ * Like glc_choose_pixel_format(), but the format comes from the cache when
+ * attribs have been chosen before, and the caller must not destroy it.
+ * Returns GLC_BAD_ALLOC when a new list does not fit the cache, and
+ * GLC_BAD_ATTRIBUTE when it has too many distinct attributes.
+ */
+glc_error pixel_format_cache_choose(struct pixel_format_cache *cache, const glc_attrib *attribs,
+                                    glc_pixel_format **pixel_format, GLint *number_pixel_formats);
+
+#endif
@@ -0,0 +1,297 @@
+#include "program_cache.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "draw_pipeline.h"
+
+/*
+ * File layout: a header, then records back to back. Each record is a
+ * record_header followed by the binary, padded to 8 bytes.
+ */
+
+static const char cache_magic[8] = { 'G', 'L', 'P', 'C', 'A', 'C', 'H', 'E' };
+#define CACHE_VERSION 1
+
+struct file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+struct record_header {
+    uint64_t key;
+    uint64_t compile_ns;
+    uint32_t format;
+    uint32_t length;
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t size)
+{
+    const uint8_t *bytes = data;
+
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static uint64_t fnv1a_string(uint64_t hash, const char *s)
+{
+    // the terminator goes in too, so ("ab", "c") and ("a", "bc") differ
+    return fnv1a(hash, s, strlen(s) + 1);
+}
+
+static size_t padded(size_t size)
+{
+    return (size + 7) & ~(size_t) 7;
+}
+
+static void add_entry(struct program_cache *cache, uint64_t key, size_t offset)
+{
+    if (cache->entry_count == cache->entry_capacity) {
+        int capacity = cache->entry_capacity ? cache->entry_capacity * 2 : 64;
+        struct program_cache_entry *entries = realloc(cache->entries, capacity * sizeof(*entries));
+
+        if (entries == NULL) {
+            return;
+        }
+        cache->entries = entries;
+        cache->entry_capacity = capacity;
+    }
+    cache->entries[cache->entry_count].key = key;
+    cache->entries[cache->entry_count].offset = offset;
+    cache->entry_count++;
+}
+
+/* Maps the file as it is now and indexes every complete record in it. */
+static void remap(struct program_cache *cache)
+{
+    struct stat st;
+
+    if (cache->map != NULL) {
+        munmap((void *) cache->map, cache->map_size);
+        cache->map = NULL;
+        cache->map_size = 0;
+    }
+    cache->entry_count = 0;
+
+    if (fstat(cache->fd, &st) != 0 || (size_t) st.st_size < sizeof(struct file_header)) {
+        return;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, cache->fd, 0);
+    if (map == MAP_FAILED) {
+        return;
+    }
+    cache->map = map;
+    cache->map_size = st.st_size;
+
+    const struct file_header *header = map;
+    if (memcmp(header->magic, cache_magic, sizeof(cache_magic)) != 0 || header->version != CACHE_VERSION) {
+        return;
+    }
+
+    size_t offset = sizeof(struct file_header);
+    while (offset + sizeof(struct record_header) <= cache->map_size) {
+        struct record_header record;
+        memcpy(&record, cache->map + offset, sizeof(record));
+
+        size_t next = offset + sizeof(record) + padded(record.length);
+        if (next > cache->map_size) {
+            break; // another process is halfway through appending it
+        }
+        add_entry(cache, record.key, offset);
+        offset = next;
+    }
+}
+
+void program_cache_open(struct program_cache *cache, const char *path)
+{
+    memset(cache, 0, sizeof(*cache));
+    cache->fd = -1;
+
+    uint64_t hash = 0xcbf29ce484222325ull;
+    hash = fnv1a_string(hash, (const char *) glGetString(GL_RENDERER));
+    hash = fnv1a_string(hash, (const char *) glGetString(GL_VERSION));
+    cache->driver_hash = hash;
+
+    GLint format_count = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+    if (format_count == 0) {
+        return; // the driver cannot hand out binaries, so there is nothing to cache
+    }
+    GLint *formats = malloc(format_count * sizeof(GLint));
+    if (formats == NULL) {
+        return;
+    }
+    glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats);
+    cache->format_count = format_count < PROGRAM_CACHE_MAX_FORMATS ? format_count : PROGRAM_CACHE_MAX_FORMATS;
+    memcpy(cache->formats, formats, cache->format_count * sizeof(GLint));
+    free(formats);
+
+    cache->fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (cache->fd < 0) {
+        return;
+    }
+
+    flock(cache->fd, LOCK_EX);
+    struct stat st;
+    if (fstat(cache->fd, &st) == 0 && st.st_size == 0) {
+        struct file_header header = { { 0 }, CACHE_VERSION, 0 };
+        memcpy(header.magic, cache_magic, sizeof(cache_magic));
+        if (write(cache->fd, &header, sizeof(header)) != (ssize_t) sizeof(header)) {
+            flock(cache->fd, LOCK_UN);
+            close(cache->fd);
+            cache->fd = -1;
+            return;
+        }
+    }
+    flock(cache->fd, LOCK_UN);
+
+    remap(cache);
+}
+
+void program_cache_close(struct program_cache *cache)
+{
+    if (cache->map != NULL) {
+        munmap((void *) cache->map, cache->map_size);
+    }
+    if (cache->fd >= 0) {
+        close(cache->fd);
+    }
+    free(cache->entries);
+    memset(cache, 0, sizeof(*cache));
+    cache->fd = -1;
+}
+
+static const struct record_header *find(const struct program_cache *cache, uint64_t key)
+{
+    // newest first, so a record appended after a rejected one wins
+    for (int i = cache->entry_count - 1; i >= 0; i--) {
+        if (cache->entries[i].key == key) {
+            return (const struct record_header *) (cache->map + cache->entries[i].offset);
+        }
+    }
+    return NULL;
+}
+
+static int knows_format(const struct program_cache *cache, GLenum format)
+{
+    for (int i = 0; i < cache->format_count; i++) {
+        if ((GLenum) cache->formats[i] == format) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static GLuint load(struct program_cache *cache, const struct record_header *record)
+{
+    GLint is_linked = 0;
+    uint64_t start = now_ns();
+
+    // an unknown format would raise GL_INVALID_ENUM; a known one that does not load only fails to link
+    if (!knows_format(cache, record->format)) {
+        cache->stats.rejected++;
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, record->format, record + 1, record->length);
+    glGetProgramiv(program, GL_LINK_STATUS, &is_linked);
+
+    if (!is_linked) {
+        glDeleteProgram(program);
+        cache->stats.rejected++;
+        return 0;
+    }
+
+    cache->stats.hits++;
+    cache->stats.load_ns += now_ns() - start;
+    cache->stats.saved_ns += record->compile_ns;
+    return program;
+}
+
+static void store(struct program_cache *cache, uint64_t key, GLuint program, uint64_t compile_ns)
+{
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    size_t record_size = sizeof(struct record_header) + padded(length);
+    uint8_t *buffer = calloc(1, record_size);
+    if (buffer == NULL) {
+        return;
+    }
+
+    struct record_header *record = (struct record_header *) buffer;
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &format, record + 1);
+
+    if (written == length) {
+        record->key = key;
+        record->compile_ns = compile_ns;
+        record->format = format;
+        record->length = (uint32_t) length;
+
+        // one write under the lock: readers in other processes never see half a record
+        flock(cache->fd, LOCK_EX);
+        if (write(cache->fd, buffer, record_size) == (ssize_t) record_size) {
+            cache->stats.stored++;
+        }
+        flock(cache->fd, LOCK_UN);
+    }
+    free(buffer);
+}
+
+GLuint program_cache_get(struct program_cache *cache, const char *vs_source, const char *fs_source)
+{
+    uint64_t key = cache->driver_hash;
+    key = fnv1a_string(key, vs_source);
+    key = fnv1a_string(key, fs_source);
+
+    if (cache->fd >= 0) {
+        const struct record_header *record = find(cache, key);
+        struct stat st;
+
+        if (record == NULL && fstat(cache->fd, &st) == 0 && (size_t) st.st_size > cache->map_size) {
+            remap(cache);
+            record = find(cache, key);
+        }
+        if (record != NULL) {
+            GLuint program = load(cache, record);
+            if (program != 0) {
+                return program;
+            }
+        }
+    }
+
+    uint64_t start = now_ns();
+    GLuint program = draw_pipeline_compile_program(vs_source, fs_source);
+    uint64_t compile_ns = now_ns() - start;
+
+    cache->stats.misses++;
+    cache->stats.compile_ns += compile_ns;
+
+    if (program != 0 && cache->fd >= 0) {
+        store(cache, key, program, compile_ns);
+    }
+    return program;
+}
@@ -0,0 +1,66 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "glc.h"
+
+/*
+ * On-disk cache of linked programs, keyed by a hash of the vertex and
+ * fragment sources plus GL_RENDERER and GL_VERSION.
+ *
+ * The cache file is an append-only list of glGetProgramBinary() blobs and
+ * is read through mmap. A hit loads the program with glProgramBinary();
+ * if the driver rejects the binary the sources are compiled as on a miss.
+ * A binary in a format the driver does not list is rejected without being
+ * handed to it, so a rejection never raises a GL error the caller would
+ * have to tell from its own.
+ * Every record carries the time its program took to compile, so a hit
+ * knows how much compile time it saved.
+ *
+ * Several processes may share one cache file: records are appended under
+ * flock() and a miss re-reads whatever other processes appended since.
+ */
+
+struct program_cache_stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t rejected;      /* hits whose binary the driver refused */
+    uint64_t stored;
+    uint64_t compile_ns;    /* spent compiling on misses */
+    uint64_t load_ns;       /* spent in glProgramBinary on hits */
+    uint64_t saved_ns;      /* compile time the hits would have cost */
+};
+
+#define PROGRAM_CACHE_MAX_FORMATS 8
+
+struct program_cache_entry {
+    uint64_t key;
+    size_t offset;
+};
+
+struct program_cache {
+    int fd;                 /* -1 if the file could not be opened */
+    const uint8_t *map;
+    size_t map_size;
+    struct program_cache_entry *entries;
+    int entry_count;
+    int entry_capacity;
+    uint64_t driver_hash;
+    GLint formats[PROGRAM_CACHE_MAX_FORMATS];   /* GL_PROGRAM_BINARY_FORMATS */
+    int format_count;
+    struct program_cache_stats stats;
+};
+
+/*
+ * Opens (or creates) the cache file at path. Needs a current context.
+ * If the file cannot be used the cache still works, it just never hits.
+ */
+void program_cache_open(struct program_cache *cache, const char *path);
+void program_cache_close(struct program_cache *cache);
+
+/* Returns a linked program, or 0 if the sources do not compile. */
+GLuint program_cache_get(struct program_cache *cache, const char *vs_source, const char *fs_source);
+
+#endif
@@ -0,0 +1,184 @@
+#include "readback.h"
+
+#include <string.h>
+
+static int bytes_per_pixel(GLenum format)
+{
+    switch (format) {
+    case GL_RED:
+        return 1;
+    case GL_RG:
+        return 2;
+    case GL_RGB:
+    case GL_BGR:
+        return 3;
+    case GL_RGBA:
+    case GL_BGRA:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+int readback_ring_init(struct readback_ring *ring, int slot_count,
+                       GLsizei max_width, GLsizei max_height,
+                       GLenum format, GLenum type)
+{
+    memset(ring, 0, sizeof(*ring));
+
+    if (slot_count < 1 || slot_count > READBACK_MAX_SLOTS ||
+        type != GL_UNSIGNED_BYTE || bytes_per_pixel(format) == 0) {
+        return -1;
+    }
+
+    ring->slot_count = slot_count;
+    ring->format = format;
+    ring->type = type;
+    ring->bytes_per_pixel = bytes_per_pixel(format);
+    ring->slot_size = (GLsizeiptr) max_width * max_height * ring->bytes_per_pixel;
+
+    for (int i = 0; i < slot_count; i++) {
+        glGenBuffers(1, &ring->slots[i].pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, ring->slots[i].pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, ring->slot_size, NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    return glGetError() == GL_NO_ERROR ? 0 : -1;
+}
+
+void readback_ring_destroy(struct readback_ring *ring)
+{
+    for (int i = 0; i < ring->slot_count; i++) {
+        if (ring->slots[i].fence != NULL) {
+            glDeleteSync(ring->slots[i].fence);
+        }
+        glDeleteBuffers(1, &ring->slots[i].pbo);
+    }
+    memset(ring, 0, sizeof(*ring));
+}
+
+int readback_ring_issue(struct readback_ring *ring, GLint x, GLint y,
+                        GLsizei width, GLsizei height, uint64_t tag)
+{
+    if (ring->pending == ring->slot_count ||
+        (GLsizeiptr) width * height * ring->bytes_per_pixel > ring->slot_size) {
+        return -1;
+    }
+
+    struct readback_slot *slot = &ring->slots[ring->head];
+    GLint alignment;
+
+    // rows are tightly packed so collect can copy the slot in one go
+    glGetIntegerv(GL_PACK_ALIGNMENT, &alignment);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+    glReadPixels(x, y, width, height, ring->format, ring->type, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, alignment);
+
+    slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot->tag = tag;
+    slot->width = width;
+    slot->height = height;
+
+    ring->head = (ring->head + 1) % ring->slot_count;
+    ring->pending++;
+    return 0;
+}
+
+int readback_ring_collect(struct readback_ring *ring, void *dst, uint64_t timeout_ns, uint64_t *tag)
+{
+    if (ring->pending == 0) {
+        return -1;
+    }
+
+    int oldest = (ring->head - ring->pending + ring->slot_count) % ring->slot_count;
+    struct readback_slot *slot = &ring->slots[oldest];
+
+    GLenum wait = glClientWaitSync(slot->fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout_ns);
+    if (wait == GL_TIMEOUT_EXPIRED) {
+        return 0;
+    }
+    if (wait == GL_WAIT_FAILED) {
+        return -1;
+    }
+
+    glDeleteSync(slot->fence);
+    slot->fence = NULL;
+
+    GLsizeiptr size = (GLsizeiptr) slot->width * slot->height * ring->bytes_per_pixel;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+    const void *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+    if (pixels != NULL) {
+        memcpy(dst, pixels, size);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    if (tag != NULL) {
+        *tag = slot->tag;
+    }
+    ring->pending--;
+
+    return pixels != NULL ? 1 : -1;
+}
+
+const char *readback_buffer_path_name(enum readback_buffer_path path)
+{
+    switch (path) {
+    case READBACK_BUFFER_GET_SUB_DATA:   return "getsubdata";
+    case READBACK_BUFFER_MAP:            return "map";
+    case READBACK_BUFFER_STAGING_COPY:   return "staging";
+    default:                             return "unknown";
+    }
+}
+
+static int map_and_copy(GLenum target, GLintptr offset, GLsizeiptr bytes, void *dst)
+{
+    const void *data = glMapBufferRange(target, offset, bytes, GL_MAP_READ_BIT);
+
+    if (data == NULL) {
+        return -1;
+    }
+    memcpy(dst, data, bytes);
+    return glUnmapBuffer(target) == GL_TRUE ? 0 : -1;
+}
+
+int readback_buffer(enum readback_buffer_path path, GLuint buffer, GLintptr offset, GLsizeiptr bytes,
+                    GLuint staging, void *dst)
+{
+    int result = -1;
+
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+
+    switch (path) {
+    case READBACK_BUFFER_GET_SUB_DATA:
+        glGetBufferSubData(GL_COPY_READ_BUFFER, offset, bytes, dst);
+        result = 0;
+        break;
+    case READBACK_BUFFER_MAP:
+        result = map_and_copy(GL_COPY_READ_BUFFER, offset, bytes, dst);
+        break;
+    case READBACK_BUFFER_STAGING_COPY: {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, staging);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, 0, bytes);
+
+        GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        GLenum wait = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, UINT64_MAX);
+        glDeleteSync(fence);
+
+        if (wait != GL_WAIT_FAILED) {
+            result = map_and_copy(GL_COPY_WRITE_BUFFER, 0, bytes, dst);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        break;
+    }
+    default:
+        break;
+    }
+
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    return result;
+}
@@ -0,0 +1,88 @@
+#ifndef READBACK_H
+#define READBACK_H
+
+#include <stdint.h>
+
+#include "glc.h"
+
+/*
+ * Asynchronous pixel readback through a ring of GL_PIXEL_PACK_BUFFERs.
+ *
+ * readback_ring_issue() queues glReadPixels of the bound read framebuffer
+ * into the next free PBO and drops a fence behind it, so the call returns
+ * as soon as the copy is queued. readback_ring_collect() hands back the
+ * oldest queued frame once its fence has signalled. With a ring of N slots
+ * up to N frames are in flight: frame K is read back while frame K+1 is
+ * being rendered.
+ */
+
+#define READBACK_MAX_SLOTS 8
+
+struct readback_slot {
+    GLuint pbo;
+    GLsync fence;
+    uint64_t tag;
+    GLsizei width;
+    GLsizei height;
+};
+
+struct readback_ring {
+    struct readback_slot slots[READBACK_MAX_SLOTS];
+    int slot_count;
+    int head;       /* next slot to issue into */
+    int pending;    /* issued but not collected, oldest at head - pending */
+    GLsizeiptr slot_size;
+    GLenum format;
+    GLenum type;
+    int bytes_per_pixel;
+};
+
+/* format/type as for glReadPixels; only 1-byte-per-channel formats. Returns 0 on success. */
+int readback_ring_init(struct readback_ring *ring, int slot_count,
+                       GLsizei max_width, GLsizei max_height,
+                       GLenum format, GLenum type);
+void readback_ring_destroy(struct readback_ring *ring);
+
+/*
+ * Queues a read of (x, y, width, height) and remembers tag with it.
+ * Returns 0, or -1 if every slot is in flight (collect first) or the
+ * region does not fit a slot. Leaves GL_PIXEL_PACK_BUFFER bound to 0.
+ */
+int readback_ring_issue(struct readback_ring *ring, GLint x, GLint y,
+                        GLsizei width, GLsizei height, uint64_t tag);
+
+/*
+ * Copies the oldest queued frame into dst (width * height * bytes per
+ * pixel, tightly packed). Waits at most timeout_ns for it; 0 only polls.
+ * Returns 1 and sets *tag when a frame was delivered, 0 if it was not
+ * ready in time, -1 if nothing is queued or the wait failed.
+ */
+int readback_ring_collect(struct readback_ring *ring, void *dst, uint64_t timeout_ns, uint64_t *tag);
+
+/*
+ * Synchronous reads of buffer contents, one per path:
+ *
+ *   GET_SUB_DATA   glGetBufferSubData straight into dst
+ *   MAP            glMapBufferRange(GL_MAP_READ_BIT) on the buffer, memcpy
+ *   STAGING_COPY   glCopyBufferSubData into a GL_STREAM_READ staging
+ *                  buffer, fence, then map that and memcpy
+ */
+enum readback_buffer_path {
+    READBACK_BUFFER_GET_SUB_DATA,
+    READBACK_BUFFER_MAP,
+    READBACK_BUFFER_STAGING_COPY,
+    READBACK_BUFFER_PATH_COUNT
+};
+
+const char *readback_buffer_path_name(enum readback_buffer_path path);
+
+/*
+ * Copies bytes bytes at offset in buffer into dst. staging is only used
+ * by READBACK_BUFFER_STAGING_COPY and must hold at least bytes bytes.
+ * Uses the GL_COPY_READ_BUFFER/GL_COPY_WRITE_BUFFER bindings and leaves
+ * them at 0. Returns 0 on success, -1 on failure.
+ */
+int readback_buffer(enum readback_buffer_path path, GLuint buffer, GLintptr offset, GLsizeiptr bytes,
+                    GLuint staging, void *dst);
+
+#endif
@@ -0,0 +1,437 @@
+#include "reference_raster.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+#define MAX_THREADS 64
+
+struct setup {
+    /* E(x, y) = a x + b y + c at the center of pixel (x, y); the pixel is covered where all three are > 0. */
+    double a[3];
+    double b[3];
+    double c[3];
+    int min_x;              /* pixels whose centers the bounding box holds, inclusive, within the frame */
+    int min_y;
+    int max_x;
+    int max_y;
+};
+
+struct job {
+    enum reference_raster_isa isa;
+    struct setup *setups;
+    int setup_count;
+    int width;
+    int height;
+    uint32_t *pixels;
+    uint32_t clear;
+    uint32_t color;
+    int tiles_x;
+    int tile_count;
+    int next_tile;
+};
+
+static uint32_t pack_unorm8(const float color[4])
+{
+    uint8_t bytes[4];
+    uint32_t packed;
+
+    for (int c = 0; c < 4; c++) {
+        float clamped = color[c] < 0.0f ? 0.0f : color[c] > 1.0f ? 1.0f : color[c];
+        bytes[c] = (uint8_t) lrintf(clamped * 255.0f);
+    }
+    memcpy(&packed, bytes, sizeof(packed));
+    return packed;
+}
+
+static int64_t floor_div(int64_t n, int64_t d)
+{
+    return n >= 0 ? n / d : -((-n + d - 1) / d);
+}
+
+/* The vertex stage, the viewport transform and the snap to fixed point; -1 outside the guard band. */
+static int transform(const float *v, int width, int height, int64_t *x, int64_t *y)
+{
+    // vec4(v, 0.0, 1.0): w is 1, so the divide leaves x and y as they are. The
+    // scale and offset are one fused multiply-add, as llvmpipe does them; a
+    // separate multiply and add rounds twice and moves a vertex 1/256 now and then.
+    float window_x = fmaf(v[0], width * 0.5f, width * 0.5f);
+    float window_y = fmaf(v[1], height * 0.5f, height * 0.5f);
+
+    if (!(fabsf(window_x) <= REFERENCE_RASTER_GUARD_BAND && fabsf(window_y) <= REFERENCE_RASTER_GUARD_BAND)) {
+        return -1;
+    }
+    *x = llrintf(window_x * (1 << REFERENCE_RASTER_SUBPIXEL_BITS));
+    *y = llrintf(window_y * (1 << REFERENCE_RASTER_SUBPIXEL_BITS));
+    return 0;
+}
+
+/* Returns 1 and fills setup for a triangle that may cover pixels, 0 for one that cannot, -1 on a bad vertex. */
+static int set_up(const float *positions, int width, int height, struct setup *setup)
+{
+    const int64_t one = 1 << REFERENCE_RASTER_SUBPIXEL_BITS;
+    int64_t x[3], y[3];
+
+    for (int i = 0; i < 3; i++) {
+        if (transform(positions + i * 2, width, height, &x[i], &y[i]) != 0) {
+            return -1;
+        }
+    }
+
+    int64_t area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (area == 0) {
+        return 0;
+    }
+    // counter-clockwise (y up), so the inside is left of every edge
+    if (area < 0) {
+        int64_t t = x[1];
+        x[1] = x[2];
+        x[2] = t;
+        t = y[1];
+        y[1] = y[2];
+        y[2] = t;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        int j = (i + 1) % 3;
+        int64_t a = y[i] - y[j];
+        int64_t b = x[j] - x[i];
+        int64_t c = -a * x[i] - b * y[i];
+        // a pixel center on a left edge, or (y up) on a horizontal bottom one, is covered: the
+        // top-left rule with y pointing down, as llvmpipe applies it in an FBO
+        int on_edge_covered = a > 0 || (a == 0 && b > 0);
+
+        // at pixel centers, x * one + one / 2; E is an integer, so E >= 0 is E + 1 > 0
+        setup->a[i] = (double) (a * one);
+        setup->b[i] = (double) (b * one);
+        setup->c[i] = (double) (c + (a + b) * (one / 2) + on_edge_covered);
+    }
+
+    int64_t min_x = x[0] < x[1] ? (x[0] < x[2] ? x[0] : x[2]) : (x[1] < x[2] ? x[1] : x[2]);
+    int64_t max_x = x[0] > x[1] ? (x[0] > x[2] ? x[0] : x[2]) : (x[1] > x[2] ? x[1] : x[2]);
+    int64_t min_y = y[0] < y[1] ? (y[0] < y[2] ? y[0] : y[2]) : (y[1] < y[2] ? y[1] : y[2]);
+    int64_t max_y = y[0] > y[1] ? (y[0] > y[2] ? y[0] : y[2]) : (y[1] > y[2] ? y[1] : y[2]);
+
+    // pixel x's center is x * one + one / 2
+    min_x = -floor_div(-(min_x - one / 2), one);
+    min_y = -floor_div(-(min_y - one / 2), one);
+    max_x = floor_div(max_x - one / 2, one);
+    max_y = floor_div(max_y - one / 2, one);
+    setup->min_x = min_x < 0 ? 0 : (int) min_x;
+    setup->min_y = min_y < 0 ? 0 : (int) min_y;
+    setup->max_x = max_x >= width ? width - 1 : (int) max_x;
+    setup->max_y = max_y >= height ? height - 1 : (int) max_y;
+    return setup->min_x <= setup->max_x && setup->min_y <= setup->max_y;
+}
+
+static void fill_scalar(uint32_t *row, int count, uint32_t color)
+{
+    for (int x = 0; x < count; x++) {
+        row[x] = color;
+    }
+}
+
+/* e holds the three edge values at (x0, y); x1 is exclusive. */
+static void span_scalar(uint32_t *row, int x0, int x1, const double *e, const double *a, uint32_t color)
+{
+    double e0 = e[0], e1 = e[1], e2 = e[2];
+
+    for (int x = x0; x < x1; x++) {
+        if (e0 > 0.0 && e1 > 0.0 && e2 > 0.0) {
+            row[x] = color;
+        }
+        e0 += a[0];
+        e1 += a[1];
+        e2 += a[2];
+    }
+}
+
+#ifdef HAVE_X86_KERNELS
+
+__attribute__((target("sse2")))
+static void fill_sse2(uint32_t *row, int count, uint32_t color)
+{
+    const __m128i colors = _mm_set1_epi32((int) color);
+    int x = 0;
+
+    for (; x + 4 <= count; x += 4) {
+        _mm_storeu_si128((__m128i *) (row + x), colors);
+    }
+    fill_scalar(row + x, count - x, color);
+}
+
+__attribute__((target("sse2")))
+static void span_sse2(uint32_t *row, int x0, int x1, const double *e, const double *a, uint32_t color)
+{
+    const __m128d zero = _mm_setzero_pd();
+    __m128d e0 = _mm_add_pd(_mm_set1_pd(e[0]), _mm_set_pd(a[0], 0.0));
+    __m128d e1 = _mm_add_pd(_mm_set1_pd(e[1]), _mm_set_pd(a[1], 0.0));
+    __m128d e2 = _mm_add_pd(_mm_set1_pd(e[2]), _mm_set_pd(a[2], 0.0));
+    const __m128d step0 = _mm_set1_pd(a[0] * 2.0);
+    const __m128d step1 = _mm_set1_pd(a[1] * 2.0);
+    const __m128d step2 = _mm_set1_pd(a[2] * 2.0);
+    int x = x0;
+
+    for (; x + 2 <= x1; x += 2) {
+        __m128d inside = _mm_and_pd(_mm_and_pd(_mm_cmpgt_pd(e0, zero), _mm_cmpgt_pd(e1, zero)), _mm_cmpgt_pd(e2, zero));
+        int lanes = _mm_movemask_pd(inside);
+
+        if (lanes & 1) {
+            row[x] = color;
+        }
+        if (lanes & 2) {
+            row[x + 1] = color;
+        }
+        e0 = _mm_add_pd(e0, step0);
+        e1 = _mm_add_pd(e1, step1);
+        e2 = _mm_add_pd(e2, step2);
+    }
+    double tail[3] = { _mm_cvtsd_f64(e0), _mm_cvtsd_f64(e1), _mm_cvtsd_f64(e2) };
+    span_scalar(row, x, x1, tail, a, color);
+}
+
+__attribute__((target("avx2")))
+static void fill_avx2(uint32_t *row, int count, uint32_t color)
+{
+    const __m256i colors = _mm256_set1_epi32((int) color);
+    int x = 0;
+
+    for (; x + 8 <= count; x += 8) {
+        _mm256_storeu_si256((__m256i *) (row + x), colors);
+    }
+    fill_scalar(row + x, count - x, color);
+}
+
+__attribute__((target("avx2")))
+static void span_avx2(uint32_t *row, int x0, int x1, const double *e, const double *a, uint32_t color)
+{
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d lane = _mm256_set_pd(3.0, 2.0, 1.0, 0.0);
+    // the low half of each 64-bit lane mask, packed into four 32-bit ones
+    const __m256i pack = _mm256_set_epi32(7, 5, 3, 1, 6, 4, 2, 0);
+    const __m128i colors = _mm_set1_epi32((int) color);
+    __m256d e0 = _mm256_add_pd(_mm256_set1_pd(e[0]), _mm256_mul_pd(lane, _mm256_set1_pd(a[0])));
+    __m256d e1 = _mm256_add_pd(_mm256_set1_pd(e[1]), _mm256_mul_pd(lane, _mm256_set1_pd(a[1])));
+    __m256d e2 = _mm256_add_pd(_mm256_set1_pd(e[2]), _mm256_mul_pd(lane, _mm256_set1_pd(a[2])));
+    const __m256d step0 = _mm256_set1_pd(a[0] * 4.0);
+    const __m256d step1 = _mm256_set1_pd(a[1] * 4.0);
+    const __m256d step2 = _mm256_set1_pd(a[2] * 4.0);
+    int x = x0;
+
+    for (; x + 4 <= x1; x += 4) {
+        __m256d inside = _mm256_and_pd(_mm256_and_pd(_mm256_cmp_pd(e0, zero, _CMP_GT_OQ),
+                                                     _mm256_cmp_pd(e1, zero, _CMP_GT_OQ)),
+                                       _mm256_cmp_pd(e2, zero, _CMP_GT_OQ));
+        __m128i mask = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(_mm256_castpd_si256(inside), pack));
+
+        _mm_maskstore_epi32((int *) (row + x), mask, colors);
+        e0 = _mm256_add_pd(e0, step0);
+        e1 = _mm256_add_pd(e1, step1);
+        e2 = _mm256_add_pd(e2, step2);
+    }
+    double tail[3] = { _mm256_cvtsd_f64(e0), _mm256_cvtsd_f64(e1), _mm256_cvtsd_f64(e2) };
+    span_scalar(row, x, x1, tail, a, color);
+}
+
+#endif
+
+static void fill(enum reference_raster_isa isa, uint32_t *row, int count, uint32_t color)
+{
+    switch (isa) {
+#ifdef HAVE_X86_KERNELS
+    case REFERENCE_RASTER_SSE2: fill_sse2(row, count, color); break;
+    case REFERENCE_RASTER_AVX2: fill_avx2(row, count, color); break;
+#endif
+    default:                    fill_scalar(row, count, color); break;
+    }
+}
+
+static void span(enum reference_raster_isa isa, uint32_t *row, int x0, int x1, const double *e, const double *a,
+                 uint32_t color)
+{
+    switch (isa) {
+#ifdef HAVE_X86_KERNELS
+    case REFERENCE_RASTER_SSE2: span_sse2(row, x0, x1, e, a, color); break;
+    case REFERENCE_RASTER_AVX2: span_avx2(row, x0, x1, e, a, color); break;
+#endif
+    default:                    span_scalar(row, x0, x1, e, a, color); break;
+    }
+}
+
+static void draw_tile(const struct job *job, int tile)
+{
+    int tile_x0 = tile % job->tiles_x * REFERENCE_RASTER_TILE;
+    int tile_y0 = tile / job->tiles_x * REFERENCE_RASTER_TILE;
+    int tile_x1 = tile_x0 + REFERENCE_RASTER_TILE < job->width ? tile_x0 + REFERENCE_RASTER_TILE : job->width;
+    int tile_y1 = tile_y0 + REFERENCE_RASTER_TILE < job->height ? tile_y0 + REFERENCE_RASTER_TILE : job->height;
+
+    for (int y = tile_y0; y < tile_y1; y++) {
+        fill(job->isa, job->pixels + (size_t) y * job->width + tile_x0, tile_x1 - tile_x0, job->clear);
+    }
+
+    for (int t = 0; t < job->setup_count; t++) {
+        const struct setup *setup = &job->setups[t];
+        int x0 = setup->min_x > tile_x0 ? setup->min_x : tile_x0;
+        int y0 = setup->min_y > tile_y0 ? setup->min_y : tile_y0;
+        int x1 = setup->max_x < tile_x1 - 1 ? setup->max_x : tile_x1 - 1;
+        int y1 = setup->max_y < tile_y1 - 1 ? setup->max_y : tile_y1 - 1;
+        int all_inside = 1, outside = 0;
+
+        if (x0 > x1 || y0 > y1) {
+            continue;
+        }
+
+        // E is linear, so its extremes over the rectangle are at its corners
+        for (int i = 0; i < 3 && !outside; i++) {
+            double e00 = setup->a[i] * x0 + setup->b[i] * y0 + setup->c[i];
+            double e10 = e00 + setup->a[i] * (x1 - x0);
+            double e01 = e00 + setup->b[i] * (y1 - y0);
+            double e11 = e10 + setup->b[i] * (y1 - y0);
+            double low = fmin(fmin(e00, e10), fmin(e01, e11));
+            double high = fmax(fmax(e00, e10), fmax(e01, e11));
+
+            outside = high <= 0.0;
+            all_inside &= low > 0.0;
+        }
+        if (outside) {
+            continue;
+        }
+
+        for (int y = y0; y <= y1; y++) {
+            uint32_t *row = job->pixels + (size_t) y * job->width;
+
+            if (all_inside) {
+                fill(job->isa, row + x0, x1 - x0 + 1, job->color);
+            } else {
+                double e[3];
+
+                for (int i = 0; i < 3; i++) {
+                    e[i] = setup->a[i] * x0 + setup->b[i] * y + setup->c[i];
+                }
+                span(job->isa, row, x0, x1 + 1, e, setup->a, job->color);
+            }
+        }
+    }
+}
+
+static void *draw_tiles(void *argument)
+{
+    struct job *job = argument;
+    int tile;
+
+    while ((tile = __atomic_fetch_add(&job->next_tile, 1, __ATOMIC_RELAXED)) < job->tile_count) {
+        draw_tile(job, tile);
+    }
+    return NULL;
+}
+
+int reference_raster_isa_supported(enum reference_raster_isa isa)
+{
+    switch (isa) {
+    case REFERENCE_RASTER_AUTO:
+    case REFERENCE_RASTER_SCALAR:
+        return 1;
+#ifdef HAVE_X86_KERNELS
+    case REFERENCE_RASTER_SSE2:
+        return __builtin_cpu_supports("sse2");
+    case REFERENCE_RASTER_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return 0;
+    }
+}
+
+const char *reference_raster_isa_name(enum reference_raster_isa isa)
+{
+    switch (isa) {
+    case REFERENCE_RASTER_AUTO:   return "auto";
+    case REFERENCE_RASTER_SCALAR: return "scalar";
+    case REFERENCE_RASTER_SSE2:   return "sse2";
+    case REFERENCE_RASTER_AVX2:   return "avx2";
+    default:                      return "unknown";
+    }
+}
+
+static enum reference_raster_isa best_isa(void)
+{
+    if (reference_raster_isa_supported(REFERENCE_RASTER_AVX2)) {
+        return REFERENCE_RASTER_AVX2;
+    }
+    if (reference_raster_isa_supported(REFERENCE_RASTER_SSE2)) {
+        return REFERENCE_RASTER_SSE2;
+    }
+    return REFERENCE_RASTER_SCALAR;
+}
+
+int reference_raster_render_with(enum reference_raster_isa isa, int thread_count, const struct reference_scene *scene,
+                                 int width, int height, uint8_t *pixels)
+{
+    struct job job;
+    pthread_t threads[MAX_THREADS];
+    int started = 0, failed = 0;
+
+    if (isa == REFERENCE_RASTER_AUTO) {
+        isa = best_isa();
+    }
+    if (!reference_raster_isa_supported(isa) || width < 1 || height < 1 || width > REFERENCE_RASTER_MAX_SIZE ||
+        height > REFERENCE_RASTER_MAX_SIZE) {
+        return -1;
+    }
+    if (thread_count < 1) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = cores > 0 ? (int) cores : 1;
+    }
+    if (thread_count > MAX_THREADS) {
+        thread_count = MAX_THREADS;
+    }
+
+    memset(&job, 0, sizeof(job));
+    job.setups = malloc((size_t) (scene->vertex_count / 3 + 1) * sizeof(*job.setups));
+    if (job.setups == NULL) {
+        return -1;
+    }
+    for (int t = 0; t < scene->vertex_count / 3 && !failed; t++) {
+        int drawn = set_up(scene->positions + t * 6, width, height, &job.setups[job.setup_count]);
+
+        failed = drawn < 0;
+        job.setup_count += drawn > 0;
+    }
+
+    job.isa = isa;
+    job.width = width;
+    job.height = height;
+    job.pixels = (uint32_t *) pixels;
+    job.clear = pack_unorm8(scene->clear_color);
+    job.color = pack_unorm8(scene->color);
+    job.tiles_x = (width + REFERENCE_RASTER_TILE - 1) / REFERENCE_RASTER_TILE;
+    job.tile_count = job.tiles_x * ((height + REFERENCE_RASTER_TILE - 1) / REFERENCE_RASTER_TILE);
+
+    // the calling thread is one of them; if a thread cannot start, the others do its share
+    for (; !failed && started < thread_count - 1; started++) {
+        if (pthread_create(&threads[started], NULL, draw_tiles, &job) != 0) {
+            break;
+        }
+    }
+    if (!failed) {
+        draw_tiles(&job);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    free(job.setups);
+    return failed ? -1 : 0;
+}
+
+int reference_raster_render(const struct reference_scene *scene, int width, int height, uint8_t *pixels)
+{
+    return reference_raster_render_with(REFERENCE_RASTER_AUTO, 0, scene, width, height, pixels);
+}
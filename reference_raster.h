@@ -0,0 +1,71 @@
+#ifndef REFERENCE_RASTER_H
+#define REFERENCE_RASTER_H
+
+#include <stdint.h>
+
+/*
+ * A CPU rasterizer for the suite's program (draw_pipeline.h's
+ * vertex_shader and fragment_shader), to compute a draw's expected frame
+ * on the fly instead of keeping a golden image of it.
+ *
+ * The vertex stage is the shader's: gl_Position = vec4(v, 0.0, 1.0). The
+ * viewport transform is one float multiply-add, fused as llvmpipe does it,
+ * and the result is snapped to REFERENCE_RASTER_SUBPIXEL_BITS of fixed
+ * point, so coverage is decided exactly: three integer edge functions per
+ * triangle, sampled at pixel centers. A pixel center right on an edge
+ * belongs to the triangle if the edge is a left or (y up) bottom one.
+ * Triangles of both windings are drawn, each over the ones before it, and
+ * every covered pixel gets the fragment stage's one color. There is no depth
+ * test, as in the draw test.
+ *
+ * Triangles are not clipped. A GPU may clip one that crosses the viewport's
+ * edge into new vertices, which snap a little differently, so frames match
+ * the GPU's bit for bit only where every triangle lies inside the viewport
+ * or covers it whole.
+ *
+ * The frame is cut into REFERENCE_RASTER_TILE-pixel square tiles that
+ * threads take in turn. A tile a triangle covers whole is filled; one it
+ * covers in part walks its rows with the edge functions in SIMD lanes (4
+ * with AVX2, 2 with SSE2, picked at run time like image_compare). The edge
+ * values are whole numbers under 2^53, held in doubles, so every kernel
+ * gives the same frame bit for bit.
+ */
+
+#define REFERENCE_RASTER_SUBPIXEL_BITS 8
+#define REFERENCE_RASTER_TILE 64
+#define REFERENCE_RASTER_MAX_SIZE 16384     /* on a side */
+#define REFERENCE_RASTER_GUARD_BAND 32768   /* pixels a vertex may lie from the viewport's origin */
+
+enum reference_raster_isa {
+    REFERENCE_RASTER_AUTO = 0,
+    REFERENCE_RASTER_SCALAR,
+    REFERENCE_RASTER_SSE2,
+    REFERENCE_RASTER_AVX2
+};
+
+struct reference_scene {
+    const float *positions;     /* vertex_count vec2, the vertex shader's v */
+    int vertex_count;           /* drawn as GL_TRIANGLES */
+    float clear_color[4];
+    float color[4];             /* what the fragment shader writes; the suite's is white */
+};
+
+int reference_raster_isa_supported(enum reference_raster_isa isa);
+const char *reference_raster_isa_name(enum reference_raster_isa isa);
+
+/*
+ * Renders scene into pixels, width x height tightly packed RGBA8 in
+ * glReadPixels order (bottom row first), as it would come out of a
+ * width x height viewport. Returns 0, or -1 if the size is out of range
+ * or a vertex is outside the guard band.
+ */
+int reference_raster_render(const struct reference_scene *scene, int width, int height, uint8_t *pixels);
+
+/*
+ * Same, on a specific kernel and with up to thread_count threads (0: one
+ * per core). Also -1 if the CPU cannot run isa.
+ */
+int reference_raster_render_with(enum reference_raster_isa isa, int thread_count, const struct reference_scene *scene,
+                                 int width, int height, uint8_t *pixels);
+
+#endif
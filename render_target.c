@@ -0,0 +1,180 @@
+#include "render_target.h"
+
+#include <string.h>
+
+struct format_info {
+    GLenum format;
+    const char *name;
+    unsigned bytes;
+};
+
+static const struct format_info formats[] = {
+    { GL_RGBA8, "RGBA8", 4 },
+    { GL_RGBA16F, "RGBA16F", 8 },
+    { GL_RGBA32F, "RGBA32F", 16 },
+    { GL_DEPTH_COMPONENT16, "DEPTH16", 2 },
+    { GL_DEPTH_COMPONENT24, "DEPTH24", 4 },     // padded to 32 bits in practice
+    { GL_DEPTH_COMPONENT32F, "DEPTH32F", 4 },
+    { GL_DEPTH24_STENCIL8, "DEPTH24_STENCIL8", 4 },
+    { GL_DEPTH32F_STENCIL8, "DEPTH32F_STENCIL8", 8 },
+};
+
+static const struct format_info *find_format(GLenum format)
+{
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+        if (formats[i].format == format) {
+            return &formats[i];
+        }
+    }
+    return NULL;
+}
+
+unsigned render_target_format_bytes(GLenum format)
+{
+    const struct format_info *info = find_format(format);
+    return info != NULL ? info->bytes : 0;
+}
+
+const char *render_target_format_name(GLenum format)
+{
+    const struct format_info *info = find_format(format);
+    return info != NULL ? info->name : "none";
+}
+
+static GLsizei sample_count(const struct render_target_desc *desc)
+{
+    return desc->samples > 1 ? desc->samples : 1;
+}
+
+uint64_t render_target_bytes(const struct render_target_desc *desc)
+{
+    uint64_t pixels = (uint64_t) desc->width * (uint64_t) desc->height;
+    uint64_t per_sample = (uint64_t) render_target_format_bytes(desc->color_format) * desc->color_count +
+                          render_target_format_bytes(desc->depth_format);
+    uint64_t bytes = pixels * sample_count(desc) * per_sample;
+
+    if (sample_count(desc) > 1) {
+        bytes += pixels * render_target_format_bytes(desc->color_format) * desc->color_count;
+    }
+    return bytes;
+}
+
+static int is_depth_stencil(GLenum format)
+{
+    return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+}
+
+static GLuint make_renderbuffer(GLenum format, GLsizei samples, GLsizei width, GLsizei height)
+{
+    GLuint renderbuffer;
+
+    glGenRenderbuffers(1, &renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples > 1 ? samples : 0, format, width, height);
+    return renderbuffer;
+}
+
+static void set_draw_buffers(int count)
+{
+    GLenum buffers[RENDER_TARGET_MAX_COLORS];
+
+    for (int i = 0; i < count; i++) {
+        buffers[i] = GL_COLOR_ATTACHMENT0 + i;
+    }
+    glDrawBuffers(count, buffers);
+}
+
+GLenum render_target_create(struct render_target *target, const struct render_target_desc *desc)
+{
+    GLint max_size = 0, max_samples = 0, max_draw_buffers = 0;
+
+    memset(target, 0, sizeof(*target));
+    target->desc = *desc;
+
+    glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &max_size);
+    glGetIntegerv(GL_MAX_SAMPLES, &max_samples);
+    glGetIntegerv(GL_MAX_DRAW_BUFFERS, &max_draw_buffers);
+    if (desc->width > max_size || desc->height > max_size || sample_count(desc) > max_samples ||
+        desc->color_count < 1 || desc->color_count > RENDER_TARGET_MAX_COLORS ||
+        desc->color_count > max_draw_buffers) {
+        return GL_INVALID_VALUE;
+    }
+
+    glGenFramebuffers(1, &target->framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, target->framebuffer);
+    for (int i = 0; i < desc->color_count; i++) {
+        target->colors[i] = make_renderbuffer(desc->color_format, desc->samples, desc->width, desc->height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_RENDERBUFFER, target->colors[i]);
+    }
+    if (desc->depth_format != 0) {
+        target->depth = make_renderbuffer(desc->depth_format, desc->samples, desc->width, desc->height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER,
+                                  is_depth_stencil(desc->depth_format) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT,
+                                  GL_RENDERBUFFER, target->depth);
+    }
+    set_draw_buffers(desc->color_count);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+    if (status == GL_FRAMEBUFFER_COMPLETE && sample_count(desc) > 1) {
+        glGenFramebuffers(1, &target->resolve_framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, target->resolve_framebuffer);
+        for (int i = 0; i < desc->color_count; i++) {
+            target->resolve_colors[i] = make_renderbuffer(desc->color_format, 0, desc->width, desc->height);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_RENDERBUFFER,
+                                      target->resolve_colors[i]);
+        }
+        status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    }
+
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return status;
+}
+
+void render_target_destroy(struct render_target *target)
+{
+    glDeleteFramebuffers(1, &target->framebuffer);
+    glDeleteFramebuffers(1, &target->resolve_framebuffer);
+    glDeleteRenderbuffers(RENDER_TARGET_MAX_COLORS, target->colors);
+    glDeleteRenderbuffers(RENDER_TARGET_MAX_COLORS, target->resolve_colors);
+    glDeleteRenderbuffers(1, &target->depth);
+    memset(target, 0, sizeof(*target));
+}
+
+void render_target_bind(const struct render_target *target)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, target->framebuffer);
+    glViewport(0, 0, target->desc.width, target->desc.height);
+}
+
+void render_target_resolve(const struct render_target *target)
+{
+    if (target->resolve_framebuffer == 0) {
+        return;
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, target->framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target->resolve_framebuffer);
+
+    // a blit reads one color buffer, so each attachment is resolved on its own
+    for (int i = 0; i < target->desc.color_count; i++) {
+        GLenum buffers[RENDER_TARGET_MAX_COLORS];
+
+        for (int k = 0; k < target->desc.color_count; k++) {
+            buffers[k] = k == i ? GL_COLOR_ATTACHMENT0 + i : GL_NONE;
+        }
+        glReadBuffer(GL_COLOR_ATTACHMENT0 + i);
+        glDrawBuffers(target->desc.color_count, buffers);
+        glBlitFramebuffer(0, 0, target->desc.width, target->desc.height, 0, 0, target->desc.width,
+                          target->desc.height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    }
+
+    set_draw_buffers(target->desc.color_count);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+GLuint render_target_result_framebuffer(const struct render_target *target)
+{
+    return target->resolve_framebuffer != 0 ? target->resolve_framebuffer : target->framebuffer;
+}
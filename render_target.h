@@ -0,0 +1,60 @@
+#ifndef RENDER_TARGET_H
+#define RENDER_TARGET_H
+
+#include <stdint.h>
+
+#include "glc.h"
+
+/*
+ * Offscreen render targets of any size, color format, depth format,
+ * sample count and number of color attachments, built from renderbuffers.
+ * A multisampled target also gets a single-sampled twin to resolve into
+ * with glBlitFramebuffer, one attachment at a time.
+ */
+
+#define RENDER_TARGET_MAX_COLORS 8
+
+struct render_target_desc {
+    GLsizei width;
+    GLsizei height;
+    GLenum color_format;    /* a sized color format, e.g. GL_RGBA16F */
+    GLenum depth_format;    /* a sized depth or depth-stencil format, or 0 for none */
+    GLsizei samples;        /* 0 or 1 for single-sampled */
+    int color_count;        /* 1 to RENDER_TARGET_MAX_COLORS */
+};
+
+struct render_target {
+    struct render_target_desc desc;
+    GLuint framebuffer;
+    GLuint colors[RENDER_TARGET_MAX_COLORS];
+    GLuint depth;
+    GLuint resolve_framebuffer;     /* 0 unless multisampled */
+    GLuint resolve_colors[RENDER_TARGET_MAX_COLORS];
+};
+
+/* Bytes per pixel per sample; 0 for formats it does not know. */
+unsigned render_target_format_bytes(GLenum format);
+
+const char *render_target_format_name(GLenum format);
+
+/* Storage the target takes, resolve twin included, at the formats' nominal sizes. */
+uint64_t render_target_bytes(const struct render_target_desc *desc);
+
+/*
+ * Returns glCheckFramebufferStatus() of the (multisampled) framebuffer, or
+ * GL_INVALID_VALUE if desc asks for more than the context's limits allow.
+ * Leaves every binding at 0. Destroy the target whatever this returns.
+ */
+GLenum render_target_create(struct render_target *target, const struct render_target_desc *desc);
+void render_target_destroy(struct render_target *target);
+
+/* Binds the target for drawing into every attachment and sets the viewport. */
+void render_target_bind(const struct render_target *target);
+
+/* Blits every attachment into the resolve twin. Leaves the framebuffer bindings at 0. */
+void render_target_resolve(const struct render_target *target);
+
+/* The framebuffer that holds single-sampled results: the resolve twin if there is one. */
+GLuint render_target_result_framebuffer(const struct render_target *target);
+
+#endif
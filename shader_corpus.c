@@ -0,0 +1,392 @@
+#include "shader_corpus.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* macOS headers stop at 4.1 and know nothing of parallel shader compiles. */
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+#define ALL_THREADS 0xFFFFFFFFu
+
+typedef void (*max_shader_compiler_threads_proc)(GLuint count);
+
+static const char *feature_defines[] = {
+    "SKINNING", "NORMAL_MAP", "SHADOWS", "FOG", "ALPHA_TEST", "VERTEX_COLOR"
+};
+
+static const char *vs_body =
+    "layout (location = 0) in vec3 position;\n"
+    "layout (location = 1) in vec3 normal;\n"
+    "layout (location = 2) in vec2 uv_in;\n"
+    "uniform mat4 model;\n"
+    "uniform mat4 view_projection;\n"
+    "out vec3 world_position;\n"
+    "out vec3 world_normal;\n"
+    "out vec2 uv;\n"
+    "#ifdef NORMAL_MAP\n"
+    "layout (location = 3) in vec4 tangent;\n"
+    "out vec3 world_tangent;\n"
+    "out vec3 world_bitangent;\n"
+    "#endif\n"
+    "#ifdef SKINNING\n"
+    "layout (location = 4) in uvec4 bone_index;\n"
+    "layout (location = 5) in vec4 bone_weight;\n"
+    "uniform mat4 bones[64];\n"
+    "#endif\n"
+    "#ifdef VERTEX_COLOR\n"
+    "layout (location = 6) in vec4 color_in;\n"
+    "out vec4 color;\n"
+    "#endif\n"
+    "#ifdef SHADOWS\n"
+    "uniform mat4 light_view_projection;\n"
+    "out vec4 shadow_position;\n"
+    "#endif\n"
+    "void main() {\n"
+    "    mat4 skin = mat4(1.0);\n"
+    "#ifdef SKINNING\n"
+    "    skin = bones[bone_index.x] * bone_weight.x + bones[bone_index.y] * bone_weight.y +\n"
+    "           bones[bone_index.z] * bone_weight.z + bones[bone_index.w] * bone_weight.w;\n"
+    "#endif\n"
+    "    vec4 world = model * skin * vec4(position, 1.0);\n"
+    "    mat3 normal_matrix = mat3(model * skin);\n"
+    "    world_position = world.xyz;\n"
+    "    world_normal = normalize(normal_matrix * normal);\n"
+    "#ifdef NORMAL_MAP\n"
+    "    world_tangent = normalize(normal_matrix * tangent.xyz);\n"
+    "    world_bitangent = cross(world_normal, world_tangent) * tangent.w;\n"
+    "#endif\n"
+    "#ifdef VERTEX_COLOR\n"
+    "    color = color_in;\n"
+    "#endif\n"
+    "#ifdef SHADOWS\n"
+    "    shadow_position = light_view_projection * world;\n"
+    "#endif\n"
+    "    uv = uv_in;\n"
+    "    gl_Position = view_projection * world;\n"
+    "}\n";
+
+static const char *fs_body =
+    "in vec3 world_position;\n"
+    "in vec3 world_normal;\n"
+    "in vec2 uv;\n"
+    "uniform sampler2D albedo_map;\n"
+    "uniform vec3 camera_position;\n"
+    "uniform vec4 light_position[LIGHT_COUNT];\n"
+    "uniform vec3 light_color[LIGHT_COUNT];\n"
+    "uniform float roughness;\n"
+    "layout (location = 0) out vec4 frag_color;\n"
+    "#ifdef NORMAL_MAP\n"
+    "in vec3 world_tangent;\n"
+    "in vec3 world_bitangent;\n"
+    "uniform sampler2D normal_map;\n"
+    "#endif\n"
+    "#ifdef VERTEX_COLOR\n"
+    "in vec4 color;\n"
+    "#endif\n"
+    "#ifdef SHADOWS\n"
+    "in vec4 shadow_position;\n"
+    "uniform sampler2DShadow shadow_map;\n"
+    "#endif\n"
+    "#ifdef FOG\n"
+    "uniform vec4 fog;\n"
+    "#endif\n"
+    "#ifdef ALPHA_TEST\n"
+    "uniform float alpha_cutoff;\n"
+    "#endif\n"
+    "float shadow() {\n"
+    "#ifdef SHADOWS\n"
+    "    vec3 p = shadow_position.xyz / shadow_position.w * 0.5 + 0.5;\n"
+    "    float lit = 0.0;\n"
+    "    for (int i = -2; i <= 2; i++) {\n"
+    "        for (int j = -2; j <= 2; j++) {\n"
+    "            lit += texture(shadow_map, vec3(p.xy + vec2(i, j) / 2048.0, p.z - 0.002));\n"
+    "        }\n"
+    "    }\n"
+    "    return lit / 25.0;\n"
+    "#else\n"
+    "    return 1.0;\n"
+    "#endif\n"
+    "}\n"
+    "void main() {\n"
+    "    vec4 albedo = texture(albedo_map, uv);\n"
+    "#ifdef VERTEX_COLOR\n"
+    "    albedo *= color;\n"
+    "#endif\n"
+    "#ifdef ALPHA_TEST\n"
+    "    if (albedo.a < alpha_cutoff) {\n"
+    "        discard;\n"
+    "    }\n"
+    "#endif\n"
+    "    vec3 n = normalize(world_normal);\n"
+    "#ifdef NORMAL_MAP\n"
+    "    vec3 t = texture(normal_map, uv).xyz * 2.0 - 1.0;\n"
+    "    n = normalize(mat3(normalize(world_tangent), normalize(world_bitangent), n) * t);\n"
+    "#endif\n"
+    "    vec3 v = normalize(camera_position - world_position);\n"
+    "    float a2 = roughness * roughness * roughness * roughness;\n"
+    "    vec3 f0 = mix(vec3(0.04), albedo.rgb, 0.1);\n"
+    "    vec3 lit = vec3(0.0);\n"
+    "    for (int i = 0; i < LIGHT_COUNT; i++) {\n"
+    "        vec3 l = light_position[i].xyz - world_position * light_position[i].w;\n"
+    "        float distance2 = max(dot(l, l), 1e-4);\n"
+    "        l = normalize(l);\n"
+    "        vec3 h = normalize(l + v);\n"
+    "        float n_dot_l = max(dot(n, l), 0.0);\n"
+    "        float n_dot_v = max(dot(n, v), 1e-4);\n"
+    "        float n_dot_h = max(dot(n, h), 0.0);\n"
+    "        float d = n_dot_h * n_dot_h * (a2 - 1.0) + 1.0;\n"
+    "        float k = a2 * 0.5;\n"
+    "        float g = n_dot_l / (n_dot_l * (1.0 - k) + k) * n_dot_v / (n_dot_v * (1.0 - k) + k);\n"
+    "        vec3 f = f0 + (1.0 - f0) * pow(1.0 - max(dot(h, v), 0.0), 5.0);\n"
+    "        vec3 specular = f * a2 / (3.14159265 * d * d) * g / (4.0 * n_dot_v * max(n_dot_l, 1e-4));\n"
+    "        vec3 diffuse = (1.0 - f) * albedo.rgb / 3.14159265;\n"
+    "        lit += (diffuse + specular) * light_color[i] * n_dot_l / mix(1.0, distance2, light_position[i].w);\n"
+    "    }\n"
+    "    lit = lit * shadow() + albedo.rgb * 0.03;\n"
+    "#ifdef FOG\n"
+    "    lit = mix(fog.rgb, lit, exp(-fog.a * length(camera_position - world_position)));\n"
+    "#endif\n"
+    "    frag_color = vec4(pow(lit / (lit + 1.0), vec3(1.0 / 2.2)), albedo.a);\n"
+    "}\n";
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+/* The #version line, the salt and the variant's #defines, then body. */
+static char *variant_source(const struct shader_variant *variant, int index, uint64_t salt, const char *body)
+{
+    char header[512];
+    int length = snprintf(header, sizeof(header), "#version 410\n// corpus %llu variant %d\n#define LIGHT_COUNT %d\n",
+                          (unsigned long long) salt, index, variant->light_count);
+
+    for (size_t f = 0; f < sizeof(feature_defines) / sizeof(feature_defines[0]); f++) {
+        if (variant->features & (1u << f)) {
+            length += snprintf(header + length, sizeof(header) - length, "#define %s\n", feature_defines[f]);
+        }
+    }
+
+    char *source = malloc(length + strlen(body) + 1);
+    if (source != NULL) {
+        memcpy(source, header, length);
+        strcpy(source + length, body);
+    }
+    return source;
+}
+
+int shader_corpus_generate(struct shader_corpus *corpus, int count, uint64_t salt)
+{
+    memset(corpus, 0, sizeof(*corpus));
+    corpus->variants = calloc(count, sizeof(*corpus->variants));
+    if (corpus->variants == NULL) {
+        return -1;
+    }
+    corpus->count = count;
+
+    for (int i = 0; i < count; i++) {
+        struct shader_variant *variant = &corpus->variants[i];
+
+        variant->features = i % 64;
+        variant->light_count = 1 << (i / 64 % 4);
+        variant->vs_source = variant_source(variant, i, salt, vs_body);
+        variant->fs_source = variant_source(variant, i, salt, fs_body);
+        if (variant->vs_source == NULL || variant->fs_source == NULL) {
+            shader_corpus_destroy(corpus);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void shader_corpus_destroy(struct shader_corpus *corpus)
+{
+    for (int i = 0; i < corpus->count; i++) {
+        free(corpus->variants[i].vs_source);
+        free(corpus->variants[i].fs_source);
+    }
+    free(corpus->variants);
+    memset(corpus, 0, sizeof(*corpus));
+}
+
+static max_shader_compiler_threads_proc max_threads_proc(void)
+{
+    GLint extensions = 0;
+
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+    for (GLint i = 0; i < extensions; i++) {
+        const char *extension = (const char *) glGetStringi(GL_EXTENSIONS, i);
+
+        if (strcmp(extension, "GL_KHR_parallel_shader_compile") == 0) {
+            return (max_shader_compiler_threads_proc) glc_get_proc_address("glMaxShaderCompilerThreadsKHR");
+        }
+        if (strcmp(extension, "GL_ARB_parallel_shader_compile") == 0) {
+            return (max_shader_compiler_threads_proc) glc_get_proc_address("glMaxShaderCompilerThreadsARB");
+        }
+    }
+    return NULL;
+}
+
+int shader_corpus_has_parallel_compile(void)
+{
+    return max_threads_proc() != NULL;
+}
+
+static GLuint compile_stage(GLenum stage, const char *source)
+{
+    GLuint shader = glCreateShader(stage);
+
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    return shader;
+}
+
+/* Starts the link; the shaders go with the program. */
+static GLuint link_stages(GLuint vs, GLuint fs)
+{
+    GLuint program = glCreateProgram();
+
+    glAttachShader(program, vs);
+    glAttachShader(program, fs);
+    glLinkProgram(program);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+    return program;
+}
+
+/* Returns program if it linked, else deletes it and returns 0. */
+static GLuint keep_if_linked(GLuint program)
+{
+    GLint is_linked = 0;
+
+    glGetProgramiv(program, GL_LINK_STATUS, &is_linked);
+    if (!is_linked) {
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+static void compile_serial(const struct shader_corpus *corpus, struct shader_corpus_result *results)
+{
+    uint64_t start = now_ns();
+
+    for (int i = 0; i < corpus->count; i++) {
+        GLint vs_is_compiled = 0, fs_is_compiled = 0;
+        uint64_t compile_start = now_ns();
+
+        GLuint vs = compile_stage(GL_VERTEX_SHADER, corpus->variants[i].vs_source);
+        GLuint fs = compile_stage(GL_FRAGMENT_SHADER, corpus->variants[i].fs_source);
+        // asking for the status waits for a compile the driver may have deferred
+        glGetShaderiv(vs, GL_COMPILE_STATUS, &vs_is_compiled);
+        glGetShaderiv(fs, GL_COMPILE_STATUS, &fs_is_compiled);
+        uint64_t link_start = now_ns();
+
+        results[i].program = keep_if_linked(link_stages(vs, fs));
+        results[i].compile_ns = link_start - compile_start;
+        results[i].link_ns = now_ns() - link_start;
+        results[i].ready_ns = now_ns() - start;
+    }
+}
+
+static void compile_parallel(const struct shader_corpus *corpus, struct shader_corpus_result *results)
+{
+    uint64_t start = now_ns();
+
+    for (int i = 0; i < corpus->count; i++) {
+        uint64_t compile_start = now_ns();
+
+        GLuint vs = compile_stage(GL_VERTEX_SHADER, corpus->variants[i].vs_source);
+        GLuint fs = compile_stage(GL_FRAGMENT_SHADER, corpus->variants[i].fs_source);
+        uint64_t link_start = now_ns();
+
+        results[i].program = link_stages(vs, fs);
+        results[i].compile_ns = link_start - compile_start;
+        results[i].link_ns = now_ns() - link_start;
+    }
+
+    // in issue order: the driver's threads take the compiles in that order too
+    for (int i = 0; i < corpus->count; i++) {
+        GLint is_complete = 0;
+        struct timespec pause = { 0, 100000 };
+
+        for (;;) {
+            glGetProgramiv(results[i].program, GL_COMPLETION_STATUS_KHR, &is_complete);
+            if (is_complete) {
+                break;
+            }
+            nanosleep(&pause, NULL);
+        }
+        results[i].ready_ns = now_ns() - start;
+        results[i].program = keep_if_linked(results[i].program);
+    }
+}
+
+static void compile_on_workers(const struct shader_corpus *corpus, struct loader *loader,
+                               struct shader_corpus_result *results)
+{
+    struct loader_request *requests = calloc(corpus->count, sizeof(*requests));
+    int submitted = 0, collected = 0;
+
+    if (requests == NULL) {
+        return;
+    }
+
+    uint64_t start = now_ns();
+    while (collected < corpus->count) {
+        struct loader_request *request;
+
+        while (submitted < corpus->count) {
+            requests[submitted].kind = LOADER_PROGRAM;
+            requests[submitted].vs_source = corpus->variants[submitted].vs_source;
+            requests[submitted].fs_source = corpus->variants[submitted].fs_source;
+            if (loader_submit(loader, &requests[submitted]) != 0) {
+                break;
+            }
+            submitted++;
+        }
+        // requests is freed below, so never leave with one still in flight
+        while ((request = loader_collect(loader, 1000000000u)) == NULL) {
+        }
+        results[request - requests].program = request->name;
+        results[request - requests].ready_ns = now_ns() - start;
+        collected++;
+    }
+    free(requests);
+}
+
+int shader_corpus_compile(const struct shader_corpus *corpus, enum shader_corpus_mode mode, struct loader *loader,
+                          struct shader_corpus_result *results)
+{
+    max_shader_compiler_threads_proc max_threads = max_threads_proc();
+    int failed = 0;
+
+    memset(results, 0, corpus->count * sizeof(*results));
+
+    if (mode == SHADER_CORPUS_WORKERS) {
+        compile_on_workers(corpus, loader, results);
+    } else if (mode == SHADER_CORPUS_PARALLEL && max_threads != NULL) {
+        max_threads(ALL_THREADS);
+        compile_parallel(corpus, results);
+    } else {
+        // 0 threads: the driver compiles on the calling thread, as without the extension
+        if (max_threads != NULL) {
+            max_threads(0);
+        }
+        compile_serial(corpus, results);
+        if (max_threads != NULL) {
+            max_threads(ALL_THREADS);
+        }
+    }
+
+    for (int i = 0; i < corpus->count; i++) {
+        failed += results[i].program == 0;
+    }
+    return failed;
+}
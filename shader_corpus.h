@@ -0,0 +1,80 @@
+#ifndef SHADER_CORPUS_H
+#define SHADER_CORPUS_H
+
+#include <stdint.h>
+
+#include "glc.h"
+#include "loader.h"
+
+/*
+ * A generated set of shader permutations, for measuring startup the way
+ * an application that compiles hundreds of variants sees it.
+ *
+ * Every variant is the same forward-lighting uber shader (skinned
+ * vertices, a normal-mapped GGX loop over LIGHT_COUNT lights, 5x5 PCF
+ * shadows, fog, alpha test, vertex colors) with its own set of #defines:
+ * variant i has the feature bits i % 64 and 1, 2, 4 or 8 lights, so 256
+ * variants are all different programs. The salt goes into a comment of
+ * every source so a driver's own shader cache cannot hit.
+ *
+ * shader_corpus_compile() builds every variant one of three ways:
+ *
+ *   SERIAL    compile and link each program before starting the next,
+ *             with any driver compiler threads turned off
+ *   PARALLEL  issue every compile and link, then poll
+ *             GL_COMPLETION_STATUS_KHR (KHR_parallel_shader_compile)
+ *   WORKERS   hand every program to a loader, whose shared contexts
+ *             compile them on their own threads
+ */
+
+enum shader_corpus_feature {
+    SHADER_CORPUS_SKINNING = 1 << 0,
+    SHADER_CORPUS_NORMAL_MAP = 1 << 1,
+    SHADER_CORPUS_SHADOWS = 1 << 2,
+    SHADER_CORPUS_FOG = 1 << 3,
+    SHADER_CORPUS_ALPHA_TEST = 1 << 4,
+    SHADER_CORPUS_VERTEX_COLOR = 1 << 5
+};
+
+enum shader_corpus_mode {
+    SHADER_CORPUS_SERIAL,
+    SHADER_CORPUS_PARALLEL,
+    SHADER_CORPUS_WORKERS
+};
+
+struct shader_variant {
+    unsigned features;      /* shader_corpus_feature bits */
+    int light_count;
+    char *vs_source;
+    char *fs_source;
+};
+
+struct shader_corpus {
+    struct shader_variant *variants;
+    int count;
+};
+
+struct shader_corpus_result {
+    GLuint program;         /* 0 if the variant did not link */
+    uint64_t compile_ns;    /* both stages; SERIAL: the compile, PARALLEL: issuing it, WORKERS: 0 */
+    uint64_t link_ns;       /* likewise */
+    uint64_t ready_ns;      /* from the start of the batch until the program was usable here */
+};
+
+/* Returns 0, or -1 out of memory with nothing allocated. */
+int shader_corpus_generate(struct shader_corpus *corpus, int count, uint64_t salt);
+void shader_corpus_destroy(struct shader_corpus *corpus);
+
+/* 1 if the current context has KHR_parallel_shader_compile (or the ARB one). */
+int shader_corpus_has_parallel_compile(void);
+
+/*
+ * Builds every variant into results (corpus->count entries); the programs
+ * belong to the caller. loader is only used by WORKERS, and must be idle.
+ * PARALLEL falls back to SERIAL without the extension. Returns the number
+ * of variants that did not link.
+ */
+int shader_corpus_compile(const struct shader_corpus *corpus, enum shader_corpus_mode mode, struct loader *loader,
+                          struct shader_corpus_result *results);
+
+#endif
@@ -0,0 +1,257 @@
+#include "shard_runner.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* What a worker sends back for every test it ran. */
+struct result_header {
+    int32_t rtype;
+    int32_t ctx;
+    int32_t line;
+    uint32_t file_length;
+    uint32_t tcname_length;
+    uint32_t msg_length;
+};
+
+struct result {
+    int rtype;
+    int line;
+    char *file;
+    char *tcname;
+    char *msg;
+};
+
+struct shard {
+    pid_t pid;
+    int fd;
+    struct result *results;
+    int result_count;
+    int status;
+};
+
+static int write_all(int fd, const void *data, size_t size)
+{
+    const char *p = data;
+
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        size -= (size_t) n;
+    }
+    return 0;
+}
+
+static int read_all(int fd, void *data, size_t size)
+{
+    char *p = data;
+
+    while (size > 0) {
+        ssize_t n = read(fd, p, size);
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        size -= (size_t) n;
+    }
+    return 0;
+}
+
+static char *read_string(int fd, uint32_t length)
+{
+    char *s = malloc(length + 1);
+
+    if (s == NULL || read_all(fd, s, length) != 0) {
+        free(s);
+        return NULL;
+    }
+    s[length] = '\0';
+    return s;
+}
+
+static void run_worker(shard_runner_make_suite make_suite, int shard, int shard_count,
+                       shard_runner_on_results on_results, int fd)
+{
+    SRunner *sr = srunner_create(make_suite(shard, shard_count));
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_SILENT);
+    if (on_results != NULL) {
+        on_results(sr);
+    }
+
+    TestResult **results = srunner_results(sr);
+    int count = srunner_ntests_run(sr);
+
+    for (int i = 0; i < count; i++) {
+        const char *file = tr_lfile(results[i]) ? tr_lfile(results[i]) : "";
+        const char *tcname = tr_tcname(results[i]) ? tr_tcname(results[i]) : "";
+        const char *msg = tr_msg(results[i]) ? tr_msg(results[i]) : "";
+        struct result_header header = {
+            tr_rtype(results[i]), tr_ctx(results[i]), tr_lno(results[i]),
+            (uint32_t) strlen(file), (uint32_t) strlen(tcname), (uint32_t) strlen(msg)
+        };
+
+        if (write_all(fd, &header, sizeof(header)) != 0 ||
+            write_all(fd, file, header.file_length) != 0 ||
+            write_all(fd, tcname, header.tcname_length) != 0 ||
+            write_all(fd, msg, header.msg_length) != 0) {
+            break;
+        }
+    }
+
+    free(results);
+    srunner_free(sr);
+}
+
+static void collect_results(struct shard *shard)
+{
+    struct result_header header;
+
+    while (read_all(shard->fd, &header, sizeof(header)) == 0) {
+        struct result *results = realloc(shard->results, (shard->result_count + 1) * sizeof(*results));
+        if (results == NULL) {
+            break;
+        }
+        shard->results = results;
+
+        struct result *r = &shard->results[shard->result_count++];
+        r->rtype = header.rtype;
+        r->line = header.line;
+        r->file = read_string(shard->fd, header.file_length);
+        r->tcname = read_string(shard->fd, header.tcname_length);
+        r->msg = read_string(shard->fd, header.msg_length);
+    }
+}
+
+static char result_char(int rtype)
+{
+    switch (rtype) {
+    case CK_PASS:    return 'P';
+    case CK_FAILURE: return 'F';
+    default:         return 'E';
+    }
+}
+
+int shard_runner_default_shard_count(void)
+{
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (int) cores : 1;
+}
+
+int shard_runner_run(shard_runner_make_suite make_suite, int shard_count, enum print_output print_mode,
+                     shard_runner_on_results on_results)
+{
+    struct timeval start, end;
+    struct shard *shards = calloc(shard_count, sizeof(*shards));
+
+    if (shards == NULL) {
+        return -1;
+    }
+
+    if (print_mode != CK_SILENT) {
+        printf("Running suite(s) on %d shard(s)\n", shard_count);
+        fflush(stdout);
+    }
+
+    gettimeofday(&start, NULL);
+
+    for (int i = 0; i < shard_count; i++) {
+        int fds[2];
+
+        if (pipe(fds) != 0) {
+            shards[i].pid = -1;
+            continue;
+        }
+
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(fds[0]);
+            run_worker(make_suite, i, shard_count, on_results, fds[1]);
+            close(fds[1]);
+            _exit(EXIT_SUCCESS);
+        }
+
+        close(fds[1]);
+        shards[i].pid = pid;
+        shards[i].fd = fds[0];
+    }
+
+    for (int i = 0; i < shard_count; i++) {
+        if (shards[i].pid <= 0) {
+            continue;
+        }
+        collect_results(&shards[i]);
+        close(shards[i].fd);
+        waitpid(shards[i].pid, &shards[i].status, 0);
+    }
+
+    gettimeofday(&end, NULL);
+
+    int checks = 0, failures = 0, errors = 0;
+
+    for (int i = 0; i < shard_count; i++) {
+        int worker_died = shards[i].pid <= 0 ||
+                          !WIFEXITED(shards[i].status) ||
+                          WEXITSTATUS(shards[i].status) != EXIT_SUCCESS;
+
+        checks += shards[i].result_count;
+        for (int k = 0; k < shards[i].result_count; k++) {
+            failures += shards[i].results[k].rtype == CK_FAILURE;
+            errors += shards[i].results[k].rtype == CK_ERROR;
+        }
+        // a worker that crashed mid-shard takes the rest of its tests with it
+        if (worker_died) {
+            checks++;
+            errors++;
+        }
+    }
+
+    int passed = checks - failures - errors;
+
+    if (print_mode != CK_SILENT) {
+        printf("%d%%: Checks: %d, Failures: %d, Errors: %d\n",
+               checks ? passed * 100 / checks : 0, checks, failures, errors);
+
+        for (int i = 0; i < shard_count; i++) {
+            for (int k = 0; k < shards[i].result_count; k++) {
+                struct result *r = &shards[i].results[k];
+
+                if (r->rtype != CK_PASS || print_mode >= CK_VERBOSE) {
+                    printf("%s:%d:%c:%s:shard %d: %s\n", r->file ? r->file : "", r->line,
+                           result_char(r->rtype), r->tcname ? r->tcname : "", i, r->msg ? r->msg : "");
+                }
+            }
+            if (shards[i].pid <= 0) {
+                printf("shard %d: could not start worker\n", i);
+            } else if (WIFSIGNALED(shards[i].status)) {
+                printf("shard %d: worker received signal %d\n", i, WTERMSIG(shards[i].status));
+            } else if (WEXITSTATUS(shards[i].status) != EXIT_SUCCESS) {
+                printf("shard %d: worker exited with %d\n", i, WEXITSTATUS(shards[i].status));
+            }
+        }
+
+        if (print_mode >= CK_VERBOSE) {
+            printf("Suite wall time: %.1f ms\n",
+                   (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_usec - start.tv_usec) / 1e3);
+        }
+    }
+
+    for (int i = 0; i < shard_count; i++) {
+        for (int k = 0; k < shards[i].result_count; k++) {
+            free(shards[i].results[k].file);
+            free(shards[i].results[k].tcname);
+            free(shards[i].results[k].msg);
+        }
+        free(shards[i].results);
+    }
+    free(shards);
+
+    return failures + errors;
+}
@@ -0,0 +1,30 @@
+#ifndef SHARD_RUNNER_H
+#define SHARD_RUNNER_H
+
+#include <check.h>
+
+/*
+ * Runs a suite split into shards, one worker per shard, and merges the
+ * results into a single libcheck style report.
+ *
+ * Workers are processes rather than threads: libcheck keeps its no-fork
+ * failure handling (the longjmp target of ck_assert) in process globals,
+ * so two tests may not run assertions concurrently in one process. Each
+ * worker runs its shard with CK_NOFORK on its own context, which gives the
+ * same one-context-per-worker layout.
+ */
+
+/* Builds the suite holding every test whose index % shard_count == shard. */
+typedef Suite *(*shard_runner_make_suite)(int shard, int shard_count);
+
+/* Called in each worker with its runner once the shard has run; may be NULL. */
+typedef void (*shard_runner_on_results)(SRunner *sr);
+
+/* One shard per online core. */
+int shard_runner_default_shard_count(void);
+
+/* Returns the number of tests that did not pass, like srunner_ntests_failed(). */
+int shard_runner_run(shard_runner_make_suite make_suite, int shard_count, enum print_output print_mode,
+                     shard_runner_on_results on_results);
+
+#endif
@@ -0,0 +1,131 @@
+#include "stream_buffer.h"
+
+#include <string.h>
+#include <time.h>
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+int stream_buffer_init(struct stream_buffer *stream, GLenum target, GLsizeiptr size)
+{
+    memset(stream, 0, sizeof(*stream));
+
+    if (size < STREAM_BUFFER_ALIGNMENT) {
+        return -1;
+    }
+    stream->target = target;
+    stream->size = size;
+
+    glGenBuffers(1, &stream->buffer);
+    glBindBuffer(target, stream->buffer);
+    glBufferData(target, size, NULL, GL_STREAM_DRAW);
+    glBindBuffer(target, 0);
+
+    return glGetError() == GL_NO_ERROR ? 0 : -1;
+}
+
+void stream_buffer_destroy(struct stream_buffer *stream)
+{
+    for (int i = 0; i < stream->fence_count; i++) {
+        glDeleteSync(stream->fences[(stream->oldest_fence + i) % STREAM_BUFFER_MAX_FENCES].sync);
+    }
+    glDeleteBuffers(1, &stream->buffer);
+    memset(stream, 0, sizeof(*stream));
+}
+
+void stream_buffer_fence(struct stream_buffer *stream)
+{
+    if (stream->fenced == stream->position) {
+        return;
+    }
+    if (stream->fence_count == STREAM_BUFFER_MAX_FENCES) {
+        // out of slots: fold the oldest fence into the next one, which signals later anyway
+        struct stream_buffer_fence *oldest = &stream->fences[stream->oldest_fence];
+        glDeleteSync(oldest->sync);
+        stream->oldest_fence = (stream->oldest_fence + 1) % STREAM_BUFFER_MAX_FENCES;
+        stream->fences[stream->oldest_fence].begin = oldest->begin;
+        stream->fence_count--;
+    }
+
+    int slot = (stream->oldest_fence + stream->fence_count) % STREAM_BUFFER_MAX_FENCES;
+    stream->fences[slot].sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    stream->fences[slot].begin = stream->fenced;
+    stream->fence_count++;
+    stream->fenced = stream->position;
+}
+
+/* Waits until no fenced command can still read bytes before position `until`. */
+static void wait_for(struct stream_buffer *stream, uint64_t until)
+{
+    GLsync newest = NULL;
+    int done = 0;
+
+    // fences signal in order, so waiting on the newest one that matters covers the older ones
+    while (done < stream->fence_count &&
+           stream->fences[(stream->oldest_fence + done) % STREAM_BUFFER_MAX_FENCES].begin < until) {
+        newest = stream->fences[(stream->oldest_fence + done) % STREAM_BUFFER_MAX_FENCES].sync;
+        done++;
+    }
+    if (newest == NULL) {
+        return;
+    }
+
+    if (glClientWaitSync(newest, 0, 0) != GL_ALREADY_SIGNALED) {
+        uint64_t start = now_ns();
+        while (glClientWaitSync(newest, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000u) == GL_TIMEOUT_EXPIRED) {
+        }
+        stream->waits++;
+        stream->wait_ns += now_ns() - start;
+    }
+
+    for (int i = 0; i < done; i++) {
+        glDeleteSync(stream->fences[stream->oldest_fence].sync);
+        stream->oldest_fence = (stream->oldest_fence + 1) % STREAM_BUFFER_MAX_FENCES;
+    }
+    stream->fence_count -= done;
+}
+
+void *stream_buffer_map(struct stream_buffer *stream, GLsizeiptr bytes, GLintptr *offset)
+{
+    const uint64_t size = stream->size;
+
+    if (bytes <= 0 || (uint64_t) bytes > size) {
+        return NULL;
+    }
+
+    uint64_t position = (stream->position + STREAM_BUFFER_ALIGNMENT - 1) & ~(uint64_t) (STREAM_BUFFER_ALIGNMENT - 1);
+    if (position % size + bytes > size) {
+        position += size - position % size; // does not fit before the end: start over at 0
+    }
+
+    // [position, position + bytes) reuses the bytes handed out one lap earlier
+    if (position + bytes > size) {
+        uint64_t until = position + bytes - size;
+
+        if (until > stream->fenced) {
+            stream_buffer_fence(stream);
+        }
+        wait_for(stream, until);
+    }
+
+    glBindBuffer(stream->target, stream->buffer);
+    void *data = glMapBufferRange(stream->target, position % size, bytes,
+                                  GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+    if (data == NULL) {
+        return NULL;
+    }
+
+    *offset = (GLintptr) (position % size);
+    stream->position = position + bytes;
+    return data;
+}
+
+void stream_buffer_unmap(struct stream_buffer *stream)
+{
+    glBindBuffer(stream->target, stream->buffer);
+    glUnmapBuffer(stream->target);
+}
@@ -0,0 +1,60 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <stdint.h>
+
+#include "glc.h"
+
+/*
+ * Streaming buffer for data that is rewritten every frame.
+ *
+ * One large buffer is used as a ring. stream_buffer_map() hands out the
+ * next free range, mapped with GL_MAP_UNSYNCHRONIZED_BIT so the driver
+ * never stalls on the rest of the buffer. stream_buffer_fence() fences
+ * everything handed out since the previous fence; once it has been
+ * issued after the draws that read those ranges, the map call that would
+ * overwrite them waits for that fence first. If a whole lap goes by
+ * without a fence, map drops one itself.
+ *
+ * Ranges start on STREAM_BUFFER_ALIGNMENT, enough for vertex, index and
+ * uniform buffer offsets.
+ */
+
+#define STREAM_BUFFER_ALIGNMENT 256
+#define STREAM_BUFFER_MAX_FENCES 64
+
+struct stream_buffer_fence {
+    GLsync sync;
+    uint64_t begin;     /* position of the first byte it covers */
+};
+
+struct stream_buffer {
+    GLuint buffer;
+    GLenum target;
+    GLsizeiptr size;
+    /* Positions count bytes handed out since init, so they never wrap. */
+    uint64_t position;
+    uint64_t fenced;
+    struct stream_buffer_fence fences[STREAM_BUFFER_MAX_FENCES];
+    int oldest_fence;
+    int fence_count;
+    uint64_t waits;
+    uint64_t wait_ns;
+};
+
+/* Returns 0 on success, -1 on failure. */
+int stream_buffer_init(struct stream_buffer *stream, GLenum target, GLsizeiptr size);
+void stream_buffer_destroy(struct stream_buffer *stream);
+
+/*
+ * Maps bytes bytes of the ring for writing and stores their offset in the
+ * buffer in *offset. Leaves the buffer bound to its target. NULL if bytes
+ * is larger than the ring or mapping fails.
+ */
+void *stream_buffer_map(struct stream_buffer *stream, GLsizeiptr bytes, GLintptr *offset);
+void stream_buffer_unmap(struct stream_buffer *stream);
+
+/* Call after the commands that read the ranges mapped since the last call. */
+void stream_buffer_fence(struct stream_buffer *stream);
+
+#endif
@@ -0,0 +1,543 @@
+#include "test_report.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+
+struct sample {
+    uint64_t wall_ns;   /* 0 until the test got through verification */
+    uint64_t cpu_ns;
+    uint64_t phase_ns[TEST_REPORT_PHASE_COUNT];
+    uint64_t gpu_phase_ns[TEST_REPORT_PHASE_COUNT];
+    int32_t gpu_timed;
+    int32_t result;     /* CK_PASS etc., 0 if it did not run */
+};
+
+struct test_entry {
+    char name[96];
+    char message[256];  /* of the last run that did not pass */
+    struct sample samples[TEST_REPORT_MAX_RUNS];
+};
+
+struct context_sample {
+    uint64_t wall_ns;
+    uint64_t cpu_ns;
+};
+
+/* In the shared mapping, written by whichever process ran the test. */
+struct shared {
+    int test_count;
+    int started[TEST_REPORT_MAX_SHARDS];  /* tests started by each shard this run */
+    struct test_entry tests[TEST_REPORT_MAX_TESTS];
+    struct context_sample contexts[TEST_REPORT_MAX_RUNS][TEST_REPORT_MAX_SHARDS];
+    struct name_pool_stats name_stats[NAME_POOL_TYPE_COUNT];
+};
+
+enum metric { METRIC_WALL, METRIC_CPU, METRIC_PHASE, METRIC_GPU_PHASE };
+
+static const char *const phase_names[TEST_REPORT_PHASE_COUNT] = { "setup", "body", "verify" };
+
+static struct shared *shared;
+static int run_count;
+static int current_run;
+static int current_shard;
+/* Index of the n-th test this process added. */
+static int order[TEST_REPORT_MAX_TESTS];
+static int order_count;
+
+static struct sample *current_sample;
+static int current_sample_id = -1;  /* test index * TEST_REPORT_MAX_RUNS + run */
+static enum test_report_phase current_phase;
+static uint64_t test_wall_start, test_cpu_start, phase_start;
+static uint64_t context_wall_start, context_cpu_start;
+
+static uint64_t clock_ns(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+int test_report_init(void)
+{
+    void *memory = mmap(NULL, sizeof(*shared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    if (memory == MAP_FAILED) {
+        return -1;
+    }
+    shared = memory;
+    return 0;
+}
+
+void test_report_begin_run(int run)
+{
+    current_run = run;
+    if (run + 1 > run_count) {
+        run_count = run + 1;
+    }
+    if (shared != NULL) {
+        memset(shared->started, 0, sizeof(shared->started));
+    }
+}
+
+void test_report_begin_suite(int shard)
+{
+    current_shard = shard < TEST_REPORT_MAX_SHARDS ? shard : TEST_REPORT_MAX_SHARDS - 1;
+    order_count = 0;
+}
+
+void test_report_add_test(const char *name, int index, int added)
+{
+    if (shared == NULL || index >= TEST_REPORT_MAX_TESTS) {
+        return;
+    }
+    strncpy(shared->tests[index].name, name, sizeof(shared->tests[index].name) - 1);
+    if (index + 1 > shared->test_count) {
+        shared->test_count = index + 1;
+    }
+    if (added) {
+        order[order_count++] = index;
+    }
+}
+
+struct name_pool_stats *test_report_name_stats(void)
+{
+    return shared != NULL ? shared->name_stats : NULL;
+}
+
+void test_report_begin_context(void)
+{
+    context_wall_start = clock_ns(CLOCK_MONOTONIC);
+    context_cpu_start = clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+void test_report_end_context(void)
+{
+    if (shared == NULL || current_run >= TEST_REPORT_MAX_RUNS) {
+        return;
+    }
+    struct context_sample *sample = &shared->contexts[current_run][current_shard];
+    sample->wall_ns = clock_ns(CLOCK_MONOTONIC) - context_wall_start;
+    sample->cpu_ns = clock_ns(CLOCK_PROCESS_CPUTIME_ID) - context_cpu_start;
+}
+
+void test_report_begin_test(void)
+{
+    current_sample = NULL;
+    current_sample_id = -1;
+    if (shared == NULL || current_run >= TEST_REPORT_MAX_RUNS) {
+        return;
+    }
+
+    int n = __atomic_fetch_add(&shared->started[current_shard], 1, __ATOMIC_RELAXED);
+    if (n >= order_count) {
+        return;
+    }
+
+    current_sample = &shared->tests[order[n]].samples[current_run];
+    current_sample_id = order[n] * TEST_REPORT_MAX_RUNS + current_run;
+    memset(current_sample, 0, sizeof(*current_sample));
+    current_phase = TEST_REPORT_SETUP;
+    test_cpu_start = clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+    test_wall_start = phase_start = clock_ns(CLOCK_MONOTONIC);
+}
+
+void test_report_begin_phase(enum test_report_phase phase)
+{
+    if (current_sample == NULL) {
+        return;
+    }
+    uint64_t now = clock_ns(CLOCK_MONOTONIC);
+    current_sample->phase_ns[current_phase] += now - phase_start;
+    current_phase = phase;
+    phase_start = now;
+}
+
+int test_report_current_sample(void)
+{
+    return current_sample_id;
+}
+
+void test_report_add_gpu_time(int sample_id, enum test_report_phase phase, uint64_t gpu_ns)
+{
+    if (shared == NULL || sample_id < 0 || sample_id >= TEST_REPORT_MAX_TESTS * TEST_REPORT_MAX_RUNS) {
+        return;
+    }
+    struct sample *sample = &shared->tests[sample_id / TEST_REPORT_MAX_RUNS].samples[sample_id % TEST_REPORT_MAX_RUNS];
+    sample->gpu_phase_ns[phase] += gpu_ns;
+    sample->gpu_timed = 1;
+}
+
+void test_report_end_test(void)
+{
+    if (current_sample == NULL) {
+        return;
+    }
+    uint64_t now = clock_ns(CLOCK_MONOTONIC);
+    current_sample->phase_ns[current_phase] += now - phase_start;
+    current_sample->cpu_ns = clock_ns(CLOCK_PROCESS_CPUTIME_ID) - test_cpu_start;
+    current_sample->wall_ns = now - test_wall_start;
+    current_sample = NULL;
+}
+
+void test_report_collect(SRunner *sr)
+{
+    if (shared == NULL || current_run >= TEST_REPORT_MAX_RUNS) {
+        return;
+    }
+
+    TestResult **results = srunner_results(sr);
+    int count = srunner_ntests_run(sr);
+
+    for (int i = 0; i < count && i < order_count; i++) {
+        struct test_entry *test = &shared->tests[order[i]];
+
+        test->samples[current_run].result = tr_rtype(results[i]);
+        if (tr_rtype(results[i]) != CK_PASS) {
+            snprintf(test->message, sizeof(test->message), "%s:%d: %s",
+                     tr_lfile(results[i]) ? tr_lfile(results[i]) : "", tr_lno(results[i]),
+                     tr_msg(results[i]) ? tr_msg(results[i]) : "");
+        }
+    }
+    free(results);
+}
+
+/* Entry 0 is the context creation, entry i > 0 is test i - 1. */
+static int entry_count(void)
+{
+    return shared != NULL ? shared->test_count + 1 : 0;
+}
+
+static const char *entry_name(int entry)
+{
+    return entry == 0 ? "context_creation" : shared->tests[entry - 1].name;
+}
+
+static int entry_samples(int entry, enum metric metric, int phase, double *out)
+{
+    int count = 0;
+    int runs = run_count < TEST_REPORT_MAX_RUNS ? run_count : TEST_REPORT_MAX_RUNS;
+
+    for (int run = 0; run < runs; run++) {
+        if (entry == 0) {
+            for (int shard = 0; shard < TEST_REPORT_MAX_SHARDS; shard++) {
+                const struct context_sample *sample = &shared->contexts[run][shard];
+                if (sample->wall_ns != 0) {
+                    out[count++] = (metric == METRIC_CPU ? sample->cpu_ns : sample->wall_ns) / 1e6;
+                }
+            }
+            continue;
+        }
+
+        const struct sample *sample = &shared->tests[entry - 1].samples[run];
+        if (sample->wall_ns == 0 || (metric == METRIC_GPU_PHASE && !sample->gpu_timed)) {
+            continue;
+        }
+        switch (metric) {
+        case METRIC_WALL:  out[count++] = sample->wall_ns / 1e6; break;
+        case METRIC_CPU:   out[count++] = sample->cpu_ns / 1e6; break;
+        case METRIC_PHASE: out[count++] = sample->phase_ns[phase] / 1e6; break;
+        case METRIC_GPU_PHASE: out[count++] = sample->gpu_phase_ns[phase] / 1e6; break;
+        }
+    }
+    return count;
+}
+
+/* Worst outcome over the runs: error, then failure, then pass; 0 if it never ran. */
+static int entry_result(int entry)
+{
+    int result = 0;
+
+    if (entry == 0) {
+        return CK_PASS;
+    }
+    for (int run = 0; run < run_count && run < TEST_REPORT_MAX_RUNS; run++) {
+        int r = shared->tests[entry - 1].samples[run].result;
+        result = r > result ? r : result;
+    }
+    return result;
+}
+
+static const char *result_name(int result)
+{
+    switch (result) {
+    case CK_PASS:    return "pass";
+    case CK_FAILURE: return "failure";
+    case CK_ERROR:   return "error";
+    default:         return "not run";
+    }
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+static double median(const double *samples, int count)
+{
+    double sorted[TEST_REPORT_MAX_RUNS * TEST_REPORT_MAX_SHARDS];
+
+    if (count == 0) {
+        return 0.0;
+    }
+    memcpy(sorted, samples, count * sizeof(double));
+    qsort(sorted, count, sizeof(double), compare_doubles);
+    return count % 2 ? sorted[count / 2] : (sorted[count / 2 - 1] + sorted[count / 2]) / 2;
+}
+
+static void write_json_array(FILE *file, const char *key, const double *samples, int count)
+{
+    fprintf(file, ", \"%s\": [", key);
+    for (int i = 0; i < count; i++) {
+        fprintf(file, "%s%.4f", i ? ", " : "", samples[i]);
+    }
+    fputc(']', file);
+}
+
+int test_report_write_json(const char *path, const char *suite_name)
+{
+    double samples[TEST_REPORT_MAX_RUNS * TEST_REPORT_MAX_SHARDS];
+    FILE *file = fopen(path, "w");
+
+    if (file == NULL || shared == NULL) {
+        if (file != NULL) {
+            fclose(file);
+        }
+        return -1;
+    }
+
+    // one test per line: test_report_gate() reads it back line by line
+    fprintf(file, "{\n  \"suite\": \"%s\",\n  \"runs\": %d,\n  \"tests\": [\n", suite_name, run_count);
+    for (int entry = 0; entry < entry_count(); entry++) {
+        fprintf(file, "    {\"name\": \"%s\", \"result\": \"%s\"", entry_name(entry), result_name(entry_result(entry)));
+        write_json_array(file, "wall_ms", samples, entry_samples(entry, METRIC_WALL, 0, samples));
+        write_json_array(file, "cpu_ms", samples, entry_samples(entry, METRIC_CPU, 0, samples));
+        if (entry > 0) {
+            for (int phase = 0; phase < TEST_REPORT_PHASE_COUNT; phase++) {
+                char key[32];
+                snprintf(key, sizeof(key), "%s_ms", phase_names[phase]);
+                write_json_array(file, key, samples, entry_samples(entry, METRIC_PHASE, phase, samples));
+            }
+            for (int phase = 0; phase < TEST_REPORT_PHASE_COUNT; phase++) {
+                char key[32];
+                snprintf(key, sizeof(key), "gpu_%s_ms", phase_names[phase]);
+                write_json_array(file, key, samples, entry_samples(entry, METRIC_GPU_PHASE, phase, samples));
+            }
+        }
+        fprintf(file, "}%s\n", entry + 1 < entry_count() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+
+    return fclose(file) == 0 ? 0 : -1;
+}
+
+static void write_xml_escaped(FILE *file, const char *text)
+{
+    for (; *text != '\0'; text++) {
+        switch (*text) {
+        case '&':  fputs("&amp;", file); break;
+        case '<':  fputs("&lt;", file); break;
+        case '>':  fputs("&gt;", file); break;
+        case '"':  fputs("&quot;", file); break;
+        case '\n': fputs("&#10;", file); break;
+        default:   fputc(*text, file); break;
+        }
+    }
+}
+
+int test_report_write_junit(const char *path, const char *suite_name)
+{
+    double samples[TEST_REPORT_MAX_RUNS * TEST_REPORT_MAX_SHARDS];
+    int failures = 0, errors = 0, skipped = 0;
+    double total_s = 0.0;
+    FILE *file = fopen(path, "w");
+
+    if (file == NULL || shared == NULL) {
+        if (file != NULL) {
+            fclose(file);
+        }
+        return -1;
+    }
+
+    for (int entry = 1; entry < entry_count(); entry++) {
+        int result = entry_result(entry);
+        failures += result == CK_FAILURE;
+        errors += result == CK_ERROR;
+        skipped += result == 0;
+        total_s += median(samples, entry_samples(entry, METRIC_WALL, 0, samples)) / 1e3;
+    }
+
+    // test times are medians over the runs
+    fprintf(file, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<testsuites>\n");
+    fprintf(file, "  <testsuite name=\"");
+    write_xml_escaped(file, suite_name);
+    fprintf(file, "\" tests=\"%d\" failures=\"%d\" errors=\"%d\" skipped=\"%d\" time=\"%.6f\">\n",
+            entry_count() - 1, failures, errors, skipped, total_s);
+    fprintf(file, "    <properties>\n");
+    fprintf(file, "      <property name=\"runs\" value=\"%d\"/>\n", run_count);
+    fprintf(file, "      <property name=\"context_creation_ms\" value=\"%.4f\"/>\n",
+            median(samples, entry_samples(0, METRIC_WALL, 0, samples)));
+    fprintf(file, "    </properties>\n");
+
+    for (int entry = 1; entry < entry_count(); entry++) {
+        int result = entry_result(entry);
+
+        fprintf(file, "    <testcase classname=\"Core\" name=\"%s\" time=\"%.6f\">\n", entry_name(entry),
+                median(samples, entry_samples(entry, METRIC_WALL, 0, samples)) / 1e3);
+        fprintf(file, "      <properties>\n");
+        fprintf(file, "        <property name=\"cpu_ms\" value=\"%.4f\"/>\n",
+                median(samples, entry_samples(entry, METRIC_CPU, 0, samples)));
+        for (int phase = 0; phase < TEST_REPORT_PHASE_COUNT; phase++) {
+            fprintf(file, "        <property name=\"%s_ms\" value=\"%.4f\"/>\n", phase_names[phase],
+                    median(samples, entry_samples(entry, METRIC_PHASE, phase, samples)));
+        }
+        for (int phase = 0; phase < TEST_REPORT_PHASE_COUNT; phase++) {
+            int count = entry_samples(entry, METRIC_GPU_PHASE, phase, samples);
+            if (count > 0) {
+                fprintf(file, "        <property name=\"gpu_%s_ms\" value=\"%.4f\"/>\n", phase_names[phase],
+                        median(samples, count));
+            }
+        }
+        fprintf(file, "      </properties>\n");
+        if (result == CK_FAILURE || result == CK_ERROR) {
+            fprintf(file, "      <%s message=\"", result == CK_FAILURE ? "failure" : "error");
+            write_xml_escaped(file, shared->tests[entry - 1].message);
+            fprintf(file, "\"/>\n");
+        } else if (result == 0) {
+            fprintf(file, "      <skipped/>\n");
+        }
+        fprintf(file, "    </testcase>\n");
+    }
+    fprintf(file, "  </testsuite>\n</testsuites>\n");
+
+    return fclose(file) == 0 ? 0 : -1;
+}
+
+double test_report_mann_whitney(const double *baseline, int baseline_count, const double *current, int current_count)
+{
+    double u = 0.0;
+    double n = baseline_count, m = current_count, total = n + m;
+    double ties = 0.0;
+
+    if (baseline_count == 0 || current_count == 0) {
+        return 1.0;
+    }
+
+    for (int i = 0; i < baseline_count; i++) {
+        for (int j = 0; j < current_count; j++) {
+            u += current[j] > baseline[i] ? 1.0 : current[j] == baseline[i] ? 0.5 : 0.0;
+        }
+    }
+
+    // tie correction to the variance: sum of t^3 - t over groups of equal values
+    double pooled[2 * TEST_REPORT_MAX_RUNS * TEST_REPORT_MAX_SHARDS];
+    memcpy(pooled, baseline, baseline_count * sizeof(double));
+    memcpy(pooled + baseline_count, current, current_count * sizeof(double));
+    qsort(pooled, baseline_count + current_count, sizeof(double), compare_doubles);
+    for (int i = 0, j; i < baseline_count + current_count; i = j) {
+        for (j = i + 1; j < baseline_count + current_count && pooled[j] == pooled[i]; j++) {
+        }
+        double t = j - i;
+        ties += t * t * t - t;
+    }
+
+    double variance = n * m / 12.0 * ((total + 1.0) - ties / (total * (total - 1.0)));
+    if (variance <= 0.0) {
+        return 1.0;
+    }
+    // normal approximation with continuity correction
+    double z = (u - n * m / 2.0 - 0.5) / sqrt(variance);
+    return 0.5 * erfc(z / sqrt(2.0));
+}
+
+static int read_json_array(const char *line, const char *key, double *out, int max)
+{
+    char pattern[48];
+    int count = 0;
+
+    snprintf(pattern, sizeof(pattern), "\"%s\": [", key);
+    const char *p = strstr(line, pattern);
+    if (p == NULL) {
+        return 0;
+    }
+    p += strlen(pattern);
+
+    while (count < max) {
+        char *end;
+        double value = strtod(p, &end);
+        if (end == p) {
+            break;
+        }
+        out[count++] = value;
+        p = end;
+        while (*p == ',' || *p == ' ') {
+            p++;
+        }
+    }
+    return count;
+}
+
+int test_report_gate(const char *baseline_path, double threshold_percent, FILE *out)
+{
+    enum { MAX_SAMPLES = TEST_REPORT_MAX_RUNS * TEST_REPORT_MAX_SHARDS };
+    double baseline[MAX_SAMPLES], current[MAX_SAMPLES];
+    char line[16384];
+    int compared = 0, regressions = 0;
+    FILE *file = fopen(baseline_path, "r");
+
+    if (file == NULL || shared == NULL) {
+        if (file != NULL) {
+            fclose(file);
+        }
+        return -1;
+    }
+
+    fprintf(out, "perf gate against %s: slower by more than %.1f%% with p < %.2f fails\n",
+            baseline_path, threshold_percent, TEST_REPORT_ALPHA);
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        const char *name = strstr(line, "\"name\": \"");
+        if (name == NULL) {
+            continue;
+        }
+        name += strlen("\"name\": \"");
+        const char *name_end = strchr(name, '"');
+        if (name_end == NULL) {
+            continue;
+        }
+
+        int entry = 0;
+        while (entry < entry_count() &&
+               (strncmp(entry_name(entry), name, name_end - name) != 0 || entry_name(entry)[name_end - name] != '\0')) {
+            entry++;
+        }
+        if (entry == entry_count()) {
+            continue;
+        }
+
+        int baseline_count = read_json_array(line, "wall_ms", baseline, MAX_SAMPLES);
+        int current_count = entry_samples(entry, METRIC_WALL, 0, current);
+        if (baseline_count < TEST_REPORT_MIN_SAMPLES || current_count < TEST_REPORT_MIN_SAMPLES) {
+            continue;
+        }
+        compared++;
+
+        double before = median(baseline, baseline_count);
+        double after = median(current, current_count);
+        double p = test_report_mann_whitney(baseline, baseline_count, current, current_count);
+        double change = before > 0.0 ? 100.0 * (after / before - 1.0) : 0.0;
+
+        if (p < TEST_REPORT_ALPHA && change > threshold_percent && after - before > TEST_REPORT_MIN_DELTA_MS) {
+            fprintf(out, "  REGRESSION %s: median %.3f ms -> %.3f ms (%+.1f%%, p = %.4f)\n",
+                    entry_name(entry), before, after, change, p);
+            regressions++;
+        }
+    }
+    fclose(file);
+
+    fprintf(out, "perf gate: %d test(s) compared, %d regression(s)\n", compared, regressions);
+    return compared > 0 ? regressions : -1;
+}
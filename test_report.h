@@ -0,0 +1,95 @@
+#ifndef TEST_REPORT_H
+#define TEST_REPORT_H
+
+#include <check.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "name_pool.h"
+
+/*
+ * Per-test timing, written out as JSON and JUnit XML and checked against a
+ * baseline.
+ *
+ * The checked fixture marks where each test starts, where its body starts,
+ * where verification starts and where it ends; wall and CPU time per test
+ * and wall time per phase are kept for every run of a --repeat, and so is
+ * GPU time per phase where the fixture could measure it. The shared
+ * context's creation is timed as a test of its own, "context_creation".
+ *
+ * Samples live in a shared anonymous mapping made by test_report_init(),
+ * so they survive the forked child of every test and the shard workers;
+ * call it before anything forks. Tests run in the order they were added,
+ * so the n-th test a process starts is the n-th it added; results are
+ * matched up the same way.
+ *
+ * The gate compares each test's wall time against a JSON report from an
+ * earlier run with a one-sided Mann-Whitney U test. A test regresses when
+ * it is slower with p < TEST_REPORT_ALPHA and its median grew by more than
+ * the threshold and by more than TEST_REPORT_MIN_DELTA_MS; tests with
+ * fewer than TEST_REPORT_MIN_SAMPLES runs on either side are not judged.
+ */
+
+#define TEST_REPORT_MAX_TESTS 128
+#define TEST_REPORT_MAX_RUNS 32
+#define TEST_REPORT_MAX_SHARDS 64
+#define TEST_REPORT_MIN_SAMPLES 5
+#define TEST_REPORT_ALPHA 0.01
+#define TEST_REPORT_MIN_DELTA_MS 0.5
+
+enum test_report_phase {
+    TEST_REPORT_SETUP,
+    TEST_REPORT_BODY,
+    TEST_REPORT_VERIFY,
+    TEST_REPORT_PHASE_COUNT
+};
+
+/* Returns 0, or -1 if the shared mapping could not be made; timing is then off. */
+int test_report_init(void);
+
+/* Before each run of the suite. */
+void test_report_begin_run(int run);
+
+/* While building a suite: the shard it is for, then every test in order. */
+void test_report_begin_suite(int shard);
+void test_report_add_test(const char *name, int index, int added);
+
+/* Around creating the shared context. */
+void test_report_begin_context(void);
+void test_report_end_context(void);
+
+/*
+ * Where the forked child of each test adds up its name pool's stats
+ * (name_pool_add_stats()) for the parent to print; NULL without the
+ * shared mapping.
+ */
+struct name_pool_stats *test_report_name_stats(void);
+
+/* From the checked fixture. */
+void test_report_begin_test(void);
+void test_report_begin_phase(enum test_report_phase phase);
+/*
+ * A handle on the current test's sample, -1 if there is none, for GPU
+ * times that come in later, by when another test may be running.
+ */
+int test_report_current_sample(void);
+void test_report_add_gpu_time(int sample, enum test_report_phase phase, uint64_t gpu_ns);
+void test_report_end_test(void);
+
+/* After a run, in the process that ran it: records pass, failure or error. */
+void test_report_collect(SRunner *sr);
+
+/* Return 0 on success. */
+int test_report_write_json(const char *path, const char *suite_name);
+int test_report_write_junit(const char *path, const char *suite_name);
+
+/*
+ * Returns the number of regressions, or -1 if the baseline cannot be read or
+ * has no test this run can be compared with.
+ */
+int test_report_gate(const char *baseline_path, double threshold_percent, FILE *out);
+
+/* One-sided p-value for "current is stochastically larger than baseline". */
+double test_report_mann_whitney(const double *baseline, int baseline_count, const double *current, int current_count);
+
+#endif
@@ -0,0 +1,179 @@
+#include "texture_upload.h"
+
+#include <string.h>
+
+const struct texture_upload_format texture_upload_formats[] = {
+    { "rgb8",    GL_RGB8,    GL_RGB,  GL_UNSIGNED_BYTE,               3 },
+    { "rgba8",   GL_RGBA8,   GL_RGBA, GL_UNSIGNED_BYTE,               4 },
+    { "bgra8",   GL_RGBA8,   GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV,    4 },
+    { "r8",      GL_R8,      GL_RED,  GL_UNSIGNED_BYTE,               1 },
+    { "rgba16f", GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT,                  8 },
+};
+
+const int texture_upload_format_count = sizeof(texture_upload_formats) / sizeof(texture_upload_formats[0]);
+
+const char *texture_upload_path_name(enum texture_upload_path path)
+{
+    switch (path) {
+    case TEXTURE_UPLOAD_TEX_IMAGE:     return "teximage";
+    case TEXTURE_UPLOAD_TEX_SUB_IMAGE: return "texsubimage";
+    case TEXTURE_UPLOAD_PBO_RING:      return "pbo ring";
+    default:                           return "unknown";
+    }
+}
+
+GLint texture_upload_alignment(GLsizeiptr row_bytes)
+{
+    for (GLint alignment = 8; alignment > 1; alignment /= 2) {
+        if (row_bytes % alignment == 0) {
+            return alignment;
+        }
+    }
+    return 1;
+}
+
+int texture_upload_has_storage(void)
+{
+// macOS's gl3.h stops at 4.1 and declares no glTexStorage2D to call
+#ifdef GL_VERSION_4_2
+    GLint major = 0, minor = 0, extensions = 0;
+
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major > 4 || (major == 4 && minor >= 2)) {
+        return 1;
+    }
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+    for (GLint i = 0; i < extensions; i++) {
+        if (strcmp((const char *) glGetStringi(GL_EXTENSIONS, i), "GL_ARB_texture_storage") == 0) {
+            return 1;
+        }
+    }
+#endif
+    return 0;
+}
+
+void texture_upload_allocate(GLuint texture, const struct texture_upload_format *format, GLsizei width,
+                             GLsizei height)
+{
+    glBindTexture(GL_TEXTURE_2D, texture);
+#ifdef GL_VERSION_4_2
+    if (texture_upload_has_storage()) {
+        glTexStorage2D(GL_TEXTURE_2D, 1, format->internal_format, width, height);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return;
+    }
+#endif
+    // mutable, but allocated once all the same; one level keeps it complete
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexImage2D(GL_TEXTURE_2D, 0, format->internal_format, width, height, 0, format->format, format->type, NULL);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+int texture_upload_ring_init(struct texture_upload_ring *ring, int slot_count, GLsizeiptr slot_size)
+{
+    memset(ring, 0, sizeof(*ring));
+
+    if (slot_count < 1 || slot_count > TEXTURE_UPLOAD_MAX_SLOTS) {
+        return -1;
+    }
+
+    ring->slot_count = slot_count;
+    ring->slot_size = slot_size;
+
+    for (int i = 0; i < slot_count; i++) {
+        glGenBuffers(1, &ring->slots[i].pbo);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring->slots[i].pbo);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, slot_size, NULL, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    return glGetError() == GL_NO_ERROR ? 0 : -1;
+}
+
+void texture_upload_ring_destroy(struct texture_upload_ring *ring)
+{
+    for (int i = 0; i < ring->slot_count; i++) {
+        if (ring->slots[i].fence != NULL) {
+            glDeleteSync(ring->slots[i].fence);
+        }
+        glDeleteBuffers(1, &ring->slots[i].pbo);
+    }
+    memset(ring, 0, sizeof(*ring));
+}
+
+/* Copies pixels into the next slot and leaves it bound to GL_PIXEL_UNPACK_BUFFER. */
+static int fill_slot(struct texture_upload_ring *ring, const void *pixels, GLsizeiptr bytes)
+{
+    struct texture_upload_slot *slot = &ring->slots[ring->head];
+
+    if (bytes > ring->slot_size) {
+        return -1;
+    }
+
+    if (slot->fence != NULL) {
+        GLenum wait = glClientWaitSync(slot->fence, 0, 0);
+
+        if (wait == GL_TIMEOUT_EXPIRED) {
+            ring->waits++;
+            do {
+                wait = glClientWaitSync(slot->fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000u);
+            } while (wait == GL_TIMEOUT_EXPIRED);
+        }
+        if (wait == GL_WAIT_FAILED) {
+            return -1;
+        }
+        glDeleteSync(slot->fence);
+        slot->fence = NULL;
+    }
+
+    // the fence says the GPU is done with the slot, so there is nothing to synchronise with
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot->pbo);
+    void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+                                    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (mapped == NULL) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return -1;
+    }
+    memcpy(mapped, pixels, bytes);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    return 0;
+}
+
+int texture_upload(enum texture_upload_path path, struct texture_upload_ring *ring, GLuint texture,
+                   const struct texture_upload_format *format, GLsizei width, GLsizei height, const void *pixels)
+{
+    GLsizeiptr row_bytes = (GLsizeiptr) width * format->bytes_per_pixel;
+    GLint alignment;
+
+    if (path == TEXTURE_UPLOAD_PBO_RING) {
+        if (fill_slot(ring, pixels, row_bytes * height) != 0) {
+            return -1;
+        }
+        pixels = NULL;  // an offset into the bound unpack buffer from here on
+    }
+
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, texture_upload_alignment(row_bytes));
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    if (path == TEXTURE_UPLOAD_TEX_IMAGE) {
+        glTexImage2D(GL_TEXTURE_2D, 0, format->internal_format, width, height, 0, format->format, format->type,
+                     pixels);
+    } else {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format->format, format->type, pixels);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+
+    if (path == TEXTURE_UPLOAD_PBO_RING) {
+        struct texture_upload_slot *slot = &ring->slots[ring->head];
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        ring->head = (ring->head + 1) % ring->slot_count;
+        return slot->fence != NULL ? 0 : -1;
+    }
+    return 0;
+}
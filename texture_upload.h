@@ -0,0 +1,90 @@
+#ifndef TEXTURE_UPLOAD_H
+#define TEXTURE_UPLOAD_H
+
+#include <stdint.h>
+
+#include "glc.h"
+
+/*
+ * Streaming client pixels into a 2D texture, one frame at a time, along
+ * one of three paths:
+ *
+ *   TEX_IMAGE      glTexImage2D every frame, which reallocates the level
+ *   TEX_SUB_IMAGE  glTexSubImage2D into storage allocated once, immutable
+ *                  with glTexStorage2D where the context has it
+ *   PBO_RING       a ring of GL_PIXEL_UNPACK_BUFFERs: the pixels are
+ *                  copied into the next free one and glTexSubImage2D
+ *                  sources them from there, so the call returns before
+ *                  the GPU has the data. A fence per slot keeps a slot
+ *                  from being rewritten while its upload is in flight.
+ *
+ * Rows are tightly packed; every upload sets the unpack alignment to the
+ * largest one the row length allows and puts back the previous one. An
+ * odd-width GL_RGB row only allows 1, which some drivers take slowly.
+ */
+
+#define TEXTURE_UPLOAD_MAX_SLOTS 8
+
+enum texture_upload_path {
+    TEXTURE_UPLOAD_TEX_IMAGE,
+    TEXTURE_UPLOAD_TEX_SUB_IMAGE,
+    TEXTURE_UPLOAD_PBO_RING,
+    TEXTURE_UPLOAD_PATH_COUNT
+};
+
+struct texture_upload_format {
+    const char *name;
+    GLenum internal_format;
+    GLenum format;          /* as for glTexSubImage2D */
+    GLenum type;
+    int bytes_per_pixel;
+};
+
+/* RGB8, RGBA8, BGRA8, R8 and RGBA16F. */
+extern const struct texture_upload_format texture_upload_formats[];
+extern const int texture_upload_format_count;
+
+struct texture_upload_slot {
+    GLuint pbo;
+    GLsync fence;
+};
+
+struct texture_upload_ring {
+    struct texture_upload_slot slots[TEXTURE_UPLOAD_MAX_SLOTS];
+    int slot_count;
+    int head;       /* next slot to upload from */
+    GLsizeiptr slot_size;
+    uint64_t waits; /* uploads that found their slot still in flight */
+};
+
+const char *texture_upload_path_name(enum texture_upload_path path);
+
+/* The largest unpack alignment, of 8, 4, 2 and 1, that row_bytes is a multiple of. */
+GLint texture_upload_alignment(GLsizeiptr row_bytes);
+
+/* 1 if the current context has glTexStorage2D (GL 4.2 or GL_ARB_texture_storage). */
+int texture_upload_has_storage(void);
+
+/*
+ * Allocates one level of width x height in format for texture, immutable
+ * if the context has glTexStorage2D and with glTexImage2D otherwise.
+ * Leaves GL_TEXTURE_2D bound to 0.
+ */
+void texture_upload_allocate(GLuint texture, const struct texture_upload_format *format, GLsizei width,
+                             GLsizei height);
+
+/* Returns 0 on success, -1 on failure. */
+int texture_upload_ring_init(struct texture_upload_ring *ring, int slot_count, GLsizeiptr slot_size);
+void texture_upload_ring_destroy(struct texture_upload_ring *ring);
+
+/*
+ * Uploads width x height pixels to level 0 of texture along path; ring is
+ * only used by PBO_RING. TEX_SUB_IMAGE and PBO_RING need the level to be
+ * allocated already. Returns 0, or -1 if the frame does not fit a ring
+ * slot or waiting for one failed. Leaves GL_TEXTURE_2D and
+ * GL_PIXEL_UNPACK_BUFFER bound to 0.
+ */
+int texture_upload(enum texture_upload_path path, struct texture_upload_ring *ring, GLuint texture,
+                   const struct texture_upload_format *format, GLsizei width, GLsizei height, const void *pixels);
+
+#endif
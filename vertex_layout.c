@@ -0,0 +1,270 @@
+#include "vertex_layout.h"
+
+#include <math.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define F32(size)   { size, GL_FLOAT, GL_FALSE, size * 4 }
+#define F16(size)   { size, GL_HALF_FLOAT, GL_FALSE, size * 2 }
+#define UNORM8(size)  { size, GL_UNSIGNED_BYTE, GL_TRUE, size }
+#define UNORM16(size) { size, GL_UNSIGNED_SHORT, GL_TRUE, size * 2 }
+#define SNORM_2_10_10_10 { 4, GL_INT_2_10_10_10_REV, GL_TRUE, 4 }
+
+/* Positions stored in 4 components get w = 1; normals get w = 0. */
+static const float fourth_component[VERTEX_ATTRIBUTE_COUNT] = { 1.0f, 0.0f, 0.0f, 1.0f };
+static const int source_components[VERTEX_ATTRIBUTE_COUNT] = { 3, 3, 2, 4 };
+
+const struct vertex_layout vertex_layouts[] = {
+    { "aos_f32",    1, { F32(3), F32(3), F32(2), F32(4) } },
+    { "soa_f32",    0, { F32(3), F32(3), F32(2), F32(4) } },
+    { "aos_f16",    1, { F16(4), F16(4), F16(2), F16(4) } },
+    { "aos_packed", 1, { F32(3), SNORM_2_10_10_10, UNORM16(2), UNORM8(4) } },
+    { "soa_packed", 0, { F32(3), SNORM_2_10_10_10, UNORM16(2), UNORM8(4) } },
+    { "aos_min",    1, { F16(4), SNORM_2_10_10_10, UNORM16(2), UNORM8(4) } },
+};
+
+const int vertex_layout_count = sizeof(vertex_layouts) / sizeof(vertex_layouts[0]);
+
+uint16_t vertex_layout_float_to_half(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t float_exponent = (bits >> 23) & 0xff;
+    int32_t exponent = (int32_t) float_exponent - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (float_exponent == 0xff) {
+        return (uint16_t) (sign | 0x7c00 | (mantissa ? 0x200 : 0));
+    }
+    if (exponent >= 31) {
+        return (uint16_t) (sign | 0x7c00);
+    }
+    if (exponent <= 0) {
+        if (exponent < -10) {
+            return (uint16_t) sign;
+        }
+        // subnormal: the implicit bit becomes explicit
+        mantissa |= 0x800000;
+        uint32_t shift = (uint32_t) (14 - exponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1))) {
+            half++;
+        }
+        return (uint16_t) (sign | half);
+    }
+
+    uint32_t half = ((uint32_t) exponent << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1fff;
+    // round to nearest even; a carry into the exponent is still the right answer
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+        half++;
+    }
+    return (uint16_t) (sign | half);
+}
+
+float vertex_layout_half_to_float(uint16_t half)
+{
+    uint32_t sign = (uint32_t) (half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1f;
+    uint32_t mantissa = half & 0x3ff;
+    uint32_t bits;
+    float value;
+
+    if (exponent == 0) {
+        value = ldexpf((float) mantissa, -24);
+        return sign ? -value : value;
+    }
+    if (exponent == 31) {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    } else {
+        bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    }
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static float clamp(float value, float low, float high)
+{
+    return value < low ? low : value > high ? high : value;
+}
+
+/* Stores one component at out; returns what GL reads back for it. */
+static float store_component(GLenum type, float value, unsigned char *out)
+{
+    switch (type) {
+    case GL_HALF_FLOAT: {
+        uint16_t half = vertex_layout_float_to_half(value);
+        memcpy(out, &half, sizeof(half));
+        return vertex_layout_half_to_float(half);
+    }
+    case GL_UNSIGNED_BYTE: {
+        uint8_t stored = (uint8_t) lrintf(clamp(value, 0.0f, 1.0f) * 255.0f);
+        *out = stored;
+        return stored / 255.0f;
+    }
+    case GL_UNSIGNED_SHORT: {
+        uint16_t stored = (uint16_t) lrintf(clamp(value, 0.0f, 1.0f) * 65535.0f);
+        memcpy(out, &stored, sizeof(stored));
+        return stored / 65535.0f;
+    }
+    default:
+        memcpy(out, &value, sizeof(value));
+        return value;
+    }
+}
+
+static const float *source_values(const struct vertex *vertex, enum vertex_attribute attribute)
+{
+    switch (attribute) {
+    case VERTEX_POSITION: return vertex->position;
+    case VERTEX_NORMAL:   return vertex->normal;
+    case VERTEX_UV:       return vertex->uv;
+    default:              return vertex->color;
+    }
+}
+
+/* Packs one attribute of one vertex at out; returns its largest component error. */
+static float store_attribute(const struct vertex_attribute_format *format, enum vertex_attribute attribute,
+                             const struct vertex *vertex, unsigned char *out)
+{
+    const float *values = source_values(vertex, attribute);
+    float error = 0.0f;
+
+    if (format->type == GL_INT_2_10_10_10_REV) {
+        uint32_t packed = 0;
+
+        for (int c = 0; c < 4; c++) {
+            float value = c < source_components[attribute] ? values[c] : fourth_component[attribute];
+            int bits = c < 3 ? 10 : 2;
+            int max = (1 << (bits - 1)) - 1;
+            int stored = (int) lrintf(clamp(value, -1.0f, 1.0f) * max);
+            float read = fmaxf((float) stored / max, -1.0f);
+
+            packed |= ((uint32_t) stored & ((1u << bits) - 1)) << (10 * c);
+            if (c < source_components[attribute]) {
+                error = fmaxf(error, fabsf(read - value));
+            }
+        }
+        memcpy(out, &packed, sizeof(packed));
+        return error;
+    }
+
+    int component_bytes = format->bytes / format->size;
+    for (int c = 0; c < format->size; c++) {
+        float value = c < source_components[attribute] ? values[c] : fourth_component[attribute];
+        float read = store_component(format->type, value, out + c * component_bytes);
+
+        if (c < source_components[attribute]) {
+            error = fmaxf(error, fabsf(read - value));
+        }
+    }
+    return error;
+}
+
+GLsizei vertex_layout_stride(const struct vertex_layout *layout)
+{
+    GLsizei stride = 0;
+
+    for (int a = 0; a < VERTEX_ATTRIBUTE_COUNT; a++) {
+        stride += layout->attributes[a].bytes;
+    }
+    return stride;
+}
+
+/* Where attribute a of vertex 0 goes, and how far apart consecutive vertices' are. */
+static void placement(const struct vertex_layout *layout, int a, uint32_t count, size_t *offset, GLsizei *stride)
+{
+    size_t before = 0;
+
+    for (int b = 0; b < a; b++) {
+        before += layout->attributes[b].bytes;
+    }
+    if (layout->interleaved) {
+        *offset = before;
+        *stride = vertex_layout_stride(layout);
+    } else {
+        *offset = before * count;
+        *stride = layout->attributes[a].bytes;
+    }
+}
+
+void vertex_layout_pack(const struct vertex_layout *layout, const struct vertex *vertices, uint32_t count,
+                        void *packed)
+{
+    for (int a = 0; a < VERTEX_ATTRIBUTE_COUNT; a++) {
+        unsigned char *out;
+        size_t offset;
+        GLsizei stride;
+
+        placement(layout, a, count, &offset, &stride);
+        out = (unsigned char *) packed + offset;
+        for (uint32_t i = 0; i < count; i++, out += stride) {
+            store_attribute(&layout->attributes[a], a, &vertices[i], out);
+        }
+    }
+}
+
+void vertex_layout_set_pointers(const struct vertex_layout *layout, uint32_t count)
+{
+    for (int a = 0; a < VERTEX_ATTRIBUTE_COUNT; a++) {
+        const struct vertex_attribute_format *format = &layout->attributes[a];
+        size_t offset;
+        GLsizei stride;
+
+        placement(layout, a, count, &offset, &stride);
+        glEnableVertexAttribArray(a);
+        glVertexAttribPointer(a, format->size, format->type, format->normalized, stride, (const void *) offset);
+    }
+}
+
+double vertex_layout_max_error(const struct vertex_layout *layout, enum vertex_attribute attribute,
+                               const struct vertex *vertices, uint32_t count)
+{
+    unsigned char scratch[16];
+    float error = 0.0f;
+
+    for (uint32_t i = 0; i < count; i++) {
+        error = fmaxf(error, store_attribute(&layout->attributes[attribute], attribute, &vertices[i], scratch));
+    }
+    return error;
+}
+
+void vertex_layout_fill_patch(const struct mesh *mesh, int patch, struct vertex *vertices)
+{
+    float cell = 2.0f / mesh->patches_per_row;
+    float left = -1.0f + (patch % mesh->patches_per_row) * cell;
+    float bottom = -1.0f + (patch / mesh->patches_per_row) * cell;
+
+    for (uint32_t i = 0; i < mesh->patch_vertex_count; i++) {
+        struct vertex *v = &vertices[i];
+        float u = mesh->patch_vertices[2 * i];
+        float w = mesh->patch_vertices[2 * i + 1];
+        float x = left + u * cell;
+        float y = bottom + w * cell;
+
+        // z = 0.25 sin(3 pi x) cos(2 pi y), and its normal
+        float dzdx = 0.25f * 3.0f * (float) M_PI * cosf(3.0f * (float) M_PI * x) * cosf(2.0f * (float) M_PI * y);
+        float dzdy = -0.25f * 2.0f * (float) M_PI * sinf(3.0f * (float) M_PI * x) * sinf(2.0f * (float) M_PI * y);
+        float length = sqrtf(dzdx * dzdx + dzdy * dzdy + 1.0f);
+
+        v->position[0] = x;
+        v->position[1] = y;
+        v->position[2] = 0.25f * sinf(3.0f * (float) M_PI * x) * cosf(2.0f * (float) M_PI * y);
+        v->normal[0] = -dzdx / length;
+        v->normal[1] = -dzdy / length;
+        v->normal[2] = 1.0f / length;
+        v->uv[0] = u;
+        v->uv[1] = w;
+        v->color[0] = 0.5f + 0.5f * x;
+        v->color[1] = 0.5f + 0.5f * y;
+        v->color[2] = 0.5f + 2.0f * v->position[2];
+        v->color[3] = 1.0f;
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef VERTEX_LAYOUT_H
+#define VERTEX_LAYOUT_H
+
+#include <stdint.h>
+
+#include "glc.h"
+#include "mesh.h"
+
+/*
+ * The same vertices -- position, normal, texture coordinate, color --
+ * packed every way worth comparing: float attributes interleaved (AoS) or
+ * as one stream per attribute (SoA), half floats, GL_INT_2_10_10_10_REV
+ * normals and normalised 8- and 16-bit attributes. Separate streams sit
+ * back to back in one buffer, in attribute order; to a vertex fetcher
+ * that is the same as one buffer per stream.
+ *
+ * Attribute i of every layout goes to location i.
+ */
+
+enum vertex_attribute {
+    VERTEX_POSITION,
+    VERTEX_NORMAL,
+    VERTEX_UV,
+    VERTEX_COLOR,
+    VERTEX_ATTRIBUTE_COUNT
+};
+
+/* A vertex at full precision, before packing. */
+struct vertex {
+    float position[3];
+    float normal[3];
+    float uv[2];
+    float color[4];
+};
+
+struct vertex_attribute_format {
+    GLint size;             /* components stored; 4 for the packed 2_10_10_10 types */
+    GLenum type;
+    GLboolean normalized;
+    GLsizei bytes;
+};
+
+struct vertex_layout {
+    const char *name;
+    int interleaved;
+    struct vertex_attribute_format attributes[VERTEX_ATTRIBUTE_COUNT];
+};
+
+extern const struct vertex_layout vertex_layouts[];
+extern const int vertex_layout_count;
+
+/* Bytes per vertex over all streams. */
+GLsizei vertex_layout_stride(const struct vertex_layout *layout);
+
+/* Writes count * vertex_layout_stride() bytes. */
+void vertex_layout_pack(const struct vertex_layout *layout, const struct vertex *vertices, uint32_t count,
+                        void *packed);
+
+/* Points every attribute into the GL_ARRAY_BUFFER binding, packed for count vertices, and enables it. */
+void vertex_layout_set_pointers(const struct vertex_layout *layout, uint32_t count);
+
+/* Largest difference between an attribute's components and what the layout stores for them. */
+double vertex_layout_max_error(const struct vertex_layout *layout, enum vertex_attribute attribute,
+                               const struct vertex *vertices, uint32_t count);
+
+/* A rolling heightfield over one patch of mesh, placed like mesh_place_patch(). */
+void vertex_layout_fill_patch(const struct mesh *mesh, int patch, struct vertex *vertices);
+
+uint16_t vertex_layout_float_to_half(float value);
+float vertex_layout_half_to_float(uint16_t half);
+
+#endif